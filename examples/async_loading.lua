@@ -0,0 +1,69 @@
+-- Load assets on the loader pool while the frame loop keeps running.
+-- Scripts are compiled in the background; images (if present) are decoded off-thread
+-- and uploaded to textures on the main thread once their futures are ready.
+local sdl = require 'sdl'
+local loader = require 'loader'
+
+sdl.init(sdl.INIT_VIDEO)
+
+local window = sdl.create_window("SDL3 Async Loading Demo", 800, 600, sdl.WINDOW_RESIZABLE)
+local renderer, err = sdl.create_renderer(window)
+if not renderer then
+    print("Error creating renderer: " .. (err or "Unknown error"))
+    return
+end
+
+print("Loader threads:", loader.start())
+
+local requests = {}
+for _, path in ipairs({"examples/geometry.lua", "examples/batch_shapes.lua", "examples/input_state.lua"}) do
+    requests[#requests + 1] = {kind = "script", future = loader.load_script(path)}
+end
+for _, path in ipairs({"assets/image.png", "assets/atlas.png"}) do
+    requests[#requests + 1] = {kind = "image", future = loader.load_image(path)}
+end
+
+local total = #requests
+local done = 0
+local textures = {}
+local batch = sdl.create_batch(1024)
+local input = sdl.get_input_state()
+
+while not sdl.update_input() and not input:pressed(sdl.SCANCODE_ESCAPE) do
+    -- Poll futures; nothing here blocks.
+    for i = #requests, 1, -1 do
+        local request = requests[i]
+        if request.future:ready() then
+            local value, msg = request.future:result()
+            if not value then
+                print(msg)
+            elseif request.kind == "image" then
+                textures[#textures + 1] = sdl.create_texture_from_image(renderer, value)
+                print("Uploaded", request.future:path(), value:size())
+            else
+                print("Compiled", request.future:path(), value)
+            end
+            table.remove(requests, i)
+            done = done + 1
+        end
+    end
+
+    sdl.set_render_draw_color(renderer, 20, 20, 30, 255)
+    sdl.render_clear(renderer)
+
+    -- Progress bar
+    batch:set_color(80, 80, 80)
+    batch:fill_rect(100, 280, 600, 40)
+    batch:set_color(80, 200, 120)
+    batch:fill_rect(100, 280, 600 * done / total, 40)
+    batch:flush(renderer)
+    for i, texture in ipairs(textures) do
+        batch:sprite(100 + (i - 1) * 140, 340, 128, 128)
+        batch:flush(renderer, texture)
+    end
+    sdl.render_debug_text(renderer, 100, 260, string.format("Loaded %d / %d (pending %d)", done, total, loader.pending()))
+    sdl.render_present(renderer)
+end
+
+sdl.destroy_window(window)
+sdl.quit()
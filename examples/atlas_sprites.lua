@@ -0,0 +1,74 @@
+-- Pack generated sprites into one sdl.atlas and draw them all with a single batch flush.
+-- A streaming texture is rewritten every frame from an sdl.image.
+local sdl = require 'sdl'
+
+sdl.init(sdl.INIT_VIDEO)
+
+local window = sdl.create_window("SDL3 Atlas Demo", 800, 600, sdl.WINDOW_RESIZABLE)
+local renderer, err = sdl.create_renderer(window)
+if not renderer then
+    print("Error creating renderer: " .. (err or "Unknown error"))
+    return
+end
+
+print("Window and renderer created. Press ESC or close to exit.")
+
+-- Generated sprites; sdl.load_image("file.png") works the same way.
+local function make_sprite(size, r, g, b)
+    local img = sdl.create_image(size, size)
+    local c = (size - 1) / 2
+    for y = 0, size - 1 do
+        for x = 0, size - 1 do
+            local d = math.sqrt((x - c) ^ 2 + (y - c) ^ 2)
+            if d <= c then
+                img:set_pixel(x, y, r, g, b, 255)
+            end
+        end
+    end
+    return img
+end
+
+local atlas = sdl.create_atlas(renderer, 256, 256)
+local sprites = {}
+for i = 1, 32 do
+    local size = 8 + (i % 5) * 6
+    local x, y, w, h, u0, v0, u1, v1 = atlas:add(make_sprite(size, (i * 53) % 256, (i * 97) % 256, 200))
+    if not x then break end
+    sprites[#sprites + 1] = {w = w, h = h, u0 = u0, v0 = v0, u1 = u1, v1 = v1}
+end
+print("Packed sprites:", atlas:count())
+
+-- Streaming texture updated through SDL_LockTexture
+local canvas = sdl.create_image(128, 128)
+local stream = sdl.create_texture_from_image(renderer, canvas, sdl.TEXTUREACCESS_STREAMING)
+
+local batch = sdl.create_batch(16 * 1024)
+local stream_batch = sdl.create_batch(4)
+local input = sdl.get_input_state()
+local frame = 0
+
+while not sdl.update_input() and not input:pressed(sdl.SCANCODE_ESCAPE) do
+    frame = frame + 1
+    sdl.set_render_draw_color(renderer, 20, 20, 30, 255)
+    sdl.render_clear(renderer)
+
+    for i = 1, 2000 do
+        local s = sprites[(i % #sprites) + 1]
+        local t = frame * 0.01 + i
+        batch:sprite(400 + math.cos(t) * (i % 350), 300 + math.sin(t * 1.3) * (i % 250), s.w, s.h, s.u0, s.v0, s.u1, s.v1)
+    end
+    batch:flush(renderer, atlas:texture())
+
+    canvas:fill(0, 0, 0, 255)
+    for x = 0, 127 do
+        canvas:set_pixel(x, math.floor(64 + math.sin((x + frame) * 0.1) * 60), 255, 255, 0)
+    end
+    sdl.stream_texture(stream, canvas)
+    stream_batch:sprite(660, 10, 128, 128)
+    stream_batch:flush(renderer, stream)
+
+    sdl.render_present(renderer)
+end
+
+sdl.destroy_window(window)
+sdl.quit()
@@ -0,0 +1,50 @@
+-- Draw many primitives through one sdl.batch, flushed with a single SDL_RenderGeometry call.
+local sdl = require 'sdl'
+
+sdl.init(sdl.INIT_VIDEO)
+
+local window = sdl.create_window("SDL3 Batch Demo", 800, 600, sdl.WINDOW_RESIZABLE)
+local renderer, err = sdl.create_renderer(window)
+if not renderer then
+    print("Error creating renderer: " .. (err or "Unknown error"))
+    return
+end
+
+print("Window and renderer created. Press ESC or close to exit.")
+
+local batch = sdl.create_batch(64 * 1024)
+local input = sdl.get_input_state()
+local frame = 0
+
+while not sdl.update_input() and not input:pressed(sdl.SCANCODE_ESCAPE) do
+    frame = frame + 1
+    sdl.set_render_draw_color(renderer, 20, 20, 30, 255)
+    sdl.render_clear(renderer)
+
+    -- Grid of filled rects
+    for y = 0, 59 do
+        for x = 0, 79 do
+            batch:set_color((x * 3 + frame) % 256, y * 4, 128)
+            batch:fill_rect(x * 10, y * 10, 8, 8)
+        end
+    end
+
+    -- Outlines, lines and points
+    batch:set_color(255, 255, 255)
+    batch:set_line_width(2)
+    batch:rect(100, 100, 200, 150)
+    batch:line(0, 0, 800, 600)
+    batch:line(800, 0, 0, 600)
+    batch:set_color(255, 255, 0)
+    for i = 0, 799 do
+        batch:point(i, 300 + math.sin((i + frame) * 0.05) * 50)
+    end
+    batch:quad(500, 400, 600, 420, 580, 520, 480, 500)
+    batch:triangle(650, 100, 750, 250, 600, 250)
+
+    batch:flush(renderer)
+    sdl.render_present(renderer)
+end
+
+sdl.destroy_window(window)
+sdl.quit()
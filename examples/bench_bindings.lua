@@ -0,0 +1,162 @@
+-- bench_bindings.lua
+-- Per-call cost of the hot command bindings (cmd_bind_pipeline, cmd_draw).
+-- Records into an offscreen render pass, no window or swapchain needed.
+-- Run it with builds before and after a binding change and compare the ns/call columns,
+-- or with a default build and a -DLUAVK_FAST_PATH=ON build to price the argument checks.
+local vulkan = require 'vulkan'
+
+local CALLS = tonumber(arg and arg[1]) or 2000000
+local BATCH = 10000 -- Calls per recording, keeps command buffer memory bounded
+local WIDTH, HEIGHT = 800, 600 -- cmd_begin_renderpass renders 800x600
+
+local appinfo = vulkan.create_vk_application_info({
+    application_name = "bench_bindings",
+    application_version = vulkan.make_version(1, 0, 0),
+    engine_name = "bench",
+    engine_version = vulkan.make_version(1, 0, 0),
+    api_version = vulkan.VK_API_VERSION_1_3
+})
+local instance = vulkan.create_instance(vulkan.create_info({ app_info = appinfo, extensions = {}, layers = {} }))
+local physical_device = vulkan.create_physical_devices(instance)[1].device
+
+local graphics_family
+for j, family in ipairs(vulkan.get_physical_devices_properties(physical_device)) do
+    if family.graphics then
+        graphics_family = j - 1
+        break
+    end
+end
+assert(graphics_family, "No graphics queue family")
+
+local device = vulkan.create_device(physical_device, vulkan.create_device_info({
+    queue_families = { { family_index = graphics_family, queue_count = 1 } },
+    extensions = {}
+}))
+local allocator = vulkan.create_allocator(physical_device, device)
+
+local render_pass = vulkan.create_render_pass(device, {
+    attachments = {
+        {
+            format = vulkan.FORMAT_B8G8R8A8_SRGB,
+            samples = vulkan.SAMPLE_COUNT_1_BIT,
+            load_op = vulkan.ATTACHMENT_LOAD_OP_CLEAR,
+            store_op = vulkan.ATTACHMENT_STORE_OP_STORE,
+            stencil_load_op = vulkan.ATTACHMENT_LOAD_OP_DONT_CARE,
+            stencil_store_op = vulkan.ATTACHMENT_STORE_OP_DONT_CARE,
+            initial_layout = vulkan.IMAGE_LAYOUT_UNDEFINED,
+            final_layout = vulkan.IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+        }
+    },
+    subpasses = {
+        { color_attachments = { { attachment = 0, layout = vulkan.IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } } }
+    }
+})
+local target = vulkan.create_image(allocator, {
+    width = WIDTH, height = HEIGHT, format = vulkan.FORMAT_B8G8R8A8_SRGB, usage = vulkan.IMAGE_USAGE_COLOR_ATTACHMENT
+})
+local target_view = vulkan.create_image_view(device, { image = target })
+local framebuffer = vulkan.create_framebuffer(device, {
+    render_pass = render_pass, attachments = { target_view }, width = WIDTH, height = HEIGHT, layers = 1
+})
+
+local function read_file(path)
+    local file = assert(io.open(path, "rb"), "Failed to open " .. path)
+    local data = file:read("*all")
+    file:close()
+    return data
+end
+local vert = vulkan.create_shader_module(device, read_file("shaders/triangle.vert.spv"))
+local frag = vulkan.create_shader_module(device, read_file("shaders/triangle.frag.spv"))
+local layout = vulkan.create_pipeline_layout(device, { set_layouts = {}, push_constant_ranges = {} })
+local pipeline = vulkan.create_graphics_pipelines(device, {
+    pipelines = {
+        {
+            stages = {
+                { stage = vulkan.SHADER_STAGE_VERTEX, module = vert, name = "main" },
+                { stage = vulkan.SHADER_STAGE_FRAGMENT, module = frag, name = "main" }
+            },
+            render_pass = render_pass,
+            layout = layout,
+            subpass = 0
+        }
+    }
+})[1]
+
+local pool = vulkan.create_command_pool(device, graphics_family)
+local cmd = vulkan.create_allocate_command_buffers(device, pool, 1)[1]
+
+-- Time fn(cmd, n) over CALLS calls, recording BATCH calls per render pass.
+local function measure(fn)
+    local elapsed = 0
+    local done = 0
+    while done < CALLS do
+        local n = math.min(BATCH, CALLS - done)
+        vulkan.reset_command_buffer(cmd)
+        vulkan.begin_command_buffer(cmd)
+        vulkan.cmd_begin_renderpass(cmd, render_pass, framebuffer)
+        vulkan.cmd_set_viewport(cmd, { { x = 0, y = 0, width = WIDTH, height = HEIGHT, min_depth = 0.0, max_depth = 1.0 } })
+        vulkan.cmd_set_scissor(cmd, { { x = 0, y = 0, width = WIDTH, height = HEIGHT } })
+        local start = os.clock()
+        fn(cmd, n)
+        elapsed = elapsed + (os.clock() - start)
+        vulkan.cmd_end_renderpass(cmd)
+        vulkan.end_commandbuffer(cmd)
+        done = done + n
+    end
+    return elapsed * 1e9 / CALLS
+end
+
+local viewports = { { x = 0, y = 0, width = WIDTH, height = HEIGHT, min_depth = 0.0, max_depth = 1.0 } }
+local scissors = { { x = 0, y = 0, width = WIDTH, height = HEIGHT } }
+
+local cases = {
+    { "baseline (make_version)", function(c, n)
+        local make_version = vulkan.make_version
+        for _ = 1, n do make_version(1, 0, 0) end
+    end },
+    { "cmd_bind_pipeline", function(c, n)
+        local cmd_bind_pipeline = vulkan.cmd_bind_pipeline
+        for _ = 1, n do cmd_bind_pipeline(c, pipeline) end
+    end },
+    { "cmd_draw", function(c, n)
+        local cmd_draw = vulkan.cmd_draw
+        for _ = 1, n do cmd_draw(c, 3, 1, 0, 0) end
+    end },
+    { "vulkan.cmd_draw (table lookup)", function(c, n)
+        for _ = 1, n do vulkan.cmd_draw(c, 3, 1, 0, 0) end
+    end },
+    { "cmd:bind_pipeline (method)", function(c, n)
+        for _ = 1, n do c:bind_pipeline(pipeline) end
+    end },
+    { "cmd:draw (method)", function(c, n)
+        for _ = 1, n do c:draw(3, 1, 0, 0) end
+    end },
+    { "cmd_set_viewport", function(c, n)
+        local cmd_set_viewport = vulkan.cmd_set_viewport
+        for _ = 1, n do cmd_set_viewport(c, viewports) end
+    end },
+    { "cmd_set_scissor", function(c, n)
+        local cmd_set_scissor = vulkan.cmd_set_scissor
+        for _ = 1, n do cmd_set_scissor(c, scissors) end
+    end },
+}
+
+print(string.format("%d calls per case, %s build", CALLS, vulkan.FAST_PATH and "fast path" or "checked"))
+for _, case in ipairs(cases) do
+    measure(case[2]) -- Warm up
+    print(string.format("%-32s %8.1f ns/call", case[1], measure(case[2])))
+end
+
+vulkan.device_wait_idle(device)
+vulkan.destroy_command_pool(device, pool)
+vulkan.destroy_pipeline(device, pipeline)
+vulkan.destroy_pipeline_layout(device, layout)
+vulkan.destroy_shader_module(device, vert)
+vulkan.destroy_shader_module(device, frag)
+vulkan.destroy_framebuffer(device, framebuffer)
+vulkan.destroy_image_view(device, target_view)
+vulkan.destroy_image(target)
+vulkan.destroy_render_pass(device, render_pass)
+vulkan.destroy_allocator(allocator)
+vulkan.destroy_device(device)
+vulkan.destroy_instance(instance)
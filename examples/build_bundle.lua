@@ -0,0 +1,19 @@
+-- Build a script bundle from a list of files.
+-- usage: sdl3_lua examples/build_bundle.lua
+-- then:  sdl3_lua game.bundle simple_vulkan
+
+local bundle = require 'bundle'
+
+local files = {
+    "simple_vulkan.lua",
+    "examples/draw_shapes.lua",
+    "examples/geometry.lua",
+}
+
+local count = bundle.build("game.bundle", files)
+print("Wrote game.bundle with " .. count .. " modules")
+
+local archive = assert(bundle.mount("game.bundle"))
+for _, name in ipairs(bundle.list(archive)) do
+    print("  " .. name)
+end
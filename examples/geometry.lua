@@ -22,6 +22,8 @@ local vertices = {
     {x=300, y=500, r=0.0, g=1.0, b=0.0, a=1.0}, -- Green vertex
     {x=500, y=500, r=0.0, g=0.0, b=1.0, a=1.0}  -- Blue vertex
 }
+-- Convert once into native vertex data, drawn every frame without re-parsing
+local triangle = sdl.create_geometry(vertices)
 
 while true do
     local events = sdl.poll_events()
@@ -62,7 +64,9 @@ while true do
     sdl.render_clear(renderer)
 
     -- Render geometry (triangle, no texture, no indices)
-    sdl.render_geometry(renderer, nil, vertices, nil)
+    sdl.draw_geometry(renderer, triangle)
+    -- Same geometry again, translated for this draw only
+    sdl.draw_geometry(renderer, triangle, nil, 250, 0)
 
     -- Draw debug text
     sdl.set_render_draw_color(renderer, 255, 0, 0, 255) -- Red text
@@ -0,0 +1,37 @@
+local sdl = require 'sdl'
+
+sdl.init(sdl.INIT_VIDEO)
+
+local window = sdl.create_window("SDL3 Input State Demo", 800, 600, sdl.WINDOW_RESIZABLE)
+
+print("Window created. WASD to move, ESC or close to exit.")
+
+local input = sdl.get_input_state()
+local x, y = 400, 300
+local speed = 0.01
+
+while true do
+    if sdl.update_input() or input:pressed(sdl.SCANCODE_ESCAPE) then
+        print("Exiting.")
+        break
+    end
+
+    if input:is_down(sdl.SCANCODE_W) then y = y - speed end
+    if input:is_down(sdl.SCANCODE_S) then y = y + speed end
+    if input:is_down(sdl.SCANCODE_A) then x = x - speed end
+    if input:is_down(sdl.SCANCODE_D) then x = x + speed end
+    if input:released(sdl.SCANCODE_SPACE) then
+        print(string.format("Position (%.2f, %.2f)", x, y))
+    end
+
+    local dx, dy = input:mouse_delta()
+    if input:mouse_down(sdl.BUTTON_LEFT) and (dx ~= 0 or dy ~= 0) then
+        print(string.format("Drag (%.2f, %.2f)", dx, dy))
+    end
+    if input:mouse_pressed(sdl.BUTTON_RIGHT) then
+        print(string.format("Right click at (%.2f, %.2f)", input:mouse_position()))
+    end
+end
+
+sdl.destroy_window(window)
+sdl.quit()
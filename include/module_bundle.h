@@ -0,0 +1,31 @@
+// module_bundle.h
+#ifndef MODULE_BUNDLE_H
+#define MODULE_BUNDLE_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Bundle file layout (little-endian, all offsets from start of file):
+//   header : char magic[4] "LVKB", uint32 version, uint32 count, uint32 reserved
+//   entries: count * { uint32 name_offset, uint32 name_len, uint64 data_offset, uint64 data_size }
+//   names and chunk data follow. Entries are sorted by module name.
+#define BUNDLE_MAGIC "LVKB"
+#define BUNDLE_VERSION 1
+#define BUNDLE_HEADER_SIZE 16
+#define BUNDLE_ENTRY_SIZE 24
+
+typedef struct {
+    const uint8_t* data; // Mapped file contents (read only)
+    size_t size;
+    uint32_t count;
+    void* map_handle;    // Platform mapping handle (Windows file mapping, unused on POSIX)
+    char* path;
+} lua_Bundle;
+
+lua_Bundle* lua_check_Bundle(lua_State* L, int idx);
+int bundle_mount(lua_State* L, const char* path);
+int luaopen_bundle(lua_State* L);
+
+#endif
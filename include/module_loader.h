@@ -0,0 +1,60 @@
+// module_loader.h
+#ifndef MODULE_LOADER_H
+#define MODULE_LOADER_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <SDL3/SDL.h>
+
+#define LOADER_MAX_THREADS 8
+
+typedef enum {
+    LOADER_JOB_FILE,   // Raw bytes
+    LOADER_JOB_IMAGE,  // stb_image decode to RGBA8
+    LOADER_JOB_SPIRV,  // SPIR-V words, validated
+    LOADER_JOB_SCRIPT  // Lua source compiled to a binary chunk
+} loader_job_kind;
+
+typedef enum {
+    LOADER_PENDING,
+    LOADER_DONE,
+    LOADER_FAILED
+} loader_job_state;
+
+// One request. Shared by the queue/worker and the future userdata; freed when both let go.
+typedef struct loader_job {
+    struct loader_job* next;
+    loader_job_kind kind;
+    loader_job_state state;
+    int refs;                 // Guarded by the pool lock
+    char* path;
+    unsigned char* data;      // Result bytes (pixels for images), malloc'd
+    size_t size;
+    int width, height;        // Images only
+    char error[256];
+} loader_job;
+
+// Worker pool owned by the loader module of one Lua state.
+typedef struct {
+    SDL_Mutex* lock;
+    SDL_Condition* work_ready;  // Signalled when a job is queued or on shutdown
+    SDL_Condition* job_done;    // Broadcast when any job finishes
+    SDL_Thread* threads[LOADER_MAX_THREADS];
+    int num_threads;
+    loader_job* head;
+    loader_job* tail;
+    int queued;                 // Waiting in the queue
+    int running;                // Being processed by a worker
+    bool quit;
+} loader_pool;
+
+typedef struct {
+    loader_job* job;
+    loader_pool* pool;
+} lua_loader_future;
+
+lua_loader_future* lua_check_loader_future(lua_State* L, int idx);
+loader_job_state loader_future_state(lua_loader_future* ud);
+int luaopen_loader(lua_State* L);
+
+#endif
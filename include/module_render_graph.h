@@ -0,0 +1,126 @@
+// module_render_graph.h
+#ifndef MODULE_RENDER_GRAPH_H
+#define MODULE_RENDER_GRAPH_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <vulkan/vulkan.h>
+#include "module_vulkan.h"
+
+// Frame graph over the vulkan module: Lua declares resources and passes, compile() culls
+// passes whose results are never used, aliases transient images with disjoint lifetimes onto
+// shared memory, precomputes every barrier and builds the render passes/framebuffers;
+// execute() records the frame in declaration order.
+#define RENDER_GRAPH_MAX_COLOR 8
+#define RENDER_GRAPH_DEPTH_SLOT RENDER_GRAPH_MAX_COLOR // Attachment slot of the depth buffer
+
+typedef enum {
+    RG_TRANSIENT_IMAGE,  // Created, allocated and aliased by the graph
+    RG_IMPORTED_IMAGE,   // vulkan.image owned by Lua
+    RG_SWAPCHAIN_IMAGE,  // One VkImage/VkImageView per swapchain index
+    RG_IMPORTED_BUFFER   // vulkan.buffer owned by Lua
+} rg_resource_kind;
+
+typedef struct {
+    char* name;
+    rg_resource_kind kind;
+    VkFormat format;
+    uint32_t width, height;
+    VkSampleCountFlagBits samples;
+    VkImageUsageFlags usage;        // Declared usage plus whatever the passes need
+    VkImageAspectFlags aspect;
+    VkImageLayout initial_layout;   // Swapchain images
+    VkImageLayout final_layout;     // Layout after the frame, UNDEFINED = leave as last used
+    lua_VkImage* image_ud;          // RG_IMPORTED_IMAGE
+    lua_VkBuffer* buffer_ud;        // RG_IMPORTED_BUFFER
+    VkImage* images;                // RG_SWAPCHAIN_IMAGE, image_count of each
+    VkImageView* views;
+    uint32_t image_count;
+
+    // Compiled
+    VkImage image;                  // Transient image
+    lua_VkImageView* view_ud;       // View created by the graph (transient and imported images)
+    int first_use, last_use;        // Positions in the recording order, -1 when unused
+    int slot;                       // Memory slot of a transient image
+    VkImageLayout end_layout;       // State after the frame, written back to imported resources
+    vulkan_sync_state end_sync;
+} rg_resource;
+
+typedef struct {
+    int resource;
+    int attachment;                 // Color index, RENDER_GRAPH_DEPTH_SLOT, or -1
+    int write;
+    int reads_contents;             // Reads, loaded attachments and storage writes
+    VkImageLayout layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+} rg_access;
+
+typedef struct {
+    int resource;
+    VkImageLayout old_layout, new_layout;
+    VkAccessFlags src_access, dst_access;
+    int from_current;               // Source state is read from the imported resource at execute
+} rg_barrier;
+
+typedef struct {
+    char* name;
+    int compute;
+    rg_access* accesses;
+    int access_count;
+    int color[RENDER_GRAPH_MAX_COLOR];
+    int color_count;
+    int depth;                      // Resource index or -1
+    VkClearValue clear[RENDER_GRAPH_MAX_COLOR + 1];
+    uint32_t clear_mask;            // Bit per attachment slot that is cleared
+
+    // Compiled
+    int live;
+    rg_barrier* barriers;           // Recorded before the pass
+    int barrier_count;
+    VkPipelineStageFlags src_stage, dst_stage;
+    lua_VkRenderPass* render_pass_ud;
+    VkFramebuffer* framebuffers;    // One, or one per swapchain image
+    uint32_t framebuffer_count;
+    uint32_t width, height;
+} rg_pass;
+
+// Device memory shared by transient images whose lifetimes do not overlap.
+typedef struct {
+    VkDeviceSize size, alignment;
+    uint32_t type_bits;
+    int last_use;
+    vulkan_sync_state sync;         // Last use of the slot while simulating the frame
+    vulkan_allocation allocation;
+} rg_slot;
+
+typedef struct {
+    VkDevice device;
+    lua_VkAllocator* allocator;
+    rg_resource* resources;
+    int resource_count, resource_capacity;
+    rg_pass* passes;
+    int pass_count, pass_capacity;
+
+    // Compiled
+    int compiled;
+    int* order;                     // Live pass indices in recording order
+    int order_count;
+    rg_slot* slots;
+    int slot_count;
+    rg_barrier* final_barriers;     // Imported images into their final layouts
+    int final_barrier_count;
+    VkPipelineStageFlags final_src_stage, final_dst_stage;
+    VkImageMemoryBarrier* image_scratch;
+    VkBufferMemoryBarrier* buffer_scratch;
+    int scratch_capacity;
+    VkDeviceSize transient_bytes;   // Sum of the transient image sizes
+    VkDeviceSize allocated_bytes;   // Memory actually allocated after aliasing
+    lua_Integer barriers_recorded;
+} lua_RenderGraph;
+
+lua_RenderGraph* lua_check_RenderGraph(lua_State* L, int idx);
+
+int luaopen_render_graph(lua_State* L);
+
+#endif
@@ -0,0 +1,117 @@
+// module_runtime.h
+#ifndef MODULE_RUNTIME_H
+#define MODULE_RUNTIME_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Small allocations (<= RUNTIME_POOL_MAX_SIZE) come from per size-class free
+// lists carved out of RUNTIME_POOL_SLAB_SIZE slabs; anything larger goes to realloc.
+#define RUNTIME_POOL_GRANULE 8
+#define RUNTIME_POOL_CLASSES 8
+#define RUNTIME_POOL_MAX_SIZE (RUNTIME_POOL_GRANULE * RUNTIME_POOL_CLASSES)
+#define RUNTIME_POOL_SLAB_SIZE (64 * 1024)
+
+typedef struct runtime_pool_block {
+    struct runtime_pool_block* next;
+} runtime_pool_block;
+
+typedef union runtime_pool_slab {
+    union runtime_pool_slab* next;
+    max_align_t align; // Keeps the blocks after the header aligned.
+} runtime_pool_slab;
+
+typedef struct {
+    runtime_pool_block* free_list[RUNTIME_POOL_CLASSES];
+    runtime_pool_slab* slabs;
+    size_t live_bytes;    // Bytes currently held by the Lua state.
+    size_t peak_bytes;    // High-water mark of live_bytes.
+    size_t pool_reserved; // Bytes reserved by pool slabs.
+    uint64_t total_allocs;
+    uint64_t total_frees;
+    uint64_t pool_allocs; // Allocations served from the pools.
+    uint64_t frame_allocs; // Allocations since the last runtime.end_frame().
+} runtime_allocator;
+
+// Collector scheduling driven from the frame loop (runtime.gc_step).
+typedef struct {
+    int auto_gc;          // 0 when the collector only runs from runtime.gc_step.
+    int generational;     // 1 in generational mode, 0 in incremental mode.
+    lua_Integer limit_kb; // With auto_gc off, finish the cycle once the heap passes this size (0 = no limit).
+    uint64_t steps;       // runtime.gc_step calls.
+    uint64_t cycles;      // Cycles completed inside runtime.gc_step.
+    uint64_t over_budget; // Calls that ran past their budget.
+    double last_us;       // Pause length of the last call.
+    double max_us;
+    double total_us;
+} runtime_gc_state;
+
+// Coroutine scheduler: tasks started with runtime.spawn await a condition that
+// runtime.update polls from the frame loop without blocking.
+typedef enum {
+    RUNTIME_WAIT_NEXT,     // Resume on the next update (plain coroutine.yield)
+    RUNTIME_WAIT_TIMER,    // value is the deadline in SDL_GetTicksNS units
+    RUNTIME_WAIT_FENCE,
+    RUNTIME_WAIT_TIMELINE, // value is the timeline value to reach
+    RUNTIME_WAIT_FUTURE
+} runtime_wait_kind;
+
+typedef struct {
+    lua_State* thread;    // NULL once the task has finished
+    int thread_ref;       // Registry references keeping the coroutine and the awaited object alive
+    int object_ref;
+    runtime_wait_kind wait;
+    void* object;         // lua_VkFence*, lua_VkSemaphore* or lua_loader_future*
+    uint64_t value;
+} runtime_task;
+
+typedef struct {
+    runtime_task* tasks;
+    int count, capacity;
+    int current;          // Task being resumed, -1 outside the scheduler
+    uint64_t resumes;     // Statistics
+} runtime_scheduler;
+
+// Native typed array shared between Lua states (worker messages) and read by vulkan
+// uploads without copying. A writable buffer has one owner and is moved when sent; once
+// read-only it never changes again and every handle shares it by reference count.
+typedef enum {
+    RUNTIME_BUFFER_U8,
+    RUNTIME_BUFFER_I8,
+    RUNTIME_BUFFER_U16,
+    RUNTIME_BUFFER_I16,
+    RUNTIME_BUFFER_U32,
+    RUNTIME_BUFFER_I32,
+    RUNTIME_BUFFER_F32,
+    RUNTIME_BUFFER_F64
+} runtime_buffer_type;
+
+typedef struct {
+    atomic_int refs;
+    int readonly;         // Set by the sole owner before the buffer is shared
+    runtime_buffer_type type;
+    size_t count;         // Elements
+    size_t size;          // Bytes
+    unsigned char* data;
+} runtime_buffer;
+
+typedef struct {
+    runtime_buffer* buffer; // NULL once moved or released
+} lua_RuntimeBuffer;
+
+void* runtime_alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+runtime_allocator* runtime_get_allocator(lua_State* L);
+lua_State* runtime_newstate(void);
+void runtime_close(lua_State* L);
+int runtime_drop_tasks(lua_State* L);
+void runtime_buffer_retain(runtime_buffer* buffer);
+void runtime_buffer_release(runtime_buffer* buffer);
+lua_RuntimeBuffer* lua_check_RuntimeBuffer(lua_State* L, int idx);
+lua_RuntimeBuffer* lua_test_RuntimeBuffer(lua_State* L, int idx); // NULL if not a runtime.buffer
+lua_RuntimeBuffer* lua_push_RuntimeBuffer(lua_State* L, runtime_buffer* buffer); // Takes over one reference
+int luaopen_runtime(lua_State* L);
+
+#endif
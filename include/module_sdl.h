@@ -5,6 +5,8 @@
 #include <lua.h>
 #include <lauxlib.h> // Added for luaL_ functions
 #include <SDL3/SDL.h>
+#include <stb_rect_pack.h>
+#include <stb_truetype.h>
 
 typedef struct {
     SDL_Window* window;
@@ -18,12 +20,107 @@ typedef struct {
     SDL_Texture* texture;
 } lua_SDL_Texture; // for texture support
 
+// Input snapshot kept up to date in C while events are pumped.
+#define SDL_INPUT_KEY_BYTES (SDL_SCANCODE_COUNT / 8)
+typedef struct {
+    const bool* keys;                          // SDL_GetKeyboardState, valid for the app lifetime
+    int num_keys;
+    Uint8 pressed[SDL_INPUT_KEY_BYTES];        // Went down this frame (bitset by scancode)
+    Uint8 released[SDL_INPUT_KEY_BYTES];       // Went up this frame
+    SDL_MouseButtonFlags mouse_buttons;
+    SDL_MouseButtonFlags mouse_pressed;
+    SDL_MouseButtonFlags mouse_released;
+    float mouse_x, mouse_y;
+    float mouse_dx, mouse_dy;                  // Accumulated motion this frame
+    float wheel_x, wheel_y;
+    bool quit;                                 // Quit or window close seen this frame
+} lua_SDL_InputState;
+
+// 2D primitive batch: shapes are appended as triangles and drawn with one SDL_RenderGeometry call.
+typedef struct {
+    SDL_Vertex* vertices;
+    int* indices;
+    int num_vertices, num_indices;
+    int vertex_capacity, index_capacity;
+    SDL_FColor color;   // Color applied to new primitives
+    float line_width;
+} lua_SDL_Batch;
+
+// Native float array, passed straight to SDL as SDL_FPoint / vertex data.
+typedef struct {
+    float* data;
+    int count;
+} lua_SDL_FloatArray;
+
+// Retained geometry converted once from Lua tables and drawn every frame.
+typedef struct {
+    SDL_Vertex* vertices;
+    int num_vertices;
+    int* indices;       // NULL when drawn without indices
+    int num_indices;
+} lua_SDL_Geometry;
+
+// Decoded RGBA8 pixels (stb_image), uploaded to SDL textures or Vulkan images.
+typedef struct {
+    unsigned char* pixels; // width * height * 4 bytes, rows tightly packed
+    int width, height;
+} lua_SDL_Image;
+
+// Texture atlas: images are rect-packed into one RGBA texture so sprites can share a batch flush.
+typedef struct {
+    stbrp_context packer;
+    stbrp_node* nodes;
+    SDL_Texture* texture; // Owned by the texture userdata kept in the atlas uservalue
+    int width, height;
+    int count;            // Images packed since creation or the last reset
+} lua_SDL_Atlas;
+
+// Glyph baked into a font atlas on first use.
+typedef struct {
+    Uint32 codepoint;
+    int glyph_index;
+    float advance;          // Pen advance in pixels
+    int x0, y0, w, h;       // Bitmap box relative to the pen on the baseline
+    float u0, v0, u1, v1;
+    bool used;              // Slot in use (open addressing table)
+} lua_SDL_Glyph;
+
+// TrueType font (stb_truetype) with glyphs baked on demand into an atlas texture.
+// Laid out strings are cached per font so repeated labels skip shaping.
+typedef struct {
+    stbtt_fontinfo info;
+    unsigned char* data;    // Font file contents, referenced by info
+    float size, scale;
+    float ascent, line_height;
+    lua_SDL_Glyph* glyphs;
+    int glyph_capacity, glyph_count;
+    lua_SDL_Atlas atlas;    // Texture kept alive by the font uservalue
+    lua_SDL_Batch scratch;  // Vertices for font:render
+    int cached_strings;     // Entries in the layout cache table
+} lua_SDL_Font;
+
+// Laid out string: one quad per visible glyph (x0, y0, x1, y1, u0, v0, u1, v1) relative to the text origin.
+typedef struct {
+    float* quads;
+    int num_quads;
+    float width, height;
+} lua_SDL_Text;
+
 void lua_push_SDL_Window(lua_State* L, SDL_Window* win);
 lua_SDL_Window* lua_check_SDL_Window(lua_State* L, int idx);
 void lua_push_SDL_Renderer(lua_State* L, SDL_Renderer* renderer);
 lua_SDL_Renderer* lua_check_SDL_Renderer(lua_State* L, int idx);
-void lua_push_SDL_Texture(lua_State* L, SDL_Texture* texture); 
-lua_SDL_Texture* lua_check_SDL_Texture(lua_State* L, int idx); 
+void lua_push_SDL_Texture(lua_State* L, SDL_Texture* texture);
+lua_SDL_Texture* lua_check_SDL_Texture(lua_State* L, int idx);
+lua_SDL_Batch* lua_check_SDL_Batch(lua_State* L, int idx);
+lua_SDL_FloatArray* lua_check_SDL_FloatArray(lua_State* L, int idx);
+lua_SDL_FloatArray* lua_push_SDL_FloatArray(lua_State* L, float* data, int count); // Takes ownership of malloc'd data
+lua_SDL_Geometry* lua_check_SDL_Geometry(lua_State* L, int idx);
+lua_SDL_InputState* lua_check_SDL_InputState(lua_State* L, int idx);
+lua_SDL_Image* lua_push_SDL_Image(lua_State* L, unsigned char* pixels, int width, int height); // Takes ownership of malloc'd RGBA8 pixels
+lua_SDL_Image* lua_check_SDL_Image(lua_State* L, int idx);
+lua_SDL_Atlas* lua_check_SDL_Atlas(lua_State* L, int idx);
+lua_SDL_Font* lua_check_SDL_Font(lua_State* L, int idx);
 int luaopen_sdl(lua_State* L);
 
-#endif
\ No newline at end of file
+#endif
@@ -6,6 +6,27 @@
 #include <lauxlib.h>
 #include <vulkan/vulkan.h>
 
+// Type tags of the userdata used on the per-frame path (cmd_*, submit, present). The tag is
+// the first field, so lua_check_* validates an argument with one compare instead of looking
+// the metatable up in the registry by name.
+typedef enum {
+    VULKAN_TAG_DEVICE = 0x564b0001,
+    VULKAN_TAG_QUEUE = 0x564b0002,
+    VULKAN_TAG_SWAPCHAIN = 0x564b0003,
+    VULKAN_TAG_IMAGE_VIEW = 0x564b0004,
+    VULKAN_TAG_RENDER_PASS = 0x564b0005,
+    VULKAN_TAG_FRAMEBUFFER = 0x564b0006,
+    VULKAN_TAG_PIPELINE_LAYOUT = 0x564b0007,
+    VULKAN_TAG_PIPELINE = 0x564b0008,
+    VULKAN_TAG_SEMAPHORE = 0x564b0009,
+    VULKAN_TAG_FENCE = 0x564b000a,
+    VULKAN_TAG_COMMAND_POOL = 0x564b000b,
+    VULKAN_TAG_COMMAND_BUFFER = 0x564b000c,
+    VULKAN_TAG_BUFFER = 0x564b000d,
+    VULKAN_TAG_IMAGE = 0x564b000e,
+    VULKAN_TAG_SAMPLER = 0x564b000f
+} vulkan_type_tag;
+
 typedef struct {
     VkApplicationInfo* app_info;
 } lua_VkApplicationInfo;
@@ -28,6 +49,7 @@ typedef struct {
 } lua_VkPhysicalDevice;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkDevice device;
 } lua_VkDevice;
 
@@ -36,25 +58,30 @@ typedef struct {
 } lua_VkDeviceCreateInfo;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkQueue queue;
 } lua_VkQueue;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkSwapchainKHR swapchain;
     VkDevice device;
 } lua_VkSwapchainKHR;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkImageView image_view;
     VkDevice device;
 } lua_VkImageView;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkRenderPass render_pass;
     VkDevice device;
 } lua_VkRenderPass;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkFramebuffer framebuffer;
     VkDevice device;
 } lua_VkFramebuffer;
@@ -65,35 +92,257 @@ typedef struct {
 } lua_VkShaderModule;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkPipelineLayout pipeline_layout;
     VkDevice device;
 } lua_VkPipelineLayout;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkPipeline pipeline;
     VkDevice device;
 } lua_VkPipeline;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkSemaphore semaphore;
     VkDevice device;
 } lua_VkSemaphore;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkFence fence;
     VkDevice device;
 } lua_VkFence;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkCommandPool command_pool;
     VkDevice device;
 } lua_VkCommandPool;
 
 typedef struct {
+    vulkan_type_tag tag;
     VkCommandBuffer command_buffer;
     VkDevice device;
 } lua_VkCommandBuffer;
 
+// Color attachments per dynamic rendering scope or pipeline
+#define VULKAN_MAX_COLOR_ATTACHMENTS 8
+
+// Device memory sub-allocator: VkDeviceMemory blocks per memory type, carved up with a
+// first-fit free list. Requests larger than half a block get a dedicated block.
+#define VULKAN_ALLOCATOR_BLOCK_SIZE (64ull * 1024 * 1024)
+
+typedef struct vulkan_memory_range {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    struct vulkan_memory_range* next;
+} vulkan_memory_range;
+
+typedef struct vulkan_memory_block {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    VkDeviceSize used;
+    uint32_t memory_type;
+    int dedicated;                   // Freed as soon as its single allocation is released
+    void* mapped;                    // Persistently mapped when the memory is host visible
+    vulkan_memory_range* free_list;  // Sorted by offset, adjacent ranges merged
+    struct vulkan_memory_block* next;
+} vulkan_memory_block;
+
+typedef struct {
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize block_size;
+    VkDeviceSize granularity;        // bufferImageGranularity, applied to every allocation
+    vulkan_memory_block* blocks;
+    uint32_t allocation_count;
+} lua_VkAllocator;
+
+typedef struct {
+    vulkan_memory_block* block;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+} vulkan_allocation;
+
+// Accesses that make data unavailable to later reads until a barrier flushes them
+#define VULKAN_ACCESS_WRITE_MASK (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | \
+    VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+// Barrier tracking state of an image or buffer. stage/access are the uses since the last barrier,
+// which the next barrier waits for. The last write is kept apart with the stages and accesses a
+// barrier has made it visible to, so a read outside them still gets a barrier.
+typedef struct {
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkPipelineStageFlags write_stage;   // 0 until something is written (layout transitions count)
+    VkAccessFlags write_access;
+    VkPipelineStageFlags visible_stage;
+    VkAccessFlags visible_access;
+} vulkan_sync_state;
+
+// Buffer with memory from a lua_VkAllocator. The allocator userdata is kept alive by the buffer.
+typedef struct {
+    vulkan_type_tag tag;
+    VkBuffer buffer;
+    VkDevice device;
+    lua_VkAllocator* allocator;
+    vulkan_allocation allocation;
+    VkDeviceSize size;
+    void* mapped;                    // NULL unless host visible
+    vulkan_sync_state sync;          // Barrier tracking
+} lua_VkBuffer;
+
+// Image with memory from a lua_VkAllocator.
+typedef struct {
+    vulkan_type_tag tag;
+    VkImage image;
+    VkDevice device;
+    lua_VkAllocator* allocator;
+    vulkan_allocation allocation;
+    VkFormat format;
+    VkExtent3D extent;
+    uint32_t mip_levels;
+    uint32_t array_layers;
+    VkImageAspectFlags aspect;
+    VkImageLayout layout;            // Layout of every subresource after the last recorded transition
+    vulkan_sync_state sync;          // Barrier tracking
+} lua_VkImage;
+
+typedef struct {
+    vulkan_type_tag tag;
+    VkSampler sampler;
+    VkDevice device;
+} lua_VkSampler;
+
+// Samplers deduplicated by create info; the cached userdata live in the cache uservalue.
+typedef struct {
+    VkDevice device;
+    int count;
+} lua_VkSamplerCache;
+
+// Collects the barriers needed between resource uses and records them as one vkCmdPipelineBarrier.
+// The resources pending in the current batch are kept alive by the tracker uservalue.
+typedef struct {
+    VkImageMemoryBarrier* image_barriers;
+    int image_count, image_capacity;
+    VkBufferMemoryBarrier* buffer_barriers;
+    int buffer_count, buffer_capacity;
+    VkPipelineStageFlags src_stage;
+    VkPipelineStageFlags dst_stage;
+    lua_Integer flushes, barriers, skipped; // Statistics
+} lua_VkBarrierTracker;
+
+// Owns a swapchain with its image views (and framebuffers for one render pass). Out of date and
+// suboptimal results recreate it in place with oldSwapchain; replaced resources are retired
+// through the device's deletion queue instead of waiting for the device to go idle.
+typedef struct {
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+    lua_VkDevice* device_ud;        // Kept alive by the uservalue; checked before destroying
+    VkSurfaceKHR surface;
+    VkSwapchainKHR swapchain;
+    VkSurfaceFormatKHR surface_format;
+    VkPresentModeKHR present_mode;
+    VkImageUsageFlags usage;
+    VkCompositeAlphaFlagBitsKHR composite_alpha;
+    uint32_t min_image_count;
+    uint32_t queue_family_indices[2];
+    uint32_t queue_family_count;
+    VkRenderPass render_pass;       // Framebuffers are built for it when set
+    VkExtent2D extent;              // Current swapchain size
+    VkExtent2D requested_extent;    // Window size, used when the surface leaves the size to us
+    int dirty;                      // Recreate before the next acquire
+    uint32_t image_count;
+    VkImage* images;
+    VkImageView* views;
+    VkFramebuffer* framebuffers;
+    lua_VkImageView** view_uds;     // Lua handles of views and framebuffers, invalidated on retirement
+    lua_VkFramebuffer** framebuffer_uds;
+    uint64_t frame;                 // Presents so far
+    lua_Integer generation;         // Incremented on every recreation
+} lua_VkSwapchainManager;
+
+typedef enum {
+    VULKAN_DELETE_BUFFER,
+    VULKAN_DELETE_IMAGE,
+    VULKAN_DELETE_IMAGE_VIEW,
+    VULKAN_DELETE_SAMPLER,
+    VULKAN_DELETE_FRAMEBUFFER,
+    VULKAN_DELETE_RENDER_PASS,
+    VULKAN_DELETE_SHADER_MODULE,
+    VULKAN_DELETE_PIPELINE_LAYOUT,
+    VULKAN_DELETE_PIPELINE,
+    VULKAN_DELETE_SEMAPHORE,
+    VULKAN_DELETE_FENCE,
+    VULKAN_DELETE_COMMAND_POOL,
+    VULKAN_DELETE_SWAPCHAIN
+} vulkan_deletion_kind;
+
+// A released object waiting for the GPU to finish the frame it was released in.
+typedef struct {
+    vulkan_deletion_kind kind;
+    union {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView image_view;
+        VkSampler sampler;
+        VkFramebuffer framebuffer;
+        VkRenderPass render_pass;
+        VkShaderModule shader_module;
+        VkPipelineLayout pipeline_layout;
+        VkPipeline pipeline;
+        VkSemaphore semaphore;
+        VkFence fence;
+        VkCommandPool command_pool;
+        VkSwapchainKHR swapchain;
+    } handle;
+    lua_VkAllocator* allocator;     // Buffers and images: memory returned with the handle
+    vulkan_allocation allocation;
+    uint64_t frame;                 // Queue frame during which the object was released
+} vulkan_deletion;
+
+// A frame is complete once its fence has signalled, or its timeline semaphore reached value;
+// either also covers every earlier submission on the queue.
+typedef struct {
+    uint64_t frame;
+    VkFence fence;
+    VkSemaphore semaphore;          // Timeline semaphore instead of the fence
+    uint64_t value;
+} vulkan_deletion_frame;
+
+// Deferred destruction for one device. While it exists, every destroy_* binding and __gc of an
+// object of that device queues the handle instead of destroying it; end_frame() seals the
+// releases of the current frame to the fence (or timeline value) of its submit, and they are
+// destroyed once it has signalled.
+typedef struct lua_VkDeletionQueue {
+    VkDevice device;
+    vulkan_deletion* entries;       // In release order
+    int count, capacity;
+    vulkan_deletion_frame* frames;  // Sealed frames not known to be complete, oldest first
+    int frame_count, frame_capacity;
+    uint64_t frame;                 // Frame currently being recorded
+    uint64_t completed;             // Every frame before this one has finished on the GPU
+    lua_Integer destroyed;          // Statistics
+    struct lua_VkDeletionQueue* next; // Queues of all devices
+} lua_VkDeletionQueue;
+
+VkResult vulkan_memory_alloc(lua_VkAllocator* allocator, const VkMemoryRequirements* requirements,
+                             VkMemoryPropertyFlags properties, vulkan_allocation* allocation);
+void vulkan_memory_free(lua_VkAllocator* allocator, vulkan_allocation* allocation);
+void vulkan_release(VkDevice device, vulkan_deletion* e);
+void vulkan_layout_sync(VkImageLayout layout, int is_destination, VkPipelineStageFlags* stage, VkAccessFlags* access);
+int vulkan_sync_hazard(const vulkan_sync_state* sync, VkPipelineStageFlags stage, VkAccessFlags access);
+void vulkan_sync_source(const vulkan_sync_state* sync, VkPipelineStageFlags* stage, VkAccessFlags* access);
+void vulkan_sync_merge(vulkan_sync_state* sync, VkPipelineStageFlags stage, VkAccessFlags access);
+void vulkan_sync_barrier(vulkan_sync_state* sync, VkPipelineStageFlags stage, VkAccessFlags access, int transition);
+lua_Integer opt_flags_field(lua_State* L, int idx, const char* field, lua_Integer def);
+void* tracker_grow(lua_State* L, void* array, int* capacity, size_t item_size);
+VkResult vulkan_get_semaphore_counter_value(VkDevice device, VkSemaphore semaphore, uint64_t* value);
+
 // Function prototypes for pushing/checking userdata
 void lua_push_VkApplicationInfo(lua_State* L, VkApplicationInfo* app_info);
 lua_VkApplicationInfo* lua_check_VkApplicationInfo(lua_State* L, int idx);
@@ -133,6 +382,14 @@ void lua_push_VkCommandPool(lua_State* L, VkCommandPool command_pool, VkDevice d
 lua_VkCommandPool* lua_check_VkCommandPool(lua_State* L, int idx);
 void lua_push_VkCommandBuffer(lua_State* L, VkCommandBuffer command_buffer, VkDevice device);
 lua_VkCommandBuffer* lua_check_VkCommandBuffer(lua_State* L, int idx);
+lua_VkAllocator* lua_check_VkAllocator(lua_State* L, int idx);
+lua_VkBuffer* lua_check_VkBuffer(lua_State* L, int idx);
+lua_VkImage* lua_check_VkImage(lua_State* L, int idx);
+lua_VkSampler* lua_check_VkSampler(lua_State* L, int idx);
+lua_VkSamplerCache* lua_check_VkSamplerCache(lua_State* L, int idx);
+lua_VkBarrierTracker* lua_check_VkBarrierTracker(lua_State* L, int idx);
+lua_VkSwapchainManager* lua_check_VkSwapchainManager(lua_State* L, int idx);
+lua_VkDeletionQueue* lua_check_VkDeletionQueue(lua_State* L, int idx);
 
 static int l_vulkan_create_shader_module_str(lua_State* L);
 
@@ -0,0 +1,66 @@
+// module_worker.h
+#ifndef MODULE_WORKER_H
+#define MODULE_WORKER_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <SDL3/SDL.h>
+#include <stdatomic.h>
+#include "module_runtime.h"
+
+// Extra Lua states on their own threads. Each worker runs a script with the sdl-less modules
+// (standard libraries, runtime, worker) and talks to the main state through lock-free
+// multi-producer single-consumer mailboxes of serialized messages.
+#define WORKER_MAX_DEPTH 64 // Nested tables per message; deeper (or cyclic) values are refused
+
+// Native array moved into a message; the sending userdata is left empty.
+typedef struct {
+    float* data;
+    int count;
+} worker_array;
+
+typedef struct worker_message {
+    _Atomic(struct worker_message*) next;
+    int sender;                  // Worker id, 0 for the main state
+    int array_count;
+    int buffer_count;
+    worker_array* arrays;        // Stored after the header, then buffers, then the bytes
+    runtime_buffer** buffers;    // One reference each, held until the message is freed
+    unsigned char* bytes;
+    size_t size;
+} worker_message;
+
+// Vyukov intrusive MPSC queue: producers swap themselves into head, the single consumer
+// walks from tail. The semaphore counts pushes so a consumer can sleep while it is empty.
+typedef struct {
+    _Atomic(worker_message*) head;
+    worker_message* tail;
+    worker_message stub;
+    SDL_Semaphore* ready;
+    atomic_int closed;           // No more messages will be sent
+} worker_mailbox;
+
+typedef struct {
+    int id;
+    char* path;
+    SDL_Thread* thread;
+    worker_mailbox inbox;        // Main state -> worker
+    worker_mailbox* outbox;      // Worker -> main state, shared by all workers
+    atomic_int finished;
+    char error[256];             // Script error, read after the thread has been joined
+} worker_thread;
+
+// Main-state side: the mailbox every worker sends to.
+typedef struct {
+    worker_mailbox inbox;
+    int next_id;
+} worker_hub;
+
+typedef struct {
+    worker_thread* worker;       // NULL once joined
+} lua_Worker;
+
+lua_Worker* lua_check_Worker(lua_State* L, int idx);
+int luaopen_worker(lua_State* L);
+
+#endif
@@ -1,6 +1,12 @@
 -- simple_vulkan.lua
 local sdl = require 'sdl'
 local vulkan = require 'vulkan'
+local runtime = require 'runtime'
+
+-- Collect garbage in frame idle time instead of on allocation.
+local GC_BUDGET_US = 500
+runtime.gc_mode("incremental")
+runtime.gc_auto(false, 64 * 1024) -- finish the cycle if the heap passes 64 MB
 
 sdl.init(sdl.INIT_VIDEO)
 local window = sdl.create_window("SDL3 Vulkan Lua 5.4 Demo", 800, 600, sdl.WINDOW_VULKAN | sdl.WINDOW_RESIZABLE)
@@ -154,176 +160,26 @@ if not render_pass then
     error("Failed to create render pass")
 end
 
-local image_views = {}
-local swapchain = nil
-local swapchain_images = nil
-local framebuffers = nil
-local surface_capabilities = nil
-
-local function recreate_swapchain()
-    local success, err = vulkan.device_wait_idle(device)
-    if not success then
-        print("Device wait idle failed: ", err or "No error message")
-        return false
-    end
-
-    if framebuffers then
-        for i = 1, #framebuffers do
-            vulkan.destroy_framebuffer(device, framebuffers[i])
-        end
-        framebuffers = nil
-    end
-    if image_views then
-        for i = 1, #image_views do
-            if image_views[i] then
-                vulkan.destroy_image_view(device, image_views[i])
-            end
-        end
-        image_views = {}
-    end
-    if swapchain_images then
-        swapchain_images = nil
-    end
-    if swapchain then
-        vulkan.destroy_swapchain_khr(device, swapchain)
-        swapchain = nil
-    end
-
-    surface_capabilities = vulkan.get_physical_device_surface_capabilities_KHR(physical_device, surface)
-    print("surface_capabilities:" .. tostring(surface_capabilities))
-    print("Surface Capabilities: min_image_count=" .. (surface_capabilities.min_image_count or "nil") ..
-          ", max_image_count=" .. (surface_capabilities.max_image_count or "nil") ..
-          ", current_extent=" .. (surface_capabilities.current_extent_width or "nil") .. "x" ..
-          (surface_capabilities.current_extent_height or "nil"))
-
-    local present_support = vulkan.get_physical_device_surface_support_KHR(physical_device, present_family, surface)
-    print("Checking presentation support for queue family " .. present_family .. ": " .. tostring(present_support))
-    if not present_support then
-        print("Error: Surface does not support presentation for present queue family " .. present_family)
-        return false
-    end
-
-    local create_info = {
-        surface = surface,
-        min_image_count = surface_capabilities.min_image_count,
-        format = vulkan.FORMAT_B8G8R8A8_SRGB,
-        color_space = vulkan.COLOR_SPACE_SRGB_NONLINEAR_KHR,
-        extent = {
-            width = surface_capabilities.current_extent_width,
-            height = surface_capabilities.current_extent_height
-        },
-        image_array_layers = 1,
-        image_usage = vulkan.IMAGE_USAGE_COLOR_ATTACHMENT,
-        sharing_mode = graphics_family == present_family and vulkan.SHARING_MODE_EXCLUSIVE or vulkan.SHARING_MODE_CONCURRENT,
-        queue_family_indices = graphics_family == present_family and {} or { graphics_family, present_family },
-        pre_transform = surface_capabilities.current_transform or vulkan.SURFACE_TRANSFORM_IDENTITY,
-        composite_alpha = vulkan.COMPOSITE_ALPHA_OPAQUE,
-        present_mode = vulkan.PRESENT_MODE_FIFO_KHR,
-        clipped = true,
-        old_swapchain = swapchain
-    }
-    print("create_swap_chain_KHR fields:")
-    for k, v in pairs(create_info) do
-        print(k .. ": " .. tostring(v))
-        if type(v) == "table" and k == "extent" then
-            print("extent.width: " .. tostring(v.width))
-            print("extent.height: " .. tostring(v.height))
-        end
-    end
-
-    swapchain = vulkan.create_swap_chain_KHR(device, create_info)
-    if not swapchain then
-        print("Failed to create swapchain")
-        return false
-    end
-    print("swapchain:" .. tostring(swapchain))
-    print("swapchain type:", type(swapchain), "metatable:", getmetatable(swapchain) and getmetatable(swapchain).__name or "none")
-
-    swapchain_images = vulkan.get_swapchain_images_KHR(device, swapchain)
-    print("swapchain_images:" .. tostring(swapchain_images))
-    if not swapchain_images or type(swapchain_images) ~= "table" then
-        print("Failed to get swapchain images")
-        return false
-    end
-    print("Number of swapchain images: " .. #swapchain_images)
-
-    framebuffers = {}
-    image_views = {}
-    for i = 1, #swapchain_images do
-        print("Processing swapchain_image[" .. i .. "]: " .. tostring(swapchain_images[i]))
-        if not swapchain_images[i] then
-            print("Error: swapchain_images[" .. i .. "] is nil")
-            return false
-        end
-
-        local image_view_create_info = {
-            image = swapchain_images[i],
-            format = vulkan.FORMAT_B8G8R8A8_SRGB,
-            view_type = vulkan.IMAGE_VIEW_TYPE_2D,
-            components = {
-                r = vulkan.COMPONENT_SWIZZLE_IDENTITY,
-                g = vulkan.COMPONENT_SWIZZLE_IDENTITY,
-                b = vulkan.COMPONENT_SWIZZLE_IDENTITY,
-                a = vulkan.COMPONENT_SWIZZLE_IDENTITY
-            },
-            subresource_range = {
-                aspect_mask = vulkan.IMAGE_ASPECT_COLOR_BIT,
-                base_mip_level = 0,
-                level_count = 1,
-                base_array_layer = 0,
-                layer_count = 1
-            }
-        }
-        print("image_view_create_info for image " .. i .. ":")
-        for k, v in pairs(image_view_create_info) do
-            print("  " .. k .. ": " .. tostring(v))
-            if type(v) == "table" then
-                for k2, v2 in pairs(v) do
-                    print("    " .. k2 .. ": " .. tostring(v2))
-                end
-            end
-        end
-
-        local image_view = vulkan.create_image_view(device, image_view_create_info)
-        print("image_view[" .. i .. "]: " .. tostring(image_view))
-        if not image_view then
-            print("Failed to create image view for swapchain image " .. i)
-            return false
-        end
-        image_views[i] = image_view
-
-        if not render_pass then
-            print("Error: render_pass is nil")
-            return false
-        end
-
-        local framebuffer_create_info = {
-            render_pass = render_pass,
-            attachments = { image_view },
-            width = surface_capabilities.current_extent_width,
-            height = surface_capabilities.current_extent_height,
-            layers = 1
-        }
-        print("framebuffer_create_info for image " .. i .. ":")
-        for k, v in pairs(framebuffer_create_info) do
-            print("  " .. k .. ": " .. tostring(v))
-            if type(v) == "table" then
-                for k2, v2 in pairs(v) do
-                    print("    " .. k2 .. ": " .. tostring(v2))
-                end
-            end
-        end
-
-        framebuffers[i] = vulkan.create_framebuffer(device, framebuffer_create_info)
-        print("framebuffer[" .. i .. "]: " .. tostring(framebuffers[i]))
-        if not framebuffers[i] then
-            print("Failed to create framebuffer for swapchain image " .. i)
-            return false
-        end
-    end
-    print("Created " .. #framebuffers .. " framebuffers")
-    return true
+-- The manager owns the swapchain, its views and framebuffers. On resize it recreates them with
+-- oldSwapchain and releases the old ones through the deletion queue, so there is no device_wait_idle.
+local MAX_FRAMES_IN_FLIGHT = 2
+local deletion_queue = vulkan.create_deletion_queue(device)
+local swapchain_manager = vulkan.create_swapchain_manager(physical_device, device, surface, {
+    width = 800, height = 600,
+    render_pass = render_pass,
+    queue_families = { graphics_family, present_family }
+})
+print("swapchain_manager:" .. tostring(swapchain_manager))
+local swapchain_images, image_views, framebuffers
+local swapchain_width, swapchain_height
+
+local function update_swapchain_resources()
+    swapchain_images, image_views, framebuffers = vulkan.swapchain_images(swapchain_manager)
+    local info = vulkan.swapchain_info(swapchain_manager)
+    swapchain_width, swapchain_height = info.width, info.height
+    print(string.format("Swapchain %d: %dx%d, %d images", info.generation, info.width, info.height, info.image_count))
 end
+update_swapchain_resources()
 
 print("Loading shaders")
 local function readFile(path)
@@ -376,7 +232,6 @@ else
     return
 end
 
-local MAX_FRAMES_IN_FLIGHT = 2
 local imageAvailableSemaphores = {}
 local renderFinishedSemaphores = {}
 local inFlightFences = {}
@@ -399,46 +254,44 @@ for i = 1, #commandBuffers do
     print("commandBuffers[" .. i .. "] type:", type(commandBuffers[i]), "metatable:", mt and (mt.__name or tostring(mt)) or "none")
 end
 
-if not recreate_swapchain() then
-    error("Initial swapchain creation failed")
-end
+-- Reused every frame; only the render area changes on resize.
+local renderpass_options = {
+    width = 0, height = 0,
+    clear_values = { { r = 1.0, g = 0.0, b = 0.0, a = 1.0 } }
+}
 
 local currentFrame = 1
 local function render()
     local fence = inFlightFences[currentFrame]
     vulkan.wait_for_fences(device, fence)
-    vulkan.reset_fences(device, fence)
 
-    local success, err = vulkan.device_wait_idle(device)
-    if not success then
-        print("Device wait idle failed: ", err or "No error message")
-        return false
+    local imageIndex, recreated = vulkan.swapchain_acquire(swapchain_manager, imageAvailableSemaphores[currentFrame])
+    if recreated then
+        update_swapchain_resources()
     end
-
-    local imageIndex = vulkan.acquire_next_image_KHR(device, swapchain, vulkan.UINT64_MAX, imageAvailableSemaphores[currentFrame], nil)
     if not imageIndex then
-        print("Failed to acquire next image")
-        return recreate_swapchain()
+        return true -- Minimized: skip the frame, the fence stays signalled
     end
+    vulkan.reset_fences(device, fence)
 
+    -- Record with method calls: no global/module table lookups per command.
     local cmdBuffer = commandBuffers[currentFrame]
-    vulkan.reset_command_buffer(cmdBuffer)
-    vulkan.begin_command_buffer(cmdBuffer)
-    vulkan.cmd_begin_renderpass(cmdBuffer, render_pass, framebuffers[imageIndex + 1], {
-        clear_values = { { r = 1.0, g = 0.0, b = 0.0, a = 1.0 } }
-    })
-    vulkan.cmd_set_viewport(cmdBuffer, {
-        { x = 0, y = 0, width = surface_capabilities.current_extent_width, height = surface_capabilities.current_extent_height, min_depth = 0.0, max_depth = 1.0 }
+    cmdBuffer:reset()
+    cmdBuffer:begin()
+    renderpass_options.width, renderpass_options.height = swapchain_width, swapchain_height
+    cmdBuffer:begin_renderpass(render_pass, framebuffers[imageIndex + 1], renderpass_options)
+    cmdBuffer:set_viewport({
+        { x = 0, y = 0, width = swapchain_width, height = swapchain_height, min_depth = 0.0, max_depth = 1.0 }
     })
-    vulkan.cmd_set_scissor(cmdBuffer, {
-        { x = 0, y = 0, width = surface_capabilities.current_extent_width, height = surface_capabilities.current_extent_height }
+    cmdBuffer:set_scissor({
+        { x = 0, y = 0, width = swapchain_width, height = swapchain_height }
     })
-    vulkan.cmd_bind_pipeline(cmdBuffer, pipelines[1])
-    vulkan.cmd_draw(cmdBuffer, 3, 1, 0, 0)
-    vulkan.cmd_end_renderpass(cmdBuffer)
-    vulkan.end_commandbuffer(cmdBuffer)
+    cmdBuffer:bind_pipeline(pipelines[1])
+    cmdBuffer:draw(3, 1, 0, 0)
+    cmdBuffer:end_renderpass()
+    cmdBuffer:finish()
 
-    local submit_result = vulkan.queue_submit(graphics_queue, {
+    local submit_result = graphics_queue:submit({
         wait_semaphores = { imageAvailableSemaphores[currentFrame] },
         wait_dst_stage_mask = { vulkan.PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT },
         command_buffers = {cmdBuffer},
@@ -448,17 +301,14 @@ local function render()
         print("Failed to submit command buffer")
         return false
     end
+    -- Swapchains replaced during this frame are destroyed once its fence signals
+    vulkan.deletion_queue_end_frame(deletion_queue, fence)
 
-    local present_result, err_msg = vulkan.queue_present_KHR(present_queue, {
-        wait_semaphores = { renderFinishedSemaphores[currentFrame] },
-        swapchains = {swapchain},
-        image_indices = { imageIndex }
-    })
+    -- Out of date and suboptimal results mark the swapchain for recreation on the next acquire.
+    local present_result, err_msg = vulkan.swapchain_present(swapchain_manager, present_queue,
+        renderFinishedSemaphores[currentFrame], imageIndex)
     if not present_result then
         print("Failed to present image: ", err_msg or "No error message")
-        if err_msg and err_msg:find("VkResult -8") then
-            return recreate_swapchain()
-        end
         return false
     end
 
@@ -468,21 +318,8 @@ end
 
 local function cleanup()
     vulkan.device_wait_idle(device)
-    if framebuffers then
-        for i = 1, #framebuffers do
-            vulkan.destroy_framebuffer(device, framebuffers[i])
-        end
-    end
-    if image_views then
-        for i = 1, #image_views do
-            if image_views[i] then
-                vulkan.destroy_image_view(device, image_views[i])
-            end
-        end
-    end
-    if swapchain then
-        vulkan.destroy_swapchain_khr(device, swapchain)
-    end
+    vulkan.destroy_swapchain_manager(swapchain_manager)
+    vulkan.destroy_deletion_queue(deletion_queue)
     for i = 1, #imageAvailableSemaphores do
         vulkan.destroy_semaphore(device, imageAvailableSemaphores[i])
         vulkan.destroy_semaphore(device, renderFinishedSemaphores[i])
@@ -503,17 +340,23 @@ local function cleanup()
 end
 
 local running = true
+local events = {}
 while running do
-    local events = sdl.poll_events()
-    for i, event in ipairs(events) do
+    local _, event_count = sdl.poll_events(events)
+    for i = 1, event_count do
+        local event = events[i]
         if event.type == sdl.QUIT or (event.type == sdl.WINDOW_CLOSE and event.window_id == window_id) then
             print("Window closed.")
             running = false
+        elseif event.type == sdl.WINDOW_PIXEL_SIZE_CHANGED and event.window_id == window_id then
+            vulkan.swapchain_resize(swapchain_manager, event.width, event.height)
         end
     end
     if not render() then
         running = false
     end
+    runtime.end_frame()
+    runtime.gc_step(GC_BUDGET_US)
 end
 
 print("finished lua")
@@ -10,6 +10,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include "module_bundle.h"
+#include "module_runtime.h"
+#include "module_loader.h"
+#include "module_render_graph.h"
+#include "module_worker.h"
 
 // Declare the sdl module's entry point (from module_sdl.c).
 int luaopen_sdl(lua_State* L);
@@ -25,19 +30,25 @@ static int file_exists(const char* path) {
     return 0; // File does not exist.
 }
 
-// Check if the file has a .lua extension.
+// Check if the file has a script extension: .lua source or .luac/.out bytecode (luac or string.dump output).
 static int has_lua_extension(const char* path) {
     const char* ext = strrchr(path, '.'); // Find the last '.' in the path.
-    if (ext && strcmp(ext, ".lua") == 0) {
-        return 1; // Has .lua extension.
+    if (ext && (strcmp(ext, ".lua") == 0 || strcmp(ext, ".luac") == 0 || strcmp(ext, ".out") == 0)) {
+        return 1; // Has script extension.
     }
-    return 0; // Does not have .lua extension.
+    return 0; // Does not have script extension.
+}
+
+// Check if the file is a script bundle (see module_bundle.h).
+static int has_bundle_extension(const char* path) {
+    const char* ext = strrchr(path, '.');
+    return ext && strcmp(ext, ".bundle") == 0;
 }
 
 int main(int argc, char* argv[]) {
     printf("SDL 3.2 Vulkan Lua 5.4\n");
-    // Initialize Lua state.
-    lua_State* L = luaL_newstate();
+    // Initialize Lua state with the pooled allocator (module_runtime.c).
+    lua_State* L = runtime_newstate();
     if (!L) {
         fprintf(stderr, "Failed to create Lua state\n");
         return 1;
@@ -53,6 +64,21 @@ int main(int argc, char* argv[]) {
     luaL_requiref(L, "vulkan", luaopen_vulkan, 1);
     lua_pop(L, 1); // Remove module from stack.
 
+    luaL_requiref(L, "bundle", luaopen_bundle, 1);
+    lua_pop(L, 1); // Remove module from stack.
+
+    luaL_requiref(L, "runtime", luaopen_runtime, 1);
+    lua_pop(L, 1); // Remove module from stack.
+
+    luaL_requiref(L, "loader", luaopen_loader, 1);
+    lua_pop(L, 1); // Remove module from stack.
+
+    luaL_requiref(L, "render_graph", luaopen_render_graph, 1);
+    lua_pop(L, 1); // Remove module from stack.
+
+    luaL_requiref(L, "worker", luaopen_worker, 1);
+    lua_pop(L, 1); // Remove module from stack.
+
     // Determine script path: command-line arg or default to "main.lua".
     const char* script_path = (argc >= 2) ? argv[1] : "simple_vulkan.lua";
 
@@ -60,35 +86,67 @@ int main(int argc, char* argv[]) {
     if (!file_exists(script_path)) {
         fprintf(stderr, "Error: Script '%s' not found\n", script_path);
         if (argc < 2) {
-            fprintf(stderr, "Usage: %s [<lua_script_path>]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [<lua_script_path> | <bundle_path> [<entry_module>]]\n", argv[0]);
         }
-        lua_close(L);
+        runtime_close(L);
         return 1;
     }
 
-    // Check if the script has a .lua extension.
+    // Bundle: mount it and require the entry module (default "main") from it.
+    if (has_bundle_extension(script_path)) {
+        const char* entry = (argc >= 3) ? argv[2] : "main";
+        if (!bundle_mount(L, script_path)) {
+            fprintf(stderr, "Error: %s\n", lua_tostring(L, -1));
+            runtime_close(L);
+            return 1;
+        }
+        lua_pop(L, 1); // Searcher keeps the bundle alive.
+        lua_getglobal(L, "require");
+        lua_pushstring(L, entry);
+        if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+            fprintf(stderr, "Error running module '%s' from bundle '%s': %s\n", entry, script_path, lua_tostring(L, -1));
+            runtime_close(L);
+            return 1;
+        }
+        int dropped = runtime_drop_tasks(L);
+        if (dropped > 0) {
+            fprintf(stderr, "Warning: bundle '%s' returned with %d task(s) still waiting; dropped them\n", script_path, dropped);
+        }
+        runtime_close(L);
+        SDL_Quit();
+        return 0;
+    }
+
+    // Check if the script has a .lua/.luac extension.
     if (!has_lua_extension(script_path)) {
-        fprintf(stderr, "Error: Script '%s' does not have a .lua extension\n", script_path);
-        lua_close(L);
+        fprintf(stderr, "Error: Script '%s' does not have a .lua or .luac extension\n", script_path);
+        runtime_close(L);
         return 1;
     }
 
-    // Load and run the Lua script.
+    // Load and run the Lua script. luaL_loadfile detects the bytecode signature,
+    // so precompiled chunks skip the parser.
     if (luaL_loadfile(L, script_path) != LUA_OK) {
         fprintf(stderr, "Error loading script '%s': %s\n", script_path, lua_tostring(L, -1));
-        lua_close(L);
+        runtime_close(L);
         return 1;
     }
 
     // Execute the script.
     if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
         fprintf(stderr, "Error running script '%s': %s\n", script_path, lua_tostring(L, -1));
-        lua_close(L);
+        runtime_close(L);
         return 1;
     }
 
+    // Drop the tasks the script left waiting (runtime.spawn); they are not resumed.
+    int dropped = runtime_drop_tasks(L);
+    if (dropped > 0) {
+        fprintf(stderr, "Warning: script '%s' returned with %d task(s) still waiting; dropped them\n", script_path, dropped);
+    }
+
     // Clean up.
-    lua_close(L);
+    runtime_close(L);
     SDL_Quit(); // Ensure SDL is cleaned up after script execution.
     return 0;
 }
\ No newline at end of file
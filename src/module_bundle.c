@@ -0,0 +1,475 @@
+// module_bundle.c
+// Memory-mapped script bundles. A bundle packs many Lua chunks (source or
+// precompiled bytecode) into one file that is mapped read only and loaded
+// straight from the mapping through a package.searchers entry.
+
+#include "module_bundle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char* BUNDLE_MT = "bundle.archive";
+
+//===============================================
+// Mapping
+//===============================================
+
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const uint8_t* p) {
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+// Map a whole file read only. Returns 0 and sets err on failure.
+static int map_file(lua_Bundle* b, const char* path, const char** err) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        *err = "cannot open file";
+        return 0;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        *err = "empty or unreadable file";
+        return 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        *err = "CreateFileMapping failed";
+        return 0;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        *err = "MapViewOfFile failed";
+        return 0;
+    }
+    b->data = (const uint8_t*)view;
+    b->size = (size_t)size.QuadPart;
+    b->map_handle = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        *err = "cannot open file";
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        *err = "empty or unreadable file";
+        return 0;
+    }
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file.
+    if (view == MAP_FAILED) {
+        *err = "mmap failed";
+        return 0;
+    }
+    b->data = (const uint8_t*)view;
+    b->size = (size_t)st.st_size;
+    b->map_handle = NULL;
+#endif
+    return 1;
+}
+
+static void unmap_file(lua_Bundle* b) {
+    if (!b->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)b->data);
+    if (b->map_handle) CloseHandle((HANDLE)b->map_handle);
+#else
+    munmap((void*)b->data, b->size);
+#endif
+    b->data = NULL;
+    b->size = 0;
+    b->map_handle = NULL;
+}
+
+// Check header and that every entry points inside the mapping.
+static int validate_bundle(lua_Bundle* b, const char** err) {
+    if (b->size < BUNDLE_HEADER_SIZE || memcmp(b->data, BUNDLE_MAGIC, 4) != 0) {
+        *err = "not a bundle file";
+        return 0;
+    }
+    if (read_u32(b->data + 4) != BUNDLE_VERSION) {
+        *err = "unsupported bundle version";
+        return 0;
+    }
+    uint64_t count = read_u32(b->data + 8);
+    if (count > (b->size - BUNDLE_HEADER_SIZE) / BUNDLE_ENTRY_SIZE) {
+        *err = "truncated entry table";
+        return 0;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        const uint8_t* e = b->data + BUNDLE_HEADER_SIZE + i * BUNDLE_ENTRY_SIZE;
+        uint64_t name_off = read_u32(e), name_len = read_u32(e + 4);
+        uint64_t data_off = read_u64(e + 8), data_size = read_u64(e + 16);
+        if (name_off > b->size || name_len > b->size - name_off ||
+            data_off > b->size || data_size > b->size - data_off) {
+            *err = "entry out of range";
+            return 0;
+        }
+    }
+    b->count = (uint32_t)count;
+    return 1;
+}
+
+//===============================================
+// Lookup
+//===============================================
+
+static const uint8_t* entry_at(const lua_Bundle* b, uint32_t i) {
+    return b->data + BUNDLE_HEADER_SIZE + (size_t)i * BUNDLE_ENTRY_SIZE;
+}
+
+static int compare_names(const char* a, size_t alen, const char* b, size_t blen) {
+    int r = memcmp(a, b, alen < blen ? alen : blen);
+    if (r != 0) return r;
+    return (alen > blen) - (alen < blen);
+}
+
+// Binary search by module name (entries are sorted at build time).
+static const uint8_t* find_entry(const lua_Bundle* b, const char* name, size_t len) {
+    uint32_t lo = 0, hi = b->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const uint8_t* e = entry_at(b, mid);
+        int r = compare_names((const char*)b->data + read_u32(e), read_u32(e + 4), name, len);
+        if (r == 0) return e;
+        if (r < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+// Load an entry as a chunk. Pushes the function, or an error message on failure.
+static int load_entry(lua_State* L, const lua_Bundle* b, const uint8_t* e, const char* name) {
+    lua_pushfstring(L, "@%s", name);
+    const char* chunkname = lua_tostring(L, -1);
+    int status = luaL_loadbufferx(L, (const char*)b->data + read_u64(e + 8),
+                                  (size_t)read_u64(e + 16), chunkname, "bt");
+    lua_remove(L, -2); // chunkname
+    return status;
+}
+
+//===============================================
+// Bundle userdata
+//===============================================
+
+static int bundle_gc(lua_State* L) {
+    lua_Bundle* b = (lua_Bundle*)luaL_checkudata(L, 1, BUNDLE_MT);
+    unmap_file(b);
+    free(b->path);
+    b->path = NULL;
+    return 0;
+}
+
+lua_Bundle* lua_check_Bundle(lua_State* L, int idx) {
+    lua_Bundle* b = (lua_Bundle*)luaL_checkudata(L, idx, BUNDLE_MT);
+    if (!b->data) {
+        luaL_error(L, "Invalid bundle (already closed)");
+    }
+    return b;
+}
+
+static void bundle_metatable(lua_State* L) {
+    luaL_newmetatable(L, BUNDLE_MT);
+    lua_pushcfunction(L, bundle_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+// package.searchers entry; upvalue 1 is the bundle userdata.
+static int bundle_searcher(lua_State* L) {
+    size_t len;
+    const char* name = luaL_checklstring(L, 1, &len);
+    lua_Bundle* b = (lua_Bundle*)lua_touserdata(L, lua_upvalueindex(1));
+    if (!b->data) {
+        lua_pushfstring(L, "no module '%s' (bundle closed)", name);
+        return 1;
+    }
+    const uint8_t* e = find_entry(b, name, len);
+    if (!e) {
+        lua_pushfstring(L, "no module '%s' in bundle '%s'", name, b->path);
+        return 1;
+    }
+    if (load_entry(L, b, e, name) != LUA_OK) {
+        return luaL_error(L, "error loading module '%s' from bundle '%s':\n\t%s",
+                          name, b->path, lua_tostring(L, -1));
+    }
+    lua_pushstring(L, b->path); // Second argument passed to the loader.
+    return 2;
+}
+
+// Map a bundle and insert its searcher right after package.preload.
+// Pushes the bundle userdata and returns 1, or pushes an error message and returns 0.
+int bundle_mount(lua_State* L, const char* path) {
+    lua_Bundle* b = (lua_Bundle*)lua_newuserdata(L, sizeof(lua_Bundle));
+    memset(b, 0, sizeof(lua_Bundle));
+    luaL_setmetatable(L, BUNDLE_MT);
+
+    const char* err = NULL;
+    if (!map_file(b, path, &err) || !validate_bundle(b, &err)) {
+        unmap_file(b);
+        lua_pop(L, 1);
+        lua_pushfstring(L, "Failed to mount bundle '%s': %s", path, err);
+        return 0;
+    }
+    b->path = (char*)malloc(strlen(path) + 1);
+    if (b->path) strcpy(b->path, path);
+
+    lua_getglobal(L, "package");
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 2);
+        lua_pushstring(L, "Failed to mount bundle: package library not loaded");
+        return 0;
+    }
+    lua_getfield(L, -1, "searchers");
+    lua_remove(L, -2); // package
+    lua_Integer n = (lua_Integer)lua_rawlen(L, -1);
+    for (lua_Integer i = n; i >= 2; i--) {
+        lua_rawgeti(L, -1, i);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushvalue(L, -2); // bundle
+    lua_pushcclosure(L, bundle_searcher, 1);
+    lua_rawseti(L, -2, 2);
+    lua_pop(L, 1); // searchers
+    return 1;
+}
+
+//===============================================
+// Builder
+//===============================================
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} dump_buffer;
+
+static int dump_writer(lua_State* L, const void* p, size_t sz, void* ud) {
+    (void)L;
+    dump_buffer* buf = (dump_buffer*)ud;
+    if (buf->size + sz > buf->capacity) {
+        size_t cap = buf->capacity ? buf->capacity * 2 : 4096;
+        while (cap < buf->size + sz) cap *= 2;
+        char* data = (char*)realloc(buf->data, cap);
+        if (!data) return 1;
+        buf->data = data;
+        buf->capacity = cap;
+    }
+    memcpy(buf->data + buf->size, p, sz);
+    buf->size += sz;
+    return 0;
+}
+
+typedef struct {
+    const char* name;
+    size_t name_len;
+    const char* blob;
+    size_t blob_len;
+} build_entry;
+
+static int compare_build_entries(const void* a, const void* b) {
+    const build_entry* ea = (const build_entry*)a;
+    const build_entry* eb = (const build_entry*)b;
+    return compare_names(ea->name, ea->name_len, eb->name, eb->name_len);
+}
+
+// Module name from a file path: "./ui/button.lua" -> "ui.button", "ui/init.lua" -> "ui".
+static void push_module_name(lua_State* L, const char* path) {
+    if (path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path += 2;
+    size_t len = strlen(path);
+    const char* ext = strrchr(path, '.');
+    if (ext && (strcmp(ext, ".lua") == 0 || strcmp(ext, ".luac") == 0)) {
+        len = (size_t)(ext - path);
+    }
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    for (size_t i = 0; i < len; i++) {
+        luaL_addchar(&b, (path[i] == '/' || path[i] == '\\') ? '.' : path[i]);
+    }
+    luaL_pushresult(&b);
+    size_t name_len;
+    const char* name = lua_tolstring(L, -1, &name_len);
+    if (name_len > 5 && strcmp(name + name_len - 5, ".init") == 0) {
+        lua_pushlstring(L, name, name_len - 5);
+        lua_remove(L, -2);
+    }
+}
+
+static void write_u32(FILE* f, uint32_t v) {
+    uint8_t p[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    fwrite(p, 1, 4, f);
+}
+
+static void write_u64(FILE* f, uint64_t v) {
+    write_u32(f, (uint32_t)v);
+    write_u32(f, (uint32_t)(v >> 32));
+}
+
+// Build a bundle: bundle.build(out_path, files, [strip])
+// files is an array of script paths (module name derived from the path)
+// and/or a map of module name -> script path. Each script is compiled and
+// stored as bytecode, so loading skips the parser entirely.
+static int l_bundle_build(lua_State* L) {
+    const char* out_path = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    int strip = lua_isnoneornil(L, 3) ? 1 : lua_toboolean(L, 3);
+
+    // Validate the paths and size the entry array first. The array is a userdata, so a
+    // compile error or failed allocation below leaves nothing to free.
+    size_t total = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        luaL_checkstring(L, -1);
+        total++;
+        lua_pop(L, 1);
+    }
+    build_entry* entries = (build_entry*)lua_newuserdatauv(L, (total ? total : 1) * sizeof(build_entry), 0);
+    lua_newtable(L); // Anchors names and blobs while the entry array points at them.
+    int anchor = lua_gettop(L);
+    size_t count = 0;
+
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        const char* path = lua_tostring(L, -1);
+        if (lua_type(L, -2) == LUA_TSTRING) {
+            lua_pushvalue(L, -2);
+        } else {
+            push_module_name(L, path);
+        }
+        // stack: key, path, name
+        if (luaL_loadfilex(L, path, "bt") != LUA_OK) {
+            return luaL_error(L, "Failed to compile '%s': %s", path, lua_tostring(L, -1));
+        }
+        dump_buffer buf = { 0 };
+        int dump_status = lua_dump(L, dump_writer, &buf, strip);
+        lua_pop(L, 1); // function
+        if (dump_status != 0) {
+            free(buf.data);
+            return luaL_error(L, "Failed to dump '%s': out of memory", path);
+        }
+        lua_pushlstring(L, buf.data, buf.size);
+        free(buf.data);
+
+        build_entry* e = &entries[count++];
+        e->blob = lua_tolstring(L, -1, &e->blob_len);
+        e->name = lua_tolstring(L, -2, &e->name_len);
+        lua_rawseti(L, anchor, (lua_Integer)(2 * count));     // blob
+        lua_rawseti(L, anchor, (lua_Integer)(2 * count - 1)); // name
+        lua_pop(L, 1); // path, keep key
+    }
+
+    qsort(entries, count, sizeof(build_entry), compare_build_entries);
+    for (size_t i = 1; i < count; i++) {
+        if (compare_build_entries(&entries[i - 1], &entries[i]) == 0) {
+            lua_pushlstring(L, entries[i].name, entries[i].name_len);
+            return luaL_error(L, "Failed to build bundle: duplicate module '%s'", lua_tostring(L, -1));
+        }
+    }
+
+    FILE* f = fopen(out_path, "wb");
+    if (!f) {
+        return luaL_error(L, "Failed to open '%s' for writing", out_path);
+    }
+    uint64_t name_off = BUNDLE_HEADER_SIZE + (uint64_t)count * BUNDLE_ENTRY_SIZE;
+    uint64_t data_off = name_off;
+    for (size_t i = 0; i < count; i++) data_off += entries[i].name_len;
+
+    fwrite(BUNDLE_MAGIC, 1, 4, f);
+    write_u32(f, BUNDLE_VERSION);
+    write_u32(f, (uint32_t)count);
+    write_u32(f, 0);
+    for (size_t i = 0; i < count; i++) {
+        write_u32(f, (uint32_t)name_off);
+        write_u32(f, (uint32_t)entries[i].name_len);
+        write_u64(f, data_off);
+        write_u64(f, entries[i].blob_len);
+        name_off += entries[i].name_len;
+        data_off += entries[i].blob_len;
+    }
+    for (size_t i = 0; i < count; i++) fwrite(entries[i].name, 1, entries[i].name_len, f);
+    for (size_t i = 0; i < count; i++) fwrite(entries[i].blob, 1, entries[i].blob_len, f);
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) {
+        return luaL_error(L, "Failed to write bundle '%s'", out_path);
+    }
+    lua_pushinteger(L, (lua_Integer)count);
+    return 1;
+}
+
+//===============================================
+// Lua API
+//===============================================
+
+// Mount a bundle: bundle.mount(path) -> archive or nil, message
+static int l_bundle_mount(lua_State* L) {
+    const char* path = luaL_checkstring(L, 1);
+    if (!bundle_mount(L, path)) {
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        return 2;
+    }
+    return 1;
+}
+
+// Load a module chunk without running it: bundle.load(archive, name) -> function or nil, message
+static int l_bundle_load(lua_State* L) {
+    lua_Bundle* b = lua_check_Bundle(L, 1);
+    size_t len;
+    const char* name = luaL_checklstring(L, 2, &len);
+    const uint8_t* e = find_entry(b, name, len);
+    if (!e) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "no module '%s' in bundle '%s'", name, b->path);
+        return 2;
+    }
+    if (load_entry(L, b, e, name) != LUA_OK) {
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        return 2;
+    }
+    return 1;
+}
+
+// List module names in a bundle: bundle.list(archive) -> { name, ... }
+static int l_bundle_list(lua_State* L) {
+    lua_Bundle* b = lua_check_Bundle(L, 1);
+    lua_createtable(L, (int)b->count, 0);
+    for (uint32_t i = 0; i < b->count; i++) {
+        const uint8_t* e = entry_at(b, i);
+        lua_pushlstring(L, (const char*)b->data + read_u32(e), read_u32(e + 4));
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    return 1;
+}
+
+static const struct luaL_Reg bundle_lib[] = {
+    {"mount", l_bundle_mount},
+    {"load", l_bundle_load},
+    {"list", l_bundle_list},
+    {"build", l_bundle_build},
+    {NULL, NULL}
+};
+
+int luaopen_bundle(lua_State* L) {
+    bundle_metatable(L);
+    luaL_newlib(L, bundle_lib);
+    return 1;
+}
@@ -0,0 +1,538 @@
+// module_loader.c
+// Asset loading on worker threads. Files are read and decoded off the Lua thread;
+// Lua polls the returned futures from the frame loop and finishes GPU uploads itself.
+
+#include "module_loader.h"
+#include "module_sdl.h"
+#include "module_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_image.h>
+
+static const char* POOL_MT = "loader.pool";
+static const char* FUTURE_MT = "loader.future";
+
+#define SPIRV_MAGIC 0x07230203u
+
+//===============================================
+// Jobs (run on worker threads, no Lua access)
+//===============================================
+
+// Record "<what> '<path>'[: detail]" as the job error.
+static void job_fail(loader_job* job, const char* what, const char* detail) {
+    snprintf(job->error, sizeof(job->error), "%s '%s'%s%s", what, job->path,
+             detail ? ": " : "", detail ? detail : "");
+}
+
+// Read a whole file into a malloc'd buffer.
+static unsigned char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    unsigned char* data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long len = ftell(file);
+        if (len >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            data = (unsigned char*)malloc(len > 0 ? (size_t)len : 1);
+            if (data && fread(data, 1, (size_t)len, file) != (size_t)len) {
+                free(data);
+                data = NULL;
+            }
+            *size = (size_t)len;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+} chunk_buffer;
+
+static int chunk_writer(lua_State* L, const void* p, size_t sz, void* ud) {
+    (void)L;
+    chunk_buffer* buf = (chunk_buffer*)ud;
+    if (buf->size + sz > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        while (capacity < buf->size + sz) capacity *= 2;
+        unsigned char* data = (unsigned char*)realloc(buf->data, capacity);
+        if (!data) return 1;
+        buf->data = data;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->size, p, sz);
+    buf->size += sz;
+    return 0;
+}
+
+// Compile a script in a private state and keep the binary chunk, so the Lua thread
+// only has to undump it.
+static loader_job_state compile_script(loader_job* job, unsigned char* source, size_t size) {
+    lua_State* L = runtime_newstate();
+    if (!L) {
+        job_fail(job, "Failed to compile", "out of memory");
+        return LOADER_FAILED;
+    }
+    char chunkname[260];
+    snprintf(chunkname, sizeof(chunkname), "@%s", job->path);
+    loader_job_state state = LOADER_DONE;
+    if (luaL_loadbufferx(L, (const char*)source, size, chunkname, NULL) != LUA_OK) {
+        job_fail(job, "Failed to compile", lua_tostring(L, -1));
+        state = LOADER_FAILED;
+    } else {
+        chunk_buffer buf = {0};
+        if (lua_dump(L, chunk_writer, &buf, 0) != 0) {
+            free(buf.data);
+            job_fail(job, "Failed to compile", "out of memory");
+            state = LOADER_FAILED;
+        } else {
+            job->data = buf.data;
+            job->size = buf.size;
+        }
+    }
+    runtime_close(L);
+    return state;
+}
+
+static loader_job_state run_job(loader_job* job) {
+    if (job->kind == LOADER_JOB_IMAGE) {
+        int channels;
+        job->data = stbi_load(job->path, &job->width, &job->height, &channels, STBI_rgb_alpha);
+        if (!job->data) {
+            job_fail(job, "Failed to load image", stbi_failure_reason());
+            return LOADER_FAILED;
+        }
+        job->size = (size_t)job->width * job->height * 4;
+        return LOADER_DONE;
+    }
+
+    size_t size = 0;
+    unsigned char* data = read_file(job->path, &size);
+    if (!data) {
+        job_fail(job, "Failed to read", NULL);
+        return LOADER_FAILED;
+    }
+
+    switch (job->kind) {
+        case LOADER_JOB_SPIRV: {
+            uint32_t magic = 0;
+            if (size >= 4) memcpy(&magic, data, 4);
+            if (size < 20 || size % 4 != 0 || magic != SPIRV_MAGIC) {
+                free(data);
+                job_fail(job, "Invalid SPIR-V file", NULL);
+                return LOADER_FAILED;
+            }
+            break;
+        }
+        case LOADER_JOB_SCRIPT: {
+            loader_job_state state = compile_script(job, data, size);
+            free(data);
+            return state;
+        }
+        default:
+            break;
+    }
+    job->data = data;
+    job->size = size;
+    return LOADER_DONE;
+}
+
+// Drop one reference; called with the pool lock held (or after shutdown).
+static void job_release(loader_job* job) {
+    if (--job->refs > 0) return;
+    free(job->data);
+    free(job->path);
+    free(job);
+}
+
+//===============================================
+// Pool
+//===============================================
+
+static int loader_worker(void* data) {
+    loader_pool* pool = (loader_pool*)data;
+    SDL_LockMutex(pool->lock);
+    for (;;) {
+        while (!pool->head && !pool->quit) {
+            SDL_WaitCondition(pool->work_ready, pool->lock);
+        }
+        if (pool->quit) break;
+
+        loader_job* job = pool->head;
+        pool->head = job->next;
+        if (!pool->head) pool->tail = NULL;
+        job->next = NULL;
+        pool->queued--;
+
+        if (job->refs == 1) {
+            // The future was collected before the job started; skip the work.
+            job_release(job);
+            continue;
+        }
+
+        pool->running++;
+        SDL_UnlockMutex(pool->lock);
+        loader_job_state state = run_job(job);
+        SDL_LockMutex(pool->lock);
+        pool->running--;
+        job->state = state;
+        job_release(job);
+        SDL_BroadcastCondition(pool->job_done);
+    }
+    SDL_UnlockMutex(pool->lock);
+    return 0;
+}
+
+static loader_pool* check_pool(lua_State* L) {
+    loader_pool* pool = (loader_pool*)lua_touserdata(L, lua_upvalueindex(1));
+    if (!pool->lock) {
+        luaL_error(L, "Loader has been shut down");
+    }
+    return pool;
+}
+
+static int default_thread_count(void) {
+    int n = SDL_GetNumLogicalCPUCores() - 1; // Leave a core for the main thread
+    if (n < 1) n = 1;
+    if (n > LOADER_MAX_THREADS) n = LOADER_MAX_THREADS;
+    return n;
+}
+
+static void pool_start(lua_State* L, loader_pool* pool, int num_threads) {
+    for (int i = pool->num_threads; i < num_threads; i++) {
+        SDL_Thread* thread = SDL_CreateThread(loader_worker, "lua_loader", pool);
+        if (!thread) {
+            if (pool->num_threads > 0) break; // Run with the workers we have
+            luaL_error(L, "Failed to create loader thread: %s", SDL_GetError());
+        }
+        pool->threads[pool->num_threads++] = thread;
+    }
+}
+
+static void pool_shutdown(loader_pool* pool) {
+    if (!pool->lock || !pool->work_ready || !pool->job_done) {
+        // Partially created pool: no workers were ever started.
+        if (pool->work_ready) SDL_DestroyCondition(pool->work_ready);
+        if (pool->job_done) SDL_DestroyCondition(pool->job_done);
+        if (pool->lock) SDL_DestroyMutex(pool->lock);
+        pool->work_ready = NULL;
+        pool->job_done = NULL;
+        pool->lock = NULL;
+        return;
+    }
+    SDL_LockMutex(pool->lock);
+    pool->quit = true;
+    SDL_BroadcastCondition(pool->work_ready);
+    SDL_UnlockMutex(pool->lock);
+    for (int i = 0; i < pool->num_threads; i++) {
+        SDL_WaitThread(pool->threads[i], NULL);
+        pool->threads[i] = NULL;
+    }
+    pool->num_threads = 0;
+
+    // Fail whatever never started; the queue's reference goes away with it.
+    while (pool->head) {
+        loader_job* job = pool->head;
+        pool->head = job->next;
+        job->state = LOADER_FAILED;
+        snprintf(job->error, sizeof(job->error), "Loader shut down before '%s' was loaded", job->path);
+        job_release(job);
+    }
+    pool->tail = NULL;
+    pool->queued = 0;
+
+    SDL_DestroyCondition(pool->work_ready);
+    SDL_DestroyCondition(pool->job_done);
+    SDL_DestroyMutex(pool->lock);
+    pool->work_ready = NULL;
+    pool->job_done = NULL;
+    pool->lock = NULL;
+}
+
+static int pool_gc(lua_State* L) {
+    pool_shutdown((loader_pool*)luaL_checkudata(L, 1, POOL_MT));
+    return 0;
+}
+
+//===============================================
+// Futures
+//===============================================
+
+lua_loader_future* lua_check_loader_future(lua_State* L, int idx) {
+    lua_loader_future* ud = (lua_loader_future*)luaL_checkudata(L, idx, FUTURE_MT);
+    if (!ud->job) {
+        luaL_error(L, "Invalid loader future (already destroyed)");
+    }
+    return ud;
+}
+
+static void future_lock(loader_pool* pool) {
+    if (pool->lock) SDL_LockMutex(pool->lock);
+}
+
+static void future_unlock(loader_pool* pool) {
+    if (pool->lock) SDL_UnlockMutex(pool->lock);
+}
+
+// State of a future's job; safe to call from the thread owning the Lua state while workers run.
+loader_job_state loader_future_state(lua_loader_future* ud) {
+    future_lock(ud->pool);
+    loader_job_state state = ud->job->state;
+    future_unlock(ud->pool);
+    return state;
+}
+
+static int future_gc(lua_State* L) {
+    lua_loader_future* ud = (lua_loader_future*)luaL_checkudata(L, 1, FUTURE_MT);
+    if (ud->job) {
+        future_lock(ud->pool);
+        job_release(ud->job);
+        future_unlock(ud->pool);
+        ud->job = NULL;
+    }
+    return 0;
+}
+
+// future:ready() -> true once the job has finished (successfully or not)
+static int future_ready(lua_State* L) {
+    lua_loader_future* ud = lua_check_loader_future(L, 1);
+    lua_pushboolean(L, loader_future_state(ud) != LOADER_PENDING);
+    return 1;
+}
+
+// future:status() -> "pending" | "done" | "failed"
+static int future_status(lua_State* L) {
+    lua_loader_future* ud = lua_check_loader_future(L, 1);
+    static const char* names[] = { "pending", "done", "failed" };
+    lua_pushstring(L, names[loader_future_state(ud)]);
+    return 1;
+}
+
+// future:path() -> requested path
+static int future_path(lua_State* L) {
+    lua_loader_future* ud = lua_check_loader_future(L, 1);
+    lua_pushstring(L, ud->job->path);
+    return 1;
+}
+
+// future:result() -> value | nil, err
+// Images become sdl.image, SPIR-V and files strings, scripts functions. The value is
+// converted once and cached; while the job is pending this returns nil, "pending".
+static int future_result(lua_State* L) {
+    lua_loader_future* ud = lua_check_loader_future(L, 1);
+    loader_job* job = ud->job;
+    loader_job_state state = loader_future_state(ud);
+    if (state == LOADER_PENDING) {
+        lua_pushnil(L);
+        lua_pushliteral(L, "pending");
+        return 2;
+    }
+    if (state == LOADER_FAILED) {
+        lua_pushnil(L);
+        lua_pushstring(L, job->error);
+        return 2;
+    }
+
+    if (lua_getiuservalue(L, 1, 2) != LUA_TNIL) {
+        return 1;
+    }
+    lua_pop(L, 1);
+
+    // The worker no longer touches a finished job, so its data is ours.
+    switch (job->kind) {
+        case LOADER_JOB_IMAGE:
+            lua_push_SDL_Image(L, job->data, job->width, job->height);
+            job->data = NULL; // Owned by the image now
+            break;
+        case LOADER_JOB_SCRIPT:
+            lua_pushfstring(L, "@%s", job->path); // File chunkname, as luaL_loadfile uses
+            if (luaL_loadbufferx(L, (const char*)job->data, job->size, lua_tostring(L, -1), "b") != LUA_OK) {
+                return lua_error(L);
+            }
+            lua_remove(L, -2);
+            break;
+        default:
+            lua_pushlstring(L, (const char*)job->data, job->size);
+            break;
+    }
+    free(job->data);
+    job->data = NULL;
+    job->size = 0;
+
+    lua_pushvalue(L, -1);
+    lua_setiuservalue(L, 1, 2);
+    return 1;
+}
+
+// future:wait([timeout_ms]) -> ready
+// Blocks the Lua thread; meant for loading screens, not the frame loop.
+static int future_wait(lua_State* L) {
+    lua_loader_future* ud = lua_check_loader_future(L, 1);
+    lua_Integer timeout = luaL_optinteger(L, 2, -1);
+    loader_pool* pool = ud->pool;
+    if (!pool->lock) {
+        lua_pushboolean(L, ud->job->state != LOADER_PENDING);
+        return 1;
+    }
+
+    Uint64 deadline = SDL_GetTicks() + (Uint64)(timeout > 0 ? timeout : 0);
+    SDL_LockMutex(pool->lock);
+    while (ud->job->state == LOADER_PENDING) {
+        if (timeout < 0) {
+            SDL_WaitCondition(pool->job_done, pool->lock);
+            continue;
+        }
+        Uint64 now = SDL_GetTicks();
+        if (now >= deadline) break;
+        SDL_WaitConditionTimeout(pool->job_done, pool->lock, (Sint32)(deadline - now));
+    }
+    bool ready = ud->job->state != LOADER_PENDING;
+    SDL_UnlockMutex(pool->lock);
+    lua_pushboolean(L, ready);
+    return 1;
+}
+
+static const struct luaL_Reg future_methods[] = {
+    {"ready", future_ready},
+    {"status", future_status},
+    {"path", future_path},
+    {"result", future_result},
+    {"wait", future_wait},
+    {NULL, NULL}
+};
+
+static void future_metatable(lua_State* L) {
+    luaL_newmetatable(L, FUTURE_MT);
+    lua_pushcfunction(L, future_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, future_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// Lua API
+//===============================================
+
+// Queue a job and push its future. Starts the workers on first use.
+static int push_request(lua_State* L, loader_job_kind kind) {
+    loader_pool* pool = check_pool(L);
+    size_t len;
+    const char* path = luaL_checklstring(L, 1, &len);
+    if (pool->num_threads == 0) {
+        pool_start(L, pool, default_thread_count());
+    }
+
+    lua_loader_future* ud = (lua_loader_future*)lua_newuserdatauv(L, sizeof(lua_loader_future), 2);
+    memset(ud, 0, sizeof(lua_loader_future));
+    luaL_setmetatable(L, FUTURE_MT);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_setiuservalue(L, -2, 1); // The pool outlives its futures
+
+    loader_job* job = (loader_job*)calloc(1, sizeof(loader_job));
+    if (!job || !(job->path = (char*)malloc(len + 1))) {
+        free(job);
+        luaL_error(L, "Failed to allocate loader job");
+    }
+    memcpy(job->path, path, len + 1);
+    job->kind = kind;
+    job->state = LOADER_PENDING;
+    job->refs = 2; // Queue/worker and future
+    ud->job = job;
+    ud->pool = pool;
+
+    SDL_LockMutex(pool->lock);
+    if (pool->tail) pool->tail->next = job;
+    else pool->head = job;
+    pool->tail = job;
+    pool->queued++;
+    SDL_SignalCondition(pool->work_ready);
+    SDL_UnlockMutex(pool->lock);
+    return 1;
+}
+
+// Start the worker threads: loader.start([num_threads]) -> num_threads
+// Optional; the first request starts one worker per spare core.
+static int l_loader_start(lua_State* L) {
+    loader_pool* pool = check_pool(L);
+    int n = (int)luaL_optinteger(L, 1, default_thread_count());
+    if (n < 1 || n > LOADER_MAX_THREADS) {
+        luaL_error(L, "Thread count must be between 1 and %d", LOADER_MAX_THREADS);
+    }
+    pool_start(L, pool, n);
+    lua_pushinteger(L, pool->num_threads);
+    return 1;
+}
+
+// Read a file: loader.load_file(path) -> future (result: string)
+static int l_loader_load_file(lua_State* L) {
+    return push_request(L, LOADER_JOB_FILE);
+}
+
+// Decode an image: loader.load_image(path) -> future (result: sdl.image)
+static int l_loader_load_image(lua_State* L) {
+    return push_request(L, LOADER_JOB_IMAGE);
+}
+
+// Read a SPIR-V module: loader.load_spirv(path) -> future (result: string for vulkan.create_shader_module)
+static int l_loader_load_spirv(lua_State* L) {
+    return push_request(L, LOADER_JOB_SPIRV);
+}
+
+// Read and compile a script: loader.load_script(path) -> future (result: function)
+static int l_loader_load_script(lua_State* L) {
+    return push_request(L, LOADER_JOB_SCRIPT);
+}
+
+// Jobs not finished yet: loader.pending() -> queued + running
+static int l_loader_pending(lua_State* L) {
+    loader_pool* pool = check_pool(L);
+    SDL_LockMutex(pool->lock);
+    int pending = pool->queued + pool->running;
+    SDL_UnlockMutex(pool->lock);
+    lua_pushinteger(L, pending);
+    return 1;
+}
+
+// Stop the workers: loader.shutdown()
+// Jobs that have not started fail with an error. Also runs when the Lua state closes.
+static int l_loader_shutdown(lua_State* L) {
+    pool_shutdown((loader_pool*)lua_touserdata(L, lua_upvalueindex(1)));
+    return 0;
+}
+
+static const struct luaL_Reg loader_lib[] = {
+    {"start", l_loader_start},
+    {"load_file", l_loader_load_file},
+    {"load_image", l_loader_load_image},
+    {"load_spirv", l_loader_load_spirv},
+    {"load_script", l_loader_load_script},
+    {"pending", l_loader_pending},
+    {"shutdown", l_loader_shutdown},
+    {NULL, NULL}
+};
+
+//===============================================
+// module
+//===============================================
+int luaopen_loader(lua_State* L) {
+    future_metatable(L);
+    luaL_newlibtable(L, loader_lib);
+    // Shared upvalue: the worker pool for this Lua state.
+    loader_pool* pool = (loader_pool*)lua_newuserdata(L, sizeof(loader_pool));
+    memset(pool, 0, sizeof(loader_pool));
+    luaL_newmetatable(L, POOL_MT);
+    lua_pushcfunction(L, pool_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+    pool->lock = SDL_CreateMutex();
+    pool->work_ready = SDL_CreateCondition();
+    pool->job_done = SDL_CreateCondition();
+    if (!pool->lock || !pool->work_ready || !pool->job_done) {
+        luaL_error(L, "Failed to create loader pool: %s", SDL_GetError());
+    }
+    luaL_setfuncs(L, loader_lib, 1);
+    return 1;
+}
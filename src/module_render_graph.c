@@ -0,0 +1,1243 @@
+// module_render_graph.c
+// Render graph: passes declare the images and buffers they read and write, and the graph
+// works out culling, transient memory aliasing, barriers, render passes and framebuffers.
+// Compile once (and again after a resize); execute every frame.
+
+#include "module_render_graph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* RENDER_GRAPH_MT = "render_graph.graph";
+
+// Uservalue slots of a graph
+#define RG_UV_RESOURCES 1  // resource name -> index + 1
+#define RG_UV_PASSES    2  // pass name -> index + 1
+#define RG_UV_CALLBACKS 3  // pass index + 1 -> function
+#define RG_UV_KEEP      4  // device, allocator and imported userdata
+#define RG_UV_COMPILED  5  // render pass and image view userdata of the current compile
+#define RG_UV_COUNT     5
+
+//===============================================
+// Declarations
+//===============================================
+
+lua_RenderGraph* lua_check_RenderGraph(lua_State* L, int idx) {
+    lua_RenderGraph* ud = (lua_RenderGraph*)luaL_checkudata(L, idx, RENDER_GRAPH_MT);
+    if (!ud->device) {
+        luaL_error(L, "Invalid render graph (already destroyed)");
+    }
+    return ud;
+}
+
+static char* copy_name(lua_State* L, const char* name) {
+    size_t len = strlen(name);
+    char* copy = (char*)malloc(len + 1);
+    if (!copy) {
+        luaL_error(L, "Out of memory");
+    }
+    memcpy(copy, name, len + 1);
+    return copy;
+}
+
+// Index of a named entry in the uservalue map at slot, or -1.
+static int lookup_name(lua_State* L, int graph_idx, int slot, const char* name) {
+    lua_getiuservalue(L, graph_idx, slot);
+    lua_getfield(L, -1, name);
+    int index = (int)lua_tointeger(L, -1) - 1;
+    lua_pop(L, 2);
+    return index;
+}
+
+static void store_name(lua_State* L, int graph_idx, int slot, const char* name, int index) {
+    lua_getiuservalue(L, graph_idx, slot);
+    lua_pushinteger(L, index + 1);
+    lua_setfield(L, -2, name);
+    lua_pop(L, 1);
+}
+
+// Keep a userdata alive for the lifetime of the graph declarations.
+static void keep_value(lua_State* L, int graph_idx, int value_idx) {
+    value_idx = lua_absindex(L, value_idx);
+    lua_getiuservalue(L, graph_idx, RG_UV_KEEP);
+    lua_pushvalue(L, value_idx);
+    lua_rawseti(L, -2, (lua_Integer)lua_rawlen(L, -2) + 1);
+    lua_pop(L, 1);
+}
+
+static void release_compiled(lua_State* L, lua_RenderGraph* g, int graph_idx);
+
+// Append a resource under a new name and return it; declarations invalidate the compiled graph.
+static rg_resource* new_resource(lua_State* L, lua_RenderGraph* g, const char* name, rg_resource_kind kind) {
+    if (lookup_name(L, 1, RG_UV_RESOURCES, name) >= 0) {
+        luaL_error(L, "Render graph resource '%s' already exists", name);
+    }
+    release_compiled(L, g, 1);
+    if (g->resource_count == g->resource_capacity) {
+        g->resources = (rg_resource*)tracker_grow(L, g->resources, &g->resource_capacity, sizeof(rg_resource));
+    }
+    rg_resource* r = &g->resources[g->resource_count];
+    memset(r, 0, sizeof(rg_resource));
+    r->name = copy_name(L, name);
+    r->kind = kind;
+    r->samples = VK_SAMPLE_COUNT_1_BIT;
+    r->first_use = r->last_use = -1;
+    store_name(L, 1, RG_UV_RESOURCES, name, g->resource_count);
+    g->resource_count++;
+    return r;
+}
+
+static VkImageAspectFlags aspect_for_format(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static lua_Integer check_field(lua_State* L, int idx, const char* field) {
+    lua_getfield(L, idx, field);
+    if (lua_isnil(L, -1)) {
+        luaL_error(L, "Field '%s' is required", field);
+    }
+    lua_Integer value = luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+    return value;
+}
+
+// Create render graph: render_graph.create(device, allocator)
+static int l_render_graph_create(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    lua_VkAllocator* allocator = lua_check_VkAllocator(L, 2);
+
+    lua_RenderGraph* g = (lua_RenderGraph*)lua_newuserdatauv(L, sizeof(lua_RenderGraph), RG_UV_COUNT);
+    memset(g, 0, sizeof(lua_RenderGraph));
+    g->device = device_ud->device;
+    g->allocator = allocator;
+    luaL_setmetatable(L, RENDER_GRAPH_MT);
+    for (int i = 1; i <= RG_UV_COUNT; i++) {
+        lua_newtable(L);
+        lua_setiuservalue(L, -2, i);
+    }
+    int graph_idx = lua_gettop(L);
+    keep_value(L, graph_idx, 1);
+    keep_value(L, graph_idx, 2);
+    return 1;
+}
+
+// Declare a transient image: render_graph.add_image(graph, name, {width, height, format, [usage], [samples]})
+// The graph owns its memory, which is shared with other transient images whose passes do not overlap.
+static int l_render_graph_add_image(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+    luaL_checktype(L, 3, LUA_TTABLE);
+
+    uint32_t width = (uint32_t)check_field(L, 3, "width");
+    uint32_t height = (uint32_t)check_field(L, 3, "height");
+    VkFormat format = (VkFormat)check_field(L, 3, "format");
+    if (width == 0 || height == 0) {
+        luaL_error(L, "Image '%s' must have a positive size", name);
+    }
+    rg_resource* r = new_resource(L, g, name, RG_TRANSIENT_IMAGE);
+    r->width = width;
+    r->height = height;
+    r->format = format;
+    r->aspect = aspect_for_format(format);
+    r->usage = (VkImageUsageFlags)opt_flags_field(L, 3, "usage", 0);
+    r->samples = (VkSampleCountFlagBits)opt_flags_field(L, 3, "samples", VK_SAMPLE_COUNT_1_BIT);
+    return 0;
+}
+
+// Import an image: render_graph.import_image(graph, name, {image, [final_layout]})
+//   or a swapchain: render_graph.import_image(graph, name, {images, views, format, width, height, [initial_layout], [final_layout]})
+// image is a vulkan.image; its tracked layout is used and updated every execute. Swapchain images
+// default to initial_layout UNDEFINED and final_layout PRESENT_SRC_KHR.
+static int l_render_graph_import_image(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+    luaL_checktype(L, 3, LUA_TTABLE);
+
+    lua_getfield(L, 3, "image");
+    if (!lua_isnil(L, -1)) {
+        lua_VkImage* img = lua_check_VkImage(L, -1);
+        rg_resource* r = new_resource(L, g, name, RG_IMPORTED_IMAGE);
+        r->image_ud = img;
+        r->format = img->format;
+        r->width = img->extent.width;
+        r->height = img->extent.height;
+        r->aspect = img->aspect;
+        r->final_layout = (VkImageLayout)opt_flags_field(L, 3, "final_layout", VK_IMAGE_LAYOUT_UNDEFINED);
+        keep_value(L, 1, -1);
+        lua_pop(L, 1);
+        return 0;
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, 3, "images");
+    luaL_checktype(L, -1, LUA_TTABLE);
+    lua_getfield(L, 3, "views");
+    luaL_checktype(L, -1, LUA_TTABLE);
+    int images_idx = lua_gettop(L) - 1, views_idx = lua_gettop(L);
+    uint32_t count = (uint32_t)lua_rawlen(L, images_idx);
+    if (count == 0 || lua_rawlen(L, views_idx) != count) {
+        luaL_error(L, "Swapchain import '%s' needs matching, non-empty images and views", name);
+    }
+    uint32_t width = (uint32_t)check_field(L, 3, "width");
+    uint32_t height = (uint32_t)check_field(L, 3, "height");
+    VkFormat format = (VkFormat)check_field(L, 3, "format");
+
+    rg_resource* r = new_resource(L, g, name, RG_SWAPCHAIN_IMAGE);
+    r->format = format;
+    r->width = width;
+    r->height = height;
+    r->aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    r->initial_layout = (VkImageLayout)opt_flags_field(L, 3, "initial_layout", VK_IMAGE_LAYOUT_UNDEFINED);
+    r->final_layout = (VkImageLayout)opt_flags_field(L, 3, "final_layout", VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    r->images = (VkImage*)calloc(count, sizeof(VkImage));
+    r->views = (VkImageView*)calloc(count, sizeof(VkImageView));
+    if (!r->images || !r->views) {
+        luaL_error(L, "Out of memory");
+    }
+    r->image_count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        lua_rawgeti(L, images_idx, i + 1);
+        if (!lua_islightuserdata(L, -1)) {
+            luaL_error(L, "images[%d] must be a swapchain image", (int)i + 1);
+        }
+        r->images[i] = (VkImage)lua_touserdata(L, -1);
+        lua_pop(L, 1);
+        lua_rawgeti(L, views_idx, i + 1);
+        r->views[i] = lua_check_VkImageView(L, -1)->image_view;
+        lua_pop(L, 1);
+    }
+    keep_value(L, 1, views_idx);
+    lua_pop(L, 2);
+    return 0;
+}
+
+// Import a buffer: render_graph.import_buffer(graph, name, buffer)
+static int l_render_graph_import_buffer(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+    lua_VkBuffer* buf = lua_check_VkBuffer(L, 3);
+    rg_resource* r = new_resource(L, g, name, RG_IMPORTED_BUFFER);
+    r->buffer_ud = buf;
+    keep_value(L, 1, 3);
+    return 0;
+}
+
+static int is_image(const rg_resource* r) {
+    return r->kind != RG_IMPORTED_BUFFER;
+}
+
+// Resolve a resource name of a pass declaration; a pass may name each resource once.
+static int pass_resource(lua_State* L, rg_pass* p, const char* name) {
+    int index = lookup_name(L, 1, RG_UV_RESOURCES, name);
+    if (index < 0) {
+        luaL_error(L, "Pass '%s' uses unknown resource '%s'", p->name, name);
+    }
+    for (int i = 0; i < p->access_count; i++) {
+        if (p->accesses[i].resource == index) {
+            luaL_error(L, "Pass '%s' uses '%s' more than once", p->name, name);
+        }
+    }
+    return index;
+}
+
+static void read_clear_color(lua_State* L, int idx, VkClearValue* value) {
+    luaL_checktype(L, idx, LUA_TTABLE);
+    const char* keys[4] = { "r", "g", "b", "a" };
+    for (int i = 0; i < 4; i++) {
+        lua_getfield(L, idx, keys[i]);
+        value->color.float32[i] = (float)luaL_optnumber(L, -1, i == 3 ? 1.0 : 0.0);
+        lua_pop(L, 1);
+    }
+}
+
+// Fill in layout, stages and access of a pass access from its role.
+static void describe_access(rg_access* a, const rg_resource* r, int compute, int role) {
+    VkPipelineStageFlags shader_stage = compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    a->attachment = -1;
+    switch (role) {
+        case 'c': // Color attachment
+            a->write = 1;
+            a->layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            a->stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            a->access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (a->reads_contents ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+            break;
+        case 'd': // Depth attachment
+            a->write = 1;
+            a->layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            a->stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            a->access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            break;
+        case 'r': // Sampled image or read-only buffer
+            a->reads_contents = 1;
+            if (is_image(r)) {
+                a->layout = (r->aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                                    : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                a->stage = shader_stage;
+                a->access = VK_ACCESS_SHADER_READ_BIT;
+            } else {
+                a->stage = compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                   : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | shader_stage;
+                a->access = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                            (compute ? 0 : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+            }
+            break;
+        default: // 'w': storage image or buffer written by shaders
+            a->write = 1;
+            a->reads_contents = 1; // Storage writes may be partial
+            a->layout = is_image(r) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            a->stage = shader_stage;
+            a->access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            break;
+    }
+}
+
+static rg_access* add_access(lua_State* L, lua_RenderGraph* g, rg_pass* p, int* capacity, const char* name, int role) {
+    int index = pass_resource(L, p, name);
+    rg_resource* r = &g->resources[index];
+    if ((role == 'c' || role == 'd') && !is_image(r)) {
+        luaL_error(L, "Pass '%s' uses buffer '%s' as an attachment", p->name, name);
+    }
+    if (p->access_count == *capacity) {
+        p->accesses = (rg_access*)tracker_grow(L, p->accesses, capacity, sizeof(rg_access));
+    }
+    rg_access* a = &p->accesses[p->access_count++];
+    memset(a, 0, sizeof(rg_access));
+    a->resource = index;
+    return a;
+}
+
+// Read a list of resource names from field of the pass table and add them with role.
+static void add_access_list(lua_State* L, lua_RenderGraph* g, rg_pass* p, int* capacity, const char* field, int role) {
+    lua_getfield(L, 3, field);
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        int n = (int)lua_rawlen(L, -1);
+        for (int i = 1; i <= n; i++) {
+            lua_rawgeti(L, -1, i);
+            rg_access* a = add_access(L, g, p, capacity, luaL_checkstring(L, -1), role);
+            describe_access(a, &g->resources[a->resource], p->compute, role);
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+}
+
+// Declare a pass: render_graph.add_pass(graph, name, {[color], [depth], [reads], [writes], [clear], [clear_depth], [compute]}, fn)
+// color is a list of image names and depth one name; reads are sampled images or read buffers; writes
+// are storage images or buffers. clear holds one {r, g, b, a} per color attachment (false keeps the
+// contents) and clear_depth {depth, stencil}. fn(command_buffer, width, height) records the pass;
+// raster passes run inside the graph's render pass.
+static int l_render_graph_add_pass(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+    luaL_checktype(L, 3, LUA_TTABLE);
+    luaL_checktype(L, 4, LUA_TFUNCTION);
+    if (lookup_name(L, 1, RG_UV_PASSES, name) >= 0) {
+        luaL_error(L, "Render graph pass '%s' already exists", name);
+    }
+    release_compiled(L, g, 1);
+
+    if (g->pass_count == g->pass_capacity) {
+        g->passes = (rg_pass*)tracker_grow(L, g->passes, &g->pass_capacity, sizeof(rg_pass));
+    }
+    rg_pass* p = &g->passes[g->pass_count];
+    memset(p, 0, sizeof(rg_pass));
+    p->depth = -1;
+    p->name = copy_name(L, name);
+    int pass_index = g->pass_count++; // Counted now so errors below still free the pass
+    lua_getfield(L, 3, "compute");
+    p->compute = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    int capacity = 0;
+
+    lua_getfield(L, 3, "clear");
+    int clear_idx = lua_gettop(L);
+    lua_getfield(L, 3, "color");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        int n = (int)lua_rawlen(L, -1);
+        if (n > RENDER_GRAPH_MAX_COLOR) {
+            luaL_error(L, "Pass '%s' has more than %d color attachments", name, RENDER_GRAPH_MAX_COLOR);
+        }
+        for (int i = 0; i < n; i++) {
+            lua_rawgeti(L, -1, i + 1);
+            rg_access* a = add_access(L, g, p, &capacity, luaL_checkstring(L, -1), 'c');
+            lua_pop(L, 1);
+            int cleared = 0;
+            if (lua_istable(L, clear_idx)) {
+                lua_rawgeti(L, clear_idx, i + 1);
+                if (lua_istable(L, -1)) {
+                    read_clear_color(L, lua_gettop(L), &p->clear[i]);
+                    cleared = 1;
+                }
+                lua_pop(L, 1);
+            }
+            a->reads_contents = !cleared;
+            describe_access(a, &g->resources[a->resource], 0, 'c');
+            a->attachment = i;
+            p->clear_mask |= cleared ? 1u << i : 0;
+            p->color[i] = a->resource;
+        }
+        p->color_count = n;
+    }
+    lua_pop(L, 2);
+
+    lua_getfield(L, 3, "depth");
+    if (!lua_isnil(L, -1)) {
+        rg_access* a = add_access(L, g, p, &capacity, luaL_checkstring(L, -1), 'd');
+        lua_getfield(L, 3, "clear_depth");
+        int cleared = lua_istable(L, -1);
+        if (cleared) {
+            lua_rawgeti(L, -1, 1);
+            p->clear[RENDER_GRAPH_DEPTH_SLOT].depthStencil.depth = (float)luaL_optnumber(L, -1, 1.0);
+            lua_rawgeti(L, -2, 2);
+            p->clear[RENDER_GRAPH_DEPTH_SLOT].depthStencil.stencil = (uint32_t)luaL_optinteger(L, -1, 0);
+            lua_pop(L, 2);
+        }
+        lua_pop(L, 1);
+        a->reads_contents = !cleared;
+        describe_access(a, &g->resources[a->resource], 0, 'd');
+        a->attachment = RENDER_GRAPH_DEPTH_SLOT;
+        p->clear_mask |= cleared ? 1u << RENDER_GRAPH_DEPTH_SLOT : 0;
+        p->depth = a->resource;
+    }
+    lua_pop(L, 1);
+
+    add_access_list(L, g, p, &capacity, "reads", 'r');
+    add_access_list(L, g, p, &capacity, "writes", 'w');
+    if (p->compute && (p->color_count > 0 || p->depth >= 0)) {
+        luaL_error(L, "Compute pass '%s' cannot have attachments", name);
+    }
+
+    store_name(L, 1, RG_UV_PASSES, name, pass_index);
+    lua_getiuservalue(L, 1, RG_UV_CALLBACKS);
+    lua_pushvalue(L, 4);
+    lua_rawseti(L, -2, pass_index + 1);
+    lua_pop(L, 1);
+    return 0;
+}
+
+//===============================================
+// Compile
+//===============================================
+
+// Destroy everything compile() created; declarations stay.
+static void release_compiled(lua_State* L, lua_RenderGraph* g, int graph_idx) {
+    if (!g->compiled) return;
+    for (int i = 0; i < g->pass_count; i++) {
+        rg_pass* p = &g->passes[i];
+        for (uint32_t f = 0; f < p->framebuffer_count; f++) {
+            vulkan_release(g->device, &(vulkan_deletion){VULKAN_DELETE_FRAMEBUFFER, .handle.framebuffer = p->framebuffers[f]});
+        }
+        free(p->framebuffers);
+        p->framebuffers = NULL;
+        p->framebuffer_count = 0;
+        if (p->render_pass_ud && p->render_pass_ud->render_pass) {
+            vulkan_release(g->device, &(vulkan_deletion){VULKAN_DELETE_RENDER_PASS, .handle.render_pass = p->render_pass_ud->render_pass});
+            p->render_pass_ud->render_pass = VK_NULL_HANDLE;
+            p->render_pass_ud->device = VK_NULL_HANDLE;
+        }
+        p->render_pass_ud = NULL;
+        free(p->barriers);
+        p->barriers = NULL;
+        p->barrier_count = 0;
+        p->live = 0;
+    }
+    for (int i = 0; i < g->resource_count; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->view_ud && r->view_ud->image_view) {
+            vulkan_release(g->device, &(vulkan_deletion){VULKAN_DELETE_IMAGE_VIEW, .handle.image_view = r->view_ud->image_view});
+            r->view_ud->image_view = VK_NULL_HANDLE;
+            r->view_ud->device = VK_NULL_HANDLE;
+        }
+        r->view_ud = NULL;
+        if (r->image) {
+            // The first image released from a slot takes the slot's memory along, so the memory
+            // is only reused once the frame that last used it has finished
+            vulkan_deletion e = {VULKAN_DELETE_IMAGE, .handle.image = r->image};
+            rg_slot* slot = r->kind == RG_TRANSIENT_IMAGE && r->slot < g->slot_count ? &g->slots[r->slot] : NULL;
+            if (slot && slot->allocation.block && g->allocator->device) {
+                e.allocator = g->allocator;
+                e.allocation = slot->allocation;
+                memset(&slot->allocation, 0, sizeof(vulkan_allocation));
+            }
+            vulkan_release(g->device, &e);
+            r->image = VK_NULL_HANDLE;
+        }
+        r->first_use = r->last_use = -1;
+    }
+    for (int i = 0; i < g->slot_count; i++) {
+        if (g->slots[i].allocation.block && g->allocator->device) {
+            vulkan_memory_free(g->allocator, &g->slots[i].allocation);
+        }
+    }
+    free(g->slots);
+    free(g->order);
+    free(g->final_barriers);
+    free(g->image_scratch);
+    free(g->buffer_scratch);
+    g->slots = NULL;
+    g->order = NULL;
+    g->final_barriers = NULL;
+    g->image_scratch = NULL;
+    g->buffer_scratch = NULL;
+    g->slot_count = g->order_count = g->final_barrier_count = g->scratch_capacity = 0;
+    g->final_src_stage = g->final_dst_stage = 0;
+    g->transient_bytes = g->allocated_bytes = 0;
+    g->compiled = 0;
+    if (L) {
+        lua_newtable(L);
+        lua_setiuservalue(L, graph_idx, RG_UV_COMPILED);
+    }
+}
+
+// Keep a userdata created by compile() alive until the next release.
+static void keep_compiled(lua_State* L, int graph_idx) {
+    lua_getiuservalue(L, graph_idx, RG_UV_COMPILED);
+    lua_pushvalue(L, -2);
+    lua_rawseti(L, -2, (lua_Integer)lua_rawlen(L, -2) + 1);
+    lua_pop(L, 2);
+}
+
+// Drop passes whose writes are never needed. Walks backwards from the imported resources (the
+// frame's outputs): a pass is live when it writes something still needed; its reads then become
+// needed, while its full overwrites (cleared attachments) end the need for earlier writers.
+static void cull_passes(lua_RenderGraph* g, char* needed) {
+    for (int i = 0; i < g->resource_count; i++) {
+        needed[i] = g->resources[i].kind != RG_TRANSIENT_IMAGE;
+    }
+    for (int i = g->pass_count - 1; i >= 0; i--) {
+        rg_pass* p = &g->passes[i];
+        int writes = 0;
+        p->live = 0;
+        for (int a = 0; a < p->access_count; a++) {
+            if (p->accesses[a].write) {
+                writes = 1;
+                if (needed[p->accesses[a].resource]) p->live = 1;
+            }
+        }
+        if (!writes) p->live = 1; // Nothing to reason about: keep it
+        if (!p->live) continue;
+        for (int a = 0; a < p->access_count; a++) {
+            if (p->accesses[a].write && !p->accesses[a].reads_contents) needed[p->accesses[a].resource] = 0;
+        }
+        for (int a = 0; a < p->access_count; a++) {
+            if (p->accesses[a].reads_contents) needed[p->accesses[a].resource] = 1;
+        }
+    }
+}
+
+static VkResult create_transient_image(lua_RenderGraph* g, rg_resource* r, VkMemoryRequirements* requirements) {
+    VkImageCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = r->format;
+    create_info.extent.width = r->width;
+    create_info.extent.height = r->height;
+    create_info.extent.depth = 1;
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = r->samples;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = r->usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult result = vkCreateImage(g->device, &create_info, NULL, &r->image);
+    if (result == VK_SUCCESS) {
+        vkGetImageMemoryRequirements(g->device, r->image, requirements);
+    }
+    return result;
+}
+
+// Give every used transient image a memory slot, reusing slots whose previous occupant is dead.
+static void assign_slots(lua_State* L, lua_RenderGraph* g, VkMemoryRequirements* requirements) {
+    g->slots = (rg_slot*)calloc(g->resource_count ? g->resource_count : 1, sizeof(rg_slot));
+    if (!g->slots) {
+        luaL_error(L, "Out of memory");
+    }
+    // Visit images in order of first use so a slot is handed on as soon as it is free
+    for (int pos = 0; pos < g->order_count; pos++) {
+        for (int i = 0; i < g->resource_count; i++) {
+            rg_resource* r = &g->resources[i];
+            if (r->kind != RG_TRANSIENT_IMAGE || r->first_use != pos) continue;
+            VkMemoryRequirements* req = &requirements[i];
+            int chosen = -1;
+            for (int s = 0; s < g->slot_count; s++) {
+                if (g->slots[s].last_use < pos && (g->slots[s].type_bits & req->memoryTypeBits)) {
+                    chosen = s;
+                    break;
+                }
+            }
+            if (chosen < 0) {
+                chosen = g->slot_count++;
+                g->slots[chosen].type_bits = req->memoryTypeBits;
+            }
+            rg_slot* slot = &g->slots[chosen];
+            if (req->size > slot->size) slot->size = req->size;
+            if (req->alignment > slot->alignment) slot->alignment = req->alignment;
+            slot->type_bits &= req->memoryTypeBits;
+            slot->last_use = r->last_use;
+            r->slot = chosen;
+            g->transient_bytes += req->size;
+        }
+    }
+}
+
+static void push_barrier(lua_State* L, rg_barrier** list, int* count, int* capacity, const rg_barrier* b) {
+    if (*count == *capacity) {
+        *list = (rg_barrier*)tracker_grow(L, *list, capacity, sizeof(rg_barrier));
+    }
+    (*list)[(*count)++] = *b;
+}
+
+// Start every slot from the accesses of its last occupant, i.e. where the previous execution of
+// the graph left that memory. The first barrier on the slot then waits for the previous frame's
+// last use instead of TOP_OF_PIPE, which matters with frames in flight.
+static void seed_slots(lua_RenderGraph* g) {
+    for (int s = 0; s < g->slot_count; s++) {
+        memset(&g->slots[s].sync, 0, sizeof(vulkan_sync_state));
+    }
+    for (int pos = 0; pos < g->order_count; pos++) {
+        rg_pass* p = &g->passes[g->order[pos]];
+        for (int a = 0; a < p->access_count; a++) {
+            rg_access* use = &p->accesses[a];
+            rg_resource* r = &g->resources[use->resource];
+            if (r->kind != RG_TRANSIENT_IMAGE || r->last_use != g->slots[r->slot].last_use) continue;
+            vulkan_sync_merge(&g->slots[r->slot].sync, use->stage, use->access);
+        }
+    }
+}
+
+// Walk the live passes in order, tracking every resource's layout and sync state, and record the
+// barriers each pass needs: layout changes and hazards only (see vulkan_sync_hazard); reads of
+// data the last write is already visible to are merged.
+static void plan_barriers(lua_State* L, lua_RenderGraph* g) {
+    int n = g->resource_count;
+    VkImageLayout* layout = (VkImageLayout*)calloc(n ? n : 1, sizeof(VkImageLayout));
+    vulkan_sync_state* sync = (vulkan_sync_state*)calloc(n ? n : 1, sizeof(vulkan_sync_state));
+    char* pending_current = (char*)calloc(n ? n : 1, 1);
+    if (!layout || !sync || !pending_current) {
+        free(layout); free(sync); free(pending_current);
+        luaL_error(L, "Out of memory");
+    }
+    for (int i = 0; i < n; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->kind == RG_SWAPCHAIN_IMAGE) {
+            // Chains with the acquire semaphore, which is waited on at this stage
+            layout[i] = r->initial_layout;
+            sync[i].stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        } else if (r->kind == RG_IMPORTED_IMAGE) {
+            layout[i] = r->image_ud->layout;
+            pending_current[i] = 1;
+        } else if (r->kind == RG_IMPORTED_BUFFER) {
+            pending_current[i] = 1;
+        }
+    }
+
+    int max_barriers = 0;
+    for (int pos = 0; pos < g->order_count; pos++) {
+        rg_pass* p = &g->passes[g->order[pos]];
+        int capacity = 0;
+        for (int a = 0; a < p->access_count; a++) {
+            rg_access* use = &p->accesses[a];
+            int r_index = use->resource;
+            rg_resource* r = &g->resources[r_index];
+            if (r->kind == RG_TRANSIENT_IMAGE && r->first_use == pos) {
+                // Memory inherited from the previous occupant of the slot: contents are garbage,
+                // but its last accesses must finish before we overwrite them
+                layout[r_index] = VK_IMAGE_LAYOUT_UNDEFINED;
+                sync[r_index] = g->slots[r->slot].sync;
+            }
+            VkImageLayout wanted = is_image(r) ? use->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            if (!pending_current[r_index] && wanted == layout[r_index] &&
+                !vulkan_sync_hazard(&sync[r_index], use->stage, use->access)) {
+                vulkan_sync_merge(&sync[r_index], use->stage, use->access);
+            } else {
+                rg_barrier b;
+                VkPipelineStageFlags src_stage;
+                vulkan_sync_source(&sync[r_index], &src_stage, &b.src_access);
+                b.resource = r_index;
+                b.old_layout = use->reads_contents || r->kind != RG_TRANSIENT_IMAGE ? layout[r_index] : VK_IMAGE_LAYOUT_UNDEFINED;
+                b.new_layout = wanted;
+                b.dst_access = use->access;
+                b.from_current = pending_current[r_index];
+                push_barrier(L, &p->barriers, &p->barrier_count, &capacity, &b);
+                if (!b.from_current) {
+                    p->src_stage |= src_stage;
+                }
+                p->dst_stage |= use->stage;
+                pending_current[r_index] = 0;
+                layout[r_index] = wanted;
+                // The state an imported resource arrives in is only known at execute: treat it
+                // like a transition, so the earlier writes count as visible to this use only
+                vulkan_sync_barrier(&sync[r_index], use->stage, use->access, b.from_current || b.old_layout != b.new_layout);
+            }
+            if (r->kind == RG_TRANSIENT_IMAGE) {
+                g->slots[r->slot].sync = sync[r_index];
+            }
+        }
+        if (p->barrier_count > max_barriers) max_barriers = p->barrier_count;
+    }
+
+    // Imported images leave the frame in their final layout
+    int capacity = 0;
+    for (int i = 0; i < n; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->first_use >= 0 && is_image(r) && r->kind != RG_TRANSIENT_IMAGE &&
+            r->final_layout != VK_IMAGE_LAYOUT_UNDEFINED && r->final_layout != layout[i]) {
+            rg_barrier b;
+            VkPipelineStageFlags dst_stage;
+            VkAccessFlags dst_access;
+            vulkan_layout_sync(r->final_layout, 1, &dst_stage, &dst_access);
+            VkPipelineStageFlags src_stage;
+            vulkan_sync_source(&sync[i], &src_stage, &b.src_access);
+            b.resource = i;
+            b.old_layout = layout[i];
+            b.new_layout = r->final_layout;
+            b.dst_access = dst_access;
+            b.from_current = 0;
+            push_barrier(L, &g->final_barriers, &g->final_barrier_count, &capacity, &b);
+            g->final_src_stage |= src_stage;
+            g->final_dst_stage |= dst_stage;
+            layout[i] = r->final_layout;
+            vulkan_sync_barrier(&sync[i], dst_stage, dst_access, 1);
+        }
+        r->end_layout = layout[i];
+        r->end_sync = sync[i];
+    }
+    if (g->final_barrier_count > max_barriers) max_barriers = g->final_barrier_count;
+
+    free(layout);
+    free(sync);
+    free(pending_current);
+
+    g->scratch_capacity = max_barriers;
+    g->image_scratch = (VkImageMemoryBarrier*)calloc(max_barriers ? max_barriers : 1, sizeof(VkImageMemoryBarrier));
+    g->buffer_scratch = (VkBufferMemoryBarrier*)calloc(max_barriers ? max_barriers : 1, sizeof(VkBufferMemoryBarrier));
+    if (!g->image_scratch || !g->buffer_scratch) {
+        luaL_error(L, "Out of memory");
+    }
+}
+
+// Create the render pass and framebuffers of a raster pass. Attachments are already in their
+// attachment layout (the graph's barriers do the transitions), so the render pass keeps layouts.
+static void build_render_pass(lua_State* L, lua_RenderGraph* g, rg_pass* p, int pos) {
+    VkAttachmentDescription attachments[RENDER_GRAPH_MAX_COLOR + 1];
+    VkAttachmentReference color_refs[RENDER_GRAPH_MAX_COLOR];
+    VkAttachmentReference depth_ref;
+    int slots[RENDER_GRAPH_MAX_COLOR + 1];
+    int count = 0;
+    uint32_t framebuffer_count = 1;
+    memset(attachments, 0, sizeof(attachments));
+
+    for (int i = 0; i <= p->color_count; i++) {
+        int slot = i < p->color_count ? i : RENDER_GRAPH_DEPTH_SLOT;
+        int r_index = i < p->color_count ? p->color[i] : p->depth;
+        if (r_index < 0) continue;
+        rg_resource* r = &g->resources[r_index];
+        if (count == 0) {
+            p->width = r->width;
+            p->height = r->height;
+        } else if (r->width != p->width || r->height != p->height) {
+            luaL_error(L, "Pass '%s' mixes attachment sizes ('%s' is %dx%d, expected %dx%d)",
+                       p->name, r->name, (int)r->width, (int)r->height, (int)p->width, (int)p->height);
+        }
+        if (r->kind == RG_SWAPCHAIN_IMAGE) {
+            if (framebuffer_count > 1 && framebuffer_count != r->image_count) {
+                luaL_error(L, "Pass '%s' mixes swapchains of different lengths", p->name);
+            }
+            framebuffer_count = r->image_count;
+        }
+        int cleared = (p->clear_mask >> slot) & 1;
+        int keep = r->kind != RG_TRANSIENT_IMAGE || r->last_use > pos;
+        VkImageLayout layout = slot == RENDER_GRAPH_DEPTH_SLOT ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                                               : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentLoadOp load = cleared ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                : (r->kind == RG_TRANSIENT_IMAGE && r->first_use == pos) ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
+                                : VK_ATTACHMENT_LOAD_OP_LOAD;
+        if (r->kind == RG_SWAPCHAIN_IMAGE && !cleared && r->first_use == pos && r->initial_layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+            load = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        }
+        VkAttachmentDescription* d = &attachments[count];
+        d->format = r->format;
+        d->samples = r->samples;
+        d->loadOp = load;
+        d->storeOp = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        d->stencilLoadOp = (r->aspect & VK_IMAGE_ASPECT_STENCIL_BIT) ? load : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        d->stencilStoreOp = (r->aspect & VK_IMAGE_ASPECT_STENCIL_BIT) ? d->storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        d->initialLayout = layout;
+        d->finalLayout = layout;
+        if (slot == RENDER_GRAPH_DEPTH_SLOT) {
+            depth_ref.attachment = (uint32_t)count;
+            depth_ref.layout = layout;
+        } else {
+            color_refs[i].attachment = (uint32_t)count;
+            color_refs[i].layout = layout;
+        }
+        slots[count++] = r_index;
+    }
+
+    VkSubpassDescription subpass = {0};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = (uint32_t)p->color_count;
+    subpass.pColorAttachments = color_refs;
+    subpass.pDepthStencilAttachment = p->depth >= 0 ? &depth_ref : NULL;
+
+    VkRenderPassCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = (uint32_t)count;
+    create_info.pAttachments = attachments;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    VkRenderPass render_pass;
+    VkResult result = vkCreateRenderPass(g->device, &create_info, NULL, &render_pass);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create render pass for '%s': VkResult %d", p->name, result);
+    }
+    lua_push_VkRenderPass(L, render_pass, g->device);
+    p->render_pass_ud = (lua_VkRenderPass*)lua_touserdata(L, -1);
+    keep_compiled(L, 1);
+
+    p->framebuffers = (VkFramebuffer*)calloc(framebuffer_count, sizeof(VkFramebuffer));
+    if (!p->framebuffers) {
+        luaL_error(L, "Out of memory");
+    }
+    for (uint32_t f = 0; f < framebuffer_count; f++) {
+        VkImageView views[RENDER_GRAPH_MAX_COLOR + 1];
+        for (int i = 0; i < count; i++) {
+            rg_resource* r = &g->resources[slots[i]];
+            views[i] = r->kind == RG_SWAPCHAIN_IMAGE ? r->views[f] : r->view_ud->image_view;
+        }
+        VkFramebufferCreateInfo fb_info = {0};
+        fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        fb_info.renderPass = render_pass;
+        fb_info.attachmentCount = (uint32_t)count;
+        fb_info.pAttachments = views;
+        fb_info.width = p->width;
+        fb_info.height = p->height;
+        fb_info.layers = 1;
+        result = vkCreateFramebuffer(g->device, &fb_info, NULL, &p->framebuffers[f]);
+        if (result != VK_SUCCESS) {
+            luaL_error(L, "Failed to create framebuffer for '%s': VkResult %d", p->name, result);
+        }
+        p->framebuffer_count = f + 1;
+    }
+}
+
+static void create_view(lua_State* L, lua_RenderGraph* g, rg_resource* r, VkImage image) {
+    VkImageViewCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    create_info.image = image;
+    create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    create_info.format = r->format;
+    create_info.subresourceRange.aspectMask = r->aspect;
+    create_info.subresourceRange.levelCount = 1; // Attachment views must cover a single mip
+    create_info.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    VkImageView view;
+    VkResult result = vkCreateImageView(g->device, &create_info, NULL, &view);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create image view for '%s': VkResult %d", r->name, result);
+    }
+    lua_push_VkImageView(L, view, g->device);
+    r->view_ud = (lua_VkImageView*)lua_touserdata(L, -1);
+    keep_compiled(L, 1);
+}
+
+// Compile: render_graph.compile(graph)
+// Culls, orders, aliases and builds everything execute needs. Call it again after changing the
+// declarations (e.g. on resize, after render_graph.reset) while the GPU is idle.
+static int l_render_graph_compile(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    release_compiled(L, g, 1);
+    g->compiled = 1; // From here on, errors leave a partial compile that release_compiled cleans up
+
+    char* needed = (char*)calloc(g->resource_count ? g->resource_count : 1, 1);
+    g->order = (int*)calloc(g->pass_count ? g->pass_count : 1, sizeof(int));
+    if (!needed || !g->order) {
+        free(needed);
+        luaL_error(L, "Out of memory");
+    }
+    cull_passes(g, needed);
+    free(needed);
+
+    for (int i = 0; i < g->pass_count; i++) {
+        rg_pass* p = &g->passes[i];
+        if (!p->live) continue;
+        int pos = g->order_count++;
+        g->order[pos] = i;
+        for (int a = 0; a < p->access_count; a++) {
+            rg_access* use = &p->accesses[a];
+            rg_resource* r = &g->resources[use->resource];
+            if (r->first_use < 0) {
+                r->first_use = pos;
+                if (r->kind == RG_TRANSIENT_IMAGE && use->reads_contents && !use->write) {
+                    luaL_error(L, "Pass '%s' reads '%s' before any pass writes it", p->name, r->name);
+                }
+            }
+            r->last_use = pos;
+            if (r->kind == RG_TRANSIENT_IMAGE) {
+                r->usage |= use->attachment == RENDER_GRAPH_DEPTH_SLOT ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                          : use->attachment >= 0 ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                          : use->write ? VK_IMAGE_USAGE_STORAGE_BIT
+                          : VK_IMAGE_USAGE_SAMPLED_BIT;
+            }
+        }
+    }
+
+    // Transient images and their shared memory
+    VkMemoryRequirements* requirements = (VkMemoryRequirements*)lua_newuserdata(L,
+        sizeof(VkMemoryRequirements) * (g->resource_count ? g->resource_count : 1));
+    for (int i = 0; i < g->resource_count; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->kind != RG_TRANSIENT_IMAGE || r->first_use < 0) continue;
+        VkResult result = create_transient_image(g, r, &requirements[i]);
+        if (result != VK_SUCCESS) {
+            luaL_error(L, "Failed to create image '%s': VkResult %d", r->name, result);
+        }
+    }
+    assign_slots(L, g, requirements);
+    for (int s = 0; s < g->slot_count; s++) {
+        rg_slot* slot = &g->slots[s];
+        VkMemoryRequirements req = { slot->size, slot->alignment, slot->type_bits };
+        VkResult result = vulkan_memory_alloc(g->allocator, &req, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &slot->allocation);
+        if (result != VK_SUCCESS) {
+            luaL_error(L, "Failed to allocate render graph memory: VkResult %d", result);
+        }
+        g->allocated_bytes += slot->size;
+    }
+    lua_pop(L, 1);
+    for (int i = 0; i < g->resource_count; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->first_use < 0) continue;
+        if (r->kind == RG_TRANSIENT_IMAGE) {
+            rg_slot* slot = &g->slots[r->slot];
+            VkResult result = vkBindImageMemory(g->device, r->image, slot->allocation.block->memory, slot->allocation.offset);
+            if (result != VK_SUCCESS) {
+                luaL_error(L, "Failed to bind memory for '%s': VkResult %d", r->name, result);
+            }
+            create_view(L, g, r, r->image);
+        } else if (r->kind == RG_IMPORTED_IMAGE) {
+            create_view(L, g, r, r->image_ud->image);
+        }
+    }
+    seed_slots(g);
+
+    plan_barriers(L, g);
+    for (int pos = 0; pos < g->order_count; pos++) {
+        rg_pass* p = &g->passes[g->order[pos]];
+        if (!p->compute && (p->color_count > 0 || p->depth >= 0)) {
+            build_render_pass(L, g, p, pos);
+        }
+    }
+    return 0;
+}
+
+//===============================================
+// Execute
+//===============================================
+
+// Translate planned barriers into Vulkan barriers and record them as one call.
+static void record_barriers(lua_RenderGraph* g, VkCommandBuffer cmd, const rg_barrier* barriers, int count,
+                            VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, uint32_t image_index) {
+    int images = 0, buffers = 0;
+    for (int i = 0; i < count; i++) {
+        const rg_barrier* b = &barriers[i];
+        rg_resource* r = &g->resources[b->resource];
+        VkAccessFlags src_access = b->src_access;
+        if (b->from_current) {
+            VkPipelineStageFlags current_stage;
+            vulkan_sync_source(r->image_ud ? &r->image_ud->sync : &r->buffer_ud->sync, &current_stage, &src_access);
+            src_stage |= current_stage;
+        }
+        if (r->kind == RG_IMPORTED_BUFFER) {
+            VkBufferMemoryBarrier* vb = &g->buffer_scratch[buffers++];
+            memset(vb, 0, sizeof(*vb));
+            vb->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            vb->srcAccessMask = src_access;
+            vb->dstAccessMask = b->dst_access;
+            vb->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            vb->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            vb->buffer = r->buffer_ud->buffer;
+            vb->size = VK_WHOLE_SIZE;
+            continue;
+        }
+        VkImageMemoryBarrier* vb = &g->image_scratch[images++];
+        memset(vb, 0, sizeof(*vb));
+        vb->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        vb->srcAccessMask = src_access;
+        vb->dstAccessMask = b->dst_access;
+        vb->oldLayout = b->from_current ? r->image_ud->layout : b->old_layout;
+        vb->newLayout = b->new_layout;
+        vb->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vb->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vb->image = r->kind == RG_SWAPCHAIN_IMAGE ? r->images[image_index]
+                  : r->kind == RG_IMPORTED_IMAGE ? r->image_ud->image : r->image;
+        vb->subresourceRange.aspectMask = r->aspect;
+        vb->subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        vb->subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    }
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, (uint32_t)buffers, g->buffer_scratch,
+                         (uint32_t)images, g->image_scratch);
+    g->barriers_recorded += count;
+}
+
+// Execute: render_graph.execute(graph, command_buffer, [image_index])
+// Records every live pass with its barriers; image_index (0-based, from acquire_next_image_KHR) picks
+// the swapchain image. Imported vulkan.image/vulkan.buffer state is updated for the barrier tracker.
+static int l_render_graph_execute(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    lua_VkCommandBuffer* cmd_ud = lua_check_VkCommandBuffer(L, 2);
+    uint32_t image_index = (uint32_t)luaL_optinteger(L, 3, 0);
+    if (!g->compiled) {
+        luaL_error(L, "Render graph is not compiled (call render_graph.compile)");
+    }
+    for (int i = 0; i < g->resource_count; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->kind == RG_SWAPCHAIN_IMAGE && r->first_use >= 0 && image_index >= r->image_count) {
+            luaL_error(L, "Image index %d out of range for '%s' (%d images)", (int)image_index, r->name, (int)r->image_count);
+        }
+        if (r->image_ud && !r->image_ud->image) {
+            luaL_error(L, "Imported image '%s' was destroyed", r->name);
+        }
+        if (r->buffer_ud && !r->buffer_ud->buffer) {
+            luaL_error(L, "Imported buffer '%s' was destroyed", r->name);
+        }
+    }
+
+    VkCommandBuffer cmd = cmd_ud->command_buffer;
+    lua_getiuservalue(L, 1, RG_UV_CALLBACKS);
+    int callbacks_idx = lua_gettop(L);
+    for (int pos = 0; pos < g->order_count; pos++) {
+        int pass_index = g->order[pos];
+        rg_pass* p = &g->passes[pass_index];
+        if (p->barrier_count > 0) {
+            record_barriers(g, cmd, p->barriers, p->barrier_count, p->src_stage, p->dst_stage, image_index);
+        }
+
+        if (p->render_pass_ud) {
+            VkClearValue clear_values[RENDER_GRAPH_MAX_COLOR + 1];
+            int count = 0;
+            for (int i = 0; i < p->color_count; i++) clear_values[count++] = p->clear[i];
+            if (p->depth >= 0) clear_values[count++] = p->clear[RENDER_GRAPH_DEPTH_SLOT];
+            VkRenderPassBeginInfo begin_info = {0};
+            begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            begin_info.renderPass = p->render_pass_ud->render_pass;
+            begin_info.framebuffer = p->framebuffers[p->framebuffer_count > 1 ? image_index : 0];
+            begin_info.renderArea.extent.width = p->width;
+            begin_info.renderArea.extent.height = p->height;
+            begin_info.clearValueCount = (uint32_t)count;
+            begin_info.pClearValues = clear_values;
+            vkCmdBeginRenderPass(cmd, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        lua_rawgeti(L, callbacks_idx, pass_index + 1);
+        lua_pushvalue(L, 2);
+        lua_pushinteger(L, p->width);
+        lua_pushinteger(L, p->height);
+        lua_call(L, 3, 0);
+
+        if (p->render_pass_ud) {
+            vkCmdEndRenderPass(cmd);
+        }
+    }
+    if (g->final_barrier_count > 0) {
+        record_barriers(g, cmd, g->final_barriers, g->final_barrier_count, g->final_src_stage, g->final_dst_stage, image_index);
+    }
+
+    for (int i = 0; i < g->resource_count; i++) {
+        rg_resource* r = &g->resources[i];
+        if (r->first_use < 0) continue;
+        if (r->image_ud) {
+            r->image_ud->layout = r->end_layout;
+            r->image_ud->sync = r->end_sync;
+        } else if (r->buffer_ud) {
+            r->buffer_ud->sync = r->end_sync;
+        }
+    }
+    return 0;
+}
+
+//===============================================
+// Queries
+//===============================================
+
+static void check_compiled(lua_State* L, lua_RenderGraph* g) {
+    if (!g->compiled) {
+        luaL_error(L, "Render graph is not compiled (call render_graph.compile)");
+    }
+}
+
+// Render pass of a raster pass: render_graph.render_pass(graph, pass_name) -> vulkan.render_pass
+// For creating compatible pipelines. It belongs to the graph and is replaced on every compile;
+// nil when the pass was culled or is a compute pass.
+static int l_render_graph_render_pass(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+    check_compiled(L, g);
+    int index = lookup_name(L, 1, RG_UV_PASSES, name);
+    if (index < 0) {
+        luaL_error(L, "Unknown render graph pass '%s'", name);
+    }
+    lua_VkRenderPass* target = g->passes[index].render_pass_ud;
+    if (!target) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_getiuservalue(L, 1, RG_UV_COMPILED);
+    int n = (int)lua_rawlen(L, -1);
+    for (int i = 1; i <= n; i++) {
+        if (lua_rawgeti(L, -1, i) == LUA_TUSERDATA && lua_touserdata(L, -1) == target) {
+            return 1;
+        }
+        lua_pop(L, 1);
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+// Image view of an image: render_graph.image_view(graph, resource_name) -> vulkan.image_view
+// For sampling a graph image in later passes; owned by the graph and replaced on every compile.
+static int l_render_graph_image_view(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+    check_compiled(L, g);
+    int index = lookup_name(L, 1, RG_UV_RESOURCES, name);
+    if (index < 0) {
+        luaL_error(L, "Unknown render graph resource '%s'", name);
+    }
+    lua_VkImageView* target = g->resources[index].view_ud;
+    if (target) {
+        lua_getiuservalue(L, 1, RG_UV_COMPILED);
+        int n = (int)lua_rawlen(L, -1);
+        for (int i = 1; i <= n; i++) {
+            if (lua_rawgeti(L, -1, i) == LUA_TUSERDATA && lua_touserdata(L, -1) == target) {
+                return 1;
+            }
+            lua_pop(L, 1);
+        }
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+// Statistics: render_graph.stats(graph) -> {passes, culled, transient_images, memory_slots,
+//     transient_bytes, allocated_bytes, barriers}
+// transient_bytes - allocated_bytes is the memory saved by aliasing; barriers counts every
+// barrier recorded by execute so far.
+static int l_render_graph_stats(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    int transient = 0;
+    for (int i = 0; i < g->resource_count; i++) {
+        if (g->resources[i].kind == RG_TRANSIENT_IMAGE && g->resources[i].first_use >= 0) transient++;
+    }
+    lua_createtable(L, 0, 7);
+    lua_pushinteger(L, g->order_count);
+    lua_setfield(L, -2, "passes");
+    lua_pushinteger(L, g->compiled ? g->pass_count - g->order_count : 0);
+    lua_setfield(L, -2, "culled");
+    lua_pushinteger(L, transient);
+    lua_setfield(L, -2, "transient_images");
+    lua_pushinteger(L, g->slot_count);
+    lua_setfield(L, -2, "memory_slots");
+    lua_pushinteger(L, (lua_Integer)g->transient_bytes);
+    lua_setfield(L, -2, "transient_bytes");
+    lua_pushinteger(L, (lua_Integer)g->allocated_bytes);
+    lua_setfield(L, -2, "allocated_bytes");
+    lua_pushinteger(L, g->barriers_recorded);
+    lua_setfield(L, -2, "barriers");
+    return 1;
+}
+
+// Free declarations (compiled objects must already be released).
+static void release_declarations(lua_RenderGraph* g) {
+    for (int i = 0; i < g->resource_count; i++) {
+        free(g->resources[i].name);
+        free(g->resources[i].images);
+        free(g->resources[i].views);
+    }
+    for (int i = 0; i < g->pass_count; i++) {
+        free(g->passes[i].name);
+        free(g->passes[i].accesses);
+    }
+    free(g->resources);
+    free(g->passes);
+    g->resources = NULL;
+    g->passes = NULL;
+    g->resource_count = g->resource_capacity = 0;
+    g->pass_count = g->pass_capacity = 0;
+}
+
+// Reset: render_graph.reset(graph)
+// Drops every declaration and compiled object so the frame can be declared again (e.g. after a resize).
+static int l_render_graph_reset(lua_State* L) {
+    lua_RenderGraph* g = lua_check_RenderGraph(L, 1);
+    release_compiled(L, g, 1);
+    release_declarations(g);
+    for (int slot = RG_UV_RESOURCES; slot <= RG_UV_CALLBACKS; slot++) {
+        lua_newtable(L);
+        lua_setiuservalue(L, 1, slot);
+    }
+    // Keep device and allocator, drop imported resources
+    lua_getiuservalue(L, 1, RG_UV_KEEP);
+    lua_createtable(L, 2, 0);
+    lua_rawgeti(L, -2, 1);
+    lua_rawseti(L, -2, 1);
+    lua_rawgeti(L, -2, 2);
+    lua_rawseti(L, -2, 2);
+    lua_setiuservalue(L, 1, RG_UV_KEEP);
+    lua_pop(L, 1);
+    return 0;
+}
+
+static int render_graph_gc(lua_State* L) {
+    lua_RenderGraph* g = (lua_RenderGraph*)luaL_checkudata(L, 1, RENDER_GRAPH_MT);
+    if (g->device) {
+        release_compiled(NULL, g, 1);
+        release_declarations(g);
+        g->device = VK_NULL_HANDLE;
+    }
+    return 0;
+}
+
+// Destroy: render_graph.destroy(graph)
+// Frees the graph's images, memory, render passes and framebuffers. Call it before destroying the device.
+static int l_render_graph_destroy(lua_State* L) {
+    lua_check_RenderGraph(L, 1);
+    return render_graph_gc(L);
+}
+
+static const luaL_Reg render_graph_lib[] = {
+    {"create", l_render_graph_create},
+    {"add_image", l_render_graph_add_image},
+    {"import_image", l_render_graph_import_image},
+    {"import_buffer", l_render_graph_import_buffer},
+    {"add_pass", l_render_graph_add_pass},
+    {"compile", l_render_graph_compile},
+    {"execute", l_render_graph_execute},
+    {"render_pass", l_render_graph_render_pass},
+    {"image_view", l_render_graph_image_view},
+    {"stats", l_render_graph_stats},
+    {"reset", l_render_graph_reset},
+    {"destroy", l_render_graph_destroy},
+    {NULL, NULL}
+};
+
+int luaopen_render_graph(lua_State* L) {
+    luaL_newmetatable(L, RENDER_GRAPH_MT);
+    lua_pushcfunction(L, render_graph_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+    luaL_newlib(L, render_graph_lib);
+    return 1;
+}
@@ -0,0 +1,860 @@
+// module_runtime.c
+// Runtime services for the Lua state created by main.c: a pooled allocator
+// with statistics readable from Lua, budgeted GC steps for the frame loop and
+// a coroutine scheduler that resumes tasks when their fence, timeline value,
+// loader future or timer is ready, and native buffers shared between states.
+
+#include "module_runtime.h"
+#include "module_vulkan.h"
+#include "module_loader.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//===============================================
+// Allocator
+//===============================================
+
+static int pool_class(size_t size) {
+    return (int)((size + RUNTIME_POOL_GRANULE - 1) / RUNTIME_POOL_GRANULE) - 1;
+}
+
+// Carve a new slab into blocks of one size class.
+static int pool_refill(runtime_allocator* a, int cls) {
+    size_t block_size = (size_t)(cls + 1) * RUNTIME_POOL_GRANULE;
+    runtime_pool_slab* slab = (runtime_pool_slab*)malloc(RUNTIME_POOL_SLAB_SIZE);
+    if (!slab) return 0;
+    slab->next = a->slabs;
+    a->slabs = slab;
+    a->pool_reserved += RUNTIME_POOL_SLAB_SIZE;
+
+    char* base = (char*)(slab + 1);
+    size_t count = (RUNTIME_POOL_SLAB_SIZE - sizeof(runtime_pool_slab)) / block_size;
+    for (size_t i = count; i > 0; i--) {
+        runtime_pool_block* block = (runtime_pool_block*)(base + (i - 1) * block_size);
+        block->next = a->free_list[cls];
+        a->free_list[cls] = block;
+    }
+    return 1;
+}
+
+static void* pool_get(runtime_allocator* a, size_t size) {
+    int cls = pool_class(size);
+    if (!a->free_list[cls] && !pool_refill(a, cls)) return NULL;
+    runtime_pool_block* block = a->free_list[cls];
+    a->free_list[cls] = block->next;
+    a->pool_allocs++;
+    return block;
+}
+
+static void pool_put(runtime_allocator* a, void* ptr, size_t size) {
+    int cls = pool_class(size);
+    runtime_pool_block* block = (runtime_pool_block*)ptr;
+    block->next = a->free_list[cls];
+    a->free_list[cls] = block;
+}
+
+static void* block_get(runtime_allocator* a, size_t size) {
+    return size <= RUNTIME_POOL_MAX_SIZE ? pool_get(a, size) : malloc(size);
+}
+
+static void block_put(runtime_allocator* a, void* ptr, size_t size) {
+    if (size <= RUNTIME_POOL_MAX_SIZE) pool_put(a, ptr, size);
+    else free(ptr);
+}
+
+// lua_Alloc: Lua passes the old block size on free/realloc, so blocks need no header.
+void* runtime_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    runtime_allocator* a = (runtime_allocator*)ud;
+    if (!ptr) osize = 0; // osize is a type tag for new objects.
+
+    if (nsize == 0) {
+        if (ptr) {
+            block_put(a, ptr, osize);
+            a->live_bytes -= osize;
+            a->total_frees++;
+        }
+        return NULL;
+    }
+
+    void* block;
+    if (!ptr) {
+        block = block_get(a, nsize);
+    } else if (osize > RUNTIME_POOL_MAX_SIZE && nsize > RUNTIME_POOL_MAX_SIZE) {
+        block = realloc(ptr, nsize);
+    } else if (osize <= RUNTIME_POOL_MAX_SIZE && nsize <= RUNTIME_POOL_MAX_SIZE &&
+               pool_class(osize) == pool_class(nsize)) {
+        block = ptr; // Same size class, nothing to move.
+    } else {
+        block = block_get(a, nsize);
+        if (block) {
+            memcpy(block, ptr, osize < nsize ? osize : nsize);
+            block_put(a, ptr, osize);
+        }
+    }
+    if (!block) return NULL; // Lua collects garbage and retries or raises a memory error.
+
+    a->live_bytes += nsize - osize;
+    if (a->live_bytes > a->peak_bytes) a->peak_bytes = a->live_bytes;
+    a->total_allocs++;
+    a->frame_allocs++;
+    return block;
+}
+
+static int runtime_panic(lua_State* L) {
+    const char* msg = lua_tostring(L, -1);
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", msg ? msg : "error object is not a string");
+    return 0;
+}
+
+// Create a Lua state that uses the pooled allocator.
+lua_State* runtime_newstate(void) {
+    runtime_allocator* a = (runtime_allocator*)calloc(1, sizeof(runtime_allocator));
+    if (!a) return NULL;
+    lua_State* L = lua_newstate(runtime_alloc, a);
+    if (!L) {
+        free(a);
+        return NULL;
+    }
+    lua_atpanic(L, runtime_panic);
+    return L;
+}
+
+// Returns the allocator of a state made by runtime_newstate, or NULL.
+runtime_allocator* runtime_get_allocator(lua_State* L) {
+    void* ud = NULL;
+    lua_Alloc f = lua_getallocf(L, &ud);
+    return f == runtime_alloc ? (runtime_allocator*)ud : NULL;
+}
+
+// Close a state made by runtime_newstate and release its pool slabs.
+void runtime_close(lua_State* L) {
+    runtime_allocator* a = runtime_get_allocator(L);
+    lua_close(L);
+    if (!a) return;
+    while (a->slabs) {
+        runtime_pool_slab* next = a->slabs->next;
+        free(a->slabs);
+        a->slabs = next;
+    }
+    free(a);
+}
+
+//===============================================
+// Lua API
+//===============================================
+
+static runtime_allocator* check_allocator(lua_State* L) {
+    runtime_allocator* a = runtime_get_allocator(L);
+    if (!a) {
+        luaL_error(L, "Runtime allocator not installed (state not created by runtime_newstate)");
+    }
+    return a;
+}
+
+// Get allocator statistics: runtime.memory_stats() -> table
+static int l_runtime_memory_stats(lua_State* L) {
+    runtime_allocator* a = check_allocator(L);
+    lua_createtable(L, 0, 8);
+    lua_pushinteger(L, (lua_Integer)a->live_bytes);
+    lua_setfield(L, -2, "live_bytes");
+    lua_pushinteger(L, (lua_Integer)a->peak_bytes);
+    lua_setfield(L, -2, "peak_bytes");
+    lua_pushinteger(L, (lua_Integer)a->frame_allocs);
+    lua_setfield(L, -2, "frame_allocs");
+    lua_pushinteger(L, (lua_Integer)a->total_allocs);
+    lua_setfield(L, -2, "total_allocs");
+    lua_pushinteger(L, (lua_Integer)a->total_frees);
+    lua_setfield(L, -2, "total_frees");
+    lua_pushinteger(L, (lua_Integer)a->pool_allocs);
+    lua_setfield(L, -2, "pool_allocs");
+    lua_pushinteger(L, (lua_Integer)a->pool_reserved);
+    lua_setfield(L, -2, "pool_reserved");
+    return 1;
+}
+
+// Get live/peak bytes without allocating: runtime.memory_usage() -> live_bytes, peak_bytes, frame_allocs
+static int l_runtime_memory_usage(lua_State* L) {
+    runtime_allocator* a = check_allocator(L);
+    lua_pushinteger(L, (lua_Integer)a->live_bytes);
+    lua_pushinteger(L, (lua_Integer)a->peak_bytes);
+    lua_pushinteger(L, (lua_Integer)a->frame_allocs);
+    return 3;
+}
+
+// Mark the end of a frame: runtime.end_frame() -> allocations made during the frame
+static int l_runtime_end_frame(lua_State* L) {
+    runtime_allocator* a = check_allocator(L);
+    lua_pushinteger(L, (lua_Integer)a->frame_allocs);
+    a->frame_allocs = 0;
+    return 1;
+}
+
+// Reset the peak to the current live size: runtime.reset_peak()
+static int l_runtime_reset_peak(lua_State* L) {
+    runtime_allocator* a = check_allocator(L);
+    a->peak_bytes = a->live_bytes;
+    return 0;
+}
+
+//===============================================
+// GC scheduling
+//===============================================
+
+static const char* GC_STATE_MT = "runtime.gc_state";
+
+static runtime_gc_state* gc_state(lua_State* L) {
+    return (runtime_gc_state*)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+// Switch collector mode: runtime.gc_mode("incremental", [pause], [stepmul], [stepsize])
+//                       runtime.gc_mode("generational", [minormul], [majormul])
+// Returns the previous mode name. Omitted parameters keep their current value.
+static int l_runtime_gc_mode(lua_State* L) {
+    static const char* const modes[] = {"incremental", "generational", NULL};
+    runtime_gc_state* gc = gc_state(L);
+    int mode = luaL_checkoption(L, 1, NULL, modes);
+    int previous;
+    if (mode == 1) {
+        previous = lua_gc(L, LUA_GCGEN, (int)luaL_optinteger(L, 2, 0), (int)luaL_optinteger(L, 3, 0));
+    } else {
+        previous = lua_gc(L, LUA_GCINC, (int)luaL_optinteger(L, 2, 0), (int)luaL_optinteger(L, 3, 0),
+                          (int)luaL_optinteger(L, 4, 0));
+    }
+    gc->generational = (mode == 1);
+    lua_pushstring(L, previous == LUA_GCGEN ? "generational" : "incremental");
+    return 1;
+}
+
+// Enable or disable allocation-triggered collection: runtime.gc_auto(enabled, [limit_kb])
+// With auto collection off the collector only runs from runtime.gc_step; limit_kb
+// is a safety cap that makes gc_step finish the cycle if the heap grows past it.
+static int l_runtime_gc_auto(lua_State* L) {
+    runtime_gc_state* gc = gc_state(L);
+    luaL_checktype(L, 1, LUA_TBOOLEAN);
+    gc->auto_gc = lua_toboolean(L, 1);
+    gc->limit_kb = luaL_optinteger(L, 2, 0);
+    lua_gc(L, gc->auto_gc ? LUA_GCRESTART : LUA_GCSTOP);
+    return 0;
+}
+
+// Run collector steps in frame idle time: runtime.gc_step(budget_us, [step_kb]) -> elapsed_us, cycle_done
+// Call it after present and before the next fence wait. In incremental mode it steps
+// until the budget is spent or the cycle ends; in generational mode it runs one minor
+// collection, which cannot be split.
+static int l_runtime_gc_step(lua_State* L) {
+    runtime_gc_state* gc = gc_state(L);
+    lua_Number budget_us = luaL_checknumber(L, 1);
+    int step_kb = (int)luaL_optinteger(L, 2, 0);
+
+    int forced = !gc->auto_gc && gc->limit_kb > 0 && lua_gc(L, LUA_GCCOUNT) > gc->limit_kb;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 budget_ticks = (Uint64)(budget_us * (lua_Number)freq / 1000000.0);
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 elapsed = 0;
+    int done = 0;
+    do {
+        done = lua_gc(L, LUA_GCSTEP, step_kb);
+        elapsed = SDL_GetPerformanceCounter() - start;
+    } while (!done && !gc->generational && (forced || elapsed < budget_ticks));
+
+    double elapsed_us = (double)elapsed * 1000000.0 / (double)freq;
+    gc->steps++;
+    if (done) gc->cycles++;
+    if (elapsed > budget_ticks) gc->over_budget++;
+    gc->last_us = elapsed_us;
+    gc->total_us += elapsed_us;
+    if (elapsed_us > gc->max_us) gc->max_us = elapsed_us;
+
+    lua_pushnumber(L, elapsed_us);
+    lua_pushboolean(L, done);
+    return 2;
+}
+
+// Get GC pause statistics: runtime.gc_stats() -> table
+static int l_runtime_gc_stats(lua_State* L) {
+    runtime_gc_state* gc = gc_state(L);
+    lua_createtable(L, 0, 9);
+    lua_pushstring(L, gc->generational ? "generational" : "incremental");
+    lua_setfield(L, -2, "mode");
+    lua_pushboolean(L, gc->auto_gc);
+    lua_setfield(L, -2, "auto");
+    lua_pushinteger(L, (lua_Integer)gc->steps);
+    lua_setfield(L, -2, "steps");
+    lua_pushinteger(L, (lua_Integer)gc->cycles);
+    lua_setfield(L, -2, "cycles");
+    lua_pushinteger(L, (lua_Integer)gc->over_budget);
+    lua_setfield(L, -2, "over_budget");
+    lua_pushnumber(L, gc->last_us);
+    lua_setfield(L, -2, "last_us");
+    lua_pushnumber(L, gc->max_us);
+    lua_setfield(L, -2, "max_us");
+    lua_pushnumber(L, gc->steps ? gc->total_us / (double)gc->steps : 0.0);
+    lua_setfield(L, -2, "avg_us");
+    lua_pushinteger(L, lua_gc(L, LUA_GCCOUNT));
+    lua_setfield(L, -2, "heap_kb");
+    return 1;
+}
+
+// Reset GC pause statistics: runtime.gc_reset_stats()
+static int l_runtime_gc_reset_stats(lua_State* L) {
+    runtime_gc_state* gc = gc_state(L);
+    gc->steps = gc->cycles = gc->over_budget = 0;
+    gc->last_us = gc->max_us = gc->total_us = 0.0;
+    return 0;
+}
+
+//===============================================
+// Task scheduler
+//===============================================
+
+static const char* SCHEDULER_MT = "runtime.scheduler";
+
+static runtime_scheduler* scheduler(lua_State* L) {
+    return (runtime_scheduler*)lua_touserdata(L, lua_upvalueindex(2));
+}
+
+static int scheduler_gc(lua_State* L) {
+    runtime_scheduler* s = (runtime_scheduler*)luaL_checkudata(L, 1, SCHEDULER_MT);
+    free(s->tasks);
+    s->tasks = NULL;
+    s->count = s->capacity = 0;
+    return 0;
+}
+
+static void task_release_object(lua_State* L, runtime_task* t) {
+    if (t->object_ref != LUA_NOREF) {
+        luaL_unref(L, LUA_REGISTRYINDEX, t->object_ref);
+        t->object_ref = LUA_NOREF;
+    }
+    t->object = NULL;
+}
+
+// Resume task i with nargs values on its stack. Errors inside the task are raised in L
+// after the task has been removed.
+static void task_resume(lua_State* L, runtime_scheduler* s, int i, int nargs) {
+    lua_State* co = s->tasks[i].thread;
+    task_release_object(L, &s->tasks[i]);
+    s->tasks[i].wait = RUNTIME_WAIT_NEXT; // A plain coroutine.yield resumes on the next update
+
+    int previous = s->current;
+    s->current = i;
+    int nres;
+    int status = lua_resume(co, L, nargs, &nres);
+    s->current = previous;
+    s->resumes++;
+
+    if (status == LUA_YIELD) {
+        lua_pop(co, nres);
+        return;
+    }
+    // Finished or failed; the tasks array may have grown during the resume
+    runtime_task* t = &s->tasks[i];
+    if (status != LUA_OK) {
+        const char* msg = lua_tostring(co, -1);
+        luaL_traceback(L, co, msg ? msg : "(error object is not a string)", 0);
+    }
+    task_release_object(L, t);
+    luaL_unref(L, LUA_REGISTRYINDEX, t->thread_ref);
+    t->thread = NULL;
+    if (status != LUA_OK) {
+        lua_error(L);
+    }
+}
+
+// Push the values await returns onto the task stack once its condition is met.
+// Returns the number of values, 0 while the task keeps waiting.
+static int task_poll(runtime_task* t, uint64_t now) {
+    lua_State* co = t->thread;
+    switch (t->wait) {
+    case RUNTIME_WAIT_NEXT:
+        break;
+    case RUNTIME_WAIT_TIMER:
+        if (now < t->value) return 0;
+        break;
+    case RUNTIME_WAIT_FENCE: {
+        lua_VkFence* fence = (lua_VkFence*)t->object;
+        if (!fence->fence) {
+            lua_pushboolean(co, 0);
+            lua_pushliteral(co, "Fence destroyed while awaited");
+            return 2;
+        }
+        VkResult result = vkGetFenceStatus(fence->device, fence->fence);
+        if (result == VK_NOT_READY) return 0;
+        if (result != VK_SUCCESS) {
+            lua_pushboolean(co, 0);
+            lua_pushfstring(co, "Failed to get fence status: VkResult %d", result);
+            return 2;
+        }
+        break;
+    }
+    case RUNTIME_WAIT_TIMELINE: {
+        lua_VkSemaphore* semaphore = (lua_VkSemaphore*)t->object;
+        if (!semaphore->semaphore) {
+            lua_pushboolean(co, 0);
+            lua_pushliteral(co, "Semaphore destroyed while awaited");
+            return 2;
+        }
+        uint64_t value = 0;
+        VkResult result = vulkan_get_semaphore_counter_value(semaphore->device, semaphore->semaphore, &value);
+        if (result != VK_SUCCESS) {
+            lua_pushboolean(co, 0);
+            lua_pushfstring(co, "Failed to get semaphore counter value: VkResult %d", result);
+            return 2;
+        }
+        if (value < t->value) return 0;
+        break;
+    }
+    case RUNTIME_WAIT_FUTURE: {
+        lua_loader_future* future = (lua_loader_future*)t->object;
+        if (!future->job) {
+            lua_pushboolean(co, 0);
+            lua_pushliteral(co, "Loader future destroyed while awaited");
+            return 2;
+        }
+        loader_job_state state = loader_future_state(future);
+        if (state == LOADER_PENDING) return 0;
+        if (state == LOADER_FAILED) {
+            lua_pushboolean(co, 0);
+            lua_pushstring(co, future->job->error);
+            return 2;
+        }
+        break;
+    }
+    }
+    lua_pushboolean(co, 1);
+    return 1;
+}
+
+// Start a task: runtime.spawn(fn, ...) -> coroutine
+// fn runs right away until its first await; afterwards runtime.update resumes it.
+static int l_runtime_spawn(lua_State* L) {
+    runtime_scheduler* s = scheduler(L);
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    int nargs = lua_gettop(L) - 1;
+
+    if (s->count == s->capacity) {
+        int capacity = s->capacity ? s->capacity * 2 : 16;
+        runtime_task* tasks = (runtime_task*)realloc(s->tasks, capacity * sizeof(runtime_task));
+        if (!tasks) {
+            luaL_error(L, "Failed to spawn task: out of memory");
+        }
+        s->tasks = tasks;
+        s->capacity = capacity;
+    }
+    lua_State* co = lua_newthread(L);
+    lua_pushvalue(L, -1);
+    int thread_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    int i = s->count++;
+    runtime_task* t = &s->tasks[i];
+    memset(t, 0, sizeof(runtime_task));
+    t->thread = co;
+    t->thread_ref = thread_ref;
+    t->object_ref = LUA_NOREF;
+    t->wait = RUNTIME_WAIT_NEXT;
+
+    lua_rotate(L, 1, 1); // coroutine, fn, args...
+    lua_xmove(L, co, nargs + 1);
+    task_resume(L, s, i, nargs);
+    return 1;
+}
+
+// Suspend the calling task: runtime.await([condition], [value]) -> true | false, err
+// condition is a vulkan.fence, a timeline vulkan.semaphore with the value to reach, a
+// loader future, a delay in seconds, or nil for the next update.
+static int l_runtime_await(lua_State* L) {
+    runtime_scheduler* s = scheduler(L);
+    if (s->current < 0 || s->tasks[s->current].thread != L) {
+        luaL_error(L, "runtime.await must be called from a task started by runtime.spawn");
+    }
+    runtime_task* t = &s->tasks[s->current];
+    void* object = NULL;
+    if (lua_isnoneornil(L, 1)) {
+        t->wait = RUNTIME_WAIT_NEXT;
+    } else if (lua_type(L, 1) == LUA_TNUMBER) {
+        lua_Number seconds = lua_tonumber(L, 1);
+        t->wait = RUNTIME_WAIT_TIMER;
+        t->value = SDL_GetTicksNS() + (uint64_t)(seconds > 0 ? seconds * 1e9 : 0);
+    } else if ((object = luaL_testudata(L, 1, "vulkan.fence"))) {
+        lua_check_VkFence(L, 1);
+        t->wait = RUNTIME_WAIT_FENCE;
+    } else if ((object = luaL_testudata(L, 1, "vulkan.semaphore"))) {
+        lua_check_VkSemaphore(L, 1);
+        t->wait = RUNTIME_WAIT_TIMELINE;
+        t->value = (uint64_t)luaL_checkinteger(L, 2);
+    } else if ((object = luaL_testudata(L, 1, "loader.future"))) {
+        lua_check_loader_future(L, 1);
+        t->wait = RUNTIME_WAIT_FUTURE;
+    } else {
+        luaL_argerror(L, 1, "expected fence, timeline semaphore, loader future, seconds or nil");
+    }
+    if (object) {
+        t->object = object;
+        lua_pushvalue(L, 1);
+        t->object_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    return lua_yield(L, 0);
+}
+
+// Resume every task whose condition is met: runtime.update() -> tasks still waiting
+// Never blocks; call it once per frame. A task error is raised here after the task is dropped.
+static int l_runtime_update(lua_State* L) {
+    runtime_scheduler* s = scheduler(L);
+    if (s->current >= 0) {
+        luaL_error(L, "runtime.update cannot be called from a task");
+    }
+    uint64_t now = SDL_GetTicksNS();
+    int count = s->count; // Tasks spawned meanwhile already ran up to their first await
+    for (int i = 0; i < count; i++) {
+        if (!s->tasks[i].thread) continue;
+        int nargs = task_poll(&s->tasks[i], now);
+        if (nargs) task_resume(L, s, i, nargs);
+    }
+
+    int alive = 0;
+    for (int i = 0; i < s->count; i++) {
+        if (s->tasks[i].thread) s->tasks[alive++] = s->tasks[i];
+    }
+    s->count = alive;
+    lua_pushinteger(L, alive);
+    return 1;
+}
+
+// Task statistics: runtime.tasks() -> waiting, resumes
+static int l_runtime_tasks(lua_State* L) {
+    runtime_scheduler* s = scheduler(L);
+    int alive = 0;
+    for (int i = 0; i < s->count; i++) {
+        if (s->tasks[i].thread) alive++;
+    }
+    lua_pushinteger(L, alive);
+    lua_pushinteger(L, (lua_Integer)s->resumes);
+    return 2;
+}
+
+// Drop the tasks still waiting when a script returns, without resuming them: a per-frame
+// task never finishes, and fence or timeline tasks would poll a device the script may have
+// destroyed already. Returns the number of tasks dropped.
+int runtime_drop_tasks(lua_State* L) {
+    int top = lua_gettop(L);
+    int dropped = 0;
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    if (lua_getfield(L, -1, "runtime") == LUA_TTABLE && lua_getfield(L, -1, "update") == LUA_TFUNCTION &&
+        lua_getupvalue(L, -1, 2)) {
+        runtime_scheduler* s = (runtime_scheduler*)luaL_testudata(L, -1, SCHEDULER_MT);
+        for (int i = 0; s && i < s->count; i++) {
+            runtime_task* t = &s->tasks[i];
+            if (!t->thread) continue;
+            task_release_object(L, t);
+            luaL_unref(L, LUA_REGISTRYINDEX, t->thread_ref);
+            t->thread = NULL;
+            dropped++;
+        }
+        if (s) s->count = 0;
+    }
+    lua_settop(L, top);
+    return dropped;
+}
+
+//===============================================
+// Shared buffers
+//===============================================
+
+static const char* BUFFER_MT = "runtime.buffer";
+
+static const char* const buffer_type_names[] = {"u8", "i8", "u16", "i16", "u32", "i32", "f32", "f64", NULL};
+static const size_t buffer_type_sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+void runtime_buffer_retain(runtime_buffer* buffer) {
+    atomic_fetch_add_explicit(&buffer->refs, 1, memory_order_relaxed);
+}
+
+// Drop one reference; the last one frees the data. Safe from any thread.
+void runtime_buffer_release(runtime_buffer* buffer) {
+    if (atomic_fetch_sub_explicit(&buffer->refs, 1, memory_order_acq_rel) == 1) {
+        free(buffer->data);
+        free(buffer);
+    }
+}
+
+lua_RuntimeBuffer* lua_test_RuntimeBuffer(lua_State* L, int idx) {
+    return (lua_RuntimeBuffer*)luaL_testudata(L, idx, BUFFER_MT);
+}
+
+lua_RuntimeBuffer* lua_check_RuntimeBuffer(lua_State* L, int idx) {
+    lua_RuntimeBuffer* ud = (lua_RuntimeBuffer*)luaL_checkudata(L, idx, BUFFER_MT);
+    if (!ud->buffer) {
+        luaL_error(L, "Invalid buffer (moved or released)");
+    }
+    return ud;
+}
+
+lua_RuntimeBuffer* lua_push_RuntimeBuffer(lua_State* L, runtime_buffer* buffer) {
+    lua_RuntimeBuffer* ud = (lua_RuntimeBuffer*)lua_newuserdatauv(L, sizeof(lua_RuntimeBuffer), 0);
+    ud->buffer = buffer;
+    luaL_setmetatable(L, BUFFER_MT);
+    return ud;
+}
+
+static runtime_buffer* check_writable(lua_State* L, int idx) {
+    runtime_buffer* b = lua_check_RuntimeBuffer(L, idx)->buffer;
+    if (b->readonly) {
+        luaL_error(L, "Buffer is read-only");
+    }
+    return b;
+}
+
+// 1-based element index i covering span elements -> 0-based index.
+static size_t check_element(lua_State* L, runtime_buffer* b, int idx, size_t span) {
+    lua_Integer i = luaL_checkinteger(L, idx);
+    luaL_argcheck(L, i >= 1 && (size_t)i - 1 + span <= b->count, idx, "index out of range");
+    return (size_t)i - 1;
+}
+
+static void buffer_store(lua_State* L, runtime_buffer* b, size_t i, int idx) {
+    void* p = b->data + i * buffer_type_sizes[b->type];
+    switch (b->type) {
+    case RUNTIME_BUFFER_U8: *(uint8_t*)p = (uint8_t)luaL_checkinteger(L, idx); break;
+    case RUNTIME_BUFFER_I8: *(int8_t*)p = (int8_t)luaL_checkinteger(L, idx); break;
+    case RUNTIME_BUFFER_U16: *(uint16_t*)p = (uint16_t)luaL_checkinteger(L, idx); break;
+    case RUNTIME_BUFFER_I16: *(int16_t*)p = (int16_t)luaL_checkinteger(L, idx); break;
+    case RUNTIME_BUFFER_U32: *(uint32_t*)p = (uint32_t)luaL_checkinteger(L, idx); break;
+    case RUNTIME_BUFFER_I32: *(int32_t*)p = (int32_t)luaL_checkinteger(L, idx); break;
+    case RUNTIME_BUFFER_F32: *(float*)p = (float)luaL_checknumber(L, idx); break;
+    case RUNTIME_BUFFER_F64: *(double*)p = (double)luaL_checknumber(L, idx); break;
+    }
+}
+
+static void buffer_load(lua_State* L, runtime_buffer* b, size_t i) {
+    const void* p = b->data + i * buffer_type_sizes[b->type];
+    switch (b->type) {
+    case RUNTIME_BUFFER_U8: lua_pushinteger(L, *(const uint8_t*)p); break;
+    case RUNTIME_BUFFER_I8: lua_pushinteger(L, *(const int8_t*)p); break;
+    case RUNTIME_BUFFER_U16: lua_pushinteger(L, *(const uint16_t*)p); break;
+    case RUNTIME_BUFFER_I16: lua_pushinteger(L, *(const int16_t*)p); break;
+    case RUNTIME_BUFFER_U32: lua_pushinteger(L, *(const uint32_t*)p); break;
+    case RUNTIME_BUFFER_I32: lua_pushinteger(L, *(const int32_t*)p); break;
+    case RUNTIME_BUFFER_F32: lua_pushnumber(L, *(const float*)p); break;
+    case RUNTIME_BUFFER_F64: lua_pushnumber(L, *(const double*)p); break;
+    }
+}
+
+static int buffer_gc(lua_State* L) {
+    lua_RuntimeBuffer* ud = (lua_RuntimeBuffer*)luaL_checkudata(L, 1, BUFFER_MT);
+    if (ud->buffer) {
+        runtime_buffer_release(ud->buffer);
+        ud->buffer = NULL;
+    }
+    return 0;
+}
+
+// #buf -> element count
+static int buffer_len(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)lua_check_RuntimeBuffer(L, 1)->buffer->count);
+    return 1;
+}
+
+// buf:get(i) -> number
+static int buffer_get(lua_State* L) {
+    runtime_buffer* b = lua_check_RuntimeBuffer(L, 1)->buffer;
+    buffer_load(L, b, check_element(L, b, 2, 1));
+    return 1;
+}
+
+// buf:set(i, v1, [v2, ...]): Write consecutive elements starting at 1-based index i.
+static int buffer_set(lua_State* L) {
+    runtime_buffer* b = check_writable(L, 1);
+    int n = lua_gettop(L) - 2;
+    size_t i = check_element(L, b, 2, n > 0 ? (size_t)n : 1);
+    for (int k = 0; k < n; k++) {
+        buffer_store(L, b, i + (size_t)k, k + 3);
+    }
+    return 0;
+}
+
+// buf:write(byte_offset, string): Copy raw bytes in.
+static int buffer_write(lua_State* L) {
+    runtime_buffer* b = check_writable(L, 1);
+    lua_Integer offset = luaL_checkinteger(L, 2);
+    size_t len;
+    const char* data = luaL_checklstring(L, 3, &len);
+    if (offset < 0 || (size_t)offset + len > b->size) {
+        luaL_error(L, "Write of %d bytes at offset %d exceeds buffer size %d", (int)len, (int)offset, (int)b->size);
+    }
+    memcpy(b->data + offset, data, len);
+    return 0;
+}
+
+// buf:read([byte_offset], [length]) -> string (copies)
+static int buffer_read(lua_State* L) {
+    runtime_buffer* b = lua_check_RuntimeBuffer(L, 1)->buffer;
+    lua_Integer offset = luaL_optinteger(L, 2, 0);
+    lua_Integer len = luaL_optinteger(L, 3, (lua_Integer)b->size - offset);
+    if (offset < 0 || len < 0 || (size_t)offset + (size_t)len > b->size) {
+        luaL_error(L, "Read of %d bytes at offset %d exceeds buffer size %d", (int)len, (int)offset, (int)b->size);
+    }
+    lua_pushlstring(L, (const char*)b->data + offset, (size_t)len);
+    return 1;
+}
+
+// buf:size() -> bytes
+static int buffer_size(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)lua_check_RuntimeBuffer(L, 1)->buffer->size);
+    return 1;
+}
+
+// buf:type() -> "u8" | "i8" | "u16" | "i16" | "u32" | "i32" | "f32" | "f64"
+static int buffer_type(lua_State* L) {
+    lua_pushstring(L, buffer_type_names[lua_check_RuntimeBuffer(L, 1)->buffer->type]);
+    return 1;
+}
+
+// Make the buffer immutable so it can be shared: buf:freeze() -> buf
+static int buffer_freeze(lua_State* L) {
+    lua_check_RuntimeBuffer(L, 1)->buffer->readonly = 1;
+    lua_settop(L, 1);
+    return 1;
+}
+
+// Another read-only handle to the same data: buf:share() -> buffer (freezes buf)
+static int buffer_share(lua_State* L) {
+    runtime_buffer* b = lua_check_RuntimeBuffer(L, 1)->buffer;
+    b->readonly = 1;
+    runtime_buffer_retain(b);
+    lua_push_RuntimeBuffer(L, b);
+    return 1;
+}
+
+// buf:readonly() -> boolean
+static int buffer_readonly(lua_State* L) {
+    lua_pushboolean(L, lua_check_RuntimeBuffer(L, 1)->buffer->readonly);
+    return 1;
+}
+
+// Handles sharing the data, in any state: buf:refs() -> integer
+static int buffer_refs(lua_State* L) {
+    lua_pushinteger(L, atomic_load(&lua_check_RuntimeBuffer(L, 1)->buffer->refs));
+    return 1;
+}
+
+// Drop this handle's reference now instead of at collection: buf:release()
+static int buffer_release(lua_State* L) {
+    lua_RuntimeBuffer* ud = lua_check_RuntimeBuffer(L, 1);
+    runtime_buffer_release(ud->buffer);
+    ud->buffer = NULL;
+    return 0;
+}
+
+static const struct luaL_Reg buffer_methods[] = {
+    {"get", buffer_get},
+    {"set", buffer_set},
+    {"write", buffer_write},
+    {"read", buffer_read},
+    {"size", buffer_size},
+    {"type", buffer_type},
+    {"freeze", buffer_freeze},
+    {"share", buffer_share},
+    {"readonly", buffer_readonly},
+    {"refs", buffer_refs},
+    {"release", buffer_release},
+    {NULL, NULL}
+};
+
+static void buffer_metatable(lua_State* L) {
+    luaL_newmetatable(L, BUFFER_MT);
+    lua_pushcfunction(L, buffer_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pushcfunction(L, buffer_len);
+    lua_setfield(L, -2, "__len");
+    luaL_newlib(L, buffer_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+// Create a buffer: runtime.create_buffer(count | {v1, v2, ...} | string, [type])
+// type defaults to "u8"; a string is copied in as raw bytes (its length must be a multiple
+// of the element size). New buffers are writable and zero-filled.
+static int l_runtime_create_buffer(lua_State* L) {
+    runtime_buffer_type type = (runtime_buffer_type)luaL_checkoption(L, 2, "u8", buffer_type_names);
+    size_t elem = buffer_type_sizes[type];
+    size_t len = 0;
+    const char* bytes = NULL;
+    lua_Integer count;
+    if (lua_type(L, 1) == LUA_TSTRING) {
+        bytes = lua_tolstring(L, 1, &len);
+        if (len % elem != 0) {
+            luaL_error(L, "String length %d is not a multiple of the %s element size", (int)len, buffer_type_names[type]);
+        }
+        count = (lua_Integer)(len / elem);
+    } else if (lua_istable(L, 1)) {
+        count = (lua_Integer)lua_rawlen(L, 1);
+    } else {
+        count = luaL_checkinteger(L, 1);
+    }
+    if (count < 0 || (size_t)count > SIZE_MAX / elem) {
+        luaL_error(L, "Invalid buffer size: %d", (int)count);
+    }
+
+    lua_RuntimeBuffer* ud = lua_push_RuntimeBuffer(L, NULL);
+    runtime_buffer* b = (runtime_buffer*)calloc(1, sizeof(runtime_buffer));
+    if (!b || !(b->data = (unsigned char*)calloc(count > 0 ? (size_t)count : 1, elem))) {
+        free(b);
+        luaL_error(L, "Failed to allocate buffer");
+    }
+    atomic_init(&b->refs, 1);
+    b->type = type;
+    b->count = (size_t)count;
+    b->size = (size_t)count * elem;
+    ud->buffer = b;
+    if (bytes) {
+        memcpy(b->data, bytes, len);
+    } else if (lua_istable(L, 1)) {
+        for (lua_Integer i = 1; i <= count; i++) {
+            lua_rawgeti(L, 1, i);
+            buffer_store(L, b, (size_t)i - 1, -1);
+            lua_pop(L, 1);
+        }
+    }
+    return 1;
+}
+
+static const struct luaL_Reg runtime_lib[] = {
+    {"memory_stats", l_runtime_memory_stats},
+    {"memory_usage", l_runtime_memory_usage},
+    {"end_frame", l_runtime_end_frame},
+    {"reset_peak", l_runtime_reset_peak},
+    {"gc_mode", l_runtime_gc_mode},
+    {"gc_auto", l_runtime_gc_auto},
+    {"gc_step", l_runtime_gc_step},
+    {"gc_stats", l_runtime_gc_stats},
+    {"gc_reset_stats", l_runtime_gc_reset_stats},
+    {"spawn", l_runtime_spawn},
+    {"await", l_runtime_await},
+    {"update", l_runtime_update},
+    {"tasks", l_runtime_tasks},
+    {"create_buffer", l_runtime_create_buffer},
+    {NULL, NULL}
+};
+
+int luaopen_runtime(lua_State* L) {
+    buffer_metatable(L);
+    luaL_newlibtable(L, runtime_lib);
+    // Shared upvalue: collector scheduling state for this Lua state.
+    runtime_gc_state* gc = (runtime_gc_state*)lua_newuserdata(L, sizeof(runtime_gc_state));
+    memset(gc, 0, sizeof(runtime_gc_state));
+    gc->auto_gc = 1;
+    luaL_newmetatable(L, GC_STATE_MT);
+    lua_setmetatable(L, -2);
+    // Shared upvalue: task scheduler.
+    runtime_scheduler* s = (runtime_scheduler*)lua_newuserdata(L, sizeof(runtime_scheduler));
+    memset(s, 0, sizeof(runtime_scheduler));
+    s->current = -1;
+    if (luaL_newmetatable(L, SCHEDULER_MT)) {
+        lua_pushcfunction(L, scheduler_gc);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_setmetatable(L, -2);
+    luaL_setfuncs(L, runtime_lib, 2);
+    return 1;
+}
@@ -4,11 +4,25 @@
 #include "module_sdl.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stb_image.h>
 
 // Metatables
 static const char* WINDOW_MT = "sdl.window";
 static const char* RENDERER_MT = "sdl.renderer";
 static const char* TEXTURE_MT = "sdl.texture";
+static const char* INPUT_STATE_MT = "sdl.input_state";
+static const char* BATCH_MT = "sdl.batch";
+static const char* FLOAT_ARRAY_MT = "sdl.float_array";
+static const char* GEOMETRY_MT = "sdl.geometry";
+static const char* IMAGE_MT = "sdl.image";
+static const char* ATLAS_MT = "sdl.atlas";
+static const char* FONT_MT = "sdl.font";
+static const char* TEXT_MT = "sdl.text";
+
+// The input snapshot is a single userdata anchored in the registry.
+static lua_SDL_InputState* input_state = NULL;
 
 // GC metamethod for texture: Destroy the SDL_Texture
 static int texture_gc(lua_State* L) {
@@ -449,13 +463,346 @@ static int l_sdl_render_debug_text(lua_State* L) {
     return 0;
 }
 
+// Set a field on the table at the top of the stack, or clear it when it does not apply.
+static void set_event_integer(lua_State* L, const char* key, int has, lua_Integer value) {
+    if (has) lua_pushinteger(L, value);
+    else lua_pushnil(L);
+    lua_setfield(L, -2, key);
+}
+
+static void set_event_number(lua_State* L, const char* key, int has, lua_Number value) {
+    if (has) lua_pushnumber(L, value);
+    else lua_pushnil(L);
+    lua_setfield(L, -2, key);
+}
+
+// Fill the table at the top of the stack with an event, reusing it. Every field is
+// written (nil when it does not apply) so a table reused across event types never
+// keeps stale values. Assigning existing keys does not allocate. Key names are only
+// looked up when with_names is set. Returns 0 for unsupported events.
+static int fill_event_table(lua_State* L, SDL_Event* e, int with_names) {
+    int is_key = 0, is_button = 0, is_motion = 0, is_resize = 0;
+    Uint32 window_id = 0;
+    switch (e->type) {
+        case SDL_EVENT_QUIT:
+            break;
+        case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
+            window_id = e->window.windowID;
+            break;
+        case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+            is_resize = 1;
+            window_id = e->window.windowID;
+            break;
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_KEY_UP:
+            is_key = 1;
+            window_id = e->key.windowID;
+            break;
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_UP:
+            is_button = 1;
+            window_id = e->button.windowID;
+            break;
+        case SDL_EVENT_MOUSE_MOTION:
+            is_motion = 1;
+            window_id = e->motion.windowID;
+            break;
+        default:
+            return 0;
+    }
+
+    lua_pushinteger(L, e->type);
+    lua_setfield(L, -2, "type");
+    set_event_integer(L, "window_id", e->type != SDL_EVENT_QUIT, window_id);
+
+    set_event_integer(L, "scancode", is_key, is_key ? e->key.scancode : 0);
+    set_event_integer(L, "keycode", is_key, is_key ? e->key.key : 0);
+    if (is_key) lua_pushboolean(L, e->key.repeat);
+    else lua_pushnil(L);
+    lua_setfield(L, -2, "is_repeat");
+    if (is_key && with_names) {
+        const char* scancode_name = SDL_GetScancodeName(e->key.scancode);
+        lua_pushstring(L, scancode_name ? scancode_name : "unknown");
+        lua_setfield(L, -2, "scancode_name");
+        const char* key_name = SDL_GetKeyName(e->key.key);
+        lua_pushstring(L, key_name ? key_name : "unknown");
+        lua_setfield(L, -2, "key_name");
+    } else {
+        lua_pushnil(L);
+        lua_setfield(L, -2, "scancode_name");
+        lua_pushnil(L);
+        lua_setfield(L, -2, "key_name");
+    }
+
+    set_event_integer(L, "button", is_button, is_button ? e->button.button : 0);
+    set_event_integer(L, "clicks", is_button, is_button ? e->button.clicks : 0);
+    set_event_number(L, "x", is_button || is_motion, is_button ? e->button.x : (is_motion ? e->motion.x : 0));
+    set_event_number(L, "y", is_button || is_motion, is_button ? e->button.y : (is_motion ? e->motion.y : 0));
+    set_event_number(L, "xrel", is_motion, is_motion ? e->motion.xrel : 0);
+    set_event_number(L, "yrel", is_motion, is_motion ? e->motion.yrel : 0);
+    set_event_integer(L, "width", is_resize, is_resize ? e->window.data1 : 0);
+    set_event_integer(L, "height", is_resize, is_resize ? e->window.data2 : 0);
+    return 1;
+}
+
+//===============================================
+// Input state
+//===============================================
+
+// Clear per-frame input (pressed/released sets, deltas) before pumping a new frame.
+static void input_state_begin_frame(void) {
+    if (!input_state) return;
+    memset(input_state->pressed, 0, sizeof(input_state->pressed));
+    memset(input_state->released, 0, sizeof(input_state->released));
+    input_state->mouse_pressed = 0;
+    input_state->mouse_released = 0;
+    input_state->mouse_dx = input_state->mouse_dy = 0.0f;
+    input_state->wheel_x = input_state->wheel_y = 0.0f;
+    input_state->quit = false;
+}
+
+static void input_state_update(const SDL_Event* e) {
+    if (!input_state) return;
+    switch (e->type) {
+        case SDL_EVENT_QUIT:
+        case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
+            input_state->quit = true;
+            break;
+        case SDL_EVENT_KEY_DOWN:
+            if (!e->key.repeat && e->key.scancode < SDL_SCANCODE_COUNT) {
+                input_state->pressed[e->key.scancode >> 3] |= (Uint8)(1u << (e->key.scancode & 7));
+            }
+            break;
+        case SDL_EVENT_KEY_UP:
+            if (e->key.scancode < SDL_SCANCODE_COUNT) {
+                input_state->released[e->key.scancode >> 3] |= (Uint8)(1u << (e->key.scancode & 7));
+            }
+            break;
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+            input_state->mouse_pressed |= SDL_BUTTON_MASK(e->button.button);
+            break;
+        case SDL_EVENT_MOUSE_BUTTON_UP:
+            input_state->mouse_released |= SDL_BUTTON_MASK(e->button.button);
+            break;
+        case SDL_EVENT_MOUSE_MOTION:
+            input_state->mouse_dx += e->motion.xrel;
+            input_state->mouse_dy += e->motion.yrel;
+            break;
+        case SDL_EVENT_MOUSE_WHEEL:
+            input_state->wheel_x += e->wheel.x;
+            input_state->wheel_y += e->wheel.y;
+            break;
+        default:
+            break;
+    }
+}
+
+// Refresh held keys and mouse position after the event queue is drained.
+static void input_state_end_frame(void) {
+    if (!input_state) return;
+    input_state->mouse_buttons = SDL_GetMouseState(&input_state->mouse_x, &input_state->mouse_y);
+}
+
+lua_SDL_InputState* lua_check_SDL_InputState(lua_State* L, int idx) {
+    return (lua_SDL_InputState*)luaL_checkudata(L, idx, INPUT_STATE_MT);
+}
+
+static int check_scancode(lua_State* L, int idx) {
+    lua_Integer scancode = luaL_checkinteger(L, idx);
+    luaL_argcheck(L, scancode >= 0 && scancode < SDL_SCANCODE_COUNT, idx, "scancode out of range");
+    return (int)scancode;
+}
+
+static int input_bit(const Uint8* bits, int scancode) {
+    return (bits[scancode >> 3] >> (scancode & 7)) & 1;
+}
+
+// input:is_down(scancode) -> boolean
+static int input_is_down(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    int scancode = check_scancode(L, 2);
+    lua_pushboolean(L, scancode < in->num_keys && in->keys[scancode]);
+    return 1;
+}
+
+// input:pressed(scancode) -> boolean, true if the key went down this frame
+static int input_pressed(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_pushboolean(L, input_bit(in->pressed, check_scancode(L, 2)));
+    return 1;
+}
+
+// input:released(scancode) -> boolean, true if the key went up this frame
+static int input_released(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_pushboolean(L, input_bit(in->released, check_scancode(L, 2)));
+    return 1;
+}
+
+// input:mouse_position() -> x, y
+static int input_mouse_position(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_pushnumber(L, in->mouse_x);
+    lua_pushnumber(L, in->mouse_y);
+    return 2;
+}
+
+// input:mouse_delta() -> dx, dy accumulated this frame
+static int input_mouse_delta(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_pushnumber(L, in->mouse_dx);
+    lua_pushnumber(L, in->mouse_dy);
+    return 2;
+}
+
+// input:wheel() -> x, y accumulated this frame
+static int input_wheel(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_pushnumber(L, in->wheel_x);
+    lua_pushnumber(L, in->wheel_y);
+    return 2;
+}
+
+// input:mouse_down(button) / input:mouse_pressed(button) / input:mouse_released(button) -> boolean
+static int input_mouse_down(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_Integer button = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, button >= 1 && button <= 32, 2, "invalid mouse button");
+    lua_pushboolean(L, (in->mouse_buttons & SDL_BUTTON_MASK((int)button)) != 0);
+    return 1;
+}
+
+static int input_mouse_pressed(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_Integer button = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, button >= 1 && button <= 32, 2, "invalid mouse button");
+    lua_pushboolean(L, (in->mouse_pressed & SDL_BUTTON_MASK((int)button)) != 0);
+    return 1;
+}
+
+static int input_mouse_released(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_Integer button = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, button >= 1 && button <= 32, 2, "invalid mouse button");
+    lua_pushboolean(L, (in->mouse_released & SDL_BUTTON_MASK((int)button)) != 0);
+    return 1;
+}
+
+// input:quit_requested() -> boolean, true if a quit or window close event arrived this frame
+static int input_quit_requested(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    lua_pushboolean(L, in->quit);
+    return 1;
+}
+
+static int input_state_gc(lua_State* L) {
+    lua_SDL_InputState* in = lua_check_SDL_InputState(L, 1);
+    if (in == input_state) {
+        input_state = NULL;
+    }
+    return 0;
+}
+
+static const struct luaL_Reg input_state_methods[] = {
+    {"is_down", input_is_down},
+    {"pressed", input_pressed},
+    {"released", input_released},
+    {"mouse_position", input_mouse_position},
+    {"mouse_delta", input_mouse_delta},
+    {"wheel", input_wheel},
+    {"mouse_down", input_mouse_down},
+    {"mouse_pressed", input_mouse_pressed},
+    {"mouse_released", input_mouse_released},
+    {"quit_requested", input_quit_requested},
+    {NULL, NULL}
+};
+
+static void input_state_metatable(lua_State* L) {
+    luaL_newmetatable(L, INPUT_STATE_MT);
+    lua_pushcfunction(L, input_state_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, input_state_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+// sdl.get_input_state(): Return the persistent input snapshot userdata.
+// It is updated by sdl.poll_events and sdl.update_input; the pressed/released sets,
+// mouse delta and wheel cover the events pumped by the latest call.
+static int l_sdl_get_input_state(lua_State* L) {
+    if (lua_getfield(L, LUA_REGISTRYINDEX, INPUT_STATE_MT) == LUA_TUSERDATA) {
+        return 1;
+    }
+    lua_pop(L, 1);
+    lua_SDL_InputState* in = (lua_SDL_InputState*)lua_newuserdata(L, sizeof(lua_SDL_InputState));
+    memset(in, 0, sizeof(lua_SDL_InputState));
+    in->keys = SDL_GetKeyboardState(&in->num_keys);
+    in->mouse_buttons = SDL_GetMouseState(&in->mouse_x, &in->mouse_y);
+    luaL_setmetatable(L, INPUT_STATE_MT);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, INPUT_STATE_MT);
+    input_state = in;
+    return 1;
+}
+
+// sdl.update_input(): Drain the event queue into the input state only, without
+// creating event tables. Returns true if a quit or window close event arrived.
+static int l_sdl_update_input(lua_State* L) {
+    input_state_begin_frame();
+    int quit = 0;
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        input_state_update(&e);
+        if (e.type == SDL_EVENT_QUIT || e.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED) {
+            quit = 1;
+        }
+    }
+    input_state_end_frame();
+    lua_pushboolean(L, quit);
+    return 1;
+}
+
 // sdl.poll_events(): Return a table of events.
+// sdl.poll_events(events, [with_names]): Fill a reused table instead and return it with the
+// event count. Event tables already in it are reused, so a steady frame loop allocates
+// nothing; iterate with `for i = 1, count` since entries past count are kept for reuse.
+// Key and scancode names are only looked up when with_names is true.
 static int l_sdl_poll_events(lua_State* L) {
+    if (lua_istable(L, 1)) {
+        int with_names = lua_toboolean(L, 2);
+        lua_settop(L, 1);
+        int event_count = 0;
+
+        input_state_begin_frame();
+        SDL_Event e;
+        while (SDL_PollEvent(&e)) {
+            input_state_update(&e);
+            if (lua_rawgeti(L, 1, event_count + 1) != LUA_TTABLE) {
+                lua_pop(L, 1);
+                lua_createtable(L, 0, 14);
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, 1, event_count + 1);
+            }
+            if (fill_event_table(L, &e, with_names)) {
+                event_count++;
+            }
+            lua_pop(L, 1);
+        }
+        input_state_end_frame();
+
+        lua_pushinteger(L, event_count);
+        lua_setfield(L, 1, "n");
+        lua_pushinteger(L, event_count);
+        return 2;
+    }
+
     lua_newtable(L);
     int event_count = 0;
 
+    input_state_begin_frame();
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
+        input_state_update(&e);
         push_event_table(L, &e);
         if (lua_isnil(L, -1)) {
             lua_pop(L, 1);
@@ -463,7 +810,193 @@ static int l_sdl_poll_events(lua_State* L) {
             lua_rawseti(L, -2, ++event_count);
         }
     }
+    input_state_end_frame();
+
+    return 1;
+}
+
+//===============================================
+// Flat float data
+//===============================================
+
+lua_SDL_FloatArray* lua_check_SDL_FloatArray(lua_State* L, int idx) {
+    lua_SDL_FloatArray* arr = (lua_SDL_FloatArray*)luaL_checkudata(L, idx, FLOAT_ARRAY_MT);
+    if (!arr->data && arr->count > 0) {
+        luaL_error(L, "Invalid float array (already destroyed)");
+    }
+    return arr;
+}
+
+static int float_array_gc(lua_State* L) {
+    lua_SDL_FloatArray* arr = (lua_SDL_FloatArray*)luaL_checkudata(L, 1, FLOAT_ARRAY_MT);
+    free(arr->data);
+    arr->data = NULL;
+    arr->count = 0;
+    return 0;
+}
+
+static void float_array_resize(lua_State* L, lua_SDL_FloatArray* arr, int count) {
+    float* data = (float*)realloc(arr->data, (count > 0 ? count : 1) * sizeof(float));
+    if (!data) {
+        luaL_error(L, "Failed to allocate float array of %d elements", count);
+    }
+    if (count > arr->count) {
+        memset(data + arr->count, 0, (count - arr->count) * sizeof(float));
+    }
+    arr->data = data;
+    arr->count = count;
+}
+
+static int check_array_index(lua_State* L, lua_SDL_FloatArray* arr, int idx, int span) {
+    lua_Integer i = luaL_checkinteger(L, idx);
+    luaL_argcheck(L, i >= 1 && i + span - 1 <= arr->count, idx, "index out of range");
+    return (int)i - 1;
+}
+
+// arr:set(i, v1, [v2, ...]): Write consecutive values starting at 1-based index i.
+static int float_array_set(lua_State* L) {
+    lua_SDL_FloatArray* arr = lua_check_SDL_FloatArray(L, 1);
+    int n = lua_gettop(L) - 2;
+    int i = check_array_index(L, arr, 2, n > 0 ? n : 1);
+    for (int k = 0; k < n; k++) {
+        arr->data[i + k] = (float)luaL_checknumber(L, k + 3);
+    }
+    return 0;
+}
+
+// arr:get(i) -> number
+static int float_array_get(lua_State* L) {
+    lua_SDL_FloatArray* arr = lua_check_SDL_FloatArray(L, 1);
+    int i = check_array_index(L, arr, 2, 1);
+    lua_pushnumber(L, arr->data[i]);
+    return 1;
+}
+
+// arr:size() -> number of floats
+static int float_array_size(lua_State* L) {
+    lua_SDL_FloatArray* arr = lua_check_SDL_FloatArray(L, 1);
+    lua_pushinteger(L, arr->count);
+    return 1;
+}
+
+// arr:resize(count): New elements are zero.
+static int float_array_resize_method(lua_State* L) {
+    lua_SDL_FloatArray* arr = lua_check_SDL_FloatArray(L, 1);
+    lua_Integer count = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, count >= 0 && count <= INT_MAX / (lua_Integer)sizeof(float), 2, "invalid size");
+    float_array_resize(L, arr, (int)count);
+    return 0;
+}
+
+static const struct luaL_Reg float_array_methods[] = {
+    {"set", float_array_set},
+    {"get", float_array_get},
+    {"size", float_array_size},
+    {"resize", float_array_resize_method},
+    {NULL, NULL}
+};
+
+static void float_array_metatable(lua_State* L) {
+    luaL_newmetatable(L, FLOAT_ARRAY_MT);
+    lua_pushcfunction(L, float_array_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pushcfunction(L, float_array_size);
+    lua_setfield(L, -2, "__len");
+    luaL_newlib(L, float_array_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+// Push a float array that takes ownership of malloc'd data. Also works in states without the
+// sdl module (worker threads), where the metatable is registered on first use.
+lua_SDL_FloatArray* lua_push_SDL_FloatArray(lua_State* L, float* data, int count) {
+    if (luaL_getmetatable(L, FLOAT_ARRAY_MT) == LUA_TNIL) {
+        float_array_metatable(L);
+    }
+    lua_pop(L, 1);
+    lua_SDL_FloatArray* arr = (lua_SDL_FloatArray*)lua_newuserdata(L, sizeof(lua_SDL_FloatArray));
+    arr->data = data;
+    arr->count = count;
+    luaL_setmetatable(L, FLOAT_ARRAY_MT);
+    return arr;
+}
+
+// Create a float array: sdl.create_float_array(count) or sdl.create_float_array({v1, v2, ...})
+static int l_sdl_create_float_array(lua_State* L) {
+    lua_SDL_FloatArray* arr = (lua_SDL_FloatArray*)lua_newuserdata(L, sizeof(lua_SDL_FloatArray));
+    arr->data = NULL;
+    arr->count = 0;
+    luaL_setmetatable(L, FLOAT_ARRAY_MT);
+
+    if (lua_istable(L, 1)) {
+        int count = (int)lua_rawlen(L, 1);
+        float_array_resize(L, arr, count);
+        for (int i = 1; i <= count; i++) {
+            lua_rawgeti(L, 1, i);
+            arr->data[i - 1] = (float)luaL_checknumber(L, -1);
+            lua_pop(L, 1);
+        }
+    } else {
+        lua_Integer count = luaL_checkinteger(L, 1);
+        luaL_argcheck(L, count >= 0 && count <= INT_MAX / (lua_Integer)sizeof(float), 1, "invalid size");
+        float_array_resize(L, arr, (int)count);
+    }
+    return 1;
+}
+
+// Scratch buffer for flat numeric tables, reused across calls (the renderer is single threaded).
+static float* float_scratch = NULL;
+static size_t float_scratch_capacity = 0;
+
+static float* float_scratch_reserve(lua_State* L, size_t count) {
+    if (count > float_scratch_capacity) {
+        size_t capacity = float_scratch_capacity ? float_scratch_capacity : 1024;
+        while (capacity < count) capacity *= 2;
+        float* data = (float*)realloc(float_scratch, capacity * sizeof(float));
+        if (!data) {
+            luaL_error(L, "Failed to allocate scratch buffer for %d floats", (int)count);
+        }
+        float_scratch = data;
+        float_scratch_capacity = capacity;
+    }
+    return float_scratch;
+}
 
+// Read flat float data at idx: a float array userdata, a packed string of native floats
+// (string.pack("f", ...)), or a flat numeric table {x1, y1, x2, y2, ...}.
+// Returns 0 (nothing read) for a table of tables, which callers handle with the field path.
+static int get_flat_floats(lua_State* L, int idx, const float** data, int* count) {
+    if (lua_type(L, idx) == LUA_TUSERDATA) {
+        lua_SDL_FloatArray* arr = lua_check_SDL_FloatArray(L, idx);
+        *data = arr->data;
+        *count = arr->count;
+        return 1;
+    }
+    if (lua_type(L, idx) == LUA_TSTRING) {
+        size_t len;
+        const char* bytes = lua_tolstring(L, idx, &len);
+        if (len % sizeof(float) != 0) {
+            luaL_error(L, "Packed float string length must be a multiple of %d", (int)sizeof(float));
+        }
+        *data = (const float*)bytes;
+        *count = (int)(len / sizeof(float));
+        return 1;
+    }
+    luaL_checktype(L, idx, LUA_TTABLE);
+    int n = (int)lua_rawlen(L, idx);
+    if (n == 0 || lua_rawgeti(L, idx, 1) != LUA_TNUMBER) {
+        lua_pop(L, 1);
+        return 0;
+    }
+    lua_pop(L, 1);
+    float* out = float_scratch_reserve(L, (size_t)n);
+    for (int i = 1; i <= n; i++) {
+        lua_rawgeti(L, idx, i);
+        out[i - 1] = (float)luaL_checknumber(L, -1);
+        lua_pop(L, 1);
+    }
+    *data = out;
+    *count = n;
     return 1;
 }
 
@@ -485,6 +1018,7 @@ static int l_sdl_render_point(lua_State* L) {
 }
 
 // Draw multiple points: sdl.render_points(renderer, points_table)
+// points may also be flat: {x1, y1, x2, y2, ...}, a packed float string or an sdl.float_array.
 static int l_sdl_render_points(lua_State* L) {
     lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
 
@@ -492,6 +1026,16 @@ static int l_sdl_render_points(lua_State* L) {
         luaL_error(L, "No renderer available");
     }
 
+    const float* flat;
+    int flat_count;
+    if (get_flat_floats(L, 2, &flat, &flat_count)) {
+        // SDL_FPoint is two packed floats, so flat data is passed through as is.
+        if (flat_count >= 2 && !SDL_RenderPoints(ud->renderer, (const SDL_FPoint*)flat, flat_count / 2)) {
+            luaL_error(L, "Failed to draw points: %s", SDL_GetError());
+        }
+        return 0;
+    }
+
     // Expect a table of points [{x1, y1}, {x2, y2}, ...]
     luaL_checktype(L, 2, LUA_TTABLE);
     int count = lua_rawlen(L, 2);
@@ -570,6 +1114,7 @@ static int l_sdl_render_fill_rect(lua_State* L) {
 }
 
 // Draw multiple connected lines: sdl.render_lines(renderer, points_table)
+// points may also be flat: {x1, y1, x2, y2, ...}, a packed float string or an sdl.float_array.
 static int l_sdl_render_lines(lua_State* L) {
     lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
 
@@ -577,6 +1122,18 @@ static int l_sdl_render_lines(lua_State* L) {
         luaL_error(L, "No renderer available");
     }
 
+    const float* flat;
+    int flat_count;
+    if (get_flat_floats(L, 2, &flat, &flat_count)) {
+        if (flat_count < 4) {
+            luaL_error(L, "At least two points are required to draw lines");
+        }
+        if (!SDL_RenderLines(ud->renderer, (const SDL_FPoint*)flat, flat_count / 2)) {
+            luaL_error(L, "Failed to draw lines: %s", SDL_GetError());
+        }
+        return 0;
+    }
+
     // Expect a table of points [{x1, y1}, {x2, y2}, ...]
     luaL_checktype(L, 2, LUA_TTABLE);
     int count = lua_rawlen(L, 2);
@@ -635,7 +1192,101 @@ static int l_sdl_create_texture(lua_State* L) {
     return 1;
 }
 
+// Read the vertex table at the top of the stack: {x, y, r, g, b, a, u, v}
+static void read_vertex(lua_State* L, SDL_Vertex* vertex) {
+    luaL_checktype(L, -1, LUA_TTABLE);
+
+    lua_getfield(L, -1, "x");
+    vertex->position.x = (float)luaL_checknumber(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "y");
+    vertex->position.y = (float)luaL_checknumber(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "r");
+    vertex->color.r = (float)luaL_optnumber(L, -1, 1.0); // Default to 1.0 (white)
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "g");
+    vertex->color.g = (float)luaL_optnumber(L, -1, 1.0);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "b");
+    vertex->color.b = (float)luaL_optnumber(L, -1, 1.0);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "a");
+    vertex->color.a = (float)luaL_optnumber(L, -1, 1.0);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "u");
+    vertex->tex_coord.x = (float)luaL_optnumber(L, -1, 0.0); // Default to 0.0
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "v");
+    vertex->tex_coord.y = (float)luaL_optnumber(L, -1, 0.0);
+    lua_pop(L, 1);
+}
+
+// Flat vertex layout: 8 floats per vertex (x, y, r, g, b, a, u, v), colors 0.0 - 1.0.
+#define FLAT_VERTEX_FLOATS 8
+
+// Indices for the flat path: a table of 1-based integers (like the table path) or a
+// packed string of native 0-based int32 values (string.pack("i4", ...)).
+static int render_geometry_flat(lua_State* L, SDL_Renderer* renderer, SDL_Texture* texture,
+                                const float* flat, int flat_count, int indices_idx) {
+    if (flat_count % FLAT_VERTEX_FLOATS != 0) {
+        luaL_error(L, "Flat vertex data must have %d floats per vertex (x, y, r, g, b, a, u, v)", FLAT_VERTEX_FLOATS);
+    }
+    int num_vertices = flat_count / FLAT_VERTEX_FLOATS;
+    if (num_vertices == 0) {
+        return 0;
+    }
+
+    const void* indices = NULL;
+    int num_indices = 0;
+    int* owned_indices = NULL;
+    if (lua_type(L, indices_idx) == LUA_TSTRING) {
+        size_t len;
+        indices = lua_tolstring(L, indices_idx, &len);
+        if (len % sizeof(int) != 0) {
+            luaL_error(L, "Packed index string length must be a multiple of %d", (int)sizeof(int));
+        }
+        num_indices = (int)(len / sizeof(int));
+    } else if (!lua_isnoneornil(L, indices_idx)) {
+        luaL_checktype(L, indices_idx, LUA_TTABLE);
+        num_indices = (int)lua_rawlen(L, indices_idx);
+        if (num_indices > 0) {
+            owned_indices = (int*)malloc(num_indices * sizeof(int));
+            if (!owned_indices) {
+                luaL_error(L, "Failed to allocate memory for indices");
+            }
+            for (int i = 1; i <= num_indices; i++) {
+                lua_rawgeti(L, indices_idx, i);
+                owned_indices[i-1] = (int)lua_tointeger(L, -1) - 1; // Lua indices are 1-based
+                lua_pop(L, 1);
+            }
+            indices = owned_indices;
+        }
+    }
+
+    const int stride = FLAT_VERTEX_FLOATS * (int)sizeof(float);
+    bool ok = SDL_RenderGeometryRaw(renderer, texture,
+                                    flat, stride,
+                                    (const SDL_FColor*)(flat + 2), stride,
+                                    flat + 6, stride,
+                                    num_vertices, indices, num_indices, indices ? (int)sizeof(int) : 0);
+    if (owned_indices) free(owned_indices);
+    if (!ok) {
+        luaL_error(L, "Failed to render geometry: %s", SDL_GetError());
+    }
+    return 0;
+}
+
 // Render geometry: sdl.render_geometry(renderer, texture, vertices, indices)
+// vertices may also be flat (8 floats per vertex: x, y, r, g, b, a, u, v) as a numeric
+// table, packed float string or sdl.float_array; this path uses SDL_RenderGeometryRaw.
 static int l_sdl_render_geometry(lua_State* L) {
     lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
     SDL_Texture* texture = NULL;
@@ -648,6 +1299,12 @@ static int l_sdl_render_geometry(lua_State* L) {
         luaL_error(L, "No renderer available");
     }
 
+    const float* flat;
+    int flat_count;
+    if (get_flat_floats(L, 3, &flat, &flat_count)) {
+        return render_geometry_flat(L, ud->renderer, texture, flat, flat_count, 4);
+    }
+
     // Expect a table of vertices [{x, y, r, g, b, a, u, v}, ...]
     luaL_checktype(L, 3, LUA_TTABLE);
     int num_vertices = lua_rawlen(L, 3);
@@ -663,42 +1320,9 @@ static int l_sdl_render_geometry(lua_State* L) {
     // Iterate over the vertices table
     for (int i = 1; i <= num_vertices; i++) {
         lua_rawgeti(L, 3, i); // Get vertices[i]
-        luaL_checktype(L, -1, LUA_TTABLE);
-
-        lua_getfield(L, -1, "x");
-        vertices[i-1].position.x = (float)luaL_checknumber(L, -1);
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "y");
-        vertices[i-1].position.y = (float)luaL_checknumber(L, -1);
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "r");
-        vertices[i-1].color.r = (float)luaL_optnumber(L, -1, 1.0); // Default to 1.0 (white)
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "g");
-        vertices[i-1].color.g = (float)luaL_optnumber(L, -1, 1.0);
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "b");
-        vertices[i-1].color.b = (float)luaL_optnumber(L, -1, 1.0);
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "a");
-        vertices[i-1].color.a = (float)luaL_optnumber(L, -1, 1.0);
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "u");
-        vertices[i-1].tex_coord.x = (float)luaL_optnumber(L, -1, 0.0); // Default to 0.0
-        lua_pop(L, 1);
-
-        lua_getfield(L, -1, "v");
-        vertices[i-1].tex_coord.y = (float)luaL_optnumber(L, -1, 0.0);
-        lua_pop(L, 1);
-
-        lua_pop(L, 1); // Pop the vertex table
-    }
+        read_vertex(L, &vertices[i-1]);
+        lua_pop(L, 1); // Pop the vertex table
+    }
 
     // Handle indices (optional)
     int* indices = NULL;
@@ -750,6 +1374,1312 @@ static int l_sdl_quit(lua_State* L) {
     return 0;
 }
 
+//===============================================
+// 2D batch
+//===============================================
+
+lua_SDL_Batch* lua_check_SDL_Batch(lua_State* L, int idx) {
+    lua_SDL_Batch* batch = (lua_SDL_Batch*)luaL_checkudata(L, idx, BATCH_MT);
+    if (!batch->vertices) {
+        luaL_error(L, "Invalid batch (already destroyed)");
+    }
+    return batch;
+}
+
+// Make room for nv more vertices and ni more indices; returns the base vertex index.
+static int batch_reserve(lua_State* L, lua_SDL_Batch* batch, int nv, int ni) {
+    if (batch->num_vertices + nv > batch->vertex_capacity) {
+        int capacity = batch->vertex_capacity * 2;
+        while (capacity < batch->num_vertices + nv) capacity *= 2;
+        SDL_Vertex* vertices = (SDL_Vertex*)realloc(batch->vertices, capacity * sizeof(SDL_Vertex));
+        if (!vertices) {
+            luaL_error(L, "Failed to grow batch vertex array");
+        }
+        batch->vertices = vertices;
+        batch->vertex_capacity = capacity;
+    }
+    if (batch->num_indices + ni > batch->index_capacity) {
+        int capacity = batch->index_capacity * 2;
+        while (capacity < batch->num_indices + ni) capacity *= 2;
+        int* indices = (int*)realloc(batch->indices, capacity * sizeof(int));
+        if (!indices) {
+            luaL_error(L, "Failed to grow batch index array");
+        }
+        batch->indices = indices;
+        batch->index_capacity = capacity;
+    }
+    return batch->num_vertices;
+}
+
+static void batch_vertex(lua_SDL_Batch* batch, float x, float y, float u, float v) {
+    SDL_Vertex* vert = &batch->vertices[batch->num_vertices++];
+    vert->position.x = x;
+    vert->position.y = y;
+    vert->color = batch->color;
+    vert->tex_coord.x = u;
+    vert->tex_coord.y = v;
+}
+
+// Append a quad given in winding order (two triangles).
+static void batch_quad(lua_State* L, lua_SDL_Batch* batch, const float* xy, const float* uv) {
+    int base = batch_reserve(L, batch, 4, 6);
+    for (int i = 0; i < 4; i++) {
+        batch_vertex(batch, xy[i * 2], xy[i * 2 + 1], uv ? uv[i * 2] : 0.0f, uv ? uv[i * 2 + 1] : 0.0f);
+    }
+    int* idx = &batch->indices[batch->num_indices];
+    idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+    idx[3] = base; idx[4] = base + 2; idx[5] = base + 3;
+    batch->num_indices += 6;
+}
+
+static void batch_rect(lua_State* L, lua_SDL_Batch* batch, float x, float y, float w, float h) {
+    float xy[8] = { x, y, x + w, y, x + w, y + h, x, y + h };
+    batch_quad(L, batch, xy, NULL);
+}
+
+// A line is a quad of line_width around the segment.
+static void batch_line(lua_State* L, lua_SDL_Batch* batch, float x1, float y1, float x2, float y2) {
+    float dx = x2 - x1, dy = y2 - y1;
+    float len = SDL_sqrtf(dx * dx + dy * dy);
+    float half = batch->line_width * 0.5f;
+    if (len <= 0.0f) {
+        batch_rect(L, batch, x1 - half, y1 - half, batch->line_width, batch->line_width);
+        return;
+    }
+    float nx = -dy / len * half, ny = dx / len * half;
+    float xy[8] = { x1 + nx, y1 + ny, x2 + nx, y2 + ny, x2 - nx, y2 - ny, x1 - nx, y1 - ny };
+    batch_quad(L, batch, xy, NULL);
+}
+
+static float batch_color_component(lua_State* L, int idx, lua_Integer def) {
+    lua_Integer c = luaL_optinteger(L, idx, def);
+    c = c < 0 ? 0 : (c > 255 ? 255 : c);
+    return (float)c / 255.0f;
+}
+
+static int batch_gc(lua_State* L) {
+    lua_SDL_Batch* batch = (lua_SDL_Batch*)luaL_checkudata(L, 1, BATCH_MT);
+    free(batch->vertices);
+    free(batch->indices);
+    batch->vertices = NULL;
+    batch->indices = NULL;
+    return 0;
+}
+
+// batch:set_color(r, g, b, [a]): Color (0-255) for primitives added afterwards.
+static int batch_set_color(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    batch->color.r = batch_color_component(L, 2, 255);
+    batch->color.g = batch_color_component(L, 3, 255);
+    batch->color.b = batch_color_component(L, 4, 255);
+    batch->color.a = batch_color_component(L, 5, 255);
+    return 0;
+}
+
+// batch:set_line_width(width): Thickness used by line and rect.
+static int batch_set_line_width(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    batch->line_width = (float)luaL_checknumber(L, 2);
+    return 0;
+}
+
+// batch:point(x, y): One pixel square.
+static int batch_point(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    batch_rect(L, batch, (float)luaL_checknumber(L, 2), (float)luaL_checknumber(L, 3), 1.0f, 1.0f);
+    return 0;
+}
+
+// batch:line(x1, y1, x2, y2)
+static int batch_line_method(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    batch_line(L, batch, (float)luaL_checknumber(L, 2), (float)luaL_checknumber(L, 3),
+               (float)luaL_checknumber(L, 4), (float)luaL_checknumber(L, 5));
+    return 0;
+}
+
+// batch:rect(x, y, w, h): Rectangle outline, line_width thick, drawn inside the rectangle.
+static int batch_rect_method(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    float x = (float)luaL_checknumber(L, 2);
+    float y = (float)luaL_checknumber(L, 3);
+    float w = (float)luaL_checknumber(L, 4);
+    float h = (float)luaL_checknumber(L, 5);
+    float t = batch->line_width;
+    if (w <= 2 * t || h <= 2 * t) {
+        batch_rect(L, batch, x, y, w, h);
+        return 0;
+    }
+    batch_rect(L, batch, x, y, w, t);
+    batch_rect(L, batch, x, y + h - t, w, t);
+    batch_rect(L, batch, x, y + t, t, h - 2 * t);
+    batch_rect(L, batch, x + w - t, y + t, t, h - 2 * t);
+    return 0;
+}
+
+// batch:fill_rect(x, y, w, h)
+static int batch_fill_rect(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    batch_rect(L, batch, (float)luaL_checknumber(L, 2), (float)luaL_checknumber(L, 3),
+               (float)luaL_checknumber(L, 4), (float)luaL_checknumber(L, 5));
+    return 0;
+}
+
+// batch:quad(x1, y1, x2, y2, x3, y3, x4, y4): Filled quad in winding order.
+static int batch_quad_method(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    float xy[8];
+    for (int i = 0; i < 8; i++) {
+        xy[i] = (float)luaL_checknumber(L, i + 2);
+    }
+    batch_quad(L, batch, xy, NULL);
+    return 0;
+}
+
+// batch:triangle(x1, y1, x2, y2, x3, y3)
+static int batch_triangle(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    float xy[6];
+    for (int i = 0; i < 6; i++) {
+        xy[i] = (float)luaL_checknumber(L, i + 2);
+    }
+    int base = batch_reserve(L, batch, 3, 3);
+    for (int i = 0; i < 3; i++) {
+        batch_vertex(batch, xy[i * 2], xy[i * 2 + 1], 0.0f, 0.0f);
+        batch->indices[batch->num_indices++] = base + i;
+    }
+    return 0;
+}
+
+// batch:sprite(x, y, w, h, [u0, v0, u1, v1]): Textured quad, uv defaults to the whole texture.
+static int batch_sprite(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    float x = (float)luaL_checknumber(L, 2);
+    float y = (float)luaL_checknumber(L, 3);
+    float w = (float)luaL_checknumber(L, 4);
+    float h = (float)luaL_checknumber(L, 5);
+    float u0 = (float)luaL_optnumber(L, 6, 0.0);
+    float v0 = (float)luaL_optnumber(L, 7, 0.0);
+    float u1 = (float)luaL_optnumber(L, 8, 1.0);
+    float v1 = (float)luaL_optnumber(L, 9, 1.0);
+    float xy[8] = { x, y, x + w, y, x + w, y + h, x, y + h };
+    float uv[8] = { u0, v0, u1, v0, u1, v1, u0, v1 };
+    batch_quad(L, batch, xy, uv);
+    return 0;
+}
+
+// batch:count() -> vertices, indices
+static int batch_count(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    lua_pushinteger(L, batch->num_vertices);
+    lua_pushinteger(L, batch->num_indices);
+    return 2;
+}
+
+// batch:clear(): Drop queued primitives, keeping the allocated arrays.
+static int batch_clear(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    batch->num_vertices = 0;
+    batch->num_indices = 0;
+    return 0;
+}
+
+// batch:flush(renderer, [texture]): Draw everything queued with one SDL_RenderGeometry call, then clear.
+static int batch_flush(lua_State* L) {
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 1);
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 2);
+    SDL_Texture* texture = NULL;
+    if (!lua_isnoneornil(L, 3)) {
+        texture = lua_check_SDL_Texture(L, 3)->texture;
+    }
+
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+    if (batch->num_indices == 0) {
+        return 0;
+    }
+
+    int num_vertices = batch->num_vertices, num_indices = batch->num_indices;
+    batch->num_vertices = 0;
+    batch->num_indices = 0;
+    if (!SDL_RenderGeometry(ud->renderer, texture, batch->vertices, num_vertices, batch->indices, num_indices)) {
+        luaL_error(L, "Failed to render batch: %s", SDL_GetError());
+    }
+    return 0;
+}
+
+static const struct luaL_Reg batch_methods[] = {
+    {"set_color", batch_set_color},
+    {"set_line_width", batch_set_line_width},
+    {"point", batch_point},
+    {"line", batch_line_method},
+    {"rect", batch_rect_method},
+    {"fill_rect", batch_fill_rect},
+    {"quad", batch_quad_method},
+    {"triangle", batch_triangle},
+    {"sprite", batch_sprite},
+    {"count", batch_count},
+    {"clear", batch_clear},
+    {"flush", batch_flush},
+    {NULL, NULL}
+};
+
+static void batch_metatable(lua_State* L) {
+    luaL_newmetatable(L, BATCH_MT);
+    lua_pushcfunction(L, batch_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, batch_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+// Create a 2D batch: sdl.create_batch([vertex_capacity])
+static int l_sdl_create_batch(lua_State* L) {
+    int capacity = (int)luaL_optinteger(L, 1, 4096);
+    if (capacity < 4) capacity = 4;
+
+    lua_SDL_Batch* batch = (lua_SDL_Batch*)lua_newuserdata(L, sizeof(lua_SDL_Batch));
+    memset(batch, 0, sizeof(lua_SDL_Batch));
+    luaL_setmetatable(L, BATCH_MT);
+
+    batch->vertices = (SDL_Vertex*)malloc(capacity * sizeof(SDL_Vertex));
+    batch->indices = (int*)malloc(capacity / 4 * 6 * sizeof(int));
+    if (!batch->vertices || !batch->indices) {
+        luaL_error(L, "Failed to allocate batch arrays");
+    }
+    batch->vertex_capacity = capacity;
+    batch->index_capacity = capacity / 4 * 6;
+    batch->color.r = batch->color.g = batch->color.b = batch->color.a = 1.0f;
+    batch->line_width = 1.0f;
+    return 1;
+}
+
+//===============================================
+// Retained geometry
+//===============================================
+
+lua_SDL_Geometry* lua_check_SDL_Geometry(lua_State* L, int idx) {
+    lua_SDL_Geometry* geom = (lua_SDL_Geometry*)luaL_checkudata(L, idx, GEOMETRY_MT);
+    if (!geom->vertices) {
+        luaL_error(L, "Invalid geometry (already destroyed)");
+    }
+    return geom;
+}
+
+static int geometry_gc(lua_State* L) {
+    lua_SDL_Geometry* geom = (lua_SDL_Geometry*)luaL_checkudata(L, 1, GEOMETRY_MT);
+    free(geom->vertices);
+    free(geom->indices);
+    geom->vertices = NULL;
+    geom->indices = NULL;
+    return 0;
+}
+
+static void geometry_metatable(lua_State* L) {
+    luaL_newmetatable(L, GEOMETRY_MT);
+    lua_pushcfunction(L, geometry_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+// Create retained geometry: sdl.create_geometry(vertices, [indices])
+// vertices and indices take the same forms as sdl.render_geometry; they are converted
+// once into SDL_Vertex / int arrays owned by the returned userdata.
+static int l_sdl_create_geometry(lua_State* L) {
+    lua_SDL_Geometry* geom = (lua_SDL_Geometry*)lua_newuserdata(L, sizeof(lua_SDL_Geometry));
+    memset(geom, 0, sizeof(lua_SDL_Geometry));
+    luaL_setmetatable(L, GEOMETRY_MT); // __gc frees the arrays if parsing raises an error
+
+    const float* flat;
+    int flat_count;
+    if (get_flat_floats(L, 1, &flat, &flat_count)) {
+        if (flat_count == 0 || flat_count % FLAT_VERTEX_FLOATS != 0) {
+            luaL_error(L, "Flat vertex data must have %d floats per vertex (x, y, r, g, b, a, u, v)", FLAT_VERTEX_FLOATS);
+        }
+        geom->num_vertices = flat_count / FLAT_VERTEX_FLOATS;
+        geom->vertices = (SDL_Vertex*)malloc(geom->num_vertices * sizeof(SDL_Vertex));
+        if (!geom->vertices) {
+            luaL_error(L, "Failed to allocate memory for vertices");
+        }
+        for (int i = 0; i < geom->num_vertices; i++) {
+            const float* f = flat + i * FLAT_VERTEX_FLOATS;
+            SDL_Vertex* v = &geom->vertices[i];
+            v->position.x = f[0];
+            v->position.y = f[1];
+            v->color.r = f[2];
+            v->color.g = f[3];
+            v->color.b = f[4];
+            v->color.a = f[5];
+            v->tex_coord.x = f[6];
+            v->tex_coord.y = f[7];
+        }
+    } else {
+        int num_vertices = (int)lua_rawlen(L, 1);
+        if (num_vertices == 0) {
+            luaL_error(L, "Geometry needs at least one vertex");
+        }
+        geom->vertices = (SDL_Vertex*)malloc(num_vertices * sizeof(SDL_Vertex));
+        if (!geom->vertices) {
+            luaL_error(L, "Failed to allocate memory for vertices");
+        }
+        geom->num_vertices = num_vertices;
+        for (int i = 1; i <= num_vertices; i++) {
+            lua_rawgeti(L, 1, i);
+            read_vertex(L, &geom->vertices[i-1]);
+            lua_pop(L, 1);
+        }
+    }
+
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        size_t len;
+        const char* bytes = lua_tolstring(L, 2, &len);
+        if (len % sizeof(int) != 0) {
+            luaL_error(L, "Packed index string length must be a multiple of %d", (int)sizeof(int));
+        }
+        geom->num_indices = (int)(len / sizeof(int));
+        geom->indices = (int*)malloc(len > 0 ? len : 1);
+        if (!geom->indices) {
+            luaL_error(L, "Failed to allocate memory for indices");
+        }
+        memcpy(geom->indices, bytes, len);
+    } else if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        int num_indices = (int)lua_rawlen(L, 2);
+        geom->indices = (int*)malloc((num_indices > 0 ? num_indices : 1) * sizeof(int));
+        if (!geom->indices) {
+            luaL_error(L, "Failed to allocate memory for indices");
+        }
+        geom->num_indices = num_indices;
+        for (int i = 1; i <= num_indices; i++) {
+            lua_rawgeti(L, 2, i);
+            geom->indices[i-1] = (int)luaL_checkinteger(L, -1) - 1; // Lua indices are 1-based, SDL expects 0-based
+            lua_pop(L, 1);
+        }
+    }
+
+    for (int i = 0; i < geom->num_indices; i++) {
+        if (geom->indices[i] < 0 || geom->indices[i] >= geom->num_vertices) {
+            luaL_error(L, "Geometry index %d out of range (vertex count %d)", geom->indices[i] + 1, geom->num_vertices);
+        }
+    }
+    return 1;
+}
+
+// Draw retained geometry: sdl.draw_geometry(renderer, geom, [texture], [dx], [dy])
+// An optional translation offsets the positions for this draw only.
+static int l_sdl_draw_geometry(lua_State* L) {
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
+    lua_SDL_Geometry* geom = lua_check_SDL_Geometry(L, 2);
+    SDL_Texture* texture = NULL;
+    if (!lua_isnoneornil(L, 3)) {
+        texture = lua_check_SDL_Texture(L, 3)->texture;
+    }
+    float dx = (float)luaL_optnumber(L, 4, 0.0);
+    float dy = (float)luaL_optnumber(L, 5, 0.0);
+
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+
+    bool ok;
+    if (dx == 0.0f && dy == 0.0f) {
+        ok = SDL_RenderGeometry(ud->renderer, texture, geom->vertices, geom->num_vertices,
+                                geom->indices, geom->num_indices);
+    } else {
+        // Translate positions into the scratch buffer; colors and uvs are read in place.
+        float* xy = float_scratch_reserve(L, (size_t)geom->num_vertices * 2);
+        for (int i = 0; i < geom->num_vertices; i++) {
+            xy[i * 2] = geom->vertices[i].position.x + dx;
+            xy[i * 2 + 1] = geom->vertices[i].position.y + dy;
+        }
+        ok = SDL_RenderGeometryRaw(ud->renderer, texture,
+                                   xy, 2 * (int)sizeof(float),
+                                   &geom->vertices[0].color, (int)sizeof(SDL_Vertex),
+                                   &geom->vertices[0].tex_coord.x, (int)sizeof(SDL_Vertex),
+                                   geom->num_vertices, geom->indices, geom->num_indices,
+                                   geom->indices ? (int)sizeof(int) : 0);
+    }
+    if (!ok) {
+        luaL_error(L, "Failed to draw geometry: %s", SDL_GetError());
+    }
+    return 0;
+}
+
+//===============================================
+// Images
+//===============================================
+
+// stb_image allocates with malloc (STBI_MALLOC is left at its default), so every
+// image buffer is released with free().
+lua_SDL_Image* lua_push_SDL_Image(lua_State* L, unsigned char* pixels, int width, int height) {
+    if (!pixels) {
+        luaL_error(L, "Cannot create userdata for null image pixels");
+    }
+    lua_SDL_Image* img = (lua_SDL_Image*)lua_newuserdata(L, sizeof(lua_SDL_Image));
+    img->pixels = pixels;
+    img->width = width;
+    img->height = height;
+    luaL_setmetatable(L, IMAGE_MT);
+    return img;
+}
+
+lua_SDL_Image* lua_check_SDL_Image(lua_State* L, int idx) {
+    lua_SDL_Image* img = (lua_SDL_Image*)luaL_checkudata(L, idx, IMAGE_MT);
+    if (!img->pixels) {
+        luaL_error(L, "Invalid image (already destroyed)");
+    }
+    return img;
+}
+
+static int image_gc(lua_State* L) {
+    lua_SDL_Image* img = (lua_SDL_Image*)luaL_checkudata(L, 1, IMAGE_MT);
+    free(img->pixels);
+    img->pixels = NULL;
+    return 0;
+}
+
+// image:size() -> w, h
+static int image_size(lua_State* L) {
+    lua_SDL_Image* img = lua_check_SDL_Image(L, 1);
+    lua_pushinteger(L, img->width);
+    lua_pushinteger(L, img->height);
+    return 2;
+}
+
+static unsigned char* image_texel(lua_State* L, lua_SDL_Image* img, int x, int y) {
+    if (x < 0 || y < 0 || x >= img->width || y >= img->height) {
+        luaL_error(L, "Pixel (%d, %d) out of range (image is %dx%d)", x, y, img->width, img->height);
+    }
+    return img->pixels + ((size_t)y * img->width + x) * 4;
+}
+
+// image:get_pixel(x, y) -> r, g, b, a (0-255, x/y are 0-based)
+static int image_get_pixel(lua_State* L) {
+    lua_SDL_Image* img = lua_check_SDL_Image(L, 1);
+    unsigned char* p = image_texel(L, img, (int)luaL_checkinteger(L, 2), (int)luaL_checkinteger(L, 3));
+    for (int i = 0; i < 4; i++) {
+        lua_pushinteger(L, p[i]);
+    }
+    return 4;
+}
+
+// image:set_pixel(x, y, r, g, b, [a])
+static int image_set_pixel(lua_State* L) {
+    lua_SDL_Image* img = lua_check_SDL_Image(L, 1);
+    unsigned char* p = image_texel(L, img, (int)luaL_checkinteger(L, 2), (int)luaL_checkinteger(L, 3));
+    p[0] = (unsigned char)luaL_checkinteger(L, 4);
+    p[1] = (unsigned char)luaL_checkinteger(L, 5);
+    p[2] = (unsigned char)luaL_checkinteger(L, 6);
+    p[3] = (unsigned char)luaL_optinteger(L, 7, 255);
+    return 0;
+}
+
+// image:fill(r, g, b, [a])
+static int image_fill(lua_State* L) {
+    lua_SDL_Image* img = lua_check_SDL_Image(L, 1);
+    unsigned char rgba[4] = {
+        (unsigned char)luaL_checkinteger(L, 2),
+        (unsigned char)luaL_checkinteger(L, 3),
+        (unsigned char)luaL_checkinteger(L, 4),
+        (unsigned char)luaL_optinteger(L, 5, 255)
+    };
+    size_t count = (size_t)img->width * img->height;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(img->pixels + i * 4, rgba, 4);
+    }
+    return 0;
+}
+
+static const struct luaL_Reg image_methods[] = {
+    {"size", image_size},
+    {"get_pixel", image_get_pixel},
+    {"set_pixel", image_set_pixel},
+    {"fill", image_fill},
+    {NULL, NULL}
+};
+
+static void image_metatable(lua_State* L) {
+    luaL_newmetatable(L, IMAGE_MT);
+    lua_pushcfunction(L, image_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, image_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+// Load an image file: sdl.load_image(path) -> image | nil, err
+// PNG, JPEG, BMP and TGA are decoded to RGBA8.
+static int l_sdl_load_image(lua_State* L) {
+    const char* path = luaL_checkstring(L, 1);
+    int w, h, channels;
+    unsigned char* pixels = stbi_load(path, &w, &h, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "Failed to load image '%s': %s", path, stbi_failure_reason());
+        return 2;
+    }
+    lua_push_SDL_Image(L, pixels, w, h);
+    return 1;
+}
+
+// Decode an image held in a string: sdl.load_image_from_memory(bytes) -> image | nil, err
+static int l_sdl_load_image_from_memory(lua_State* L) {
+    size_t len;
+    const char* bytes = luaL_checklstring(L, 1, &len);
+    if (len > INT_MAX) {
+        luaL_error(L, "Image data too large");
+    }
+    int w, h, channels;
+    unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)bytes, (int)len, &w, &h, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "Failed to decode image: %s", stbi_failure_reason());
+        return 2;
+    }
+    lua_push_SDL_Image(L, pixels, w, h);
+    return 1;
+}
+
+// Create a blank (transparent) image: sdl.create_image(w, h)
+static int l_sdl_create_image(lua_State* L) {
+    int w = (int)luaL_checkinteger(L, 1);
+    int h = (int)luaL_checkinteger(L, 2);
+    if (w <= 0 || h <= 0 || (size_t)w > SIZE_MAX / 4 / (size_t)h) {
+        luaL_error(L, "Invalid image size %dx%d", w, h);
+    }
+    unsigned char* pixels = (unsigned char*)calloc((size_t)w * h, 4);
+    if (!pixels) {
+        luaL_error(L, "Failed to allocate image pixels");
+    }
+    lua_push_SDL_Image(L, pixels, w, h);
+    return 1;
+}
+
+// Create an RGBA32 texture from an image: sdl.create_texture_from_image(renderer, image, [access])
+static int l_sdl_create_texture_from_image(lua_State* L) {
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
+    lua_SDL_Image* img = lua_check_SDL_Image(L, 2);
+    int access = (int)luaL_optinteger(L, 3, SDL_TEXTUREACCESS_STATIC);
+
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(ud->renderer, SDL_PIXELFORMAT_RGBA32, access, img->width, img->height);
+    if (!texture) {
+        luaL_error(L, "Failed to create texture: %s", SDL_GetError());
+    }
+    if (!SDL_UpdateTexture(texture, NULL, img->pixels, img->width * 4)) {
+        SDL_DestroyTexture(texture);
+        luaL_error(L, "Failed to upload texture: %s", SDL_GetError());
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    lua_push_SDL_Texture(L, texture);
+    return 1;
+}
+
+// Read an RGBA8 pixel source (image or packed string) covering w x h pixels.
+// For strings w and h must be supplied by the caller; *pitch is the source row length in bytes.
+static const unsigned char* check_pixel_source(lua_State* L, int idx, int* w, int* h, int* pitch) {
+    if (lua_type(L, idx) == LUA_TSTRING) {
+        size_t len;
+        const char* bytes = lua_tolstring(L, idx, &len);
+        if (len != (size_t)*w * (size_t)*h * 4) {
+            luaL_error(L, "Pixel string is %d bytes, expected %d (%dx%d RGBA)", (int)len, *w * *h * 4, *w, *h);
+        }
+        *pitch = *w * 4;
+        return (const unsigned char*)bytes;
+    }
+    lua_SDL_Image* img = lua_check_SDL_Image(L, idx);
+    if (*w > img->width || *h > img->height) {
+        luaL_error(L, "Region %dx%d is larger than the image (%dx%d)", *w, *h, img->width, img->height);
+    }
+    *pitch = img->width * 4;
+    return img->pixels;
+}
+
+// Pixel sources are tightly packed RGBA8, so only RGBA32 textures can take them as-is.
+static void check_rgba32_texture(lua_State* L, SDL_Texture* texture) {
+    SDL_PixelFormat format = (SDL_PixelFormat)SDL_GetNumberProperty(SDL_GetTextureProperties(texture),
+                                                                    SDL_PROP_TEXTURE_FORMAT_NUMBER, SDL_PIXELFORMAT_UNKNOWN);
+    if (format != SDL_PIXELFORMAT_RGBA32) {
+        luaL_error(L, "Texture format %s is not RGBA32", SDL_GetPixelFormatName(format));
+    }
+}
+
+static void texture_size(lua_State* L, SDL_Texture* texture, int* w, int* h) {
+    float fw, fh;
+    if (!SDL_GetTextureSize(texture, &fw, &fh)) {
+        luaL_error(L, "Failed to get texture size: %s", SDL_GetError());
+    }
+    *w = (int)fw;
+    *h = (int)fh;
+}
+
+// Update part of a texture: sdl.update_texture(texture, src, [x], [y], [w], [h])
+// src is an image or an RGBA8 string. The region defaults to the image size, or the
+// whole texture for strings. The texture must use SDL_PIXELFORMAT_RGBA32.
+static int l_sdl_update_texture(lua_State* L) {
+    lua_SDL_Texture* tex = lua_check_SDL_Texture(L, 1);
+    check_rgba32_texture(L, tex->texture);
+    int tw, th;
+    texture_size(L, tex->texture, &tw, &th);
+
+    int def_w = tw, def_h = th;
+    if (lua_type(L, 2) != LUA_TSTRING) {
+        lua_SDL_Image* img = lua_check_SDL_Image(L, 2);
+        def_w = img->width;
+        def_h = img->height;
+    }
+    SDL_Rect rect;
+    rect.x = (int)luaL_optinteger(L, 3, 0);
+    rect.y = (int)luaL_optinteger(L, 4, 0);
+    rect.w = (int)luaL_optinteger(L, 5, def_w);
+    rect.h = (int)luaL_optinteger(L, 6, def_h);
+    if (rect.x < 0 || rect.y < 0 || rect.w <= 0 || rect.h <= 0 || rect.x + rect.w > tw || rect.y + rect.h > th) {
+        luaL_error(L, "Update region (%d, %d, %d, %d) outside texture (%dx%d)", rect.x, rect.y, rect.w, rect.h, tw, th);
+    }
+
+    int pitch;
+    const unsigned char* pixels = check_pixel_source(L, 2, &rect.w, &rect.h, &pitch);
+    if (!SDL_UpdateTexture(tex->texture, &rect, pixels, pitch)) {
+        luaL_error(L, "Failed to update texture: %s", SDL_GetError());
+    }
+    return 0;
+}
+
+// Rewrite a streaming texture through SDL_LockTexture: sdl.stream_texture(texture, src)
+// src (image or RGBA8 string) must match the texture size. Rows are copied straight
+// into the locked buffer, honouring its pitch. The texture must use SDL_PIXELFORMAT_RGBA32.
+static int l_sdl_stream_texture(lua_State* L) {
+    lua_SDL_Texture* tex = lua_check_SDL_Texture(L, 1);
+    check_rgba32_texture(L, tex->texture);
+    int w, h;
+    texture_size(L, tex->texture, &w, &h);
+    if (lua_type(L, 2) != LUA_TSTRING) {
+        lua_SDL_Image* img = lua_check_SDL_Image(L, 2);
+        if (img->width != w || img->height != h) {
+            luaL_error(L, "Image is %dx%d, texture is %dx%d", img->width, img->height, w, h);
+        }
+    }
+    int src_pitch;
+    const unsigned char* src = check_pixel_source(L, 2, &w, &h, &src_pitch);
+
+    void* dst;
+    int dst_pitch;
+    if (!SDL_LockTexture(tex->texture, NULL, &dst, &dst_pitch)) {
+        luaL_error(L, "Failed to lock texture: %s", SDL_GetError());
+    }
+    if (dst_pitch == src_pitch) {
+        memcpy(dst, src, (size_t)src_pitch * h);
+    } else {
+        for (int row = 0; row < h; row++) {
+            memcpy((unsigned char*)dst + (size_t)row * dst_pitch, src + (size_t)row * src_pitch, (size_t)w * 4);
+        }
+    }
+    SDL_UnlockTexture(tex->texture);
+    return 0;
+}
+
+//===============================================
+// Texture atlas
+//===============================================
+
+#define ATLAS_PADDING 1 // Transparent gap between packed images to avoid bleeding when filtering
+
+lua_SDL_Atlas* lua_check_SDL_Atlas(lua_State* L, int idx) {
+    lua_SDL_Atlas* atlas = (lua_SDL_Atlas*)luaL_checkudata(L, idx, ATLAS_MT);
+    if (!atlas->nodes) {
+        luaL_error(L, "Invalid atlas (already destroyed)");
+    }
+    return atlas;
+}
+
+// Set up the packer and an empty RGBA32 texture. Pushes the texture userdata, which the
+// owner must keep alive (atlas->texture is borrowed from it).
+static void atlas_init(lua_State* L, lua_SDL_Atlas* atlas, SDL_Renderer* renderer, int w, int h) {
+    if (w <= 0 || h <= 0) {
+        luaL_error(L, "Invalid atlas size %dx%d", w, h);
+    }
+    atlas->nodes = (stbrp_node*)malloc((size_t)w * sizeof(stbrp_node));
+    if (!atlas->nodes) {
+        luaL_error(L, "Failed to allocate atlas nodes");
+    }
+    atlas->width = w;
+    atlas->height = h;
+    atlas->count = 0;
+    stbrp_init_target(&atlas->packer, w, h, atlas->nodes, w);
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, w, h);
+    if (!texture) {
+        luaL_error(L, "Failed to create atlas texture: %s", SDL_GetError());
+    }
+    lua_push_SDL_Texture(L, texture);
+    atlas->texture = texture;
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    // Texture contents start undefined; clear so padding stays transparent.
+    void* zeros = calloc((size_t)w * h, 4);
+    if (!zeros) {
+        luaL_error(L, "Failed to allocate atlas pixels");
+    }
+    bool ok = SDL_UpdateTexture(texture, NULL, zeros, w * 4);
+    free(zeros);
+    if (!ok) {
+        luaL_error(L, "Failed to clear atlas texture: %s", SDL_GetError());
+    }
+}
+
+// Find room for rect->w x rect->h and fill in rect->x/y. Returns false when full.
+static bool atlas_pack(lua_SDL_Atlas* atlas, SDL_Rect* rect) {
+    stbrp_rect r;
+    memset(&r, 0, sizeof(r));
+    r.w = rect->w + ATLAS_PADDING;
+    r.h = rect->h + ATLAS_PADDING;
+    if (!stbrp_pack_rects(&atlas->packer, &r, 1) || !r.was_packed) {
+        return false;
+    }
+    rect->x = r.x;
+    rect->y = r.y;
+    atlas->count++;
+    return true;
+}
+
+static int atlas_gc(lua_State* L) {
+    lua_SDL_Atlas* atlas = (lua_SDL_Atlas*)luaL_checkudata(L, 1, ATLAS_MT);
+    free(atlas->nodes);
+    atlas->nodes = NULL;
+    atlas->texture = NULL; // Destroyed by its own userdata
+    return 0;
+}
+
+// atlas:add(image) -> x, y, w, h, u0, v0, u1, v1 | nil when the atlas is full
+// The uv rectangle can be passed straight to batch:sprite.
+static int atlas_add(lua_State* L) {
+    lua_SDL_Atlas* atlas = lua_check_SDL_Atlas(L, 1);
+    lua_SDL_Image* img = lua_check_SDL_Image(L, 2);
+
+    SDL_Rect dst = { 0, 0, img->width, img->height };
+    if (!atlas_pack(atlas, &dst)) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    if (!SDL_UpdateTexture(atlas->texture, &dst, img->pixels, img->width * 4)) {
+        luaL_error(L, "Failed to update atlas texture: %s", SDL_GetError());
+    }
+
+    lua_pushinteger(L, dst.x);
+    lua_pushinteger(L, dst.y);
+    lua_pushinteger(L, dst.w);
+    lua_pushinteger(L, dst.h);
+    lua_pushnumber(L, (lua_Number)dst.x / atlas->width);
+    lua_pushnumber(L, (lua_Number)dst.y / atlas->height);
+    lua_pushnumber(L, (lua_Number)(dst.x + dst.w) / atlas->width);
+    lua_pushnumber(L, (lua_Number)(dst.y + dst.h) / atlas->height);
+    return 8;
+}
+
+// atlas:texture() -> texture
+static int atlas_texture(lua_State* L) {
+    lua_check_SDL_Atlas(L, 1);
+    lua_getiuservalue(L, 1, 1);
+    return 1;
+}
+
+// atlas:size() -> w, h
+static int atlas_size(lua_State* L) {
+    lua_SDL_Atlas* atlas = lua_check_SDL_Atlas(L, 1);
+    lua_pushinteger(L, atlas->width);
+    lua_pushinteger(L, atlas->height);
+    return 2;
+}
+
+// atlas:count() -> number of packed images
+static int atlas_count(lua_State* L) {
+    lua_SDL_Atlas* atlas = lua_check_SDL_Atlas(L, 1);
+    lua_pushinteger(L, atlas->count);
+    return 1;
+}
+
+// atlas:reset(): Forget all packed rects; new images overwrite the old texels.
+static int atlas_reset(lua_State* L) {
+    lua_SDL_Atlas* atlas = lua_check_SDL_Atlas(L, 1);
+    stbrp_init_target(&atlas->packer, atlas->width, atlas->height, atlas->nodes, atlas->width);
+    atlas->count = 0;
+    return 0;
+}
+
+static const struct luaL_Reg atlas_methods[] = {
+    {"add", atlas_add},
+    {"texture", atlas_texture},
+    {"size", atlas_size},
+    {"count", atlas_count},
+    {"reset", atlas_reset},
+    {NULL, NULL}
+};
+
+static void atlas_metatable(lua_State* L) {
+    luaL_newmetatable(L, ATLAS_MT);
+    lua_pushcfunction(L, atlas_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, atlas_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+// Create a texture atlas: sdl.create_atlas(renderer, w, h)
+static int l_sdl_create_atlas(lua_State* L) {
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
+    int w = (int)luaL_checkinteger(L, 2);
+    int h = (int)luaL_checkinteger(L, 3);
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+
+    lua_SDL_Atlas* atlas = (lua_SDL_Atlas*)lua_newuserdatauv(L, sizeof(lua_SDL_Atlas), 1);
+    memset(atlas, 0, sizeof(lua_SDL_Atlas));
+    luaL_setmetatable(L, ATLAS_MT);
+    atlas_init(L, atlas, ud->renderer, w, h);
+    lua_setiuservalue(L, -2, 1); // The atlas keeps its texture alive
+    return 1;
+}
+
+//===============================================
+// Fonts
+//===============================================
+
+#define FONT_QUAD_FLOATS 8         // x0, y0, x1, y1, u0, v0, u1, v1
+#define FONT_TEXT_CACHE_MAX 1024   // The layout cache is dropped once it holds this many strings
+#define FONT_DEFAULT_ATLAS 1024
+
+lua_SDL_Font* lua_check_SDL_Font(lua_State* L, int idx) {
+    lua_SDL_Font* font = (lua_SDL_Font*)luaL_checkudata(L, idx, FONT_MT);
+    if (!font->data) {
+        luaL_error(L, "Invalid font (already destroyed)");
+    }
+    return font;
+}
+
+static int font_gc(lua_State* L) {
+    lua_SDL_Font* font = (lua_SDL_Font*)luaL_checkudata(L, 1, FONT_MT);
+    free(font->data);
+    free(font->glyphs);
+    free(font->atlas.nodes);
+    free(font->scratch.vertices);
+    free(font->scratch.indices);
+    font->data = NULL;
+    font->glyphs = NULL;
+    font->atlas.nodes = NULL;
+    font->atlas.texture = NULL; // Destroyed by its own userdata
+    font->scratch.vertices = NULL;
+    font->scratch.indices = NULL;
+    return 0;
+}
+
+static int text_gc(lua_State* L) {
+    lua_SDL_Text* text = (lua_SDL_Text*)luaL_checkudata(L, 1, TEXT_MT);
+    free(text->quads);
+    text->quads = NULL;
+    return 0;
+}
+
+// Decode one UTF-8 sequence and advance *p. Malformed bytes decode as U+FFFD.
+static Uint32 utf8_next(const unsigned char** p, const unsigned char* end) {
+    const unsigned char* s = *p;
+    Uint32 c = s[0];
+    int extra = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+    if (extra < 0 || extra >= end - s) {
+        *p = s + 1;
+        return 0xFFFD;
+    }
+    if (extra > 0) {
+        c &= 0x3F >> extra;
+        for (int i = 1; i <= extra; i++) {
+            if ((s[i] & 0xC0) != 0x80) {
+                *p = s + 1;
+                return 0xFFFD;
+            }
+            c = (c << 6) | (s[i] & 0x3F);
+        }
+    }
+    *p = s + extra + 1;
+    return c;
+}
+
+static lua_SDL_Glyph* font_find_slot(lua_SDL_Glyph* glyphs, int capacity, Uint32 codepoint) {
+    int mask = capacity - 1;
+    int i = (int)((codepoint * 2654435761u) & (Uint32)mask);
+    while (glyphs[i].used && glyphs[i].codepoint != codepoint) {
+        i = (i + 1) & mask;
+    }
+    return &glyphs[i];
+}
+
+// Rasterize a glyph into the atlas and record its metrics.
+static void font_bake_glyph(lua_State* L, lua_SDL_Font* font, lua_SDL_Glyph* glyph, Uint32 codepoint) {
+    int advance, lsb, x0, y0, x1, y1;
+    glyph->glyph_index = stbtt_FindGlyphIndex(&font->info, (int)codepoint);
+    stbtt_GetGlyphHMetrics(&font->info, glyph->glyph_index, &advance, &lsb);
+    stbtt_GetGlyphBitmapBox(&font->info, glyph->glyph_index, font->scale, font->scale, &x0, &y0, &x1, &y1);
+    glyph->advance = advance * font->scale;
+    glyph->x0 = x0;
+    glyph->y0 = y0;
+    glyph->w = x1 - x0;
+    glyph->h = y1 - y0;
+    if (glyph->w <= 0 || glyph->h <= 0) {
+        glyph->w = glyph->h = 0; // Whitespace: advance only
+        return;
+    }
+
+    SDL_Rect rect = { 0, 0, glyph->w, glyph->h };
+    if (!atlas_pack(&font->atlas, &rect)) {
+        luaL_error(L, "Font atlas full (%dx%d); create the font with a larger atlas_size", font->atlas.width, font->atlas.height);
+    }
+
+    // Coverage goes into alpha over white so vertex colors tint the text.
+    size_t count = (size_t)glyph->w * glyph->h;
+    unsigned char* pixels = (unsigned char*)malloc(count * 5);
+    if (!pixels) {
+        luaL_error(L, "Failed to allocate glyph bitmap");
+    }
+    unsigned char* coverage = pixels + count * 4;
+    stbtt_MakeGlyphBitmap(&font->info, coverage, glyph->w, glyph->h, glyph->w, font->scale, font->scale, glyph->glyph_index);
+    for (size_t i = 0; i < count; i++) {
+        pixels[i * 4] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = 255;
+        pixels[i * 4 + 3] = coverage[i];
+    }
+    bool ok = SDL_UpdateTexture(font->atlas.texture, &rect, pixels, glyph->w * 4);
+    free(pixels);
+    if (!ok) {
+        luaL_error(L, "Failed to update font atlas: %s", SDL_GetError());
+    }
+
+    glyph->u0 = (float)rect.x / font->atlas.width;
+    glyph->v0 = (float)rect.y / font->atlas.height;
+    glyph->u1 = (float)(rect.x + rect.w) / font->atlas.width;
+    glyph->v1 = (float)(rect.y + rect.h) / font->atlas.height;
+}
+
+// Look up a glyph, baking it on first use.
+static lua_SDL_Glyph* font_glyph(lua_State* L, lua_SDL_Font* font, Uint32 codepoint) {
+    lua_SDL_Glyph* glyph = font_find_slot(font->glyphs, font->glyph_capacity, codepoint);
+    if (glyph->used) {
+        return glyph;
+    }
+
+    if ((font->glyph_count + 1) * 4 > font->glyph_capacity * 3) {
+        int capacity = font->glyph_capacity * 2;
+        lua_SDL_Glyph* glyphs = (lua_SDL_Glyph*)calloc((size_t)capacity, sizeof(lua_SDL_Glyph));
+        if (!glyphs) {
+            luaL_error(L, "Failed to grow glyph table");
+        }
+        for (int i = 0; i < font->glyph_capacity; i++) {
+            if (font->glyphs[i].used) {
+                *font_find_slot(glyphs, capacity, font->glyphs[i].codepoint) = font->glyphs[i];
+            }
+        }
+        free(font->glyphs);
+        font->glyphs = glyphs;
+        font->glyph_capacity = capacity;
+        glyph = font_find_slot(glyphs, capacity, codepoint);
+    }
+
+    lua_SDL_Glyph baked;
+    memset(&baked, 0, sizeof(baked));
+    font_bake_glyph(L, font, &baked, codepoint);
+    baked.codepoint = codepoint;
+    baked.used = true;
+    *glyph = baked;
+    font->glyph_count++;
+    return glyph;
+}
+
+// Lay out a UTF-8 string: pen positions, kerning and newlines.
+static void font_layout(lua_State* L, lua_SDL_Font* font, const char* str, size_t len, lua_SDL_Text* text) {
+    text->quads = (float*)malloc((len > 0 ? len : 1) * FONT_QUAD_FLOATS * sizeof(float));
+    if (!text->quads) {
+        luaL_error(L, "Failed to allocate text layout");
+    }
+
+    const unsigned char* p = (const unsigned char*)str;
+    const unsigned char* end = p + len;
+    float pen_x = 0.0f, width = 0.0f;
+    int line = 0, prev = -1;
+    while (p < end) {
+        Uint32 codepoint = utf8_next(&p, end);
+        if (codepoint == '\n') {
+            width = pen_x > width ? pen_x : width;
+            pen_x = 0.0f;
+            line++;
+            prev = -1;
+            continue;
+        }
+        lua_SDL_Glyph* glyph = font_glyph(L, font, codepoint);
+        if (prev >= 0) {
+            pen_x += font->scale * stbtt_GetGlyphKernAdvance(&font->info, prev, glyph->glyph_index);
+        }
+        if (glyph->w > 0) {
+            float* q = text->quads + text->num_quads * FONT_QUAD_FLOATS;
+            q[0] = SDL_floorf(pen_x + 0.5f) + glyph->x0;
+            q[1] = font->ascent + line * font->line_height + glyph->y0;
+            q[2] = q[0] + glyph->w;
+            q[3] = q[1] + glyph->h;
+            q[4] = glyph->u0;
+            q[5] = glyph->v0;
+            q[6] = glyph->u1;
+            q[7] = glyph->v1;
+            text->num_quads++;
+        }
+        pen_x += glyph->advance;
+        prev = glyph->glyph_index;
+    }
+    text->width = pen_x > width ? pen_x : width;
+    text->height = (line + 1) * font->line_height;
+}
+
+// Push the cached layout of the string at str_idx, building it on a miss.
+static lua_SDL_Text* font_text(lua_State* L, int font_idx, int str_idx) {
+    lua_SDL_Font* font = lua_check_SDL_Font(L, font_idx);
+    size_t len;
+    const char* str = luaL_checklstring(L, str_idx, &len);
+    font_idx = lua_absindex(L, font_idx);
+    str_idx = lua_absindex(L, str_idx);
+
+    lua_getiuservalue(L, font_idx, 2);
+    lua_pushvalue(L, str_idx);
+    if (lua_rawget(L, -2) == LUA_TUSERDATA) {
+        lua_remove(L, -2);
+        return (lua_SDL_Text*)lua_touserdata(L, -1);
+    }
+    lua_pop(L, 1);
+
+    if (font->cached_strings >= FONT_TEXT_CACHE_MAX) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_setiuservalue(L, font_idx, 2);
+        font->cached_strings = 0;
+    }
+
+    lua_SDL_Text* text = (lua_SDL_Text*)lua_newuserdata(L, sizeof(lua_SDL_Text));
+    memset(text, 0, sizeof(lua_SDL_Text));
+    luaL_setmetatable(L, TEXT_MT);
+    font_layout(L, font, str, len, text);
+
+    lua_pushvalue(L, str_idx);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -4);
+    lua_remove(L, -2);
+    font->cached_strings++;
+    return text;
+}
+
+// Append a laid out string to a batch at (x, y) using the batch color.
+static void font_emit(lua_State* L, lua_SDL_Batch* batch, const lua_SDL_Text* text, float x, float y) {
+    batch_reserve(L, batch, text->num_quads * 4, text->num_quads * 6);
+    for (int i = 0; i < text->num_quads; i++) {
+        const float* q = text->quads + i * FONT_QUAD_FLOATS;
+        float xy[8] = { x + q[0], y + q[1], x + q[2], y + q[1], x + q[2], y + q[3], x + q[0], y + q[3] };
+        float uv[8] = { q[4], q[5], q[6], q[5], q[6], q[7], q[4], q[7] };
+        batch_quad(L, batch, xy, uv);
+    }
+}
+
+// font:draw(batch, text, x, y) -> w, h
+// Appends the text to a batch; flush it with font:texture(). Many labels can share one flush.
+static int font_draw(lua_State* L) {
+    lua_check_SDL_Font(L, 1);
+    lua_SDL_Batch* batch = lua_check_SDL_Batch(L, 2);
+    float x = (float)luaL_checknumber(L, 4);
+    float y = (float)luaL_checknumber(L, 5);
+    lua_SDL_Text* text = font_text(L, 1, 3);
+    font_emit(L, batch, text, x, y);
+    lua_pushnumber(L, text->width);
+    lua_pushnumber(L, text->height);
+    return 2;
+}
+
+// font:render(renderer, text, x, y, [r, g, b, a]) -> w, h
+// Draws one text block with a single SDL_RenderGeometry call. Colors are 0-255.
+static int font_render(lua_State* L) {
+    lua_SDL_Font* font = lua_check_SDL_Font(L, 1);
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 2);
+    float x = (float)luaL_checknumber(L, 4);
+    float y = (float)luaL_checknumber(L, 5);
+    SDL_FColor color = {
+        batch_color_component(L, 6, 255),
+        batch_color_component(L, 7, 255),
+        batch_color_component(L, 8, 255),
+        batch_color_component(L, 9, 255)
+    };
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+
+    lua_SDL_Text* text = font_text(L, 1, 3);
+    lua_SDL_Batch* batch = &font->scratch;
+    batch->num_vertices = 0;
+    batch->num_indices = 0;
+    batch->color = color;
+    font_emit(L, batch, text, x, y);
+    if (batch->num_indices > 0 &&
+        !SDL_RenderGeometry(ud->renderer, font->atlas.texture, batch->vertices, batch->num_vertices, batch->indices, batch->num_indices)) {
+        luaL_error(L, "Failed to render text: %s", SDL_GetError());
+    }
+    lua_pushnumber(L, text->width);
+    lua_pushnumber(L, text->height);
+    return 2;
+}
+
+// font:measure(text) -> w, h
+static int font_measure(lua_State* L) {
+    lua_SDL_Text* text = font_text(L, 1, 2);
+    lua_pushnumber(L, text->width);
+    lua_pushnumber(L, text->height);
+    return 2;
+}
+
+// font:texture() -> atlas texture
+static int font_texture(lua_State* L) {
+    lua_check_SDL_Font(L, 1);
+    lua_getiuservalue(L, 1, 1);
+    return 1;
+}
+
+// font:line_height() -> pixels between baselines
+static int font_line_height(lua_State* L) {
+    lua_SDL_Font* font = lua_check_SDL_Font(L, 1);
+    lua_pushnumber(L, font->line_height);
+    return 1;
+}
+
+// font:stats() -> baked glyphs, cached strings
+static int font_stats(lua_State* L) {
+    lua_SDL_Font* font = lua_check_SDL_Font(L, 1);
+    lua_pushinteger(L, font->glyph_count);
+    lua_pushinteger(L, font->cached_strings);
+    return 2;
+}
+
+// font:clear_cache(): Drop cached layouts (baked glyphs stay in the atlas).
+static int font_clear_cache(lua_State* L) {
+    lua_SDL_Font* font = lua_check_SDL_Font(L, 1);
+    lua_newtable(L);
+    lua_setiuservalue(L, 1, 2);
+    font->cached_strings = 0;
+    return 0;
+}
+
+static const struct luaL_Reg font_methods[] = {
+    {"draw", font_draw},
+    {"render", font_render},
+    {"measure", font_measure},
+    {"texture", font_texture},
+    {"line_height", font_line_height},
+    {"stats", font_stats},
+    {"clear_cache", font_clear_cache},
+    {NULL, NULL}
+};
+
+static void font_metatable(lua_State* L) {
+    luaL_newmetatable(L, FONT_MT);
+    lua_pushcfunction(L, font_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, font_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, TEXT_MT);
+    lua_pushcfunction(L, text_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+// Create a font from TTF bytes held in the string at data_idx. Pushes the font, or nil and a message.
+static int font_create(lua_State* L, SDL_Renderer* renderer, int data_idx, float size, int atlas_size) {
+    size_t len;
+    const char* bytes = lua_tolstring(L, data_idx, &len);
+    if (size <= 0.0f) {
+        luaL_error(L, "Font size must be positive");
+    }
+
+    lua_SDL_Font* font = (lua_SDL_Font*)lua_newuserdatauv(L, sizeof(lua_SDL_Font), 2);
+    memset(font, 0, sizeof(lua_SDL_Font));
+    luaL_setmetatable(L, FONT_MT);
+
+    font->data = (unsigned char*)malloc(len > 0 ? len : 1);
+    if (!font->data) {
+        luaL_error(L, "Failed to allocate font data");
+    }
+    memcpy(font->data, bytes, len);
+    int offset = stbtt_GetFontOffsetForIndex(font->data, 0);
+    if (offset < 0 || !stbtt_InitFont(&font->info, font->data, offset)) {
+        lua_pushnil(L);
+        lua_pushliteral(L, "Invalid TrueType font data");
+        return 2;
+    }
+
+    int ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &line_gap);
+    font->size = size;
+    font->scale = stbtt_ScaleForPixelHeight(&font->info, size);
+    font->ascent = SDL_roundf(ascent * font->scale);
+    font->line_height = SDL_ceilf((ascent - descent + line_gap) * font->scale);
+
+    font->glyph_capacity = 128;
+    font->glyphs = (lua_SDL_Glyph*)calloc((size_t)font->glyph_capacity, sizeof(lua_SDL_Glyph));
+    font->scratch.vertex_capacity = 256;
+    font->scratch.index_capacity = 384;
+    font->scratch.vertices = (SDL_Vertex*)malloc(font->scratch.vertex_capacity * sizeof(SDL_Vertex));
+    font->scratch.indices = (int*)malloc(font->scratch.index_capacity * sizeof(int));
+    if (!font->glyphs || !font->scratch.vertices || !font->scratch.indices) {
+        luaL_error(L, "Failed to allocate font tables");
+    }
+
+    atlas_init(L, &font->atlas, renderer, atlas_size, atlas_size);
+    lua_setiuservalue(L, -2, 1); // The font keeps its atlas texture alive
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 2); // Layout cache: string -> sdl.text
+    return 1;
+}
+
+// Load a TrueType font: sdl.load_font(renderer, path, size, [atlas_size]) -> font | nil, err
+static int l_sdl_load_font(lua_State* L) {
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
+    const char* path = luaL_checkstring(L, 2);
+    float size = (float)luaL_checknumber(L, 3);
+    int atlas_size = (int)luaL_optinteger(L, 4, FONT_DEFAULT_ATLAS);
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+
+    size_t len;
+    void* data = SDL_LoadFile(path, &len);
+    if (!data) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "Failed to load font '%s': %s", path, SDL_GetError());
+        return 2;
+    }
+    lua_pushlstring(L, (const char*)data, len);
+    SDL_free(data);
+    return font_create(L, ud->renderer, lua_gettop(L), size, atlas_size);
+}
+
+// Create a font from TTF bytes: sdl.load_font_from_memory(renderer, bytes, size, [atlas_size]) -> font | nil, err
+static int l_sdl_load_font_from_memory(lua_State* L) {
+    lua_SDL_Renderer* ud = lua_check_SDL_Renderer(L, 1);
+    luaL_checktype(L, 2, LUA_TSTRING);
+    float size = (float)luaL_checknumber(L, 3);
+    int atlas_size = (int)luaL_optinteger(L, 4, FONT_DEFAULT_ATLAS);
+    if (!ud->renderer) {
+        luaL_error(L, "No renderer available");
+    }
+    return font_create(L, ud->renderer, 2, size, atlas_size);
+}
+
 //===============================================
 // sdl_lib
 //===============================================
@@ -760,6 +2690,8 @@ static const struct luaL_Reg sdl_lib[] = {
     {"create_renderer", l_sdl_create_renderer},
     {"create_window_and_renderer", l_sdl_create_window_and_renderer},
     {"poll_events", l_sdl_poll_events},
+    {"get_input_state", l_sdl_get_input_state},
+    {"update_input", l_sdl_update_input},
     {"set_render_draw_color", l_sdl_set_render_draw_color},
     {"render_clear", l_sdl_render_clear},
     {"render_present", l_sdl_render_present},
@@ -772,6 +2704,19 @@ static const struct luaL_Reg sdl_lib[] = {
     {"render_lines", l_sdl_render_lines},
     {"create_texture", l_sdl_create_texture},
     {"render_geometry", l_sdl_render_geometry},
+    {"create_batch", l_sdl_create_batch},
+    {"create_float_array", l_sdl_create_float_array},
+    {"create_geometry", l_sdl_create_geometry},
+    {"draw_geometry", l_sdl_draw_geometry},
+    {"load_image", l_sdl_load_image},
+    {"load_image_from_memory", l_sdl_load_image_from_memory},
+    {"create_image", l_sdl_create_image},
+    {"create_texture_from_image", l_sdl_create_texture_from_image},
+    {"update_texture", l_sdl_update_texture},
+    {"stream_texture", l_sdl_stream_texture},
+    {"create_atlas", l_sdl_create_atlas},
+    {"load_font", l_sdl_load_font},
+    {"load_font_from_memory", l_sdl_load_font_from_memory},
     {"destroy_window", l_sdl_destroy_window},
     {"quit", l_sdl_quit}, 
     {NULL, NULL}
@@ -784,6 +2729,13 @@ int luaopen_sdl(lua_State* L) {
     window_metatable(L);
     renderer_metatable(L);
     texture_metatable(L);
+    input_state_metatable(L);
+    batch_metatable(L);
+    float_array_metatable(L);
+    geometry_metatable(L);
+    image_metatable(L);
+    atlas_metatable(L);
+    font_metatable(L);
     luaL_newlib(L, sdl_lib);
     
     // WINDOW FLAGS
@@ -807,6 +2759,8 @@ int luaopen_sdl(lua_State* L) {
     lua_setfield(L, -2, "PIXELFORMAT_RGBA8888");
     lua_pushinteger(L, SDL_PIXELFORMAT_ARGB8888);
     lua_setfield(L, -2, "PIXELFORMAT_ARGB8888");
+    lua_pushinteger(L, SDL_PIXELFORMAT_RGBA32);
+    lua_setfield(L, -2, "PIXELFORMAT_RGBA32");
 
     // Texture access modes
     lua_pushinteger(L, SDL_TEXTUREACCESS_STATIC);
@@ -821,6 +2775,8 @@ int luaopen_sdl(lua_State* L) {
     lua_setfield(L, -2, "QUIT");
     lua_pushinteger(L, SDL_EVENT_WINDOW_CLOSE_REQUESTED);
     lua_setfield(L, -2, "WINDOW_CLOSE");
+    lua_pushinteger(L, SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED);
+    lua_setfield(L, -2, "WINDOW_PIXEL_SIZE_CHANGED");
     lua_pushinteger(L, SDL_EVENT_KEY_DOWN);
     lua_setfield(L, -2, "KEY_DOWN");
     lua_pushinteger(L, SDL_EVENT_KEY_UP);
@@ -843,6 +2799,30 @@ int luaopen_sdl(lua_State* L) {
     lua_pushinteger(L, SDLK_B);
     lua_setfield(L, -2, "KEY_B");
 
+    // Scancodes for sdl.get_input_state()
+    lua_pushinteger(L, SDL_SCANCODE_W);
+    lua_setfield(L, -2, "SCANCODE_W");
+    lua_pushinteger(L, SDL_SCANCODE_A);
+    lua_setfield(L, -2, "SCANCODE_A");
+    lua_pushinteger(L, SDL_SCANCODE_S);
+    lua_setfield(L, -2, "SCANCODE_S");
+    lua_pushinteger(L, SDL_SCANCODE_D);
+    lua_setfield(L, -2, "SCANCODE_D");
+    lua_pushinteger(L, SDL_SCANCODE_SPACE);
+    lua_setfield(L, -2, "SCANCODE_SPACE");
+    lua_pushinteger(L, SDL_SCANCODE_RETURN);
+    lua_setfield(L, -2, "SCANCODE_RETURN");
+    lua_pushinteger(L, SDL_SCANCODE_ESCAPE);
+    lua_setfield(L, -2, "SCANCODE_ESCAPE");
+    lua_pushinteger(L, SDL_SCANCODE_UP);
+    lua_setfield(L, -2, "SCANCODE_UP");
+    lua_pushinteger(L, SDL_SCANCODE_DOWN);
+    lua_setfield(L, -2, "SCANCODE_DOWN");
+    lua_pushinteger(L, SDL_SCANCODE_LEFT);
+    lua_setfield(L, -2, "SCANCODE_LEFT");
+    lua_pushinteger(L, SDL_SCANCODE_RIGHT);
+    lua_setfield(L, -2, "SCANCODE_RIGHT");
+
     lua_pushinteger(L, SDL_BUTTON_LEFT);
     lua_setfield(L, -2, "BUTTON_LEFT");
     lua_pushinteger(L, SDL_BUTTON_RIGHT);
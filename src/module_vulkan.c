@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "module_vulkan.h" // For lua_SDL_Window
+#include "module_runtime.h"
 #include <shaderc/shaderc.h>
 
 // Metatable names
@@ -27,6 +28,65 @@ static const char* SEMAPHORE_MT = "vulkan.semaphore";
 static const char* FENCE_MT = "vulkan.fence";
 static const char* COMMAND_POOL_MT = "vulkan.command_pool";
 static const char* COMMAND_BUFFER_MT = "vulkan.command_buffer";
+static const char* ALLOCATOR_MT = "vulkan.allocator";
+static const char* BUFFER_MT = "vulkan.buffer";
+static const char* IMAGE_MT = "vulkan.image";
+static const char* SAMPLER_MT = "vulkan.sampler";
+static const char* SAMPLER_CACHE_MT = "vulkan.sampler_cache";
+static const char* BARRIER_TRACKER_MT = "vulkan.barrier_tracker";
+static const char* SWAPCHAIN_MANAGER_MT = "vulkan.swapchain_manager";
+static const char* DELETION_QUEUE_MT = "vulkan.deletion_queue";
+
+// Metatable of each tagged type, indexed by tag - VULKAN_TAG_DEVICE. Recorded by luaopen_vulkan
+// so the hot checks compare a pointer instead of looking the metatable up by name.
+#define VULKAN_TAG_COUNT (VULKAN_TAG_SAMPLER - VULKAN_TAG_DEVICE + 1)
+static struct {
+    const char* name;
+    const void* metatable;
+} tag_types[VULKAN_TAG_COUNT];
+
+// Tagged userdata at idx, or NULL. Only full userdata large enough to hold a tag are read,
+// so light userdata (swapchain images) are never dereferenced. The tag only picks the
+// candidate type; the metatable decides, so a foreign userdata whose first field happens
+// to equal a tag is rejected.
+static inline void* test_tag(lua_State* L, int idx, vulkan_type_tag tag) {
+    if (lua_type(L, idx) != LUA_TUSERDATA || lua_rawlen(L, idx) < sizeof(vulkan_type_tag)) return NULL;
+    vulkan_type_tag* ud = (vulkan_type_tag*)lua_touserdata(L, idx);
+    if (*ud != tag || !lua_getmetatable(L, idx)) return NULL;
+    const void* metatable = lua_topointer(L, -1);
+    lua_pop(L, 1);
+    if (metatable == tag_types[tag - VULKAN_TAG_DEVICE].metatable) return ud;
+    // The module was opened again in another state since: fall back to the lookup by name.
+    return luaL_testudata(L, idx, tag_types[tag - VULKAN_TAG_DEVICE].name);
+}
+
+// luaL_checkudata without the registry lookup when the tag matches. A mismatch falls back
+// to luaL_checkudata, which raises the usual "expected" argument error.
+static inline void* check_tag(lua_State* L, int idx, vulkan_type_tag tag, const char* mt) {
+    void* ud = test_tag(L, idx, tag);
+    return ud ? ud : luaL_checkudata(L, idx, mt);
+}
+
+// Argument access for the per-frame bindings (cmd_*, command buffer reset/begin/end, queue_submit,
+// queue_present_KHR). A LUAVK_FAST_PATH build reads handles and numbers without type, tag or
+// destroyed checks, skips list shape and count checks and ignores VkResult while recording.
+// A wrong argument then crashes instead of raising, so scripts should be run on a checked
+// build first. Submit and present still report their result (OUT_OF_DATE drives resizing).
+#ifdef LUAVK_FAST_PATH
+#define HOT_CHECKED 0
+#define HOT_UDATA(type, L, idx) ((lua_##type*)lua_touserdata(L, idx))
+#define HOT_IS(L, idx, tag) (lua_type(L, idx) == LUA_TUSERDATA)
+#define HOT_INTEGER(L, idx) lua_tointeger(L, idx)
+#define HOT_NUMBER(L, idx) lua_tonumber(L, idx)
+#define HOT_TABLE(L, idx) ((void)0)
+#else
+#define HOT_CHECKED 1
+#define HOT_UDATA(type, L, idx) lua_check_##type(L, idx)
+#define HOT_IS(L, idx, tag) (test_tag(L, idx, tag) != NULL)
+#define HOT_INTEGER(L, idx) luaL_checkinteger(L, idx)
+#define HOT_NUMBER(L, idx) luaL_checknumber(L, idx)
+#define HOT_TABLE(L, idx) luaL_checktype(L, idx, LUA_TTABLE)
+#endif
 
 // Garbage collection for VkApplicationInfo
 static int app_info_gc(lua_State* L) {
@@ -474,6 +534,310 @@ static void physical_device_metatable(lua_State* L) {
     lua_pop(L, 1);
 }
 
+//===============================================
+// timeline semaphores
+//===============================================
+// Optional timeout in nanoseconds; nil, negative values and vulkan.UINT64_MAX wait forever.
+static uint64_t opt_timeout(lua_State* L, int idx) {
+    if (lua_isnoneornil(L, idx)) return UINT64_MAX;
+    lua_Number timeout = luaL_checknumber(L, idx);
+    if (timeout < 0 || timeout >= 18446744073709551615.0) return UINT64_MAX;
+    return (uint64_t)timeout;
+}
+
+// vkWaitSemaphores/vkSignalSemaphore/vkGetSemaphoreCounterValue come from Vulkan 1.2 or
+// VK_KHR_timeline_semaphore and are loaded per device, cached for the last device used.
+static VkDevice timeline_device = VK_NULL_HANDLE;
+static PFN_vkWaitSemaphores wait_semaphores = NULL;
+static PFN_vkSignalSemaphore signal_semaphore = NULL;
+static PFN_vkGetSemaphoreCounterValue get_semaphore_counter_value = NULL;
+
+static int load_timeline_semaphore(VkDevice device) {
+    if (device == timeline_device && wait_semaphores) return 1;
+    wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+    signal_semaphore = (PFN_vkSignalSemaphore)vkGetDeviceProcAddr(device, "vkSignalSemaphore");
+    get_semaphore_counter_value = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+    if (!wait_semaphores || !signal_semaphore || !get_semaphore_counter_value) {
+        wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+        signal_semaphore = (PFN_vkSignalSemaphore)vkGetDeviceProcAddr(device, "vkSignalSemaphoreKHR");
+        get_semaphore_counter_value = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    }
+    if (!wait_semaphores || !signal_semaphore || !get_semaphore_counter_value) {
+        wait_semaphores = NULL;
+        timeline_device = VK_NULL_HANDLE;
+        return 0;
+    }
+    timeline_device = device;
+    return 1;
+}
+
+// Timeline value for code outside this module (runtime scheduler).
+VkResult vulkan_get_semaphore_counter_value(VkDevice device, VkSemaphore semaphore, uint64_t* value) {
+    if (!load_timeline_semaphore(device)) return VK_ERROR_EXTENSION_NOT_PRESENT;
+    return get_semaphore_counter_value(device, semaphore, value);
+}
+
+static void check_timeline_semaphore(lua_State* L, VkDevice device) {
+    if (!load_timeline_semaphore(device)) {
+        luaL_error(L, "Timeline semaphores are not available (needs Vulkan 1.2 or VK_KHR_timeline_semaphore)");
+    }
+}
+
+//===============================================
+// deferred deletion
+//===============================================
+// Queues of all devices; a device has at most one.
+static lua_VkDeletionQueue* deletion_queues = NULL;
+
+static lua_VkDeletionQueue* deletion_queue_for(VkDevice device) {
+    for (lua_VkDeletionQueue* q = deletion_queues; q; q = q->next) {
+        if (q->device == device) return q;
+    }
+    return NULL;
+}
+
+static void deletion_destroy(VkDevice device, vulkan_deletion* e) {
+    switch (e->kind) {
+    case VULKAN_DELETE_BUFFER: vkDestroyBuffer(device, e->handle.buffer, NULL); break;
+    case VULKAN_DELETE_IMAGE: vkDestroyImage(device, e->handle.image, NULL); break;
+    case VULKAN_DELETE_IMAGE_VIEW: vkDestroyImageView(device, e->handle.image_view, NULL); break;
+    case VULKAN_DELETE_SAMPLER: vkDestroySampler(device, e->handle.sampler, NULL); break;
+    case VULKAN_DELETE_FRAMEBUFFER: vkDestroyFramebuffer(device, e->handle.framebuffer, NULL); break;
+    case VULKAN_DELETE_RENDER_PASS: vkDestroyRenderPass(device, e->handle.render_pass, NULL); break;
+    case VULKAN_DELETE_SHADER_MODULE: vkDestroyShaderModule(device, e->handle.shader_module, NULL); break;
+    case VULKAN_DELETE_PIPELINE_LAYOUT: vkDestroyPipelineLayout(device, e->handle.pipeline_layout, NULL); break;
+    case VULKAN_DELETE_PIPELINE: vkDestroyPipeline(device, e->handle.pipeline, NULL); break;
+    case VULKAN_DELETE_SEMAPHORE: vkDestroySemaphore(device, e->handle.semaphore, NULL); break;
+    case VULKAN_DELETE_FENCE: vkDestroyFence(device, e->handle.fence, NULL); break;
+    case VULKAN_DELETE_COMMAND_POOL: vkDestroyCommandPool(device, e->handle.command_pool, NULL); break;
+    case VULKAN_DELETE_SWAPCHAIN: vkDestroySwapchainKHR(device, e->handle.swapchain, NULL); break;
+    }
+    if (e->allocator && e->allocator->device) {
+        vulkan_memory_free(e->allocator, &e->allocation);
+    }
+}
+
+// Destroy an object released by Lua. With a deletion queue on its device the handle is kept
+// until the frame it was released in has finished on the GPU.
+void vulkan_release(VkDevice device, vulkan_deletion* e) {
+    lua_VkDeletionQueue* q = deletion_queue_for(device);
+    if (q) {
+        if (e->allocator && !e->allocator->device) {
+            e->allocator = NULL; // Allocator already destroyed along with the memory
+        }
+        if (q->count == q->capacity) {
+            int capacity = q->capacity ? q->capacity * 2 : 64;
+            vulkan_deletion* entries = (vulkan_deletion*)realloc(q->entries, capacity * sizeof(vulkan_deletion));
+            if (entries) {
+                q->entries = entries;
+                q->capacity = capacity;
+            }
+        }
+        if (q->count < q->capacity) {
+            e->frame = q->frame;
+            q->entries[q->count++] = *e;
+            return;
+        }
+        vkDeviceWaitIdle(device); // Out of memory: destroy synchronously
+    }
+    deletion_destroy(device, e);
+}
+
+// Destroy the entries of every frame whose fence has signalled. Returns the number destroyed.
+static int deletion_queue_collect(lua_VkDeletionQueue* q) {
+    int done = 0;
+    while (done < q->frame_count) {
+        vulkan_deletion_frame* f = &q->frames[done];
+        if (f->semaphore) {
+            uint64_t value = 0;
+            if (!load_timeline_semaphore(q->device) ||
+                get_semaphore_counter_value(q->device, f->semaphore, &value) != VK_SUCCESS || value < f->value) break;
+        } else if (vkGetFenceStatus(q->device, f->fence) != VK_SUCCESS) {
+            break;
+        }
+        q->completed = f->frame + 1;
+        done++;
+    }
+    if (done) {
+        q->frame_count -= done;
+        memmove(q->frames, q->frames + done, q->frame_count * sizeof(vulkan_deletion_frame));
+    }
+
+    int destroyed = 0;
+    while (destroyed < q->count && q->entries[destroyed].frame < q->completed) {
+        deletion_destroy(q->device, &q->entries[destroyed]);
+        destroyed++;
+    }
+    if (destroyed) {
+        q->count -= destroyed;
+        memmove(q->entries, q->entries + destroyed, q->count * sizeof(vulkan_deletion));
+        q->destroyed += destroyed;
+    }
+    return destroyed;
+}
+
+// Wait for the device and destroy every queued object.
+static void deletion_queue_flush(lua_VkDeletionQueue* q) {
+    if (q->count) {
+        vkDeviceWaitIdle(q->device);
+        for (int i = 0; i < q->count; i++) {
+            deletion_destroy(q->device, &q->entries[i]);
+        }
+        q->destroyed += q->count;
+        q->count = 0;
+    }
+    q->frame_count = 0;
+    q->completed = q->frame;
+}
+
+// Destroy the queued buffers and images of an allocator before its memory goes away.
+static void deletion_queue_flush_allocator(lua_VkAllocator* allocator) {
+    lua_VkDeletionQueue* q = deletion_queue_for(allocator->device);
+    if (!q) return;
+    int kept = 0, waited = 0;
+    for (int i = 0; i < q->count; i++) {
+        vulkan_deletion* e = &q->entries[i];
+        if (e->allocator != allocator) {
+            q->entries[kept++] = *e;
+            continue;
+        }
+        if (!waited) {
+            vkDeviceWaitIdle(q->device);
+            waited = 1;
+        }
+        deletion_destroy(q->device, e);
+        q->destroyed++;
+    }
+    q->count = kept;
+}
+
+// Flush and unregister: the device's objects are destroyed immediately from now on.
+static void deletion_queue_release(lua_VkDeletionQueue* q) {
+    deletion_queue_flush(q);
+    for (lua_VkDeletionQueue** link = &deletion_queues; *link; link = &(*link)->next) {
+        if (*link == q) {
+            *link = q->next;
+            break;
+        }
+    }
+    free(q->entries);
+    free(q->frames);
+    q->entries = NULL;
+    q->frames = NULL;
+    q->capacity = q->frame_capacity = 0;
+    q->next = NULL;
+    q->device = VK_NULL_HANDLE;
+}
+
+static int deletion_queue_gc(lua_State* L) {
+    lua_VkDeletionQueue* q = (lua_VkDeletionQueue*)luaL_checkudata(L, 1, DELETION_QUEUE_MT);
+    if (q->device) {
+        deletion_queue_release(q);
+    }
+    return 0;
+}
+
+lua_VkDeletionQueue* lua_check_VkDeletionQueue(lua_State* L, int idx) {
+    lua_VkDeletionQueue* q = (lua_VkDeletionQueue*)luaL_checkudata(L, idx, DELETION_QUEUE_MT);
+    if (!q->device) {
+        luaL_error(L, "Invalid deletion queue (already destroyed)");
+    }
+    return q;
+}
+
+// Create deletion queue: vulkan.create_deletion_queue(device)
+static int l_vulkan_create_deletion_queue(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    if (deletion_queue_for(device_ud->device)) {
+        luaL_error(L, "Device already has a deletion queue");
+    }
+    lua_VkDeletionQueue* q = (lua_VkDeletionQueue*)lua_newuserdatauv(L, sizeof(lua_VkDeletionQueue), 1);
+    memset(q, 0, sizeof(lua_VkDeletionQueue));
+    q->device = device_ud->device;
+    luaL_setmetatable(L, DELETION_QUEUE_MT);
+    lua_pushvalue(L, 1);
+    lua_setiuservalue(L, -2, 1); // Keep the device alive
+    q->next = deletion_queues;
+    deletion_queues = q;
+    return 1;
+}
+
+// End the recorded frame: vulkan.deletion_queue_end_frame(queue, fence | timeline_semaphore, [value]) -> destroyed
+// The fence of the frame's last submit, or the timeline value it signals; objects released so far wait for it.
+static int l_vulkan_deletion_queue_end_frame(lua_State* L) {
+    lua_VkDeletionQueue* q = lua_check_VkDeletionQueue(L, 1);
+    vulkan_deletion_frame sealed = {0};
+    if (test_tag(L, 2, VULKAN_TAG_SEMAPHORE)) {
+        sealed.semaphore = lua_check_VkSemaphore(L, 2)->semaphore;
+        sealed.value = (uint64_t)luaL_checkinteger(L, 3);
+        check_timeline_semaphore(L, q->device);
+    } else {
+        sealed.fence = lua_check_VkFence(L, 2)->fence;
+    }
+    if (q->count == 0) {
+        q->frame_count = 0; // Nothing waits on earlier frames
+    } else {
+        if (q->frame_count == q->frame_capacity) {
+            int capacity = q->frame_capacity ? q->frame_capacity * 2 : 8;
+            vulkan_deletion_frame* frames = (vulkan_deletion_frame*)realloc(q->frames, capacity * sizeof(vulkan_deletion_frame));
+            if (!frames) {
+                luaL_error(L, "Failed to end deletion queue frame: out of memory");
+            }
+            q->frames = frames;
+            q->frame_capacity = capacity;
+        }
+        sealed.frame = q->frame;
+        q->frames[q->frame_count++] = sealed;
+    }
+    q->frame++;
+    lua_pushinteger(L, deletion_queue_collect(q));
+    return 1;
+}
+
+// Destroy what has finished: vulkan.deletion_queue_collect(queue) -> destroyed
+static int l_vulkan_deletion_queue_collect(lua_State* L) {
+    lua_VkDeletionQueue* q = lua_check_VkDeletionQueue(L, 1);
+    lua_pushinteger(L, deletion_queue_collect(q));
+    return 1;
+}
+
+// Wait for the device and destroy everything queued: vulkan.deletion_queue_flush(queue)
+static int l_vulkan_deletion_queue_flush(lua_State* L) {
+    lua_VkDeletionQueue* q = lua_check_VkDeletionQueue(L, 1);
+    deletion_queue_flush(q);
+    return 0;
+}
+
+// Queue statistics: vulkan.deletion_queue_stats(queue) -> {pending, frames, frame, destroyed}
+static int l_vulkan_deletion_queue_stats(lua_State* L) {
+    lua_VkDeletionQueue* q = lua_check_VkDeletionQueue(L, 1);
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, q->count);
+    lua_setfield(L, -2, "pending");
+    lua_pushinteger(L, q->frame_count);
+    lua_setfield(L, -2, "frames");
+    lua_pushinteger(L, (lua_Integer)q->frame);
+    lua_setfield(L, -2, "frame");
+    lua_pushinteger(L, q->destroyed);
+    lua_setfield(L, -2, "destroyed");
+    return 1;
+}
+
+// Destroy deletion queue: vulkan.destroy_deletion_queue(queue)
+// Waits for the device and destroys everything queued; later releases are immediate again.
+static int l_vulkan_destroy_deletion_queue(lua_State* L) {
+    lua_VkDeletionQueue* q = lua_check_VkDeletionQueue(L, 1);
+    deletion_queue_release(q);
+    return 0;
+}
+
+static void deletion_queue_metatable(lua_State* L) {
+    luaL_newmetatable(L, DELETION_QUEUE_MT);
+    lua_pushcfunction(L, deletion_queue_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
 //===============================================
 // family and device
 //===============================================
@@ -481,6 +845,8 @@ static void physical_device_metatable(lua_State* L) {
 static int device_gc(lua_State* L) {
     lua_VkDevice* ud = (lua_VkDevice*)luaL_checkudata(L, 1, DEVICE_MT);
     if (ud->device) {
+        lua_VkDeletionQueue* q = deletion_queue_for(ud->device);
+        if (q) deletion_queue_release(q);
         vkDestroyDevice(ud->device, NULL);
         ud->device = VK_NULL_HANDLE;
     }
@@ -507,6 +873,13 @@ static int device_create_info_gc(lua_State* L) {
             }
             free((char**)ud->create_info->ppEnabledExtensionNames);
         }
+        // Free chained feature structures
+        VkBaseOutStructure* next = (VkBaseOutStructure*)ud->create_info->pNext;
+        while (next) {
+            VkBaseOutStructure* feature = next;
+            next = feature->pNext;
+            free(feature);
+        }
         free(ud->create_info);
         ud->create_info = NULL;
     }
@@ -519,13 +892,14 @@ void lua_push_VkDevice(lua_State* L, VkDevice device) {
         luaL_error(L, "Cannot create userdata for null VkDevice");
     }
     lua_VkDevice* ud = (lua_VkDevice*)lua_newuserdata(L, sizeof(lua_VkDevice));
+    ud->tag = VULKAN_TAG_DEVICE;
     ud->device = device;
     luaL_setmetatable(L, DEVICE_MT);
 }
 
 // Check VkDevice userdata
 lua_VkDevice* lua_check_VkDevice(lua_State* L, int idx) {
-    lua_VkDevice* ud = (lua_VkDevice*)luaL_checkudata(L, idx, DEVICE_MT);
+    lua_VkDevice* ud = (lua_VkDevice*)check_tag(L, idx, VULKAN_TAG_DEVICE, DEVICE_MT);
     if (!ud->device) {
         luaL_error(L, "Invalid VkDevice (already destroyed)");
     }
@@ -615,7 +989,19 @@ static int l_vulkan_get_physical_devices_properties(lua_State* L) {
     return 1;
 }
 
-// Create VkDeviceCreateInfo: vulkan.create_device_info({queue_families, extensions})
+// Append a zeroed feature structure to the pNext chain of a device create info.
+static void* chain_device_feature(lua_State* L, VkDeviceCreateInfo* create_info, size_t size, VkStructureType type) {
+    VkBaseOutStructure* feature = (VkBaseOutStructure*)calloc(1, size);
+    if (!feature) {
+        luaL_error(L, "Failed to allocate memory for device features");
+    }
+    feature->sType = type;
+    feature->pNext = (VkBaseOutStructure*)create_info->pNext;
+    create_info->pNext = feature;
+    return feature;
+}
+
+// Create VkDeviceCreateInfo: vulkan.create_device_info({queue_families, extensions, [features]})
 static int l_vulkan_create_device_info(lua_State* L) {
     luaL_checktype(L, 1, LUA_TTABLE);
 
@@ -718,7 +1104,31 @@ static int l_vulkan_create_device_info(lua_State* L) {
     }
     lua_pop(L, 1);
 
+    // The userdata owns create_info from here, so errors below do not leak
     lua_push_VkDeviceCreateInfo(L, create_info);
+
+    // Optional features, chained into pNext
+    lua_getfield(L, 1, "features");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        lua_getfield(L, -1, "dynamic_rendering");
+        if (lua_toboolean(L, -1)) {
+            VkPhysicalDeviceDynamicRenderingFeatures* feature = (VkPhysicalDeviceDynamicRenderingFeatures*)
+                chain_device_feature(L, create_info, sizeof(VkPhysicalDeviceDynamicRenderingFeatures),
+                                     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES);
+            feature->dynamicRendering = VK_TRUE;
+        }
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "timeline_semaphore");
+        if (lua_toboolean(L, -1)) {
+            VkPhysicalDeviceTimelineSemaphoreFeatures* feature = (VkPhysicalDeviceTimelineSemaphoreFeatures*)
+                chain_device_feature(L, create_info, sizeof(VkPhysicalDeviceTimelineSemaphoreFeatures),
+                                     VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES);
+            feature->timelineSemaphore = VK_TRUE;
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
     return 1;
 }
 
@@ -769,7 +1179,7 @@ static int queue_gc(lua_State* L) {
 static int swapchain_gc(lua_State* L) {
     lua_VkSwapchainKHR* ud = (lua_VkSwapchainKHR*)luaL_checkudata(L, 1, SWAPCHAIN_MT);
     if (ud->swapchain && ud->device) {
-        vkDestroySwapchainKHR(ud->device, ud->swapchain, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_SWAPCHAIN, .handle.swapchain = ud->swapchain});
         ud->swapchain = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -782,13 +1192,14 @@ void lua_push_VkQueue(lua_State* L, VkQueue queue) {
         luaL_error(L, "Cannot create userdata for null VkQueue");
     }
     lua_VkQueue* ud = (lua_VkQueue*)lua_newuserdata(L, sizeof(lua_VkQueue));
+    ud->tag = VULKAN_TAG_QUEUE;
     ud->queue = queue;
     luaL_setmetatable(L, QUEUE_MT);
 }
 
 // Check VkQueue userdata
 lua_VkQueue* lua_check_VkQueue(lua_State* L, int idx) {
-    lua_VkQueue* ud = (lua_VkQueue*)luaL_checkudata(L, idx, QUEUE_MT);
+    lua_VkQueue* ud = (lua_VkQueue*)check_tag(L, idx, VULKAN_TAG_QUEUE, QUEUE_MT);
     if (!ud->queue) {
         luaL_error(L, "Invalid VkQueue (already destroyed)");
     }
@@ -801,6 +1212,7 @@ void lua_push_VkSwapchainKHR(lua_State* L, VkSwapchainKHR swapchain, VkDevice de
         luaL_error(L, "Cannot create userdata for null VkSwapchainKHR");
     }
     lua_VkSwapchainKHR* ud = (lua_VkSwapchainKHR*)lua_newuserdata(L, sizeof(lua_VkSwapchainKHR));
+    ud->tag = VULKAN_TAG_SWAPCHAIN;
     ud->swapchain = swapchain;
     ud->device = device;
     luaL_setmetatable(L, SWAPCHAIN_MT);
@@ -808,7 +1220,7 @@ void lua_push_VkSwapchainKHR(lua_State* L, VkSwapchainKHR swapchain, VkDevice de
 
 // Check VkSwapchainKHR userdata
 lua_VkSwapchainKHR* lua_check_VkSwapchainKHR(lua_State* L, int idx) {
-    lua_VkSwapchainKHR* ud = (lua_VkSwapchainKHR*)luaL_checkudata(L, idx, SWAPCHAIN_MT);
+    lua_VkSwapchainKHR* ud = (lua_VkSwapchainKHR*)check_tag(L, idx, VULKAN_TAG_SWAPCHAIN, SWAPCHAIN_MT);
     if (!ud->swapchain) {
         luaL_error(L, "Invalid VkSwapchainKHR (already destroyed)");
     }
@@ -888,6 +1300,8 @@ static int lua_getfield_integer(lua_State* L, int index, const char* field) {
 // SWAPCHAIN
 //===============================================
 // Create swapchain: vulkan.create_swap_chain_KHR(device, {surface, min_image_count, format, color_space, extent, present_mode, ...})
+// old_swapchain is retired, not destroyed: frames in flight may still use it, so the caller destroys
+// it (vulkan.destroy_swapchain_khr) once they are done, or leaves it to the garbage collector.
 static int l_vulkan_create_swap_chain_KHR(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     luaL_checktype(L, 2, LUA_TTABLE);
@@ -991,17 +1405,13 @@ static int l_vulkan_create_swap_chain_KHR(lua_State* L) {
     lua_pop(L, 1);
 
     lua_VkSwapchainKHR* swapchain_ud = (lua_VkSwapchainKHR*)lua_newuserdata(L, sizeof(lua_VkSwapchainKHR));
+    swapchain_ud->tag = VULKAN_TAG_SWAPCHAIN;
     swapchain_ud->swapchain = VK_NULL_HANDLE;
     swapchain_ud->device = device_ud->device;
 
     VkResult result = vkCreateSwapchainKHR(device_ud->device, &create_info, NULL, &swapchain_ud->swapchain);
     free(queue_family_indices);
 
-    if (old_swapchain_ud && old_swapchain_ud->swapchain != VK_NULL_HANDLE) {
-        vkDestroySwapchainKHR(device_ud->device, old_swapchain_ud->swapchain, NULL);
-        old_swapchain_ud->swapchain = VK_NULL_HANDLE;
-    }
-
     if (result != VK_SUCCESS) {
         lua_pushnil(L);
         lua_pushfstring(L, "Failed to create swapchain: VkResult %d", result);
@@ -1037,7 +1447,7 @@ static void swapchain_metatable(lua_State* L) {
 static int image_view_gc(lua_State* L) {
     lua_VkImageView* ud = (lua_VkImageView*)luaL_checkudata(L, 1, IMAGE_VIEW_MT);
     if (ud->image_view && ud->device) {
-        vkDestroyImageView(ud->device, ud->image_view, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_IMAGE_VIEW, .handle.image_view = ud->image_view});
         ud->image_view = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1050,6 +1460,7 @@ void lua_push_VkImageView(lua_State* L, VkImageView image_view, VkDevice device)
         luaL_error(L, "Cannot create userdata for null VkImageView");
     }
     lua_VkImageView* ud = (lua_VkImageView*)lua_newuserdata(L, sizeof(lua_VkImageView));
+    ud->tag = VULKAN_TAG_IMAGE_VIEW;
     ud->image_view = image_view;
     ud->device = device;
     luaL_setmetatable(L, IMAGE_VIEW_MT);
@@ -1057,7 +1468,7 @@ void lua_push_VkImageView(lua_State* L, VkImageView image_view, VkDevice device)
 
 // Check VkImageView userdata
 lua_VkImageView* lua_check_VkImageView(lua_State* L, int idx) {
-    lua_VkImageView* ud = (lua_VkImageView*)luaL_checkudata(L, idx, IMAGE_VIEW_MT);
+    lua_VkImageView* ud = (lua_VkImageView*)check_tag(L, idx, VULKAN_TAG_IMAGE_VIEW, IMAGE_VIEW_MT);
     if (!ud->image_view) {
         luaL_error(L, "Invalid VkImageView (already destroyed)");
     }
@@ -1100,6 +1511,8 @@ static int l_vulkan_get_swapchain_images_KHR(lua_State* L) {
 }
 
 // Create image view: vulkan.create_image_view(device, {image, format, view_type, components, subresource_range})
+// image is a swapchain image (light userdata) or a vulkan.image; for the latter every other
+// field is optional and defaults to a 2D view of the whole image in its own format.
 static int l_vulkan_create_image_view(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     luaL_checktype(L, 2, LUA_TTABLE);
@@ -1109,24 +1522,37 @@ static int l_vulkan_create_image_view(lua_State* L) {
 
     // Get image
     lua_getfield(L, 2, "image");
-    if (!lua_isuserdata(L, -1)) {
+    lua_VkImage* owned = (lua_VkImage*)test_tag(L, -1, VULKAN_TAG_IMAGE);
+    if (owned) {
+        lua_check_VkImage(L, -1);
+        create_info.image = owned->image;
+        create_info.format = owned->format;
+        create_info.viewType = owned->array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        create_info.subresourceRange.aspectMask = owned->aspect;
+        create_info.subresourceRange.levelCount = owned->mip_levels;
+        create_info.subresourceRange.layerCount = owned->array_layers;
+    } else if (lua_isuserdata(L, -1)) {
+        // Assuming swapchain_images[i] is pushed as light userdata (VkImage)
+        create_info.image = (VkImage)lua_touserdata(L, -1);
+    } else {
         luaL_error(L, "image must be a userdata (VkImage)");
     }
-    // Assuming swapchain_images[i] is pushed as light userdata (VkImage)
-    create_info.image = (VkImage)lua_touserdata(L, -1);
     lua_pop(L, 1);
 
     // Get format
     lua_getfield(L, 2, "format");
-    create_info.format = (VkFormat)luaL_checkinteger(L, -1);
+    if (!owned || !lua_isnil(L, -1)) {
+        create_info.format = (VkFormat)luaL_checkinteger(L, -1);
+    }
     lua_pop(L, 1);
 
     // Get view_type
     lua_getfield(L, 2, "view_type");
     if (lua_isnil(L, -1)) {
-        luaL_error(L, "view_type is required");
+        if (!owned) luaL_error(L, "view_type is required");
+    } else {
+        create_info.viewType = (VkImageViewType)luaL_checkinteger(L, -1);
     }
-    create_info.viewType = (VkImageViewType)luaL_checkinteger(L, -1);
     lua_pop(L, 1);
 
     // Get components
@@ -1147,7 +1573,7 @@ static int l_vulkan_create_image_view(lua_State* L) {
         lua_getfield(L, -1, "a");
         create_info.components.a = (VkComponentSwizzle)luaL_checkinteger(L, -1);
         lua_pop(L, 1);
-    } else {
+    } else if (!owned || !lua_isnil(L, -1)) {
         luaL_error(L, "components must be a table");
     }
     lua_pop(L, 1);
@@ -1167,32 +1593,2040 @@ static int l_vulkan_create_image_view(lua_State* L) {
         create_info.subresourceRange.levelCount = (uint32_t)luaL_checkinteger(L, -1);
         lua_pop(L, 1);
 
-        lua_getfield(L, -1, "base_array_layer");
-        create_info.subresourceRange.baseArrayLayer = (uint32_t)luaL_checkinteger(L, -1);
-        lua_pop(L, 1);
+        lua_getfield(L, -1, "base_array_layer");
+        create_info.subresourceRange.baseArrayLayer = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, -1, "layer_count");
+        create_info.subresourceRange.layerCount = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    } else if (!owned || !lua_isnil(L, -1)) {
+        luaL_error(L, "subresource_range must be a table");
+    }
+    lua_pop(L, 1);
+
+    VkImageView image_view;
+    VkResult result = vkCreateImageView(device_ud->device, &create_info, NULL, &image_view);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create image view: VkResult %d", result);
+    }
+
+    lua_push_VkImageView(L, image_view, device_ud->device);
+    return 1;
+}
+
+// Metatable setup
+static void image_view_metatable(lua_State* L) {
+    luaL_newmetatable(L, IMAGE_VIEW_MT);
+    lua_pushcfunction(L, image_view_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// MEMORY
+//===============================================
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+static int find_memory_type(lua_VkAllocator* a, uint32_t type_bits, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < a->memory_properties.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) && (a->memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void memory_block_destroy(lua_VkAllocator* a, vulkan_memory_block* block) {
+    while (block->free_list) {
+        vulkan_memory_range* next = block->free_list->next;
+        free(block->free_list);
+        block->free_list = next;
+    }
+    if (block->mapped) {
+        vkUnmapMemory(a->device, block->memory);
+    }
+    vkFreeMemory(a->device, block->memory, NULL);
+    free(block);
+}
+
+static VkResult memory_block_create(lua_VkAllocator* a, uint32_t memory_type, VkDeviceSize size, int dedicated,
+                                    vulkan_memory_block** out) {
+    vulkan_memory_block* block = (vulkan_memory_block*)calloc(1, sizeof(vulkan_memory_block));
+    vulkan_memory_range* range = (vulkan_memory_range*)calloc(1, sizeof(vulkan_memory_range));
+    if (!block || !range) {
+        free(block);
+        free(range);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkMemoryAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+    VkResult result = vkAllocateMemory(a->device, &alloc_info, NULL, &block->memory);
+    if (result != VK_SUCCESS) {
+        free(block);
+        free(range);
+        return result;
+    }
+    if (a->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(a->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+        if (result != VK_SUCCESS) {
+            vkFreeMemory(a->device, block->memory, NULL);
+            free(block);
+            free(range);
+            return result;
+        }
+    }
+
+    range->size = size;
+    block->free_list = range;
+    block->size = size;
+    block->memory_type = memory_type;
+    block->dedicated = dedicated;
+    block->next = a->blocks;
+    a->blocks = block;
+    *out = block;
+    return VK_SUCCESS;
+}
+
+// First fit inside one block. Returns 1 and fills the allocation on success.
+static int memory_block_take(vulkan_memory_block* block, VkDeviceSize size, VkDeviceSize alignment,
+                             vulkan_allocation* allocation) {
+    vulkan_memory_range** link = &block->free_list;
+    while (*link) {
+        vulkan_memory_range* range = *link;
+        VkDeviceSize offset = align_up(range->offset, alignment);
+        VkDeviceSize padding = offset - range->offset;
+        if (range->size >= padding + size) {
+            VkDeviceSize tail = range->size - padding - size;
+            if (padding > 0) {
+                // Keep the alignment gap as a free range in front. Allocate the tail range before
+                // shrinking this one, so a failure leaves the free list untouched.
+                if (tail > 0) {
+                    vulkan_memory_range* rest = (vulkan_memory_range*)malloc(sizeof(vulkan_memory_range));
+                    if (!rest) return 0;
+                    rest->offset = offset + size;
+                    rest->size = tail;
+                    rest->next = range->next;
+                    range->next = rest;
+                }
+                range->size = padding;
+            } else if (tail > 0) {
+                range->offset += size;
+                range->size = tail;
+            } else {
+                *link = range->next;
+                free(range);
+            }
+            block->used += size;
+            allocation->block = block;
+            allocation->offset = offset;
+            allocation->size = size;
+            return 1;
+        }
+        link = &range->next;
+    }
+    return 0;
+}
+
+// Allocate memory for a resource. Host visible blocks are mapped for their whole lifetime.
+VkResult vulkan_memory_alloc(lua_VkAllocator* a, const VkMemoryRequirements* requirements,
+                             VkMemoryPropertyFlags properties, vulkan_allocation* allocation) {
+    int memory_type = find_memory_type(a, requirements->memoryTypeBits, properties);
+    if (memory_type < 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+    VkDeviceSize alignment = requirements->alignment > a->granularity ? requirements->alignment : a->granularity;
+    VkDeviceSize size = align_up(requirements->size, a->granularity);
+
+    if (size > a->block_size / 2) {
+        vulkan_memory_block* block;
+        VkResult result = memory_block_create(a, (uint32_t)memory_type, size, 1, &block);
+        if (result != VK_SUCCESS) return result;
+        if (!memory_block_take(block, size, 1, allocation)) {
+            a->blocks = block->next; // Just pushed at the head
+            memory_block_destroy(a, block);
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        a->allocation_count++;
+        return VK_SUCCESS;
+    }
+
+    for (vulkan_memory_block* block = a->blocks; block; block = block->next) {
+        if (!block->dedicated && block->memory_type == (uint32_t)memory_type &&
+            memory_block_take(block, size, alignment, allocation)) {
+            a->allocation_count++;
+            return VK_SUCCESS;
+        }
+    }
+
+    vulkan_memory_block* block;
+    VkResult result = memory_block_create(a, (uint32_t)memory_type, a->block_size, 0, &block);
+    if (result != VK_SUCCESS) return result;
+    if (!memory_block_take(block, size, alignment, allocation)) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    a->allocation_count++;
+    return VK_SUCCESS;
+}
+
+// Return an allocation to its block, merging it with free neighbours.
+void vulkan_memory_free(lua_VkAllocator* a, vulkan_allocation* allocation) {
+    vulkan_memory_block* block = allocation->block;
+    if (!block) return;
+    allocation->block = NULL;
+    a->allocation_count--;
+    block->used -= allocation->size;
+
+    if (block->dedicated) {
+        vulkan_memory_block** link = &a->blocks;
+        while (*link != block) link = &(*link)->next;
+        *link = block->next;
+        memory_block_destroy(a, block);
+        return;
+    }
+
+    VkDeviceSize start = allocation->offset, end = allocation->offset + allocation->size;
+    vulkan_memory_range* prev = NULL;
+    vulkan_memory_range* next = block->free_list;
+    while (next && next->offset < start) {
+        prev = next;
+        next = next->next;
+    }
+    if (prev && prev->offset + prev->size == start) {
+        prev->size += allocation->size;
+        if (next && next->offset == end) {
+            prev->size += next->size;
+            prev->next = next->next;
+            free(next);
+        }
+    } else if (next && next->offset == end) {
+        next->offset = start;
+        next->size += allocation->size;
+    } else {
+        vulkan_memory_range* range = (vulkan_memory_range*)malloc(sizeof(vulkan_memory_range));
+        if (!range) return; // Leaks the range inside the block, never the block itself
+        range->offset = start;
+        range->size = allocation->size;
+        range->next = next;
+        if (prev) prev->next = range;
+        else block->free_list = range;
+    }
+}
+
+lua_VkAllocator* lua_check_VkAllocator(lua_State* L, int idx) {
+    lua_VkAllocator* ud = (lua_VkAllocator*)luaL_checkudata(L, idx, ALLOCATOR_MT);
+    if (!ud->device) {
+        luaL_error(L, "Invalid allocator (already destroyed)");
+    }
+    return ud;
+}
+
+static void allocator_release(lua_VkAllocator* ud) {
+    deletion_queue_flush_allocator(ud);
+    while (ud->blocks) {
+        vulkan_memory_block* next = ud->blocks->next;
+        memory_block_destroy(ud, ud->blocks);
+        ud->blocks = next;
+    }
+    ud->device = VK_NULL_HANDLE;
+}
+
+static int allocator_gc(lua_State* L) {
+    lua_VkAllocator* ud = (lua_VkAllocator*)luaL_checkudata(L, 1, ALLOCATOR_MT);
+    if (ud->device) {
+        allocator_release(ud);
+    }
+    return 0;
+}
+
+// Create memory allocator: vulkan.create_allocator(physical_device, device, [block_size])
+static int l_vulkan_create_allocator(lua_State* L) {
+    lua_VkPhysicalDevice* physical_ud = lua_check_VkPhysicalDevice(L, 1);
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 2);
+    lua_Integer block_size = luaL_optinteger(L, 3, (lua_Integer)VULKAN_ALLOCATOR_BLOCK_SIZE);
+    if (block_size < 1024 * 1024) {
+        luaL_error(L, "Allocator block size must be at least 1 MB");
+    }
+
+    lua_VkAllocator* ud = (lua_VkAllocator*)lua_newuserdata(L, sizeof(lua_VkAllocator));
+    memset(ud, 0, sizeof(lua_VkAllocator));
+    ud->device = device_ud->device;
+    ud->physical_device = physical_ud->physical_device;
+    ud->block_size = (VkDeviceSize)block_size;
+    vkGetPhysicalDeviceMemoryProperties(ud->physical_device, &ud->memory_properties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ud->physical_device, &properties);
+    ud->granularity = properties.limits.bufferImageGranularity;
+    luaL_setmetatable(L, ALLOCATOR_MT);
+    return 1;
+}
+
+// Allocator statistics: vulkan.allocator_stats(allocator) -> {blocks, reserved, used, allocations}
+static int l_vulkan_allocator_stats(lua_State* L) {
+    lua_VkAllocator* ud = lua_check_VkAllocator(L, 1);
+    lua_Integer blocks = 0, reserved = 0, used = 0;
+    for (vulkan_memory_block* block = ud->blocks; block; block = block->next) {
+        blocks++;
+        reserved += (lua_Integer)block->size;
+        used += (lua_Integer)block->used;
+    }
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, blocks);
+    lua_setfield(L, -2, "blocks");
+    lua_pushinteger(L, reserved);
+    lua_setfield(L, -2, "reserved");
+    lua_pushinteger(L, used);
+    lua_setfield(L, -2, "used");
+    lua_pushinteger(L, ud->allocation_count);
+    lua_setfield(L, -2, "allocations");
+    return 1;
+}
+
+// Destroy allocator: vulkan.destroy_allocator(allocator)
+// Frees every block. Raises while buffers or images allocated from it are still alive, since
+// their handles (and mapped pointers) point into those blocks.
+static int l_vulkan_destroy_allocator(lua_State* L) {
+    lua_VkAllocator* ud = lua_check_VkAllocator(L, 1);
+    deletion_queue_flush_allocator(ud);
+    if (ud->allocation_count > 0) {
+        luaL_error(L, "Cannot destroy allocator: %d buffers or images still allocated", (int)ud->allocation_count);
+    }
+    allocator_release(ud);
+    return 0;
+}
+
+static void allocator_metatable(lua_State* L) {
+    luaL_newmetatable(L, ALLOCATOR_MT);
+    lua_pushcfunction(L, allocator_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// BUFFERS
+//===============================================
+
+lua_VkBuffer* lua_check_VkBuffer(lua_State* L, int idx) {
+    lua_VkBuffer* ud = (lua_VkBuffer*)check_tag(L, idx, VULKAN_TAG_BUFFER, BUFFER_MT);
+    if (!ud->buffer) {
+        luaL_error(L, "Invalid VkBuffer (already destroyed)");
+    }
+    return ud;
+}
+
+static void buffer_release(lua_VkBuffer* ud) {
+    vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_BUFFER, .handle.buffer = ud->buffer,
+                                                   .allocator = ud->allocator, .allocation = ud->allocation});
+    ud->buffer = VK_NULL_HANDLE;
+    ud->mapped = NULL;
+}
+
+static int buffer_gc(lua_State* L) {
+    lua_VkBuffer* ud = (lua_VkBuffer*)luaL_checkudata(L, 1, BUFFER_MT);
+    if (ud->buffer) {
+        buffer_release(ud);
+    }
+    return 0;
+}
+
+// Create a buffer and bind memory for it. Used by vulkan.create_buffer and the staging path.
+static VkResult buffer_init(lua_VkAllocator* a, lua_VkBuffer* ud, VkDeviceSize size, VkBufferUsageFlags usage,
+                            VkMemoryPropertyFlags properties) {
+    VkBufferCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.size = size;
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult result = vkCreateBuffer(a->device, &create_info, NULL, &ud->buffer);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(a->device, ud->buffer, &requirements);
+    result = vulkan_memory_alloc(a, &requirements, properties, &ud->allocation);
+    if (result == VK_SUCCESS) {
+        result = vkBindBufferMemory(a->device, ud->buffer, ud->allocation.block->memory, ud->allocation.offset);
+        if (result != VK_SUCCESS) vulkan_memory_free(a, &ud->allocation);
+    }
+    if (result != VK_SUCCESS) {
+        vkDestroyBuffer(a->device, ud->buffer, NULL);
+        ud->buffer = VK_NULL_HANDLE;
+        return result;
+    }
+    ud->device = a->device;
+    ud->allocator = a;
+    ud->size = size;
+    ud->mapped = ud->allocation.block->mapped ? (char*)ud->allocation.block->mapped + ud->allocation.offset : NULL;
+    return VK_SUCCESS;
+}
+
+// Create buffer: vulkan.create_buffer(allocator, size, usage, [memory_properties])
+// memory_properties defaults to HOST_VISIBLE | HOST_COHERENT (mapped, writable with buffer_write).
+static int l_vulkan_create_buffer(lua_State* L) {
+    lua_VkAllocator* a = lua_check_VkAllocator(L, 1);
+    lua_Integer size = luaL_checkinteger(L, 2);
+    VkBufferUsageFlags usage = (VkBufferUsageFlags)luaL_checkinteger(L, 3);
+    VkMemoryPropertyFlags properties = (VkMemoryPropertyFlags)luaL_optinteger(L, 4,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (size <= 0) {
+        luaL_error(L, "Buffer size must be positive");
+    }
+
+    lua_VkBuffer* ud = (lua_VkBuffer*)lua_newuserdatauv(L, sizeof(lua_VkBuffer), 1);
+    memset(ud, 0, sizeof(lua_VkBuffer));
+    ud->tag = VULKAN_TAG_BUFFER;
+    VkResult result = buffer_init(a, ud, (VkDeviceSize)size, usage, properties);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create buffer: VkResult %d", result);
+    }
+    luaL_setmetatable(L, BUFFER_MT);
+    lua_pushvalue(L, 1);
+    lua_setiuservalue(L, -2, 1); // Keep the allocator alive
+    return 1;
+}
+
+// Write to a mapped buffer: vulkan.buffer_write(buffer, data, [offset])
+// data is a string, a runtime.buffer (read in place, also from workers) or an sdl.image (RGBA8 pixels).
+static int l_vulkan_buffer_write(lua_State* L) {
+    lua_VkBuffer* ud = lua_check_VkBuffer(L, 1);
+    lua_Integer offset = luaL_optinteger(L, 3, 0);
+    const void* data;
+    size_t size;
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        data = lua_tolstring(L, 2, &size);
+    } else if (lua_test_RuntimeBuffer(L, 2)) {
+        runtime_buffer* b = lua_check_RuntimeBuffer(L, 2)->buffer;
+        data = b->data;
+        size = b->size;
+    } else {
+        lua_SDL_Image* img = lua_check_SDL_Image(L, 2);
+        data = img->pixels;
+        size = (size_t)img->width * img->height * 4;
+    }
+    if (!ud->mapped) {
+        luaL_error(L, "Buffer memory is not host visible");
+    }
+    if (offset < 0 || (VkDeviceSize)offset + size > ud->size) {
+        luaL_error(L, "Write of %d bytes at offset %d exceeds buffer size %d", (int)size, (int)offset, (int)ud->size);
+    }
+    memcpy((char*)ud->mapped + offset, data, size);
+    return 0;
+}
+
+// Destroy buffer: vulkan.destroy_buffer(buffer)
+static int l_vulkan_destroy_buffer(lua_State* L) {
+    lua_VkBuffer* ud = lua_check_VkBuffer(L, 1);
+    buffer_release(ud);
+    return 0;
+}
+
+static void buffer_metatable(lua_State* L) {
+    luaL_newmetatable(L, BUFFER_MT);
+    lua_pushcfunction(L, buffer_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// OWNED IMAGES
+//===============================================
+
+lua_VkImage* lua_check_VkImage(lua_State* L, int idx) {
+    lua_VkImage* ud = (lua_VkImage*)check_tag(L, idx, VULKAN_TAG_IMAGE, IMAGE_MT);
+    if (!ud->image) {
+        luaL_error(L, "Invalid VkImage (already destroyed)");
+    }
+    return ud;
+}
+
+static void image_release(lua_VkImage* ud) {
+    vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_IMAGE, .handle.image = ud->image,
+                                                  .allocator = ud->allocator, .allocation = ud->allocation});
+    ud->image = VK_NULL_HANDLE;
+}
+
+static int image_gc(lua_State* L) {
+    lua_VkImage* ud = (lua_VkImage*)luaL_checkudata(L, 1, IMAGE_MT);
+    if (ud->image) {
+        image_release(ud);
+    }
+    return 0;
+}
+
+static VkImageAspectFlags format_aspect(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static uint32_t full_mip_chain(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    uint32_t size = width > height ? width : height;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+// Stage and access mask for a layout, as the source (is_destination = 0) or destination of a transition.
+void vulkan_layout_sync(VkImageLayout layout, int is_destination, VkPipelineStageFlags* stage, VkAccessFlags* access) {
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+        case VK_IMAGE_LAYOUT_PREINITIALIZED:
+            *stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            *access = 0;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            *stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            *access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            *stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            *access = VK_ACCESS_TRANSFER_READ_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            *stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            *access = VK_ACCESS_SHADER_READ_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            *stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            *access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            *stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            *access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+            *stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            *access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            // Presentation is ordered by semaphores; only the attachment stage needs to be covered.
+            *stage = is_destination ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            *access = 0;
+            break;
+        default: // GENERAL and anything else: full barrier
+            *stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            *access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            break;
+    }
+}
+
+// Does a use need a barrier after the tracked state? Layout changes are the caller's check.
+// Writes wait for every earlier use; reads only for a write not yet visible to their stage and access.
+int vulkan_sync_hazard(const vulkan_sync_state* sync, VkPipelineStageFlags stage, VkAccessFlags access) {
+    if (!sync->stage && !sync->write_stage) {
+        return 0; // First use
+    }
+    if (access & VULKAN_ACCESS_WRITE_MASK) {
+        return 1;
+    }
+    return sync->write_stage && ((stage & ~sync->visible_stage) || (access & ~sync->visible_access));
+}
+
+// Source scope of the next barrier: the uses since the last one, and the last write unless a
+// barrier has already made it available.
+void vulkan_sync_source(const vulkan_sync_state* sync, VkPipelineStageFlags* stage, VkAccessFlags* access) {
+    *stage = sync->stage ? sync->stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    *access = sync->visible_stage ? 0 : sync->write_access;
+}
+
+// Record a use that needed no barrier.
+void vulkan_sync_merge(vulkan_sync_state* sync, VkPipelineStageFlags stage, VkAccessFlags access) {
+    sync->stage |= stage;
+    sync->access |= access;
+    if (access & VULKAN_ACCESS_WRITE_MASK) {
+        sync->write_stage = stage;
+        sync->write_access = access & VULKAN_ACCESS_WRITE_MASK;
+        sync->visible_stage = 0;
+        sync->visible_access = 0;
+    }
+}
+
+// Record a use behind a barrier. A read adds its stage and access to where the last write is
+// visible; a layout transition is itself a write, visible to this use only.
+void vulkan_sync_barrier(vulkan_sync_state* sync, VkPipelineStageFlags stage, VkAccessFlags access, int transition) {
+    sync->stage = stage;
+    sync->access = access;
+    if (access & VULKAN_ACCESS_WRITE_MASK) {
+        sync->write_stage = stage;
+        sync->write_access = access & VULKAN_ACCESS_WRITE_MASK;
+        sync->visible_stage = 0;
+        sync->visible_access = 0;
+    } else if (transition) {
+        sync->write_stage = stage;
+        sync->write_access = 0;
+        sync->visible_stage = stage;
+        sync->visible_access = access;
+    } else {
+        sync->visible_stage |= stage;
+        sync->visible_access |= access;
+    }
+}
+
+// Record a layout transition for a range of mip levels (all array layers).
+static void image_barrier(VkCommandBuffer cmd, lua_VkImage* img, VkImageLayout old_layout, VkImageLayout new_layout,
+                          uint32_t base_mip, uint32_t mip_count) {
+    VkPipelineStageFlags src_stage, dst_stage;
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = img->image;
+    barrier.subresourceRange.aspectMask = img->aspect;
+    barrier.subresourceRange.baseMipLevel = base_mip;
+    barrier.subresourceRange.levelCount = mip_count;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = img->array_layers;
+    vulkan_layout_sync(old_layout, 0, &src_stage, &barrier.srcAccessMask);
+    vulkan_layout_sync(new_layout, 1, &dst_stage, &barrier.dstAccessMask);
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static int format_supports_linear_blit(lua_VkImage* img) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(img->allocator->physical_device, img->format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+}
+
+// Blit each level from the one above. Level 0 must hold data and every level must be in
+// TRANSFER_DST_OPTIMAL; all levels end in final_layout.
+static void image_generate_mipmaps(VkCommandBuffer cmd, lua_VkImage* img, VkImageLayout final_layout) {
+    int32_t width = (int32_t)img->extent.width, height = (int32_t)img->extent.height;
+    for (uint32_t level = 1; level < img->mip_levels; level++) {
+        image_barrier(cmd, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level - 1, 1);
+
+        int32_t next_width = width > 1 ? width / 2 : 1, next_height = height > 1 ? height / 2 : 1;
+        VkImageBlit blit = {0};
+        blit.srcSubresource.aspectMask = img->aspect;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.layerCount = img->array_layers;
+        blit.srcOffsets[1] = (VkOffset3D){ width, height, 1 };
+        blit.dstSubresource.aspectMask = img->aspect;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.layerCount = img->array_layers;
+        blit.dstOffsets[1] = (VkOffset3D){ next_width, next_height, 1 };
+        vkCmdBlitImage(cmd, img->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       img->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        image_barrier(cmd, img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, final_layout, level - 1, 1);
+        width = next_width;
+        height = next_height;
+    }
+    image_barrier(cmd, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, img->mip_levels - 1, 1);
+    img->layout = final_layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    vulkan_layout_sync(final_layout, 1, &stage, &access);
+    vulkan_sync_barrier(&img->sync, stage, access, 1);
+}
+
+// Create the VkImage and bind memory. The userdata must be zeroed and have device/allocator unset.
+static VkResult image_init(lua_VkAllocator* a, lua_VkImage* ud, const VkImageCreateInfo* create_info,
+                           VkMemoryPropertyFlags properties) {
+    VkResult result = vkCreateImage(a->device, create_info, NULL, &ud->image);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(a->device, ud->image, &requirements);
+    result = vulkan_memory_alloc(a, &requirements, properties, &ud->allocation);
+    if (result == VK_SUCCESS) {
+        result = vkBindImageMemory(a->device, ud->image, ud->allocation.block->memory, ud->allocation.offset);
+        if (result != VK_SUCCESS) vulkan_memory_free(a, &ud->allocation);
+    }
+    if (result != VK_SUCCESS) {
+        vkDestroyImage(a->device, ud->image, NULL);
+        ud->image = VK_NULL_HANDLE;
+        return result;
+    }
+    ud->device = a->device;
+    ud->allocator = a;
+    ud->format = create_info->format;
+    ud->extent = create_info->extent;
+    ud->mip_levels = create_info->mipLevels;
+    ud->array_layers = create_info->arrayLayers;
+    ud->aspect = format_aspect(create_info->format);
+    ud->layout = create_info->initialLayout;
+    return VK_SUCCESS;
+}
+
+// Push a new image userdata bound to the allocator at allocator_idx.
+static lua_VkImage* push_image(lua_State* L, int allocator_idx, const VkImageCreateInfo* create_info,
+                               VkMemoryPropertyFlags properties) {
+    lua_VkAllocator* a = lua_check_VkAllocator(L, allocator_idx);
+    allocator_idx = lua_absindex(L, allocator_idx);
+    lua_VkImage* ud = (lua_VkImage*)lua_newuserdatauv(L, sizeof(lua_VkImage), 1);
+    memset(ud, 0, sizeof(lua_VkImage));
+    ud->tag = VULKAN_TAG_IMAGE;
+    VkResult result = image_init(a, ud, create_info, properties);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create image: VkResult %d", result);
+    }
+    luaL_setmetatable(L, IMAGE_MT);
+    lua_pushvalue(L, allocator_idx);
+    lua_setiuservalue(L, -2, 1); // Keep the allocator alive
+    return ud;
+}
+
+// Create image: vulkan.create_image(allocator, {width, height, format, usage, mip_levels, array_layers, samples, tiling, memory_properties})
+// mip_levels = 0 requests the full chain. The image starts in IMAGE_LAYOUT_UNDEFINED.
+static int l_vulkan_create_image(lua_State* L) {
+    lua_check_VkAllocator(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    VkImageCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.extent.width = (uint32_t)lua_getfield_integer(L, 2, "width");
+    create_info.extent.height = (uint32_t)lua_getfield_integer(L, 2, "height");
+    create_info.extent.depth = 1;
+    create_info.format = (VkFormat)lua_getfield_integer(L, 2, "format");
+    create_info.usage = (VkImageUsageFlags)lua_getfield_integer(L, 2, "usage");
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    lua_getfield(L, 2, "mip_levels");
+    create_info.mipLevels = (uint32_t)luaL_optinteger(L, -1, 1);
+    lua_pop(L, 1);
+    if (create_info.mipLevels == 0) {
+        create_info.mipLevels = full_mip_chain(create_info.extent.width, create_info.extent.height);
+    }
+    lua_getfield(L, 2, "array_layers");
+    create_info.arrayLayers = (uint32_t)luaL_optinteger(L, -1, 1);
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "samples");
+    create_info.samples = (VkSampleCountFlagBits)luaL_optinteger(L, -1, VK_SAMPLE_COUNT_1_BIT);
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "tiling");
+    create_info.tiling = (VkImageTiling)luaL_optinteger(L, -1, VK_IMAGE_TILING_OPTIMAL);
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "memory_properties");
+    VkMemoryPropertyFlags properties = (VkMemoryPropertyFlags)luaL_optinteger(L, -1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    lua_pop(L, 1);
+
+    if (create_info.extent.width == 0 || create_info.extent.height == 0) {
+        luaL_error(L, "Image width and height must be positive");
+    }
+
+    push_image(L, 1, &create_info, properties);
+    return 1;
+}
+
+// Image properties: vulkan.image_info(image) -> {width, height, format, mip_levels, array_layers, layout}
+static int l_vulkan_image_info(lua_State* L) {
+    lua_VkImage* ud = lua_check_VkImage(L, 1);
+    lua_createtable(L, 0, 6);
+    lua_pushinteger(L, ud->extent.width);
+    lua_setfield(L, -2, "width");
+    lua_pushinteger(L, ud->extent.height);
+    lua_setfield(L, -2, "height");
+    lua_pushinteger(L, ud->format);
+    lua_setfield(L, -2, "format");
+    lua_pushinteger(L, ud->mip_levels);
+    lua_setfield(L, -2, "mip_levels");
+    lua_pushinteger(L, ud->array_layers);
+    lua_setfield(L, -2, "array_layers");
+    lua_pushinteger(L, ud->layout);
+    lua_setfield(L, -2, "layout");
+    return 1;
+}
+
+// Transition image layout: vulkan.cmd_transition_image(command_buffer, image, new_layout)
+// Records a pipeline barrier from the tracked layout; stages and access masks follow from the layouts.
+static int l_vulkan_cmd_transition_image(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    lua_VkImage* img = lua_check_VkImage(L, 2);
+    VkImageLayout new_layout = (VkImageLayout)luaL_checkinteger(L, 3);
+
+    image_barrier(cmd_ud->command_buffer, img, img->layout, new_layout, 0, img->mip_levels);
+    img->layout = new_layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    vulkan_layout_sync(new_layout, 1, &stage, &access);
+    vulkan_sync_barrier(&img->sync, stage, access, 1);
+    return 0;
+}
+
+// Copy buffer to image: vulkan.cmd_copy_buffer_to_image(command_buffer, buffer, image, [mip_level], [buffer_offset])
+// The image must be in IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; the buffer holds tightly packed texels.
+static int l_vulkan_cmd_copy_buffer_to_image(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    lua_VkBuffer* buf = lua_check_VkBuffer(L, 2);
+    lua_VkImage* img = lua_check_VkImage(L, 3);
+    uint32_t mip_level = (uint32_t)luaL_optinteger(L, 4, 0);
+    VkDeviceSize offset = (VkDeviceSize)luaL_optinteger(L, 5, 0);
+
+    if (mip_level >= img->mip_levels) {
+        luaL_error(L, "Mip level %d out of range (image has %d)", (int)mip_level, (int)img->mip_levels);
+    }
+    if (img->layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        luaL_error(L, "Image must be in IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL for a copy");
+    }
+
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = offset;
+    region.imageSubresource.aspectMask = img->aspect;
+    region.imageSubresource.mipLevel = mip_level;
+    region.imageSubresource.layerCount = img->array_layers;
+    region.imageExtent.width = img->extent.width >> mip_level ? img->extent.width >> mip_level : 1;
+    region.imageExtent.height = img->extent.height >> mip_level ? img->extent.height >> mip_level : 1;
+    region.imageExtent.depth = 1;
+    vkCmdCopyBufferToImage(cmd_ud->command_buffer, buf->buffer, img->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    return 0;
+}
+
+// Generate mipmaps: vulkan.cmd_generate_mipmaps(command_buffer, image, [final_layout])
+// Needs the image in TRANSFER_DST_OPTIMAL with level 0 filled, TRANSFER_SRC usage and a format
+// that supports linear blits. final_layout defaults to SHADER_READ_ONLY_OPTIMAL.
+static int l_vulkan_cmd_generate_mipmaps(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    lua_VkImage* img = lua_check_VkImage(L, 2);
+    VkImageLayout final_layout = (VkImageLayout)luaL_optinteger(L, 3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    if (img->layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        luaL_error(L, "Image must be in IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to generate mipmaps");
+    }
+    if (!format_supports_linear_blit(img)) {
+        luaL_error(L, "Format %d does not support linear blits", (int)img->format);
+    }
+    image_generate_mipmaps(cmd_ud->command_buffer, img, final_layout);
+    return 0;
+}
+
+// Upload an image: vulkan.upload_image(allocator, queue, command_pool, sdl_image, [{format, mipmaps, usage}])
+// Copies through a staging buffer on a one-time command buffer and waits for it, so it belongs
+// in loading code. The result is sampled-ready in SHADER_READ_ONLY_OPTIMAL. mipmaps defaults to
+// true and is skipped when the format cannot be linearly blitted.
+static int l_vulkan_upload_image(lua_State* L) {
+    lua_VkAllocator* a = lua_check_VkAllocator(L, 1);
+    lua_VkQueue* queue_ud = lua_check_VkQueue(L, 2);
+    lua_VkCommandPool* pool_ud = lua_check_VkCommandPool(L, 3);
+    lua_SDL_Image* src = lua_check_SDL_Image(L, 4);
+
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    int mipmaps = 1;
+    VkImageUsageFlags usage = 0;
+    if (lua_istable(L, 5)) {
+        lua_getfield(L, 5, "format");
+        format = (VkFormat)luaL_optinteger(L, -1, format);
+        lua_pop(L, 1);
+        lua_getfield(L, 5, "mipmaps");
+        if (!lua_isnil(L, -1)) mipmaps = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, 5, "usage");
+        usage = (VkImageUsageFlags)luaL_optinteger(L, -1, 0);
+        lua_pop(L, 1);
+    }
+    // The staging copy is width * height * 4 bytes of RGBA8 texels.
+    if (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB) {
+        luaL_error(L, "upload_image needs an RGBA8 format (R8G8B8A8_UNORM or R8G8B8A8_SRGB), got %d", (int)format);
+    }
+
+    VkImageCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = format;
+    create_info.extent.width = (uint32_t)src->width;
+    create_info.extent.height = (uint32_t)src->height;
+    create_info.extent.depth = 1;
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (mipmaps) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(a->physical_device, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) {
+            create_info.mipLevels = full_mip_chain(create_info.extent.width, create_info.extent.height);
+            create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+    }
+    lua_VkImage* img = push_image(L, 1, &create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkDeviceSize size = (VkDeviceSize)src->width * src->height * 4;
+    lua_VkBuffer staging;
+    memset(&staging, 0, sizeof(staging));
+    VkResult result = buffer_init(a, &staging, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create staging buffer: VkResult %d", result);
+    }
+    memcpy(staging.mapped, src->pixels, (size_t)size);
+
+    VkCommandBufferAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = pool_ud->command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    result = vkAllocateCommandBuffers(a->device, &alloc_info, &cmd);
+
+    if (result == VK_SUCCESS) {
+        VkCommandBufferBeginInfo begin_info = {0};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        result = vkBeginCommandBuffer(cmd, &begin_info);
+    }
+    if (result == VK_SUCCESS) {
+        image_barrier(cmd, img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, img->mip_levels);
+        img->layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+        VkBufferImageCopy region = {0};
+        region.imageSubresource.aspectMask = img->aspect;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = img->extent;
+        vkCmdCopyBufferToImage(cmd, staging.buffer, img->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        image_generate_mipmaps(cmd, img, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        result = vkEndCommandBuffer(cmd);
+    }
+    if (result == VK_SUCCESS) {
+        VkFenceCreateInfo fence_info = {0};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        result = vkCreateFence(a->device, &fence_info, NULL, &fence);
+    }
+    if (result == VK_SUCCESS) {
+        VkSubmitInfo submit_info = {0};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &cmd;
+        result = vkQueueSubmit(queue_ud->queue, 1, &submit_info, fence);
+    }
+    if (result == VK_SUCCESS) {
+        result = vkWaitForFences(a->device, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+
+    if (fence) vkDestroyFence(a->device, fence, NULL);
+    if (cmd) vkFreeCommandBuffers(a->device, pool_ud->command_pool, 1, &cmd);
+    buffer_release(&staging);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to upload image: VkResult %d", result);
+    }
+    return 1;
+}
+
+// Destroy image: vulkan.destroy_image(image)
+static int l_vulkan_destroy_image(lua_State* L) {
+    lua_VkImage* ud = lua_check_VkImage(L, 1);
+    image_release(ud);
+    return 0;
+}
+
+static void image_metatable(lua_State* L) {
+    luaL_newmetatable(L, IMAGE_MT);
+    lua_pushcfunction(L, image_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// SAMPLERS
+//===============================================
+
+static int sampler_gc(lua_State* L) {
+    lua_VkSampler* ud = (lua_VkSampler*)luaL_checkudata(L, 1, SAMPLER_MT);
+    if (ud->sampler && ud->device) {
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_SAMPLER, .handle.sampler = ud->sampler});
+        ud->sampler = VK_NULL_HANDLE;
+        ud->device = VK_NULL_HANDLE;
+    }
+    return 0;
+}
+
+lua_VkSampler* lua_check_VkSampler(lua_State* L, int idx) {
+    lua_VkSampler* ud = (lua_VkSampler*)check_tag(L, idx, VULKAN_TAG_SAMPLER, SAMPLER_MT);
+    if (!ud->sampler) {
+        luaL_error(L, "Invalid VkSampler (already destroyed)");
+    }
+    return ud;
+}
+
+lua_VkSamplerCache* lua_check_VkSamplerCache(lua_State* L, int idx) {
+    lua_VkSamplerCache* ud = (lua_VkSamplerCache*)luaL_checkudata(L, idx, SAMPLER_CACHE_MT);
+    if (!ud->device) {
+        luaL_error(L, "Invalid sampler cache (already destroyed)");
+    }
+    return ud;
+}
+
+static float opt_number_field(lua_State* L, int idx, const char* field, float def) {
+    lua_getfield(L, idx, field);
+    float value = (float)luaL_optnumber(L, -1, def);
+    lua_pop(L, 1);
+    return value;
+}
+
+static int opt_integer_field(lua_State* L, int idx, const char* field, int def) {
+    lua_getfield(L, idx, field);
+    int value = (int)luaL_optinteger(L, -1, def);
+    lua_pop(L, 1);
+    return value;
+}
+
+// Read sampler options: {mag_filter, min_filter, mipmap_mode, address_mode_u/v/w, max_anisotropy,
+// mip_lod_bias, min_lod, max_lod, compare_op, border_color}. Everything is optional
+// (linear filtering, repeat addressing, all mip levels).
+static void read_sampler_info(lua_State* L, int idx, VkSamplerCreateInfo* info) {
+    memset(info, 0, sizeof(VkSamplerCreateInfo)); // Zeroed padding keeps cache keys stable
+    info->sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    info->magFilter = VK_FILTER_LINEAR;
+    info->minFilter = VK_FILTER_LINEAR;
+    info->mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    info->addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info->addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info->addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info->maxLod = VK_LOD_CLAMP_NONE;
+    info->borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    if (lua_isnoneornil(L, idx)) {
+        return;
+    }
+    luaL_checktype(L, idx, LUA_TTABLE);
+    info->magFilter = (VkFilter)opt_integer_field(L, idx, "mag_filter", info->magFilter);
+    info->minFilter = (VkFilter)opt_integer_field(L, idx, "min_filter", info->minFilter);
+    info->mipmapMode = (VkSamplerMipmapMode)opt_integer_field(L, idx, "mipmap_mode", info->mipmapMode);
+    info->addressModeU = (VkSamplerAddressMode)opt_integer_field(L, idx, "address_mode_u", info->addressModeU);
+    info->addressModeV = (VkSamplerAddressMode)opt_integer_field(L, idx, "address_mode_v", info->addressModeV);
+    info->addressModeW = (VkSamplerAddressMode)opt_integer_field(L, idx, "address_mode_w", info->addressModeW);
+    info->mipLodBias = opt_number_field(L, idx, "mip_lod_bias", 0.0f);
+    info->minLod = opt_number_field(L, idx, "min_lod", 0.0f);
+    info->maxLod = opt_number_field(L, idx, "max_lod", info->maxLod);
+    info->maxAnisotropy = opt_number_field(L, idx, "max_anisotropy", 0.0f);
+    info->anisotropyEnable = info->maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+    if (!info->anisotropyEnable) info->maxAnisotropy = 0.0f;
+    lua_getfield(L, idx, "compare_op");
+    if (!lua_isnil(L, -1)) {
+        info->compareEnable = VK_TRUE;
+        info->compareOp = (VkCompareOp)luaL_checkinteger(L, -1);
+    }
+    lua_pop(L, 1);
+    info->borderColor = (VkBorderColor)opt_integer_field(L, idx, "border_color", info->borderColor);
+}
+
+static void push_sampler(lua_State* L, VkDevice device, const VkSamplerCreateInfo* info) {
+    VkSampler sampler;
+    VkResult result = vkCreateSampler(device, info, NULL, &sampler);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create sampler: VkResult %d", result);
+    }
+    lua_VkSampler* ud = (lua_VkSampler*)lua_newuserdata(L, sizeof(lua_VkSampler));
+    ud->tag = VULKAN_TAG_SAMPLER;
+    ud->sampler = sampler;
+    ud->device = device;
+    luaL_setmetatable(L, SAMPLER_MT);
+}
+
+// Create sampler: vulkan.create_sampler(device, [options]) (uncached, see create_sampler_cache)
+static int l_vulkan_create_sampler(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    VkSamplerCreateInfo info;
+    read_sampler_info(L, 2, &info);
+    push_sampler(L, device_ud->device, &info);
+    return 1;
+}
+
+// Create sampler cache: vulkan.create_sampler_cache(device)
+static int l_vulkan_create_sampler_cache(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    lua_VkSamplerCache* ud = (lua_VkSamplerCache*)lua_newuserdatauv(L, sizeof(lua_VkSamplerCache), 1);
+    ud->device = device_ud->device;
+    ud->count = 0;
+    luaL_setmetatable(L, SAMPLER_CACHE_MT);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 1); // create info bytes -> sampler userdata
+    return 1;
+}
+
+// Get a cached sampler: vulkan.get_sampler(cache, [options]) -> sampler
+// Equal options return the same sampler object; it lives as long as the cache.
+static int l_vulkan_get_sampler(lua_State* L) {
+    lua_VkSamplerCache* cache = lua_check_VkSamplerCache(L, 1);
+    VkSamplerCreateInfo info;
+    read_sampler_info(L, 2, &info);
+
+    lua_getiuservalue(L, 1, 1);
+    lua_pushlstring(L, (const char*)&info, sizeof(info));
+    lua_pushvalue(L, -1);
+    if (lua_rawget(L, -3) != LUA_TNIL) {
+        return 1;
+    }
+    lua_pop(L, 1);
+    push_sampler(L, cache->device, &info);
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -5);
+    cache->count++;
+    return 1;
+}
+
+// Sampler cache size: vulkan.sampler_cache_count(cache) -> number of distinct samplers
+static int l_vulkan_sampler_cache_count(lua_State* L) {
+    lua_VkSamplerCache* cache = lua_check_VkSamplerCache(L, 1);
+    lua_pushinteger(L, cache->count);
+    return 1;
+}
+
+// Destroy sampler: vulkan.destroy_sampler(sampler)
+static int l_vulkan_destroy_sampler(lua_State* L) {
+    lua_check_VkSampler(L, 1);
+    return sampler_gc(L);
+}
+
+static void sampler_metatable(lua_State* L) {
+    luaL_newmetatable(L, SAMPLER_MT);
+    lua_pushcfunction(L, sampler_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
+    // Samplers are owned by the cached userdata in the uservalue table.
+    luaL_newmetatable(L, SAMPLER_CACHE_MT);
+    lua_pop(L, 1);
+}
+
+//===============================================
+// BARRIERS
+//===============================================
+
+// Optional integer field of a table, def when absent.
+lua_Integer opt_flags_field(lua_State* L, int idx, const char* field, lua_Integer def) {
+    lua_getfield(L, idx, field);
+    lua_Integer value = luaL_optinteger(L, -1, def);
+    lua_pop(L, 1);
+    return value;
+}
+
+// Read {src_access, dst_access, [src_stage], [dst_stage]} into a VkMemoryBarrier2.
+static void read_memory_barrier(lua_State* L, int idx, VkMemoryBarrier2* b, lua_Integer src_stage, lua_Integer dst_stage) {
+    memset(b, 0, sizeof(*b));
+    b->sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    b->srcStageMask = (VkPipelineStageFlags2)opt_flags_field(L, idx, "src_stage", src_stage);
+    b->dstStageMask = (VkPipelineStageFlags2)opt_flags_field(L, idx, "dst_stage", dst_stage);
+    b->srcAccessMask = (VkAccessFlags2)opt_flags_field(L, idx, "src_access", 0);
+    b->dstAccessMask = (VkAccessFlags2)opt_flags_field(L, idx, "dst_access", 0);
+}
+
+// Read {buffer, src_access, dst_access, [offset], [size], [src_stage], [dst_stage]} into a VkBufferMemoryBarrier2.
+static lua_VkBuffer* read_buffer_barrier(lua_State* L, int idx, VkBufferMemoryBarrier2* b,
+                                         lua_Integer src_stage, lua_Integer dst_stage) {
+    memset(b, 0, sizeof(*b));
+    b->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    lua_getfield(L, idx, "buffer");
+    lua_VkBuffer* buf = lua_check_VkBuffer(L, -1);
+    lua_pop(L, 1);
+    b->buffer = buf->buffer;
+    b->srcStageMask = (VkPipelineStageFlags2)opt_flags_field(L, idx, "src_stage", src_stage);
+    b->dstStageMask = (VkPipelineStageFlags2)opt_flags_field(L, idx, "dst_stage", dst_stage);
+    b->srcAccessMask = (VkAccessFlags2)opt_flags_field(L, idx, "src_access", 0);
+    b->dstAccessMask = (VkAccessFlags2)opt_flags_field(L, idx, "dst_access", 0);
+    b->srcQueueFamilyIndex = (uint32_t)opt_flags_field(L, idx, "src_queue_family", VK_QUEUE_FAMILY_IGNORED);
+    b->dstQueueFamilyIndex = (uint32_t)opt_flags_field(L, idx, "dst_queue_family", VK_QUEUE_FAMILY_IGNORED);
+    b->offset = (VkDeviceSize)opt_flags_field(L, idx, "offset", 0);
+    lua_getfield(L, idx, "size");
+    b->size = lua_isnil(L, -1) ? VK_WHOLE_SIZE : (VkDeviceSize)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+    return buf;
+}
+
+// Read {image, new_layout, [old_layout], src_access, dst_access, [aspect], [base_mip], [level_count],
+// [base_layer], [layer_count], [src_stage], [dst_stage]} into a VkImageMemoryBarrier2.
+// image is a vulkan.image (old_layout and range default from it) or a swapchain image.
+static lua_VkImage* read_image_barrier(lua_State* L, int idx, VkImageMemoryBarrier2* b,
+                                       lua_Integer src_stage, lua_Integer dst_stage) {
+    memset(b, 0, sizeof(*b));
+    b->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    lua_getfield(L, idx, "image");
+    lua_VkImage* owned = (lua_VkImage*)test_tag(L, -1, VULKAN_TAG_IMAGE);
+    if (owned) {
+        lua_check_VkImage(L, -1);
+        b->image = owned->image;
+    } else if (lua_islightuserdata(L, -1)) {
+        b->image = (VkImage)lua_touserdata(L, -1);
+    } else {
+        luaL_error(L, "image must be a vulkan.image or a swapchain image");
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "old_layout");
+    if (lua_isnil(L, -1) && owned) {
+        b->oldLayout = owned->layout;
+    } else {
+        b->oldLayout = (VkImageLayout)luaL_checkinteger(L, -1);
+    }
+    lua_pop(L, 1);
+    lua_getfield(L, idx, "new_layout");
+    b->newLayout = (VkImageLayout)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    b->srcStageMask = (VkPipelineStageFlags2)opt_flags_field(L, idx, "src_stage", src_stage);
+    b->dstStageMask = (VkPipelineStageFlags2)opt_flags_field(L, idx, "dst_stage", dst_stage);
+    b->srcAccessMask = (VkAccessFlags2)opt_flags_field(L, idx, "src_access", 0);
+    b->dstAccessMask = (VkAccessFlags2)opt_flags_field(L, idx, "dst_access", 0);
+    b->srcQueueFamilyIndex = (uint32_t)opt_flags_field(L, idx, "src_queue_family", VK_QUEUE_FAMILY_IGNORED);
+    b->dstQueueFamilyIndex = (uint32_t)opt_flags_field(L, idx, "dst_queue_family", VK_QUEUE_FAMILY_IGNORED);
+    b->subresourceRange.aspectMask = (VkImageAspectFlags)opt_flags_field(L, idx, "aspect",
+        owned ? owned->aspect : VK_IMAGE_ASPECT_COLOR_BIT);
+    b->subresourceRange.baseMipLevel = (uint32_t)opt_flags_field(L, idx, "base_mip", 0);
+    b->subresourceRange.levelCount = (uint32_t)opt_flags_field(L, idx, "level_count", VK_REMAINING_MIP_LEVELS);
+    b->subresourceRange.baseArrayLayer = (uint32_t)opt_flags_field(L, idx, "base_layer", 0);
+    b->subresourceRange.layerCount = (uint32_t)opt_flags_field(L, idx, "layer_count", VK_REMAINING_ARRAY_LAYERS);
+    return owned;
+}
+
+// After an explicit barrier, keep the tracked state of owned resources in step.
+// Partial image barriers leave the tracked layout alone since it describes the whole image.
+static void image_barrier_recorded(lua_VkImage* img, const VkImageMemoryBarrier2* b) {
+    const VkImageSubresourceRange* r = &b->subresourceRange;
+    if (r->baseMipLevel == 0 && r->baseArrayLayer == 0 &&
+        (r->levelCount == VK_REMAINING_MIP_LEVELS || r->levelCount >= img->mip_levels) &&
+        (r->layerCount == VK_REMAINING_ARRAY_LAYERS || r->layerCount >= img->array_layers)) {
+        vulkan_sync_barrier(&img->sync, (VkPipelineStageFlags)b->dstStageMask, (VkAccessFlags)b->dstAccessMask,
+                            b->oldLayout != b->newLayout);
+        img->layout = b->newLayout;
+    }
+}
+
+// Count the entries of an optional array field and leave it on the stack.
+static int push_barrier_list(lua_State* L, int idx, const char* field) {
+    lua_getfield(L, idx, field);
+    if (lua_isnil(L, -1)) {
+        return 0;
+    }
+    luaL_checktype(L, -1, LUA_TTABLE);
+    return (int)lua_rawlen(L, -1);
+}
+
+// Pipeline barrier: vulkan.cmd_pipeline_barrier(command_buffer, {src_stage, dst_stage, [dependency_flags],
+//     [memory_barriers], [buffer_barriers], [image_barriers]})
+static int l_vulkan_cmd_pipeline_barrier(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_getfield(L, 2, "src_stage");
+    lua_Integer src_stage = luaL_checkinteger(L, -1);
+    lua_getfield(L, 2, "dst_stage");
+    lua_Integer dst_stage = luaL_checkinteger(L, -1);
+    lua_pop(L, 2);
+    VkDependencyFlags dependency_flags = (VkDependencyFlags)opt_flags_field(L, 2, "dependency_flags", 0);
+
+    // Scratch arrays live in userdata so a Lua error while parsing cannot leak them
+    int memory_count = push_barrier_list(L, 2, "memory_barriers");
+    VkMemoryBarrier* memory = (VkMemoryBarrier*)lua_newuserdata(L, sizeof(VkMemoryBarrier) * (memory_count + 1));
+    for (int i = 0; i < memory_count; i++) {
+        VkMemoryBarrier2 b;
+        lua_rawgeti(L, -2, i + 1);
+        read_memory_barrier(L, lua_gettop(L), &b, src_stage, dst_stage);
+        lua_pop(L, 1);
+        memory[i] = (VkMemoryBarrier){ VK_STRUCTURE_TYPE_MEMORY_BARRIER, NULL,
+                                       (VkAccessFlags)b.srcAccessMask, (VkAccessFlags)b.dstAccessMask };
+    }
+
+    int buffer_count = push_barrier_list(L, 2, "buffer_barriers");
+    VkBufferMemoryBarrier* buffers = (VkBufferMemoryBarrier*)lua_newuserdata(L, sizeof(VkBufferMemoryBarrier) * (buffer_count + 1));
+    for (int i = 0; i < buffer_count; i++) {
+        VkBufferMemoryBarrier2 b;
+        lua_rawgeti(L, -2, i + 1);
+        read_buffer_barrier(L, lua_gettop(L), &b, src_stage, dst_stage);
+        lua_pop(L, 1);
+        buffers[i] = (VkBufferMemoryBarrier){ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, NULL,
+            (VkAccessFlags)b.srcAccessMask, (VkAccessFlags)b.dstAccessMask,
+            b.srcQueueFamilyIndex, b.dstQueueFamilyIndex, b.buffer, b.offset, b.size };
+    }
+
+    int image_count = push_barrier_list(L, 2, "image_barriers");
+    VkImageMemoryBarrier* images = (VkImageMemoryBarrier*)lua_newuserdata(L, sizeof(VkImageMemoryBarrier) * (image_count + 1));
+    for (int i = 0; i < image_count; i++) {
+        VkImageMemoryBarrier2 b;
+        lua_rawgeti(L, -2, i + 1);
+        lua_VkImage* owned = read_image_barrier(L, lua_gettop(L), &b, src_stage, dst_stage);
+        lua_pop(L, 1);
+        images[i] = (VkImageMemoryBarrier){ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, NULL,
+            (VkAccessFlags)b.srcAccessMask, (VkAccessFlags)b.dstAccessMask, b.oldLayout, b.newLayout,
+            b.srcQueueFamilyIndex, b.dstQueueFamilyIndex, b.image, b.subresourceRange };
+        if (owned) image_barrier_recorded(owned, &b);
+    }
+
+    vkCmdPipelineBarrier(cmd_ud->command_buffer, (VkPipelineStageFlags)src_stage, (VkPipelineStageFlags)dst_stage,
+                         dependency_flags, (uint32_t)memory_count, memory, (uint32_t)buffer_count, buffers,
+                         (uint32_t)image_count, images);
+    return 0;
+}
+
+// Pipeline barrier 2: vulkan.cmd_pipeline_barrier2(command_buffer, {[src_stage], [dst_stage], [dependency_flags],
+//     [memory_barriers], [buffer_barriers], [image_barriers]})
+// Each barrier carries its own src_stage/dst_stage (the table level values are defaults). Needs
+// Vulkan 1.3 or VK_KHR_synchronization2 with the synchronization2 feature enabled on the device.
+static int l_vulkan_cmd_pipeline_barrier2(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    PFN_vkCmdPipelineBarrier2 cmd_pipeline_barrier2 =
+        (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(cmd_ud->device, "vkCmdPipelineBarrier2");
+    if (!cmd_pipeline_barrier2) {
+        cmd_pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(cmd_ud->device, "vkCmdPipelineBarrier2KHR");
+    }
+    if (!cmd_pipeline_barrier2) {
+        luaL_error(L, "vkCmdPipelineBarrier2 is not available (needs Vulkan 1.3 or VK_KHR_synchronization2)");
+    }
+
+    lua_Integer src_stage = opt_flags_field(L, 2, "src_stage", VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    lua_Integer dst_stage = opt_flags_field(L, 2, "dst_stage", VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    VkDependencyInfo info = {0};
+    info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    info.dependencyFlags = (VkDependencyFlags)opt_flags_field(L, 2, "dependency_flags", 0);
+
+    int memory_count = push_barrier_list(L, 2, "memory_barriers");
+    VkMemoryBarrier2* memory = (VkMemoryBarrier2*)lua_newuserdata(L, sizeof(VkMemoryBarrier2) * (memory_count + 1));
+    for (int i = 0; i < memory_count; i++) {
+        lua_rawgeti(L, -2, i + 1);
+        read_memory_barrier(L, lua_gettop(L), &memory[i], src_stage, dst_stage);
+        lua_pop(L, 1);
+    }
+
+    int buffer_count = push_barrier_list(L, 2, "buffer_barriers");
+    VkBufferMemoryBarrier2* buffers = (VkBufferMemoryBarrier2*)lua_newuserdata(L, sizeof(VkBufferMemoryBarrier2) * (buffer_count + 1));
+    for (int i = 0; i < buffer_count; i++) {
+        lua_rawgeti(L, -2, i + 1);
+        read_buffer_barrier(L, lua_gettop(L), &buffers[i], src_stage, dst_stage);
+        lua_pop(L, 1);
+    }
+
+    int image_count = push_barrier_list(L, 2, "image_barriers");
+    VkImageMemoryBarrier2* images = (VkImageMemoryBarrier2*)lua_newuserdata(L, sizeof(VkImageMemoryBarrier2) * (image_count + 1));
+    for (int i = 0; i < image_count; i++) {
+        lua_rawgeti(L, -2, i + 1);
+        lua_VkImage* owned = read_image_barrier(L, lua_gettop(L), &images[i], src_stage, dst_stage);
+        lua_pop(L, 1);
+        if (owned) image_barrier_recorded(owned, &images[i]);
+    }
+
+    info.memoryBarrierCount = (uint32_t)memory_count;
+    info.pMemoryBarriers = memory;
+    info.bufferMemoryBarrierCount = (uint32_t)buffer_count;
+    info.pBufferMemoryBarriers = buffers;
+    info.imageMemoryBarrierCount = (uint32_t)image_count;
+    info.pImageMemoryBarriers = images;
+    cmd_pipeline_barrier2(cmd_ud->command_buffer, &info);
+    return 0;
+}
+
+//===============================================
+// BARRIER TRACKER
+//===============================================
+
+lua_VkBarrierTracker* lua_check_VkBarrierTracker(lua_State* L, int idx) {
+    return (lua_VkBarrierTracker*)luaL_checkudata(L, idx, BARRIER_TRACKER_MT);
+}
+
+static int barrier_tracker_gc(lua_State* L) {
+    lua_VkBarrierTracker* t = lua_check_VkBarrierTracker(L, 1);
+    free(t->image_barriers);
+    free(t->buffer_barriers);
+    t->image_barriers = NULL;
+    t->buffer_barriers = NULL;
+    t->image_count = t->image_capacity = 0;
+    t->buffer_count = t->buffer_capacity = 0;
+    return 0;
+}
+
+// Double a malloc'd array (16 items at first); raises a Lua error when out of memory.
+void* tracker_grow(lua_State* L, void* array, int* capacity, size_t item_size) {
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    void* grown = realloc(array, item_size * new_capacity);
+    if (!grown) {
+        luaL_error(L, "Failed to grow array: out of memory");
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+// Look up the pending barrier index (1-based) of a resource in the current batch; 0 if none.
+static int tracker_pending(lua_State* L, int resource_idx) {
+    lua_getiuservalue(L, 1, 1);
+    lua_pushvalue(L, resource_idx);
+    lua_rawget(L, -2);
+    int index = (int)lua_tointeger(L, -1);
+    lua_pop(L, 2);
+    return index;
+}
+
+static void tracker_set_pending(lua_State* L, int resource_idx, int index) {
+    lua_getiuservalue(L, 1, 1);
+    lua_pushvalue(L, resource_idx);
+    lua_pushinteger(L, index);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+// Read the optional stage/access arguments of a use, defaulting from the layout.
+static void tracker_use_masks(lua_State* L, int idx, VkImageLayout layout, VkPipelineStageFlags* stage, VkAccessFlags* access) {
+    if (lua_isnoneornil(L, idx)) {
+        vulkan_layout_sync(layout, 1, stage, access);
+    } else {
+        *stage = (VkPipelineStageFlags)luaL_checkinteger(L, idx);
+        *access = (VkAccessFlags)luaL_optinteger(L, idx + 1, 0);
+    }
+}
+
+// Create barrier tracker: vulkan.create_barrier_tracker()
+static int l_vulkan_create_barrier_tracker(lua_State* L) {
+    lua_VkBarrierTracker* t = (lua_VkBarrierTracker*)lua_newuserdatauv(L, sizeof(lua_VkBarrierTracker), 1);
+    memset(t, 0, sizeof(lua_VkBarrierTracker));
+    luaL_setmetatable(L, BARRIER_TRACKER_MT);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 1); // resource userdata -> pending barrier index
+    return 1;
+}
+
+// Declare an image use: vulkan.tracker_use_image(tracker, image, layout, [stage], [access])
+// stage/access default to what the layout implies. Queues a barrier only when the use needs one:
+// a layout change, a write after any earlier use, or a read the last write is not yet visible to.
+// Reads after reads of visible data are free.
+static int l_vulkan_tracker_use_image(lua_State* L) {
+    lua_VkBarrierTracker* t = lua_check_VkBarrierTracker(L, 1);
+    lua_VkImage* img = lua_check_VkImage(L, 2);
+    VkImageLayout layout = (VkImageLayout)luaL_checkinteger(L, 3);
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    tracker_use_masks(L, 4, layout, &stage, &access);
+
+    int pending = tracker_pending(L, 2);
+    if (pending) {
+        // Already transitioned in this batch: widen the same barrier
+        VkImageMemoryBarrier* b = &t->image_barriers[pending - 1];
+        if (b->newLayout != layout) {
+            luaL_error(L, "Image already has a pending transition to layout %d; flush the tracker first", (int)b->newLayout);
+        }
+        b->dstAccessMask |= access;
+        t->dst_stage |= stage;
+        vulkan_sync_barrier(&img->sync, img->sync.stage | stage, img->sync.access | access, b->oldLayout != b->newLayout);
+        return 0;
+    }
+
+    if (layout == img->layout && !vulkan_sync_hazard(&img->sync, stage, access)) {
+        vulkan_sync_merge(&img->sync, stage, access);
+        t->skipped++;
+        return 0;
+    }
+
+    if (t->image_count == t->image_capacity) {
+        t->image_barriers = (VkImageMemoryBarrier*)tracker_grow(L, t->image_barriers, &t->image_capacity, sizeof(VkImageMemoryBarrier));
+    }
+    VkImageMemoryBarrier* b = &t->image_barriers[t->image_count++];
+    memset(b, 0, sizeof(*b));
+    b->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    VkPipelineStageFlags src_stage;
+    vulkan_sync_source(&img->sync, &src_stage, &b->srcAccessMask);
+    b->dstAccessMask = access;
+    b->oldLayout = img->layout;
+    b->newLayout = layout;
+    b->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b->image = img->image;
+    b->subresourceRange.aspectMask = img->aspect;
+    b->subresourceRange.levelCount = img->mip_levels;
+    b->subresourceRange.layerCount = img->array_layers;
+    t->src_stage |= src_stage;
+    t->dst_stage |= stage;
+    tracker_set_pending(L, 2, t->image_count);
+
+    vulkan_sync_barrier(&img->sync, stage, access, b->oldLayout != b->newLayout);
+    img->layout = layout;
+    return 0;
+}
+
+// Declare a buffer use: vulkan.tracker_use_buffer(tracker, buffer, stage, access)
+static int l_vulkan_tracker_use_buffer(lua_State* L) {
+    lua_VkBarrierTracker* t = lua_check_VkBarrierTracker(L, 1);
+    lua_VkBuffer* buf = lua_check_VkBuffer(L, 2);
+    VkPipelineStageFlags stage = (VkPipelineStageFlags)luaL_checkinteger(L, 3);
+    VkAccessFlags access = (VkAccessFlags)luaL_checkinteger(L, 4);
+
+    int pending = tracker_pending(L, 2);
+    if (pending) {
+        t->buffer_barriers[pending - 1].dstAccessMask |= access;
+        t->dst_stage |= stage;
+        vulkan_sync_barrier(&buf->sync, buf->sync.stage | stage, buf->sync.access | access, 0);
+        return 0;
+    }
+
+    if (!vulkan_sync_hazard(&buf->sync, stage, access)) {
+        vulkan_sync_merge(&buf->sync, stage, access);
+        t->skipped++;
+        return 0;
+    }
+
+    if (t->buffer_count == t->buffer_capacity) {
+        t->buffer_barriers = (VkBufferMemoryBarrier*)tracker_grow(L, t->buffer_barriers, &t->buffer_capacity, sizeof(VkBufferMemoryBarrier));
+    }
+    VkBufferMemoryBarrier* b = &t->buffer_barriers[t->buffer_count++];
+    memset(b, 0, sizeof(*b));
+    b->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    VkPipelineStageFlags src_stage;
+    vulkan_sync_source(&buf->sync, &src_stage, &b->srcAccessMask);
+    b->dstAccessMask = access;
+    b->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b->buffer = buf->buffer;
+    b->size = VK_WHOLE_SIZE;
+    t->src_stage |= src_stage;
+    t->dst_stage |= stage;
+    tracker_set_pending(L, 2, t->buffer_count);
+
+    vulkan_sync_barrier(&buf->sync, stage, access, 0);
+    return 0;
+}
+
+// Record the queued barriers: vulkan.tracker_flush(tracker, command_buffer) -> barrier count
+// Emits a single vkCmdPipelineBarrier for everything declared since the last flush; call it right
+// before recording the commands that perform those uses.
+static int l_vulkan_tracker_flush(lua_State* L) {
+    lua_VkBarrierTracker* t = lua_check_VkBarrierTracker(L, 1);
+    lua_VkCommandBuffer* cmd_ud = lua_check_VkCommandBuffer(L, 2);
+    int count = t->image_count + t->buffer_count;
+    if (count == 0) {
+        lua_pushinteger(L, 0);
+        return 1;
+    }
+
+    vkCmdPipelineBarrier(cmd_ud->command_buffer, t->src_stage, t->dst_stage, 0, 0, NULL,
+                         (uint32_t)t->buffer_count, t->buffer_barriers, (uint32_t)t->image_count, t->image_barriers);
+    t->flushes++;
+    t->barriers += count;
+    t->image_count = 0;
+    t->buffer_count = 0;
+    t->src_stage = 0;
+    t->dst_stage = 0;
+    lua_newtable(L);
+    lua_setiuservalue(L, 1, 1);
+
+    lua_pushinteger(L, count);
+    return 1;
+}
+
+// Tracker statistics: vulkan.tracker_stats(tracker) -> {flushes, barriers, skipped, pending}
+static int l_vulkan_tracker_stats(lua_State* L) {
+    lua_VkBarrierTracker* t = lua_check_VkBarrierTracker(L, 1);
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, t->flushes);
+    lua_setfield(L, -2, "flushes");
+    lua_pushinteger(L, t->barriers);
+    lua_setfield(L, -2, "barriers");
+    lua_pushinteger(L, t->skipped);
+    lua_setfield(L, -2, "skipped");
+    lua_pushinteger(L, t->image_count + t->buffer_count);
+    lua_setfield(L, -2, "pending");
+    return 1;
+}
+
+static void barrier_tracker_metatable(lua_State* L) {
+    luaL_newmetatable(L, BARRIER_TRACKER_MT);
+    lua_pushcfunction(L, barrier_tracker_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// swapchain manager
+//===============================================
+// Uservalues: 1 = keep-alive table (physical device, device, surface, render pass),
+// 2 = image view userdata, 3 = framebuffer userdata of the current swapchain.
+#define SWAPCHAIN_MANAGER_UV_KEEP 1
+#define SWAPCHAIN_MANAGER_UV_VIEWS 2
+#define SWAPCHAIN_MANAGER_UV_FRAMEBUFFERS 3
+
+lua_VkSwapchainManager* lua_check_VkSwapchainManager(lua_State* L, int idx) {
+    lua_VkSwapchainManager* m = (lua_VkSwapchainManager*)luaL_checkudata(L, idx, SWAPCHAIN_MANAGER_MT);
+    if (!m->device) {
+        luaL_error(L, "Invalid swapchain manager (already destroyed)");
+    }
+    return m;
+}
+
+// Destroy now, or queue on the device's deletion queue until the current frame has finished.
+static void swapchain_release(VkDevice device, vulkan_deletion* e, int deferred) {
+    if (deferred) vulkan_release(device, e);
+    else deletion_destroy(device, e);
+}
+
+// Retire the current swapchain's resources. Their Lua handles are invalidated right away so scripts
+// cannot record with them. With a deletion queue on the device the Vulkan objects wait there for the
+// frame they were replaced in; without one (or when immediate is set, after the caller waited for
+// the device) they are destroyed once the device is idle.
+static void swapchain_retire(lua_VkSwapchainManager* m, int immediate) {
+    for (uint32_t i = 0; i < m->image_count; i++) {
+        // A handle already destroyed through its userdata (__gc at lua_close) is not destroyed twice
+        if (m->view_uds && m->view_uds[i]) {
+            if (!m->view_uds[i]->image_view) m->views[i] = VK_NULL_HANDLE;
+            m->view_uds[i]->image_view = VK_NULL_HANDLE;
+            m->view_uds[i]->device = VK_NULL_HANDLE;
+        }
+        if (m->framebuffer_uds && m->framebuffer_uds[i]) {
+            if (!m->framebuffer_uds[i]->framebuffer) m->framebuffers[i] = VK_NULL_HANDLE;
+            m->framebuffer_uds[i]->framebuffer = VK_NULL_HANDLE;
+            m->framebuffer_uds[i]->device = VK_NULL_HANDLE;
+        }
+    }
+    free(m->view_uds);
+    free(m->framebuffer_uds);
+    free(m->images);
+    m->view_uds = NULL;
+    m->framebuffer_uds = NULL;
+    m->images = NULL;
+
+    int deferred = !immediate && deletion_queue_for(m->device) != NULL;
+    if (!deferred && !immediate && (m->swapchain || m->views)) {
+        vkDeviceWaitIdle(m->device);
+    }
+    for (uint32_t i = 0; i < m->image_count; i++) {
+        if (m->framebuffers && m->framebuffers[i]) {
+            swapchain_release(m->device, &(vulkan_deletion){VULKAN_DELETE_FRAMEBUFFER, .handle.framebuffer = m->framebuffers[i]}, deferred);
+        }
+        if (m->views && m->views[i]) {
+            swapchain_release(m->device, &(vulkan_deletion){VULKAN_DELETE_IMAGE_VIEW, .handle.image_view = m->views[i]}, deferred);
+        }
+    }
+    if (m->swapchain) {
+        swapchain_release(m->device, &(vulkan_deletion){VULKAN_DELETE_SWAPCHAIN, .handle.swapchain = m->swapchain}, deferred);
+    }
+    free(m->views);
+    free(m->framebuffers);
+    m->swapchain = VK_NULL_HANDLE;
+    m->views = NULL;
+    m->framebuffers = NULL;
+    m->image_count = 0;
+}
+
+// Swapchain extent for the surface, or 0x0 while the window is minimized.
+static VkExtent2D swapchain_extent(const lua_VkSwapchainManager* m, const VkSurfaceCapabilitiesKHR* caps) {
+    if (caps->currentExtent.width != UINT32_MAX) {
+        return caps->currentExtent;
+    }
+    VkExtent2D extent = m->requested_extent;
+    if (extent.width < caps->minImageExtent.width) extent.width = caps->minImageExtent.width;
+    if (extent.height < caps->minImageExtent.height) extent.height = caps->minImageExtent.height;
+    if (extent.width > caps->maxImageExtent.width) extent.width = caps->maxImageExtent.width;
+    if (extent.height > caps->maxImageExtent.height) extent.height = caps->maxImageExtent.height;
+    return extent;
+}
+
+// (Re)create the swapchain from the old one, then its views and framebuffers. Returns 0 when the
+// surface has no area (minimized window); the manager stays dirty and retries on the next acquire.
+static int swapchain_build(lua_State* L, lua_VkSwapchainManager* m, int manager_idx) {
+    VkSurfaceCapabilitiesKHR caps;
+    VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m->physical_device, m->surface, &caps);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to get surface capabilities: VkResult %d", result);
+    }
+    VkExtent2D extent = swapchain_extent(m, &caps);
+    if (extent.width == 0 || extent.height == 0) {
+        m->dirty = 1;
+        return 0;
+    }
+    uint32_t image_count = m->min_image_count > caps.minImageCount ? m->min_image_count : caps.minImageCount;
+    if (caps.maxImageCount > 0 && image_count > caps.maxImageCount) {
+        image_count = caps.maxImageCount;
+    }
+
+    VkSwapchainCreateInfoKHR create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    create_info.surface = m->surface;
+    create_info.minImageCount = image_count;
+    create_info.imageFormat = m->surface_format.format;
+    create_info.imageColorSpace = m->surface_format.colorSpace;
+    create_info.imageExtent = extent;
+    create_info.imageArrayLayers = 1;
+    create_info.imageUsage = m->usage;
+    create_info.imageSharingMode = m->queue_family_count > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    create_info.queueFamilyIndexCount = m->queue_family_count > 1 ? m->queue_family_count : 0;
+    create_info.pQueueFamilyIndices = m->queue_family_indices;
+    create_info.preTransform = caps.currentTransform;
+    create_info.compositeAlpha = m->composite_alpha;
+    create_info.presentMode = m->present_mode;
+    create_info.clipped = VK_TRUE;
+    create_info.oldSwapchain = m->swapchain; // Lets the driver hand over images without a gap
+
+    VkSwapchainKHR swapchain;
+    result = vkCreateSwapchainKHR(m->device, &create_info, NULL, &swapchain);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create swapchain: VkResult %d", result);
+    }
+    swapchain_retire(m, 0);
+    m->swapchain = swapchain;
+    m->extent = extent;
+    m->generation++;
+
+    uint32_t count = 0;
+    vkGetSwapchainImagesKHR(m->device, swapchain, &count, NULL);
+    m->images = (VkImage*)calloc(count, sizeof(VkImage));
+    m->views = (VkImageView*)calloc(count, sizeof(VkImageView));
+    m->framebuffers = m->render_pass ? (VkFramebuffer*)calloc(count, sizeof(VkFramebuffer)) : NULL;
+    m->view_uds = (lua_VkImageView**)calloc(count, sizeof(lua_VkImageView*));
+    m->framebuffer_uds = m->render_pass ? (lua_VkFramebuffer**)calloc(count, sizeof(lua_VkFramebuffer*)) : NULL;
+    if (!m->images || !m->views || !m->view_uds || (m->render_pass && (!m->framebuffers || !m->framebuffer_uds))) {
+        m->dirty = 1;
+        luaL_error(L, "Failed to allocate memory for swapchain images");
+    }
+    m->image_count = count; // Set before creating views so a failure below is cleaned up on retirement
+    vkGetSwapchainImagesKHR(m->device, swapchain, &count, m->images);
+
+    for (uint32_t i = 0; i < count; i++) {
+        VkImageViewCreateInfo view_info = {0};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = m->images[i];
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = m->surface_format.format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        result = vkCreateImageView(m->device, &view_info, NULL, &m->views[i]);
+        if (result != VK_SUCCESS) {
+            m->dirty = 1;
+            luaL_error(L, "Failed to create swapchain image view: VkResult %d", result);
+        }
+        if (m->render_pass) {
+            VkFramebufferCreateInfo fb_info = {0};
+            fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            fb_info.renderPass = m->render_pass;
+            fb_info.attachmentCount = 1;
+            fb_info.pAttachments = &m->views[i];
+            fb_info.width = extent.width;
+            fb_info.height = extent.height;
+            fb_info.layers = 1;
+            result = vkCreateFramebuffer(m->device, &fb_info, NULL, &m->framebuffers[i]);
+            if (result != VK_SUCCESS) {
+                m->dirty = 1;
+                luaL_error(L, "Failed to create swapchain framebuffer: VkResult %d", result);
+            }
+        }
+    }
+
+    // Lua handles; their __gc leaves destruction to the manager (device is NULLed on retirement)
+    lua_createtable(L, (int)count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        lua_push_VkImageView(L, m->views[i], m->device);
+        m->view_uds[i] = (lua_VkImageView*)lua_touserdata(L, -1);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setiuservalue(L, manager_idx, SWAPCHAIN_MANAGER_UV_VIEWS);
+    lua_createtable(L, m->render_pass ? (int)count : 0, 0);
+    for (uint32_t i = 0; m->render_pass && i < count; i++) {
+        lua_push_VkFramebuffer(L, m->framebuffers[i], m->device);
+        m->framebuffer_uds[i] = (lua_VkFramebuffer*)lua_touserdata(L, -1);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setiuservalue(L, manager_idx, SWAPCHAIN_MANAGER_UV_FRAMEBUFFERS);
+    m->dirty = 0;
+    return 1;
+}
+
+// Pick the requested surface format if the surface supports it, else the first one offered.
+static VkSurfaceFormatKHR choose_surface_format(lua_State* L, VkPhysicalDevice physical_device, VkSurfaceKHR surface,
+                                                VkFormat format, VkColorSpaceKHR color_space) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &count, NULL);
+    if (count == 0) {
+        luaL_error(L, "Surface reports no formats");
+    }
+    VkSurfaceFormatKHR* formats = (VkSurfaceFormatKHR*)lua_newuserdata(L, count * sizeof(VkSurfaceFormatKHR));
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &count, formats);
+    VkSurfaceFormatKHR chosen = formats[0];
+    for (uint32_t i = 0; i < count; i++) {
+        if (formats[i].format == format && formats[i].colorSpace == color_space) {
+            chosen = formats[i];
+            break;
+        }
+    }
+    lua_pop(L, 1);
+    return chosen;
+}
+
+// Use the requested present mode if supported; FIFO is always available.
+static VkPresentModeKHR choose_present_mode(lua_State* L, VkPhysicalDevice physical_device, VkSurfaceKHR surface,
+                                            VkPresentModeKHR mode) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &count, NULL);
+    if (count == 0) return VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentModeKHR* modes = (VkPresentModeKHR*)lua_newuserdata(L, count * sizeof(VkPresentModeKHR));
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &count, modes);
+    VkPresentModeKHR chosen = VK_PRESENT_MODE_FIFO_KHR;
+    for (uint32_t i = 0; i < count; i++) {
+        if (modes[i] == mode) {
+            chosen = mode;
+            break;
+        }
+    }
+    lua_pop(L, 1);
+    return chosen;
+}
+
+// Create swapchain manager: vulkan.create_swapchain_manager(physical_device, device, surface, {width, height,
+//     [format], [color_space], [present_mode], [image_count], [usage], [render_pass], [queue_families]})
+// width/height is the window size (used when the surface does not dictate one). render_pass gets one
+// framebuffer per image; leave it out for dynamic rendering. queue_families = {graphics, present}
+// selects concurrent sharing when the two differ. Replaced swapchains go through the device's
+// deletion queue (vulkan.create_deletion_queue), so create one first to avoid an idle wait on resize.
+static int l_vulkan_create_swapchain_manager(lua_State* L) {
+    lua_VkPhysicalDevice* physical_device_ud = lua_check_VkPhysicalDevice(L, 1);
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 2);
+    lua_VkSurfaceKHR* surface_ud = lua_check_VkSurfaceKHR(L, 3);
+    luaL_checktype(L, 4, LUA_TTABLE);
+
+    VkSurfaceFormatKHR surface_format = choose_surface_format(L, physical_device_ud->physical_device, surface_ud->surface,
+        (VkFormat)opt_integer_field(L, 4, "format", VK_FORMAT_B8G8R8A8_SRGB),
+        (VkColorSpaceKHR)opt_integer_field(L, 4, "color_space", VK_COLOR_SPACE_SRGB_NONLINEAR_KHR));
+    VkPresentModeKHR present_mode = choose_present_mode(L, physical_device_ud->physical_device, surface_ud->surface,
+        (VkPresentModeKHR)opt_integer_field(L, 4, "present_mode", VK_PRESENT_MODE_FIFO_KHR));
+
+    lua_VkSwapchainManager* m = (lua_VkSwapchainManager*)lua_newuserdatauv(L, sizeof(lua_VkSwapchainManager), 3);
+    memset(m, 0, sizeof(lua_VkSwapchainManager));
+    luaL_setmetatable(L, SWAPCHAIN_MANAGER_MT);
+    int manager_idx = lua_gettop(L);
+    m->physical_device = physical_device_ud->physical_device;
+    m->device = device_ud->device;
+    m->device_ud = device_ud;
+    m->surface = surface_ud->surface;
+    m->surface_format = surface_format;
+    m->present_mode = present_mode;
+    m->requested_extent.width = (uint32_t)lua_getfield_integer(L, 4, "width");
+    m->requested_extent.height = (uint32_t)lua_getfield_integer(L, 4, "height");
+    m->min_image_count = (uint32_t)opt_integer_field(L, 4, "image_count", present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2);
+    m->usage = (VkImageUsageFlags)opt_integer_field(L, 4, "usage", VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+
+    VkSurfaceCapabilitiesKHR caps;
+    VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m->physical_device, m->surface, &caps);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to get surface capabilities: VkResult %d", result);
+    }
+    m->composite_alpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    if (!(caps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR)) {
+        for (uint32_t bit = 1; bit <= VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR; bit <<= 1) {
+            if (caps.supportedCompositeAlpha & bit) {
+                m->composite_alpha = (VkCompositeAlphaFlagBitsKHR)bit;
+                break;
+            }
+        }
+    }
+
+    lua_createtable(L, 4, 0);
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, 1);
+    lua_pushvalue(L, 2);
+    lua_rawseti(L, -2, 2);
+    lua_pushvalue(L, 3);
+    lua_rawseti(L, -2, 3);
+    lua_getfield(L, 4, "render_pass");
+    if (!lua_isnil(L, -1)) {
+        m->render_pass = lua_check_VkRenderPass(L, -1)->render_pass;
+    }
+    lua_rawseti(L, -2, 4);
+    lua_setiuservalue(L, manager_idx, SWAPCHAIN_MANAGER_UV_KEEP);
+
+    lua_getfield(L, 4, "queue_families");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        for (int i = 1; i <= 2 && i <= (int)lua_rawlen(L, -1); i++) {
+            lua_rawgeti(L, -1, i);
+            uint32_t family = (uint32_t)luaL_checkinteger(L, -1);
+            lua_pop(L, 1);
+            if (m->queue_family_count == 0 || m->queue_family_indices[0] != family) {
+                m->queue_family_indices[m->queue_family_count++] = family;
+            }
+        }
+    }
+    lua_pop(L, 1);
+
+    swapchain_build(L, m, manager_idx); // A minimized window is built on the first acquire
+    return 1;
+}
+
+// Acquire: vulkan.swapchain_acquire(manager, semaphore, [timeout]) -> image_index or nil, recreated
+// image_index is 0-based. Out of date swapchains are recreated and the acquire retried; nil means
+// the window is minimized (or the timeout expired) and the frame should be skipped. recreated is
+// true when the images, views and framebuffers changed since the last call.
+static int l_vulkan_swapchain_acquire(lua_State* L) {
+    lua_VkSwapchainManager* m = lua_check_VkSwapchainManager(L, 1);
+    lua_VkSemaphore* semaphore_ud = lua_check_VkSemaphore(L, 2);
+    uint64_t timeout = opt_timeout(L, 3);
+
+    int recreated = 0;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (m->dirty || !m->swapchain) {
+            if (!swapchain_build(L, m, 1)) break;
+            recreated = 1;
+        }
+        uint32_t image_index;
+        VkResult result = vkAcquireNextImageKHR(m->device, m->swapchain, timeout, semaphore_ud->semaphore,
+                                                VK_NULL_HANDLE, &image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            m->dirty = 1;
+            continue;
+        }
+        if (result == VK_TIMEOUT || result == VK_NOT_READY) break;
+        if (result == VK_SUBOPTIMAL_KHR) {
+            m->dirty = 1; // The image is usable (and the semaphore signalled); recreate next frame
+        } else if (result != VK_SUCCESS) {
+            luaL_error(L, "Failed to acquire next image: VkResult %d", result);
+        }
+        lua_pushinteger(L, image_index);
+        lua_pushboolean(L, recreated);
+        return 2;
+    }
+    lua_pushnil(L);
+    lua_pushboolean(L, recreated);
+    return 2;
+}
+
+// Present: vulkan.swapchain_present(manager, queue, wait_semaphore(s), image_index) -> true or false, error
+// Out of date and suboptimal results mark the swapchain for recreation on the next acquire.
+static int l_vulkan_swapchain_present(lua_State* L) {
+    lua_VkSwapchainManager* m = lua_check_VkSwapchainManager(L, 1);
+    lua_VkQueue* queue_ud = lua_check_VkQueue(L, 2);
+    uint32_t image_index = (uint32_t)luaL_checkinteger(L, 4);
+    if (!m->swapchain || image_index >= m->image_count) {
+        luaL_error(L, "Invalid image index %d", (int)image_index);
+    }
+
+    VkSemaphore wait_semaphores[8];
+    uint32_t wait_count = 0;
+    if (lua_istable(L, 3)) {
+        uint32_t n = (uint32_t)lua_rawlen(L, 3);
+        if (n > 8) {
+            luaL_error(L, "Too many wait semaphores (max 8)");
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            lua_rawgeti(L, 3, i + 1);
+            wait_semaphores[wait_count++] = lua_check_VkSemaphore(L, -1)->semaphore;
+            lua_pop(L, 1);
+        }
+    } else if (!lua_isnil(L, 3)) {
+        wait_semaphores[wait_count++] = lua_check_VkSemaphore(L, 3)->semaphore;
+    }
+
+    VkPresentInfoKHR present_info = {0};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = wait_count;
+    present_info.pWaitSemaphores = wait_semaphores;
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &m->swapchain;
+    present_info.pImageIndices = &image_index;
+    VkResult result = vkQueuePresentKHR(queue_ud->queue, &present_info);
+    m->frame++;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        m->dirty = 1;
+    } else if (result != VK_SUCCESS) {
+        lua_pushboolean(L, 0);
+        lua_pushfstring(L, "Failed to present queue: VkResult %d", result);
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
 
-        lua_getfield(L, -1, "layer_count");
-        create_info.subresourceRange.layerCount = (uint32_t)luaL_checkinteger(L, -1);
+// Resize: vulkan.swapchain_resize(manager, width, height)
+// Records the new window size; the swapchain is recreated on the next acquire.
+static int l_vulkan_swapchain_resize(lua_State* L) {
+    lua_VkSwapchainManager* m = lua_check_VkSwapchainManager(L, 1);
+    m->requested_extent.width = (uint32_t)luaL_checkinteger(L, 2);
+    m->requested_extent.height = (uint32_t)luaL_checkinteger(L, 3);
+    if (m->requested_extent.width != m->extent.width || m->requested_extent.height != m->extent.height) {
+        m->dirty = 1;
+    }
+    return 0;
+}
+
+// Images: vulkan.swapchain_images(manager) -> images, image_views, framebuffers
+// images are swapchain image handles (as from get_swapchain_images_KHR); views and framebuffers are
+// owned by the manager and become invalid when the swapchain is recreated. framebuffers is empty
+// without a render_pass.
+static int l_vulkan_swapchain_images(lua_State* L) {
+    lua_VkSwapchainManager* m = lua_check_VkSwapchainManager(L, 1);
+    lua_createtable(L, (int)m->image_count, 0);
+    for (uint32_t i = 0; i < m->image_count && m->images; i++) {
+        lua_pushlightuserdata(L, (void*)m->images[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    for (int slot = SWAPCHAIN_MANAGER_UV_VIEWS; slot <= SWAPCHAIN_MANAGER_UV_FRAMEBUFFERS; slot++) {
+        // Copies, so scripts cannot reorder the manager's tables
+        lua_newtable(L);
+        if (lua_getiuservalue(L, 1, slot) == LUA_TTABLE) {
+            int n = (int)lua_rawlen(L, -1);
+            for (int i = 1; i <= n; i++) {
+                lua_rawgeti(L, -1, i);
+                lua_rawseti(L, -3, i);
+            }
+        }
         lua_pop(L, 1);
-    } else {
-        luaL_error(L, "subresource_range must be a table");
     }
-    lua_pop(L, 1);
+    return 3;
+}
+
+// Info: vulkan.swapchain_info(manager) -> {width, height, format, color_space, present_mode,
+//     image_count, generation, frame}
+static int l_vulkan_swapchain_info(lua_State* L) {
+    lua_VkSwapchainManager* m = lua_check_VkSwapchainManager(L, 1);
+    lua_createtable(L, 0, 8);
+    lua_pushinteger(L, m->extent.width);
+    lua_setfield(L, -2, "width");
+    lua_pushinteger(L, m->extent.height);
+    lua_setfield(L, -2, "height");
+    lua_pushinteger(L, m->surface_format.format);
+    lua_setfield(L, -2, "format");
+    lua_pushinteger(L, m->surface_format.colorSpace);
+    lua_setfield(L, -2, "color_space");
+    lua_pushinteger(L, m->present_mode);
+    lua_setfield(L, -2, "present_mode");
+    lua_pushinteger(L, m->image_count);
+    lua_setfield(L, -2, "image_count");
+    lua_pushinteger(L, m->generation);
+    lua_setfield(L, -2, "generation");
+    lua_pushinteger(L, (lua_Integer)m->frame);
+    lua_setfield(L, -2, "frame");
+    return 1;
+}
 
-    VkImageView image_view;
-    VkResult result = vkCreateImageView(device_ud->device, &create_info, NULL, &image_view);
-    if (result != VK_SUCCESS) {
-        luaL_error(L, "Failed to create image view: VkResult %d", result);
+static int swapchain_manager_gc(lua_State* L) {
+    lua_VkSwapchainManager* m = (lua_VkSwapchainManager*)luaL_checkudata(L, 1, SWAPCHAIN_MANAGER_MT);
+    if (m->device && m->device_ud->device) {
+        vkDeviceWaitIdle(m->device);
+        swapchain_retire(m, 1);
     }
+    m->device = VK_NULL_HANDLE;
+    return 0;
+}
 
-    lua_push_VkImageView(L, image_view, device_ud->device);
-    return 1;
+// Destroy swapchain manager: vulkan.destroy_swapchain_manager(manager)
+// Waits for the device to go idle, then destroys the swapchain, its views and framebuffers. Call it
+// before destroying the device and surface.
+static int l_vulkan_destroy_swapchain_manager(lua_State* L) {
+    lua_check_VkSwapchainManager(L, 1);
+    return swapchain_manager_gc(L);
 }
 
-// Metatable setup
-static void image_view_metatable(lua_State* L) {
-    luaL_newmetatable(L, IMAGE_VIEW_MT);
-    lua_pushcfunction(L, image_view_gc);
+static void swapchain_manager_metatable(lua_State* L) {
+    luaL_newmetatable(L, SWAPCHAIN_MANAGER_MT);
+    lua_pushcfunction(L, swapchain_manager_gc);
     lua_setfield(L, -2, "__gc");
     lua_pop(L, 1);
 }
@@ -1204,7 +3638,7 @@ static void image_view_metatable(lua_State* L) {
 static int render_pass_gc(lua_State* L) {
     lua_VkRenderPass* ud = (lua_VkRenderPass*)luaL_checkudata(L, 1, RENDER_PASS_MT);
     if (ud->render_pass && ud->device) {
-        vkDestroyRenderPass(ud->device, ud->render_pass, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_RENDER_PASS, .handle.render_pass = ud->render_pass});
         ud->render_pass = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1217,6 +3651,7 @@ void lua_push_VkRenderPass(lua_State* L, VkRenderPass render_pass, VkDevice devi
         luaL_error(L, "Cannot create userdata for null VkRenderPass");
     }
     lua_VkRenderPass* ud = (lua_VkRenderPass*)lua_newuserdata(L, sizeof(lua_VkRenderPass));
+    ud->tag = VULKAN_TAG_RENDER_PASS;
     ud->render_pass = render_pass;
     ud->device = device;
     luaL_setmetatable(L, RENDER_PASS_MT);
@@ -1224,7 +3659,7 @@ void lua_push_VkRenderPass(lua_State* L, VkRenderPass render_pass, VkDevice devi
 
 // Check VkRenderPass userdata
 lua_VkRenderPass* lua_check_VkRenderPass(lua_State* L, int idx) {
-    lua_VkRenderPass* ud = (lua_VkRenderPass*)luaL_checkudata(L, idx, RENDER_PASS_MT);
+    lua_VkRenderPass* ud = (lua_VkRenderPass*)check_tag(L, idx, VULKAN_TAG_RENDER_PASS, RENDER_PASS_MT);
     if (!ud->render_pass) {
         luaL_error(L, "Invalid VkRenderPass (already destroyed)");
     }
@@ -1439,7 +3874,7 @@ static void render_pass_metatable(lua_State* L) {
 static int framebuffer_gc(lua_State* L) {
     lua_VkFramebuffer* ud = (lua_VkFramebuffer*)luaL_checkudata(L, 1, FRAMEBUFFER_MT);
     if (ud->framebuffer && ud->device) {
-        vkDestroyFramebuffer(ud->device, ud->framebuffer, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_FRAMEBUFFER, .handle.framebuffer = ud->framebuffer});
         ud->framebuffer = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1452,6 +3887,7 @@ void lua_push_VkFramebuffer(lua_State* L, VkFramebuffer framebuffer, VkDevice de
         luaL_error(L, "Cannot create userdata for null VkFramebuffer");
     }
     lua_VkFramebuffer* ud = (lua_VkFramebuffer*)lua_newuserdata(L, sizeof(lua_VkFramebuffer));
+    ud->tag = VULKAN_TAG_FRAMEBUFFER;
     ud->framebuffer = framebuffer;
     ud->device = device;
     luaL_setmetatable(L, FRAMEBUFFER_MT);
@@ -1459,7 +3895,7 @@ void lua_push_VkFramebuffer(lua_State* L, VkFramebuffer framebuffer, VkDevice de
 
 // Check VkFramebuffer userdata
 lua_VkFramebuffer* lua_check_VkFramebuffer(lua_State* L, int idx) {
-    lua_VkFramebuffer* ud = (lua_VkFramebuffer*)luaL_checkudata(L, idx, FRAMEBUFFER_MT);
+    lua_VkFramebuffer* ud = (lua_VkFramebuffer*)check_tag(L, idx, VULKAN_TAG_FRAMEBUFFER, FRAMEBUFFER_MT);
     if (!ud->framebuffer) {
         luaL_error(L, "Invalid VkFramebuffer (already destroyed)");
     }
@@ -1542,7 +3978,7 @@ static void framebuffer_metatable(lua_State* L) {
 static int shader_module_gc(lua_State* L) {
     lua_VkShaderModule* ud = (lua_VkShaderModule*)luaL_checkudata(L, 1, SHADER_MODULE_MT);
     if (ud->shader_module && ud->device) {
-        vkDestroyShaderModule(ud->device, ud->shader_module, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_SHADER_MODULE, .handle.shader_module = ud->shader_module});
         ud->shader_module = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1553,7 +3989,7 @@ static int shader_module_gc(lua_State* L) {
 static int pipeline_layout_gc(lua_State* L) {
     lua_VkPipelineLayout* ud = (lua_VkPipelineLayout*)luaL_checkudata(L, 1, PIPELINE_LAYOUT_MT);
     if (ud->pipeline_layout && ud->device) {
-        vkDestroyPipelineLayout(ud->device, ud->pipeline_layout, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_PIPELINE_LAYOUT, .handle.pipeline_layout = ud->pipeline_layout});
         ud->pipeline_layout = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1564,7 +4000,7 @@ static int pipeline_layout_gc(lua_State* L) {
 static int pipeline_gc(lua_State* L) {
     lua_VkPipeline* ud = (lua_VkPipeline*)luaL_checkudata(L, 1, PIPELINE_MT);
     if (ud->pipeline && ud->device) {
-        vkDestroyPipeline(ud->device, ud->pipeline, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_PIPELINE, .handle.pipeline = ud->pipeline});
         ud->pipeline = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1600,6 +4036,7 @@ void lua_push_VkPipelineLayout(lua_State* L, VkPipelineLayout pipeline_layout, V
         luaL_error(L, "Cannot create userdata for null VkPipelineLayout");
     }
     lua_VkPipelineLayout* ud = (lua_VkPipelineLayout*)lua_newuserdata(L, sizeof(lua_VkPipelineLayout));
+    ud->tag = VULKAN_TAG_PIPELINE_LAYOUT;
     ud->pipeline_layout = pipeline_layout;
     ud->device = device;
     luaL_setmetatable(L, PIPELINE_LAYOUT_MT);
@@ -1607,7 +4044,7 @@ void lua_push_VkPipelineLayout(lua_State* L, VkPipelineLayout pipeline_layout, V
 
 // Check VkPipelineLayout userdata
 lua_VkPipelineLayout* lua_check_VkPipelineLayout(lua_State* L, int idx) {
-    lua_VkPipelineLayout* ud = (lua_VkPipelineLayout*)luaL_checkudata(L, idx, PIPELINE_LAYOUT_MT);
+    lua_VkPipelineLayout* ud = (lua_VkPipelineLayout*)check_tag(L, idx, VULKAN_TAG_PIPELINE_LAYOUT, PIPELINE_LAYOUT_MT);
     if (!ud->pipeline_layout) {
         luaL_error(L, "Invalid VkPipelineLayout (already destroyed)");
     }
@@ -1623,6 +4060,7 @@ void lua_push_VkPipeline(lua_State* L, VkPipeline pipeline, VkDevice device) {
         luaL_error(L, "Cannot create userdata for null VkPipeline");
     }
     lua_VkPipeline* ud = (lua_VkPipeline*)lua_newuserdata(L, sizeof(lua_VkPipeline));
+    ud->tag = VULKAN_TAG_PIPELINE;
     ud->pipeline = pipeline;
     ud->device = device;
     luaL_setmetatable(L, PIPELINE_MT);
@@ -1630,7 +4068,7 @@ void lua_push_VkPipeline(lua_State* L, VkPipeline pipeline, VkDevice device) {
 
 // Check VkPipeline userdata
 lua_VkPipeline* lua_check_VkPipeline(lua_State* L, int idx) {
-    lua_VkPipeline* ud = (lua_VkPipeline*)luaL_checkudata(L, idx, PIPELINE_MT);
+    lua_VkPipeline* ud = (lua_VkPipeline*)check_tag(L, idx, VULKAN_TAG_PIPELINE, PIPELINE_MT);
     if (!ud->pipeline) {
         luaL_error(L, "Invalid VkPipeline (already destroyed)");
     }
@@ -1730,7 +4168,42 @@ static int l_vulkan_create_pipeline_layout(lua_State* L) {
     return 1;
 }
 
+// Attachment formats of a pipeline used with dynamic rendering, kept until the pipelines are created.
+typedef struct {
+    VkPipelineRenderingCreateInfo info;
+    VkFormat color_formats[VULKAN_MAX_COLOR_ATTACHMENTS];
+    VkPipelineColorBlendAttachmentState blend_attachments[VULKAN_MAX_COLOR_ATTACHMENTS];
+} pipeline_rendering_info;
+
+// Read {color_formats, [depth_format], [stencil_format], [view_mask]} into a VkPipelineRenderingCreateInfo.
+static void read_pipeline_rendering(lua_State* L, int idx, pipeline_rendering_info* rendering) {
+    idx = lua_absindex(L, idx);
+    luaL_checktype(L, idx, LUA_TTABLE);
+    rendering->info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    lua_getfield(L, idx, "color_formats");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        uint32_t count = (uint32_t)lua_rawlen(L, -1);
+        if (count > VULKAN_MAX_COLOR_ATTACHMENTS) {
+            luaL_error(L, "Too many color formats (max %d)", VULKAN_MAX_COLOR_ATTACHMENTS);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            lua_rawgeti(L, -1, i + 1);
+            rendering->color_formats[i] = (VkFormat)luaL_checkinteger(L, -1);
+            lua_pop(L, 1);
+        }
+        rendering->info.colorAttachmentCount = count;
+        rendering->info.pColorAttachmentFormats = rendering->color_formats;
+    }
+    lua_pop(L, 1);
+    rendering->info.depthAttachmentFormat = (VkFormat)opt_integer_field(L, idx, "depth_format", VK_FORMAT_UNDEFINED);
+    rendering->info.stencilAttachmentFormat = (VkFormat)opt_integer_field(L, idx, "stencil_format", VK_FORMAT_UNDEFINED);
+    rendering->info.viewMask = (uint32_t)opt_integer_field(L, idx, "view_mask", 0);
+}
+
 // Create graphics pipeline: vulkan.create_graphics_pipelines(device, {pipelines = {...}})
+// Each pipeline targets either a render_pass/subpass or, for dynamic rendering, the attachment
+// formats given in rendering = {color_formats, [depth_format], [stencil_format], [view_mask]}.
 static int l_vulkan_create_graphics_pipelines(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     luaL_checktype(L, 2, LUA_TTABLE);
@@ -1742,11 +4215,13 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
         luaL_error(L, "No pipelines specified");
     }
 
-    VkGraphicsPipelineCreateInfo* pipeline_infos = (VkGraphicsPipelineCreateInfo*)malloc(pipeline_count * sizeof(VkGraphicsPipelineCreateInfo));
-    if (!pipeline_infos) {
-        luaL_error(L, "Failed to allocate memory for pipeline create infos");
-    }
-    memset(pipeline_infos, 0, pipeline_count * sizeof(VkGraphicsPipelineCreateInfo));
+    // Scratch arrays live in userdata below the pipelines table, so argument errors raised
+    // while reading the descriptions do not leak them.
+    VkGraphicsPipelineCreateInfo* pipeline_infos = (VkGraphicsPipelineCreateInfo*)lua_newuserdatauv(L,
+        pipeline_count * (sizeof(VkGraphicsPipelineCreateInfo) + sizeof(pipeline_rendering_info)), 0);
+    memset(pipeline_infos, 0, pipeline_count * (sizeof(VkGraphicsPipelineCreateInfo) + sizeof(pipeline_rendering_info)));
+    pipeline_rendering_info* rendering_infos = (pipeline_rendering_info*)(pipeline_infos + pipeline_count);
+    lua_insert(L, -2);
 
     // Count total shader stages across all pipelines
     uint32_t total_shader_stages = 0;
@@ -1758,15 +4233,10 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
         lua_pop(L, 2); // Pop stages and pipeline
     }
 
-    VkPipelineShaderStageCreateInfo* shader_stages = NULL;
-    if (total_shader_stages > 0) {
-        shader_stages = (VkPipelineShaderStageCreateInfo*)malloc(total_shader_stages * sizeof(VkPipelineShaderStageCreateInfo));
-        if (!shader_stages) {
-            free(pipeline_infos);
-            luaL_error(L, "Failed to allocate memory for shader stages");
-        }
-        memset(shader_stages, 0, total_shader_stages * sizeof(VkPipelineShaderStageCreateInfo));
-    }
+    VkPipelineShaderStageCreateInfo* shader_stages = (VkPipelineShaderStageCreateInfo*)lua_newuserdatauv(L,
+        (total_shader_stages ? total_shader_stages : 1) * sizeof(VkPipelineShaderStageCreateInfo), 0);
+    memset(shader_stages, 0, (total_shader_stages ? total_shader_stages : 1) * sizeof(VkPipelineShaderStageCreateInfo));
+    lua_insert(L, -2);
 
     uint32_t stage_index = 0;
     for (uint32_t i = 1; i <= pipeline_count; i++) {
@@ -1801,10 +4271,20 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
         }
         lua_pop(L, 1); // Pop stages
 
-        // Get render pass
+        // Get render pass, or the attachment formats for dynamic rendering
+        pipeline_rendering_info* rendering = NULL;
+        lua_getfield(L, -1, "rendering");
+        if (!lua_isnil(L, -1)) {
+            rendering = &rendering_infos[i-1];
+            read_pipeline_rendering(L, -1, rendering);
+            pipeline_infos[i-1].pNext = &rendering->info;
+        }
+        lua_pop(L, 1);
         lua_getfield(L, -1, "render_pass");
-        lua_VkRenderPass* render_pass_ud = lua_check_VkRenderPass(L, -1);
-        pipeline_infos[i-1].renderPass = render_pass_ud->render_pass;
+        if (!rendering || !lua_isnil(L, -1)) {
+            lua_VkRenderPass* render_pass_ud = lua_check_VkRenderPass(L, -1);
+            pipeline_infos[i-1].renderPass = render_pass_ud->render_pass;
+        }
         lua_pop(L, 1);
 
         // Get pipeline layout
@@ -1815,7 +4295,7 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
 
         // Get subpass
         lua_getfield(L, -1, "subpass");
-        pipeline_infos[i-1].subpass = luaL_checkinteger(L, -1);
+        pipeline_infos[i-1].subpass = rendering ? luaL_optinteger(L, -1, 0) : luaL_checkinteger(L, -1);
         lua_pop(L, 1);
 
         // Set up minimal pipeline state
@@ -1856,6 +4336,14 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
         color_blending.logicOpEnable = VK_FALSE;
         color_blending.attachmentCount = 1;
         color_blending.pAttachments = &color_blend_attachment;
+        if (rendering) {
+            // One blend state per color attachment format
+            for (uint32_t j = 0; j < rendering->info.colorAttachmentCount; j++) {
+                rendering->blend_attachments[j] = color_blend_attachment;
+            }
+            color_blending.attachmentCount = rendering->info.colorAttachmentCount;
+            color_blending.pAttachments = rendering->blend_attachments;
+        }
 
         VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
         VkPipelineDynamicStateCreateInfo dynamic_state = {0};
@@ -1875,18 +4363,9 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
     }
     lua_pop(L, 1); // Pop pipelines table
 
-    VkPipeline* pipelines = (VkPipeline*)malloc(pipeline_count * sizeof(VkPipeline));
-    if (!pipelines) {
-        free(shader_stages);
-        free(pipeline_infos);
-        luaL_error(L, "Failed to allocate memory for pipelines");
-    }
-
+    VkPipeline* pipelines = (VkPipeline*)lua_newuserdatauv(L, pipeline_count * sizeof(VkPipeline), 0);
     VkResult result = vkCreateGraphicsPipelines(device_ud->device, VK_NULL_HANDLE, pipeline_count, pipeline_infos, NULL, pipelines);
     if (result != VK_SUCCESS) {
-        free(pipelines);
-        free(shader_stages);
-        free(pipeline_infos);
         luaL_error(L, "Failed to create graphics pipelines: VkResult %d", result);
     }
 
@@ -1895,10 +4374,6 @@ static int l_vulkan_create_graphics_pipelines(lua_State* L) {
         lua_push_VkPipeline(L, pipelines[i], device_ud->device);
         lua_rawseti(L, -2, i + 1);
     }
-    free(pipelines);
-    free(shader_stages);
-    free(pipeline_infos);
-
     return 1;
 }
 
@@ -1932,7 +4407,7 @@ static void pipeline_metatable(lua_State* L) {
 static int semaphore_gc(lua_State* L) {
     lua_VkSemaphore* ud = (lua_VkSemaphore*)luaL_checkudata(L, 1, SEMAPHORE_MT);
     if (ud->semaphore && ud->device) {
-        vkDestroySemaphore(ud->device, ud->semaphore, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_SEMAPHORE, .handle.semaphore = ud->semaphore});
         ud->semaphore = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1943,7 +4418,7 @@ static int semaphore_gc(lua_State* L) {
 static int fence_gc(lua_State* L) {
     lua_VkFence* ud = (lua_VkFence*)luaL_checkudata(L, 1, FENCE_MT);
     if (ud->fence && ud->device) {
-        vkDestroyFence(ud->device, ud->fence, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_FENCE, .handle.fence = ud->fence});
         ud->fence = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1954,7 +4429,7 @@ static int fence_gc(lua_State* L) {
 static int command_pool_gc(lua_State* L) {
     lua_VkCommandPool* ud = (lua_VkCommandPool*)luaL_checkudata(L, 1, COMMAND_POOL_MT);
     if (ud->command_pool && ud->device) {
-        vkDestroyCommandPool(ud->device, ud->command_pool, NULL);
+        vulkan_release(ud->device, &(vulkan_deletion){VULKAN_DELETE_COMMAND_POOL, .handle.command_pool = ud->command_pool});
         ud->command_pool = VK_NULL_HANDLE;
         ud->device = VK_NULL_HANDLE;
     }
@@ -1976,6 +4451,7 @@ void lua_push_VkSemaphore(lua_State* L, VkSemaphore semaphore, VkDevice device)
         luaL_error(L, "Cannot create userdata for null VkSemaphore");
     }
     lua_VkSemaphore* ud = (lua_VkSemaphore*)lua_newuserdata(L, sizeof(lua_VkSemaphore));
+    ud->tag = VULKAN_TAG_SEMAPHORE;
     ud->semaphore = semaphore;
     ud->device = device;
     luaL_setmetatable(L, SEMAPHORE_MT);
@@ -1983,7 +4459,7 @@ void lua_push_VkSemaphore(lua_State* L, VkSemaphore semaphore, VkDevice device)
 
 // Check VkSemaphore userdata
 lua_VkSemaphore* lua_check_VkSemaphore(lua_State* L, int idx) {
-    lua_VkSemaphore* ud = (lua_VkSemaphore*)luaL_checkudata(L, idx, SEMAPHORE_MT);
+    lua_VkSemaphore* ud = (lua_VkSemaphore*)check_tag(L, idx, VULKAN_TAG_SEMAPHORE, SEMAPHORE_MT);
     if (!ud->semaphore) {
         luaL_error(L, "Invalid VkSemaphore (already destroyed)");
     }
@@ -1999,6 +4475,7 @@ void lua_push_VkFence(lua_State* L, VkFence fence, VkDevice device) {
         luaL_error(L, "Cannot create userdata for null VkFence");
     }
     lua_VkFence* ud = (lua_VkFence*)lua_newuserdata(L, sizeof(lua_VkFence));
+    ud->tag = VULKAN_TAG_FENCE;
     ud->fence = fence;
     ud->device = device;
     luaL_setmetatable(L, FENCE_MT);
@@ -2006,7 +4483,7 @@ void lua_push_VkFence(lua_State* L, VkFence fence, VkDevice device) {
 
 // Check VkFence userdata
 lua_VkFence* lua_check_VkFence(lua_State* L, int idx) {
-    lua_VkFence* ud = (lua_VkFence*)luaL_checkudata(L, idx, FENCE_MT);
+    lua_VkFence* ud = (lua_VkFence*)check_tag(L, idx, VULKAN_TAG_FENCE, FENCE_MT);
     if (!ud->fence) {
         luaL_error(L, "Invalid VkFence (already destroyed)");
     }
@@ -2022,6 +4499,7 @@ void lua_push_VkCommandPool(lua_State* L, VkCommandPool command_pool, VkDevice d
         luaL_error(L, "Cannot create userdata for null VkCommandPool");
     }
     lua_VkCommandPool* ud = (lua_VkCommandPool*)lua_newuserdata(L, sizeof(lua_VkCommandPool));
+    ud->tag = VULKAN_TAG_COMMAND_POOL;
     ud->command_pool = command_pool;
     ud->device = device;
     luaL_setmetatable(L, COMMAND_POOL_MT);
@@ -2029,7 +4507,7 @@ void lua_push_VkCommandPool(lua_State* L, VkCommandPool command_pool, VkDevice d
 
 // Check VkCommandPool userdata
 lua_VkCommandPool* lua_check_VkCommandPool(lua_State* L, int idx) {
-    lua_VkCommandPool* ud = (lua_VkCommandPool*)luaL_checkudata(L, idx, COMMAND_POOL_MT);
+    lua_VkCommandPool* ud = (lua_VkCommandPool*)check_tag(L, idx, VULKAN_TAG_COMMAND_POOL, COMMAND_POOL_MT);
     if (!ud->command_pool) {
         luaL_error(L, "Invalid VkCommandPool (already destroyed)");
     }
@@ -2045,6 +4523,7 @@ void lua_push_VkCommandBuffer(lua_State* L, VkCommandBuffer command_buffer, VkDe
         luaL_error(L, "Cannot create userdata for null VkCommandBuffer");
     }
     lua_VkCommandBuffer* ud = (lua_VkCommandBuffer*)lua_newuserdata(L, sizeof(lua_VkCommandBuffer));
+    ud->tag = VULKAN_TAG_COMMAND_BUFFER;
     ud->command_buffer = command_buffer;
     ud->device = device;
     luaL_setmetatable(L, COMMAND_BUFFER_MT);
@@ -2052,7 +4531,7 @@ void lua_push_VkCommandBuffer(lua_State* L, VkCommandBuffer command_buffer, VkDe
 
 // Check VkCommandBuffer userdata
 lua_VkCommandBuffer* lua_check_VkCommandBuffer(lua_State* L, int idx) {
-    lua_VkCommandBuffer* ud = (lua_VkCommandBuffer*)luaL_checkudata(L, idx, COMMAND_BUFFER_MT);
+    lua_VkCommandBuffer* ud = (lua_VkCommandBuffer*)check_tag(L, idx, VULKAN_TAG_COMMAND_BUFFER, COMMAND_BUFFER_MT);
     if (!ud->command_buffer) {
         luaL_error(L, "Invalid VkCommandBuffer (already destroyed)");
     }
@@ -2100,6 +4579,112 @@ static int l_vulkan_create_fence(lua_State* L) {
     return 1;
 }
 
+// Create timeline semaphore: vulkan.create_timeline_semaphore(device, [initial_value])
+static int l_vulkan_create_timeline_semaphore(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+
+    VkSemaphoreTypeCreateInfo type_info = {0};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = (uint64_t)luaL_optinteger(L, 2, 0);
+
+    VkSemaphoreCreateInfo create_info = {0};
+    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    create_info.pNext = &type_info;
+
+    VkSemaphore semaphore;
+    VkResult result = vkCreateSemaphore(device_ud->device, &create_info, NULL, &semaphore);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to create timeline semaphore: VkResult %d", result);
+    }
+
+    lua_push_VkSemaphore(L, semaphore, device_ud->device);
+    return 1;
+}
+
+// Get timeline value: vulkan.get_semaphore_counter_value(device, semaphore) -> value
+static int l_vulkan_get_semaphore_counter_value(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    lua_VkSemaphore* semaphore_ud = lua_check_VkSemaphore(L, 2);
+    check_timeline_semaphore(L, device_ud->device);
+
+    uint64_t value;
+    VkResult result = get_semaphore_counter_value(device_ud->device, semaphore_ud->semaphore, &value);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to get semaphore counter value: VkResult %d", result);
+    }
+    lua_pushinteger(L, (lua_Integer)value);
+    return 1;
+}
+
+// Wait on the host: vulkan.wait_semaphores(device, semaphores, values, [timeout], [wait_any]) -> true, or false on timeout
+// semaphores/values are one timeline semaphore and value, or tables of them.
+static int l_vulkan_wait_semaphores(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    uint64_t timeout = opt_timeout(L, 4);
+    check_timeline_semaphore(L, device_ud->device);
+
+    VkSemaphore single_semaphore;
+    uint64_t single_value;
+    VkSemaphoreWaitInfo wait_info = {0};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.flags = lua_toboolean(L, 5) ? VK_SEMAPHORE_WAIT_ANY_BIT : 0;
+    if (lua_istable(L, 2)) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        wait_info.semaphoreCount = (uint32_t)lua_rawlen(L, 2);
+        if (lua_rawlen(L, 3) != wait_info.semaphoreCount) {
+            luaL_error(L, "Mismatch between semaphores and values count");
+        }
+        // Scratch arrays live in a userdata so argument errors do not leak them
+        VkSemaphore* semaphores = (VkSemaphore*)lua_newuserdatauv(L, wait_info.semaphoreCount * (sizeof(VkSemaphore) + sizeof(uint64_t)), 0);
+        uint64_t* values = (uint64_t*)(semaphores + wait_info.semaphoreCount);
+        for (uint32_t i = 0; i < wait_info.semaphoreCount; i++) {
+            lua_rawgeti(L, 2, i + 1);
+            semaphores[i] = lua_check_VkSemaphore(L, -1)->semaphore;
+            lua_pop(L, 1);
+            lua_rawgeti(L, 3, i + 1);
+            values[i] = (uint64_t)luaL_checkinteger(L, -1);
+            lua_pop(L, 1);
+        }
+        wait_info.pSemaphores = semaphores;
+        wait_info.pValues = values;
+    } else {
+        single_semaphore = lua_check_VkSemaphore(L, 2)->semaphore;
+        single_value = (uint64_t)luaL_checkinteger(L, 3);
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &single_semaphore;
+        wait_info.pValues = &single_value;
+    }
+
+    VkResult result = wait_semaphores(device_ud->device, &wait_info, timeout);
+    if (result == VK_TIMEOUT) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to wait for semaphores: VkResult %d", result);
+    }
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+// Signal from the host: vulkan.signal_semaphore(device, semaphore, value)
+static int l_vulkan_signal_semaphore(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    lua_VkSemaphore* semaphore_ud = lua_check_VkSemaphore(L, 2);
+    check_timeline_semaphore(L, device_ud->device);
+
+    VkSemaphoreSignalInfo signal_info = {0};
+    signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+    signal_info.semaphore = semaphore_ud->semaphore;
+    signal_info.value = (uint64_t)luaL_checkinteger(L, 3);
+    VkResult result = signal_semaphore(device_ud->device, &signal_info);
+    if (result != VK_SUCCESS) {
+        luaL_error(L, "Failed to signal semaphore: VkResult %d", result);
+    }
+    return 0;
+}
+
 // Create command pool: vulkan.create_command_pool(device, queue_family_index)
 static int l_vulkan_create_command_pool(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
@@ -2188,25 +4773,58 @@ static void command_buffer_metatable(lua_State* L) {
     lua_pop(L, 1);
 }
 
-// Wait for fences: vulkan.wait_for_fences(device, fence)
+// Read a fence or a list of fences. A list is copied into a scratch userdata left on the stack,
+// so argument errors do not leak it; a single fence uses *single.
+static const VkFence* read_fences(lua_State* L, int idx, VkFence* single, uint32_t* count) {
+    if (!lua_istable(L, idx)) {
+        *single = lua_check_VkFence(L, idx)->fence;
+        *count = 1;
+        return single;
+    }
+    uint32_t n = (uint32_t)lua_rawlen(L, idx);
+    if (n == 0) {
+        luaL_error(L, "Expected at least one fence");
+    }
+    VkFence* fences = (VkFence*)lua_newuserdatauv(L, n * sizeof(VkFence), 0);
+    for (uint32_t i = 0; i < n; i++) {
+        lua_rawgeti(L, idx, i + 1);
+        fences[i] = lua_check_VkFence(L, -1)->fence;
+        lua_pop(L, 1);
+    }
+    *count = n;
+    return fences;
+}
+
+// Wait for fences: vulkan.wait_for_fences(device, fence | fences, [wait_all], [timeout]) -> true, or false on timeout
+// wait_all defaults to true; false returns as soon as any fence is signalled.
 static int l_vulkan_wait_for_fences(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
-    lua_VkFence* fence_ud = lua_check_VkFence(L, 2);
-
-    VkResult result = vkWaitForFences(device_ud->device, 1, &fence_ud->fence, VK_TRUE, UINT64_MAX);
+    VkBool32 wait_all = lua_isnoneornil(L, 3) || lua_toboolean(L, 3) ? VK_TRUE : VK_FALSE;
+    uint64_t timeout = opt_timeout(L, 4);
+    VkFence single;
+    uint32_t count;
+    const VkFence* fences = read_fences(L, 2, &single, &count);
+
+    VkResult result = vkWaitForFences(device_ud->device, count, fences, wait_all, timeout);
+    if (result == VK_TIMEOUT) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
     if (result != VK_SUCCESS) {
         luaL_error(L, "Failed to wait for fences: VkResult %d", result);
     }
-
-    return 0;
+    lua_pushboolean(L, true);
+    return 1;
 }
 
-// Reset fences: vulkan.reset_fences(device, fence)
+// Reset fences: vulkan.reset_fences(device, fence | fences)
 static int l_vulkan_reset_fences(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
-    lua_VkFence* fence_ud = lua_check_VkFence(L, 2);
+    VkFence single;
+    uint32_t count;
+    const VkFence* fences = read_fences(L, 2, &single, &count);
 
-    VkResult result = vkResetFences(device_ud->device, 1, &fence_ud->fence);
+    VkResult result = vkResetFences(device_ud->device, count, fences);
     if (result != VK_SUCCESS) {
         luaL_error(L, "Failed to reset fences: VkResult %d", result);
     }
@@ -2214,6 +4832,19 @@ static int l_vulkan_reset_fences(lua_State* L) {
     return 0;
 }
 
+// Poll a fence without blocking: vulkan.get_fence_status(device, fence) -> true if signalled
+static int l_vulkan_get_fence_status(lua_State* L) {
+    lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
+    lua_VkFence* fence_ud = lua_check_VkFence(L, 2);
+
+    VkResult result = vkGetFenceStatus(device_ud->device, fence_ud->fence);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        luaL_error(L, "Failed to get fence status: VkResult %d", result);
+    }
+    lua_pushboolean(L, result == VK_SUCCESS);
+    return 1;
+}
+
 // Acquire next image: vulkan.acquire_next_image_KHR(device, swapchain, timeout, semaphore, fence)
 static int l_vulkan_acquire_next_image_KHR(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
@@ -2239,10 +4870,10 @@ static int l_vulkan_acquire_next_image_KHR(lua_State* L) {
 
 // Reset command buffer: vulkan.reset_command_buffer(command_buffer)
 static int l_vulkan_reset_command_buffer(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
 
     VkResult result = vkResetCommandBuffer(cmd_buffer_ud->command_buffer, 0);
-    if (result != VK_SUCCESS) {
+    if (HOT_CHECKED && result != VK_SUCCESS) {
         luaL_error(L, "Failed to reset command buffer: VkResult %d", result);
     }
 
@@ -2251,36 +4882,63 @@ static int l_vulkan_reset_command_buffer(lua_State* L) {
 
 // Begin command buffer: vulkan.begin_command_buffer(command_buffer)
 static int l_vulkan_begin_command_buffer(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
 
     VkCommandBufferBeginInfo begin_info = {0};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
     VkResult result = vkBeginCommandBuffer(cmd_buffer_ud->command_buffer, &begin_info);
-    if (result != VK_SUCCESS) {
+    if (HOT_CHECKED && result != VK_SUCCESS) {
         luaL_error(L, "Failed to begin command buffer: VkResult %d", result);
     }
 
     return 0;
 }
 
-// Begin render pass: vulkan.cmd_begin_renderpass(command_buffer, render_pass, framebuffer)
+// Begin render pass: vulkan.cmd_begin_renderpass(command_buffer, render_pass, framebuffer, [{width, height, clear_values}])
+// The render area defaults to 800x600; pass the framebuffer size when it differs (e.g. after a resize).
+// clear_values holds one {r, g, b, a} or {depth, stencil} per attachment, default opaque black.
 static int l_vulkan_cmd_begin_renderpass(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
-    lua_VkRenderPass* render_pass_ud = lua_check_VkRenderPass(L, 2);
-    lua_VkFramebuffer* framebuffer_ud = lua_check_VkFramebuffer(L, 3);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    lua_VkRenderPass* render_pass_ud = HOT_UDATA(VkRenderPass, L, 2);
+    lua_VkFramebuffer* framebuffer_ud = HOT_UDATA(VkFramebuffer, L, 3);
 
-    VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}}; // Black background
+    VkClearValue clear_values[VULKAN_MAX_COLOR_ATTACHMENTS + 1] = {{{{0.0f, 0.0f, 0.0f, 1.0f}}}}; // Black background
     VkRenderPassBeginInfo render_pass_info = {0};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_info.renderPass = render_pass_ud->render_pass;
     render_pass_info.framebuffer = framebuffer_ud->framebuffer;
     render_pass_info.renderArea.offset = (VkOffset2D){0, 0};
-    render_pass_info.renderArea.extent.width = 800; // Hardcoded for simplicity
+    render_pass_info.renderArea.extent.width = 800;
     render_pass_info.renderArea.extent.height = 600;
     render_pass_info.clearValueCount = 1;
-    render_pass_info.pClearValues = &clear_color;
+    render_pass_info.pClearValues = clear_values;
+    if (lua_istable(L, 4)) {
+        render_pass_info.renderArea.extent.width = (uint32_t)opt_integer_field(L, 4, "width", 800);
+        render_pass_info.renderArea.extent.height = (uint32_t)opt_integer_field(L, 4, "height", 600);
+        if (lua_getfield(L, 4, "clear_values") == LUA_TTABLE) {
+            uint32_t count = (uint32_t)lua_rawlen(L, -1);
+            if (count > VULKAN_MAX_COLOR_ATTACHMENTS + 1) count = VULKAN_MAX_COLOR_ATTACHMENTS + 1;
+            for (uint32_t i = 0; i < count; i++) {
+                if (lua_rawgeti(L, -1, i + 1) == LUA_TTABLE) {
+                    if (lua_getfield(L, -1, "depth") != LUA_TNIL) {
+                        clear_values[i].depthStencil.depth = (float)lua_tonumber(L, -1);
+                        clear_values[i].depthStencil.stencil = (uint32_t)opt_integer_field(L, -2, "stencil", 0);
+                    } else {
+                        clear_values[i].color.float32[0] = opt_number_field(L, -2, "r", 0.0f);
+                        clear_values[i].color.float32[1] = opt_number_field(L, -2, "g", 0.0f);
+                        clear_values[i].color.float32[2] = opt_number_field(L, -2, "b", 0.0f);
+                        clear_values[i].color.float32[3] = opt_number_field(L, -2, "a", 1.0f);
+                    }
+                    lua_pop(L, 1);
+                }
+                lua_pop(L, 1);
+            }
+            if (count > 0) render_pass_info.clearValueCount = count;
+        }
+        lua_pop(L, 1);
+    }
 
     vkCmdBeginRenderPass(cmd_buffer_ud->command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
     return 0;
@@ -2288,8 +4946,8 @@ static int l_vulkan_cmd_begin_renderpass(lua_State* L) {
 
 // Bind pipeline: vulkan.cmd_bind_pipeline(command_buffer, pipeline)
 static int l_vulkan_cmd_bind_pipeline(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
-    lua_VkPipeline* pipeline_ud = lua_check_VkPipeline(L, 2);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    lua_VkPipeline* pipeline_ud = HOT_UDATA(VkPipeline, L, 2);
 
     vkCmdBindPipeline(cmd_buffer_ud->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_ud->pipeline);
     return 0;
@@ -2297,11 +4955,11 @@ static int l_vulkan_cmd_bind_pipeline(lua_State* L) {
 
 // Draw command: vulkan.cmd_draw(command_buffer, vertex_count, instance_count, first_vertex, first_instance)
 static int l_vulkan_cmd_draw(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
-    uint32_t vertex_count = luaL_checkinteger(L, 2);
-    uint32_t instance_count = luaL_checkinteger(L, 3);
-    uint32_t first_vertex = luaL_checkinteger(L, 4);
-    uint32_t first_instance = luaL_checkinteger(L, 5);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    uint32_t vertex_count = HOT_INTEGER(L, 2);
+    uint32_t instance_count = HOT_INTEGER(L, 3);
+    uint32_t first_vertex = HOT_INTEGER(L, 4);
+    uint32_t first_instance = HOT_INTEGER(L, 5);
 
     vkCmdDraw(cmd_buffer_ud->command_buffer, vertex_count, instance_count, first_vertex, first_instance);
     return 0;
@@ -2309,36 +4967,210 @@ static int l_vulkan_cmd_draw(lua_State* L) {
 
 // End render pass: vulkan.cmd_end_renderpass(command_buffer)
 static int l_vulkan_cmd_end_renderpass(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
     vkCmdEndRenderPass(cmd_buffer_ud->command_buffer);
     return 0;
 }
 
+//===============================================
+// dynamic rendering
+//===============================================
+// vkCmdBeginRendering/vkCmdEndRendering come from Vulkan 1.3 or VK_KHR_dynamic_rendering and are
+// loaded per device; the last device's pointers are cached since they are used every frame.
+static VkDevice dynamic_rendering_device = VK_NULL_HANDLE;
+static PFN_vkCmdBeginRendering cmd_begin_rendering = NULL;
+static PFN_vkCmdEndRendering cmd_end_rendering = NULL;
+
+static void load_dynamic_rendering(lua_State* L, VkDevice device) {
+    if (device == dynamic_rendering_device && cmd_begin_rendering) return;
+    cmd_begin_rendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(device, "vkCmdBeginRendering");
+    cmd_end_rendering = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(device, "vkCmdEndRendering");
+    if (!cmd_begin_rendering || !cmd_end_rendering) {
+        cmd_begin_rendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        cmd_end_rendering = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+    }
+    if (!cmd_begin_rendering || !cmd_end_rendering) {
+        cmd_begin_rendering = NULL;
+        dynamic_rendering_device = VK_NULL_HANDLE;
+        luaL_error(L, "vkCmdBeginRendering is not available (needs Vulkan 1.3 or VK_KHR_dynamic_rendering)");
+    }
+    dynamic_rendering_device = device;
+}
+
+// Read {view, [layout], [load_op], [store_op], [clear], [resolve_view], [resolve_mode], [resolve_layout]}.
+// clear is {r, g, b, a} for color or {depth, stencil} for depth/stencil attachments; load_op
+// defaults to CLEAR when clear is given and LOAD otherwise.
+static void read_rendering_attachment(lua_State* L, int idx, VkRenderingAttachmentInfo* attachment, int depth_stencil) {
+    idx = lua_absindex(L, idx);
+    luaL_checktype(L, idx, LUA_TTABLE);
+    memset(attachment, 0, sizeof(*attachment));
+    attachment->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    lua_getfield(L, idx, "view");
+    attachment->imageView = lua_check_VkImageView(L, -1)->image_view;
+    lua_pop(L, 1);
+    attachment->imageLayout = (VkImageLayout)opt_integer_field(L, idx, "layout",
+        depth_stencil ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    lua_getfield(L, idx, "clear");
+    int cleared = !lua_isnil(L, -1);
+    if (cleared) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        if (depth_stencil) {
+            attachment->clearValue.depthStencil.depth = (float)opt_number_field(L, -1, "depth", 1.0);
+            attachment->clearValue.depthStencil.stencil = (uint32_t)opt_integer_field(L, -1, "stencil", 0);
+        } else {
+            attachment->clearValue.color.float32[0] = (float)opt_number_field(L, -1, "r", 0.0);
+            attachment->clearValue.color.float32[1] = (float)opt_number_field(L, -1, "g", 0.0);
+            attachment->clearValue.color.float32[2] = (float)opt_number_field(L, -1, "b", 0.0);
+            attachment->clearValue.color.float32[3] = (float)opt_number_field(L, -1, "a", 1.0);
+        }
+    }
+    lua_pop(L, 1);
+    attachment->loadOp = (VkAttachmentLoadOp)opt_integer_field(L, idx, "load_op",
+        cleared ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD);
+    attachment->storeOp = (VkAttachmentStoreOp)opt_integer_field(L, idx, "store_op", VK_ATTACHMENT_STORE_OP_STORE);
+
+    lua_getfield(L, idx, "resolve_view");
+    if (!lua_isnil(L, -1)) {
+        attachment->resolveImageView = lua_check_VkImageView(L, -1)->image_view;
+        attachment->resolveMode = (VkResolveModeFlagBits)opt_integer_field(L, idx, "resolve_mode",
+            depth_stencil ? VK_RESOLVE_MODE_SAMPLE_ZERO_BIT : VK_RESOLVE_MODE_AVERAGE_BIT);
+        attachment->resolveImageLayout = (VkImageLayout)opt_integer_field(L, idx, "resolve_layout", attachment->imageLayout);
+    }
+    lua_pop(L, 1);
+}
+
+// Begin dynamic rendering: vulkan.cmd_begin_rendering(command_buffer, {render_area, [color_attachments],
+//     [depth_attachment], [stencil_attachment], [layer_count], [view_mask], [flags]})
+// render_area is {[x], [y], width, height}. Renders straight into image views, without a render pass
+// or framebuffer; attachments must already be in their layouts (see cmd_pipeline_barrier).
+static int l_vulkan_cmd_begin_rendering(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    load_dynamic_rendering(L, cmd_ud->device);
+
+    VkRenderingInfo info = {0};
+    info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    info.flags = (VkRenderingFlags)opt_integer_field(L, 2, "flags", 0);
+    info.layerCount = (uint32_t)opt_integer_field(L, 2, "layer_count", 1);
+    info.viewMask = (uint32_t)opt_integer_field(L, 2, "view_mask", 0);
+
+    lua_getfield(L, 2, "render_area");
+    luaL_checktype(L, -1, LUA_TTABLE);
+    info.renderArea.offset.x = opt_integer_field(L, -1, "x", 0);
+    info.renderArea.offset.y = opt_integer_field(L, -1, "y", 0);
+    info.renderArea.extent.width = (uint32_t)lua_getfield_integer(L, -1, "width");
+    info.renderArea.extent.height = (uint32_t)lua_getfield_integer(L, -1, "height");
+    lua_pop(L, 1);
+
+    VkRenderingAttachmentInfo color_attachments[VULKAN_MAX_COLOR_ATTACHMENTS];
+    lua_getfield(L, 2, "color_attachments");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        uint32_t count = (uint32_t)lua_rawlen(L, -1);
+        if (count > VULKAN_MAX_COLOR_ATTACHMENTS) {
+            luaL_error(L, "Too many color attachments (max %d)", VULKAN_MAX_COLOR_ATTACHMENTS);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            lua_rawgeti(L, -1, i + 1);
+            read_rendering_attachment(L, -1, &color_attachments[i], 0);
+            lua_pop(L, 1);
+        }
+        info.colorAttachmentCount = count;
+        info.pColorAttachments = color_attachments;
+    }
+    lua_pop(L, 1);
+
+    VkRenderingAttachmentInfo depth_attachment, stencil_attachment;
+    lua_getfield(L, 2, "depth_attachment");
+    if (!lua_isnil(L, -1)) {
+        read_rendering_attachment(L, -1, &depth_attachment, 1);
+        info.pDepthAttachment = &depth_attachment;
+    }
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "stencil_attachment");
+    if (!lua_isnil(L, -1)) {
+        read_rendering_attachment(L, -1, &stencil_attachment, 1);
+        info.pStencilAttachment = &stencil_attachment;
+    }
+    lua_pop(L, 1);
+
+    cmd_begin_rendering(cmd_ud->command_buffer, &info);
+    return 0;
+}
+
+// End dynamic rendering: vulkan.cmd_end_rendering(command_buffer)
+static int l_vulkan_cmd_end_rendering(lua_State* L) {
+    lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    load_dynamic_rendering(L, cmd_ud->device);
+    cmd_end_rendering(cmd_ud->command_buffer);
+    return 0;
+}
+
 // End command buffer: vulkan.end_commandbuffer(command_buffer)
 static int l_vulkan_end_commandbuffer(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
 
     VkResult result = vkEndCommandBuffer(cmd_buffer_ud->command_buffer);
-    if (result != VK_SUCCESS) {
+    if (HOT_CHECKED && result != VK_SUCCESS) {
         luaL_error(L, "Failed to end command buffer: VkResult %d", result);
     }
 
     return 0;
 }
 
+// Read the timeline values paired with a semaphore list of a submit (nil when absent). The array
+// lives in a userdata left on the stack, so later argument errors do not leak it.
+static const uint64_t* read_semaphore_values(lua_State* L, int idx, const char* field, const char* semaphores_field,
+                                             uint32_t* count) {
+    *count = 0;
+    if (lua_getfield(L, idx, field) == LUA_TNIL) {
+        lua_pop(L, 1);
+        return NULL;
+    }
+    luaL_checktype(L, -1, LUA_TTABLE);
+    uint32_t n = (uint32_t)lua_rawlen(L, -1);
+    lua_getfield(L, idx, semaphores_field);
+    if (!lua_istable(L, -1) || lua_rawlen(L, -1) != n) {
+        luaL_error(L, "%s must have one value per entry of %s", field, semaphores_field);
+    }
+    lua_pop(L, 1);
+    uint64_t* values = (uint64_t*)lua_newuserdatauv(L, (n ? n : 1) * sizeof(uint64_t), 0);
+    for (uint32_t i = 0; i < n; i++) {
+        lua_rawgeti(L, -2, i + 1);
+        values[i] = (uint64_t)luaL_checkinteger(L, -1); // Ignored for binary semaphores
+        lua_pop(L, 1);
+    }
+    lua_remove(L, -2);
+    *count = n;
+    return values;
+}
+
 // Submit queue: vulkan.queue_submit(queue, command_buffer, wait_semaphore, signal_semaphore, fence)
-// Queue submit: vulkan.queue_submit(queue, {wait_semaphores, wait_dst_stage_mask, command_buffers, signal_semaphores}, fence)
+// Queue submit: vulkan.queue_submit(queue, {wait_semaphores, wait_dst_stage_mask, command_buffers, signal_semaphores,
+//                                           [wait_values], [signal_values]}, fence)
 static int l_vulkan_queue_submit(lua_State* L) {
-    lua_VkQueue* queue_ud = lua_check_VkQueue(L, 1);
-    luaL_checktype(L, 2, LUA_TTABLE);
-    lua_VkFence* fence_ud = lua_isnil(L, 3) ? NULL : lua_check_VkFence(L, 3);
+    lua_VkQueue* queue_ud = HOT_UDATA(VkQueue, L, 1);
+    HOT_TABLE(L, 2);
+    lua_VkFence* fence_ud = lua_isnil(L, 3) ? NULL : HOT_UDATA(VkFence, L, 3);
 
     VkSubmitInfo submit_info = {0};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+    // Timeline semaphore values, one per wait/signal semaphore
+    VkTimelineSemaphoreSubmitInfo timeline_info = {0};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.pWaitSemaphoreValues = read_semaphore_values(L, 2, "wait_values", "wait_semaphores",
+                                                               &timeline_info.waitSemaphoreValueCount);
+    timeline_info.pSignalSemaphoreValues = read_semaphore_values(L, 2, "signal_values", "signal_semaphores",
+                                                                 &timeline_info.signalSemaphoreValueCount);
+    if (timeline_info.pWaitSemaphoreValues || timeline_info.pSignalSemaphoreValues) {
+        submit_info.pNext = &timeline_info;
+    }
+
     // Get wait semaphores
     lua_getfield(L, 2, "wait_semaphores");
-    luaL_checktype(L, -1, LUA_TTABLE);
+    HOT_TABLE(L, -1);
     submit_info.waitSemaphoreCount = lua_rawlen(L, -1);
     VkSemaphore* wait_semaphores = NULL;
     if (submit_info.waitSemaphoreCount > 0) {
@@ -2348,7 +5180,7 @@ static int l_vulkan_queue_submit(lua_State* L) {
         }
         for (uint32_t i = 1; i <= submit_info.waitSemaphoreCount; i++) {
             lua_rawgeti(L, -1, i);
-            lua_VkSemaphore* sem_ud = lua_check_VkSemaphore(L, -1);
+            lua_VkSemaphore* sem_ud = HOT_UDATA(VkSemaphore, L, -1);
             wait_semaphores[i-1] = sem_ud->semaphore;
             lua_pop(L, 1);
         }
@@ -2358,8 +5190,8 @@ static int l_vulkan_queue_submit(lua_State* L) {
 
     // Get wait destination stage mask
     lua_getfield(L, 2, "wait_dst_stage_mask");
-    luaL_checktype(L, -1, LUA_TTABLE);
-    if (lua_rawlen(L, -1) != submit_info.waitSemaphoreCount) {
+    HOT_TABLE(L, -1);
+    if (HOT_CHECKED && lua_rawlen(L, -1) != submit_info.waitSemaphoreCount) {
         free(wait_semaphores);
         luaL_error(L, "Mismatch between wait semaphores and stage mask count");
     }
@@ -2372,7 +5204,7 @@ static int l_vulkan_queue_submit(lua_State* L) {
         }
         for (uint32_t i = 1; i <= submit_info.waitSemaphoreCount; i++) {
             lua_rawgeti(L, -1, i);
-            wait_stages[i-1] = luaL_checkinteger(L, -1);
+            wait_stages[i-1] = HOT_INTEGER(L, -1);
             lua_pop(L, 1);
         }
         submit_info.pWaitDstStageMask = wait_stages;
@@ -2382,7 +5214,7 @@ static int l_vulkan_queue_submit(lua_State* L) {
     // Get command buffers
     VkCommandBuffer* command_buffers = NULL;
     lua_getfield(L, 2, "command_buffers");
-    if (luaL_testudata(L, -1, COMMAND_BUFFER_MT)) {
+    if (HOT_IS(L, -1, VULKAN_TAG_COMMAND_BUFFER)) {
         // Single command buffer
         submit_info.commandBufferCount = 1;
         command_buffers = (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer));
@@ -2391,11 +5223,11 @@ static int l_vulkan_queue_submit(lua_State* L) {
             free(wait_stages);
             luaL_error(L, "Failed to allocate memory for command buffer");
         }
-        lua_VkCommandBuffer* cmd_ud = lua_check_VkCommandBuffer(L, -1);
+        lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, -1);
         command_buffers[0] = cmd_ud->command_buffer;
     } else {
         // Table of command buffers
-        luaL_checktype(L, -1, LUA_TTABLE);
+        HOT_TABLE(L, -1);
         submit_info.commandBufferCount = lua_rawlen(L, -1);
         if (submit_info.commandBufferCount > 0) {
             command_buffers = (VkCommandBuffer*)malloc(submit_info.commandBufferCount * sizeof(VkCommandBuffer));
@@ -2406,13 +5238,13 @@ static int l_vulkan_queue_submit(lua_State* L) {
             }
             for (uint32_t i = 1; i <= submit_info.commandBufferCount; i++) {
                 lua_rawgeti(L, -1, i);
-                if (!luaL_testudata(L, -1, COMMAND_BUFFER_MT)) {
+                if (HOT_CHECKED && !test_tag(L, -1, VULKAN_TAG_COMMAND_BUFFER)) {
                     free(wait_semaphores);
                     free(wait_stages);
                     free(command_buffers);
                     luaL_error(L, "Expected vulkan.command_buffer at index %d, got %s", i, lua_typename(L, lua_type(L, -1)));
                 }
-                lua_VkCommandBuffer* cmd_ud = lua_check_VkCommandBuffer(L, -1);
+                lua_VkCommandBuffer* cmd_ud = HOT_UDATA(VkCommandBuffer, L, -1);
                 command_buffers[i-1] = cmd_ud->command_buffer;
                 lua_pop(L, 1);
             }
@@ -2423,7 +5255,7 @@ static int l_vulkan_queue_submit(lua_State* L) {
 
     // Get signal semaphores
     lua_getfield(L, 2, "signal_semaphores");
-    luaL_checktype(L, -1, LUA_TTABLE);
+    HOT_TABLE(L, -1);
     submit_info.signalSemaphoreCount = lua_rawlen(L, -1);
     VkSemaphore* signal_semaphores = NULL;
     if (submit_info.signalSemaphoreCount > 0) {
@@ -2436,7 +5268,7 @@ static int l_vulkan_queue_submit(lua_State* L) {
         }
         for (uint32_t i = 1; i <= submit_info.signalSemaphoreCount; i++) {
             lua_rawgeti(L, -1, i);
-            lua_VkSemaphore* sem_ud = lua_check_VkSemaphore(L, -1);
+            lua_VkSemaphore* sem_ud = HOT_UDATA(VkSemaphore, L, -1);
             signal_semaphores[i-1] = sem_ud->semaphore;
             lua_pop(L, 1);
         }
@@ -2462,15 +5294,15 @@ static int l_vulkan_queue_submit(lua_State* L) {
 
 // Present queue: vulkan.queue_present_KHR(queue, {wait_semaphores, swapchains, image_indices})
 static int l_vulkan_queue_present_KHR(lua_State* L) {
-    lua_VkQueue* queue_ud = lua_check_VkQueue(L, 1);
-    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_VkQueue* queue_ud = HOT_UDATA(VkQueue, L, 1);
+    HOT_TABLE(L, 2);
 
     VkPresentInfoKHR present_info = {0};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     // Get wait semaphores
     lua_getfield(L, 2, "wait_semaphores");
-    luaL_checktype(L, -1, LUA_TTABLE);
+    HOT_TABLE(L, -1);
     present_info.waitSemaphoreCount = lua_rawlen(L, -1);
     VkSemaphore* wait_semaphores = NULL;
     if (present_info.waitSemaphoreCount > 0) {
@@ -2480,7 +5312,7 @@ static int l_vulkan_queue_present_KHR(lua_State* L) {
         }
         for (uint32_t i = 1; i <= present_info.waitSemaphoreCount; i++) {
             lua_rawgeti(L, -1, i);
-            lua_VkSemaphore* sem_ud = lua_check_VkSemaphore(L, -1);
+            lua_VkSemaphore* sem_ud = HOT_UDATA(VkSemaphore, L, -1);
             wait_semaphores[i-1] = sem_ud->semaphore;
             lua_pop(L, 1);
         }
@@ -2491,7 +5323,7 @@ static int l_vulkan_queue_present_KHR(lua_State* L) {
     // Get swapchains
     VkSwapchainKHR* swapchains = NULL;
     lua_getfield(L, 2, "swapchains");
-    if (luaL_testudata(L, -1, SWAPCHAIN_MT)) {
+    if (HOT_IS(L, -1, VULKAN_TAG_SWAPCHAIN)) {
         // Single swapchain
         present_info.swapchainCount = 1;
         swapchains = (VkSwapchainKHR*)malloc(sizeof(VkSwapchainKHR));
@@ -2499,11 +5331,11 @@ static int l_vulkan_queue_present_KHR(lua_State* L) {
             free(wait_semaphores);
             luaL_error(L, "Failed to allocate memory for swapchain");
         }
-        lua_VkSwapchainKHR* swapchain_ud = lua_check_VkSwapchainKHR(L, -1);
+        lua_VkSwapchainKHR* swapchain_ud = HOT_UDATA(VkSwapchainKHR, L, -1);
         swapchains[0] = swapchain_ud->swapchain;
     } else {
         // Table of swapchains
-        luaL_checktype(L, -1, LUA_TTABLE);
+        HOT_TABLE(L, -1);
         present_info.swapchainCount = lua_rawlen(L, -1);
         if (present_info.swapchainCount > 0) {
             swapchains = (VkSwapchainKHR*)malloc(present_info.swapchainCount * sizeof(VkSwapchainKHR));
@@ -2513,12 +5345,12 @@ static int l_vulkan_queue_present_KHR(lua_State* L) {
             }
             for (uint32_t i = 1; i <= present_info.swapchainCount; i++) {
                 lua_rawgeti(L, -1, i);
-                if (!luaL_testudata(L, -1, SWAPCHAIN_MT)) {
+                if (HOT_CHECKED && !test_tag(L, -1, VULKAN_TAG_SWAPCHAIN)) {
                     free(wait_semaphores);
                     free(swapchains);
                     luaL_error(L, "Expected vulkan.swapchain at index %d, got %s", i, lua_typename(L, lua_type(L, -1)));
                 }
-                lua_VkSwapchainKHR* swapchain_ud = lua_check_VkSwapchainKHR(L, -1);
+                lua_VkSwapchainKHR* swapchain_ud = HOT_UDATA(VkSwapchainKHR, L, -1);
                 swapchains[i-1] = swapchain_ud->swapchain;
                 lua_pop(L, 1);
             }
@@ -2529,8 +5361,8 @@ static int l_vulkan_queue_present_KHR(lua_State* L) {
 
     // Get image indices
     lua_getfield(L, 2, "image_indices");
-    luaL_checktype(L, -1, LUA_TTABLE);
-    if (lua_rawlen(L, -1) != present_info.swapchainCount) {
+    HOT_TABLE(L, -1);
+    if (HOT_CHECKED && lua_rawlen(L, -1) != present_info.swapchainCount) {
         free(wait_semaphores);
         free(swapchains);
         luaL_error(L, "Mismatch between swapchains and image indices count");
@@ -2545,7 +5377,7 @@ static int l_vulkan_queue_present_KHR(lua_State* L) {
         }
         for (uint32_t i = 1; i <= present_info.swapchainCount; i++) {
             lua_rawgeti(L, -1, i);
-            image_indices[i-1] = luaL_checkinteger(L, -1);
+            image_indices[i-1] = HOT_INTEGER(L, -1);
             lua_pop(L, 1);
         }
         present_info.pImageIndices = image_indices;
@@ -2571,7 +5403,7 @@ static int l_vulkan_destroy_framebuffer(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkFramebuffer* framebuffer_ud = lua_check_VkFramebuffer(L, 2);
     if (framebuffer_ud->framebuffer != VK_NULL_HANDLE) {
-        vkDestroyFramebuffer(device_ud->device, framebuffer_ud->framebuffer, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_FRAMEBUFFER, .handle.framebuffer = framebuffer_ud->framebuffer});
         framebuffer_ud->framebuffer = VK_NULL_HANDLE;
     }
     return 0;
@@ -2581,7 +5413,7 @@ static int l_vulkan_destroy_image_view(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkImageView* image_view_ud = lua_check_VkImageView(L, 2);
     if (image_view_ud->image_view != VK_NULL_HANDLE) {
-        vkDestroyImageView(device_ud->device, image_view_ud->image_view, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_IMAGE_VIEW, .handle.image_view = image_view_ud->image_view});
         image_view_ud->image_view = VK_NULL_HANDLE;
     }
     return 0;
@@ -2600,30 +5432,30 @@ static int l_vulkan_device_wait_idle(lua_State* L) {
 }
 
 static int l_vulkan_cmd_set_viewport(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
-    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    HOT_TABLE(L, 2);
 
     uint32_t viewport_count = lua_rawlen(L, 2);
     VkViewport* viewports = (VkViewport*)malloc(viewport_count * sizeof(VkViewport));
     for (uint32_t i = 0; i < viewport_count; i++) {
         lua_rawgeti(L, 2, i + 1);
         lua_getfield(L, -1, "x");
-        viewports[i].x = (float)luaL_checknumber(L, -1);
+        viewports[i].x = (float)HOT_NUMBER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "y");
-        viewports[i].y = (float)luaL_checknumber(L, -1);
+        viewports[i].y = (float)HOT_NUMBER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "width");
-        viewports[i].width = (float)luaL_checknumber(L, -1);
+        viewports[i].width = (float)HOT_NUMBER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "height");
-        viewports[i].height = (float)luaL_checknumber(L, -1);
+        viewports[i].height = (float)HOT_NUMBER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "min_depth");
-        viewports[i].minDepth = (float)luaL_checknumber(L, -1);
+        viewports[i].minDepth = (float)HOT_NUMBER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "max_depth");
-        viewports[i].maxDepth = (float)luaL_checknumber(L, -1);
+        viewports[i].maxDepth = (float)HOT_NUMBER(L, -1);
         lua_pop(L, 1);
         lua_pop(L, 1);
     }
@@ -2633,24 +5465,24 @@ static int l_vulkan_cmd_set_viewport(lua_State* L) {
 }
 
 static int l_vulkan_cmd_set_scissor(lua_State* L) {
-    lua_VkCommandBuffer* cmd_buffer_ud = lua_check_VkCommandBuffer(L, 1);
-    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_VkCommandBuffer* cmd_buffer_ud = HOT_UDATA(VkCommandBuffer, L, 1);
+    HOT_TABLE(L, 2);
 
     uint32_t scissor_count = lua_rawlen(L, 2);
     VkRect2D* scissors = (VkRect2D*)malloc(scissor_count * sizeof(VkRect2D));
     for (uint32_t i = 0; i < scissor_count; i++) {
         lua_rawgeti(L, 2, i + 1);
         lua_getfield(L, -1, "x");
-        scissors[i].offset.x = (int32_t)luaL_checkinteger(L, -1);
+        scissors[i].offset.x = (int32_t)HOT_INTEGER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "y");
-        scissors[i].offset.y = (int32_t)luaL_checkinteger(L, -1);
+        scissors[i].offset.y = (int32_t)HOT_INTEGER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "width");
-        scissors[i].extent.width = (uint32_t)luaL_checkinteger(L, -1);
+        scissors[i].extent.width = (uint32_t)HOT_INTEGER(L, -1);
         lua_pop(L, 1);
         lua_getfield(L, -1, "height");
-        scissors[i].extent.height = (uint32_t)luaL_checkinteger(L, -1);
+        scissors[i].extent.height = (uint32_t)HOT_INTEGER(L, -1);
         lua_pop(L, 1);
         lua_pop(L, 1);
     }
@@ -2672,7 +5504,7 @@ static int l_vulkan_get_physical_device_surface_support_KHR(lua_State* L) {
 static int l_vulkan_destroy_swapchain_khr(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkSwapchainKHR* swapchain_ud = lua_check_VkSwapchainKHR(L, 2);
-    vkDestroySwapchainKHR(device_ud->device, swapchain_ud->swapchain, NULL);
+    vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_SWAPCHAIN, .handle.swapchain = swapchain_ud->swapchain});
     swapchain_ud->swapchain = VK_NULL_HANDLE;
     return 0;
 }
@@ -2683,7 +5515,7 @@ static int l_vulkan_destroy_semaphore(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkSemaphore* semaphore_ud = lua_check_VkSemaphore(L, 2);
     if (semaphore_ud->semaphore != VK_NULL_HANDLE) {
-        vkDestroySemaphore(device_ud->device, semaphore_ud->semaphore, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_SEMAPHORE, .handle.semaphore = semaphore_ud->semaphore});
         semaphore_ud->semaphore = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2694,7 +5526,7 @@ static int l_vulkan_destroy_fence(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkFence* fence_ud = lua_check_VkFence(L, 2);
     if (fence_ud->fence != VK_NULL_HANDLE) {
-        vkDestroyFence(device_ud->device, fence_ud->fence, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_FENCE, .handle.fence = fence_ud->fence});
         fence_ud->fence = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2705,7 +5537,7 @@ static int l_vulkan_destroy_command_pool(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkCommandPool* command_pool_ud = lua_check_VkCommandPool(L, 2);
     if (command_pool_ud->command_pool != VK_NULL_HANDLE) {
-        vkDestroyCommandPool(device_ud->device, command_pool_ud->command_pool, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_COMMAND_POOL, .handle.command_pool = command_pool_ud->command_pool});
         command_pool_ud->command_pool = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2716,7 +5548,7 @@ static int l_vulkan_destroy_pipeline(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkPipeline* pipeline_ud = lua_check_VkPipeline(L, 2);
     if (pipeline_ud->pipeline != VK_NULL_HANDLE) {
-        vkDestroyPipeline(device_ud->device, pipeline_ud->pipeline, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_PIPELINE, .handle.pipeline = pipeline_ud->pipeline});
         pipeline_ud->pipeline = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2727,7 +5559,7 @@ static int l_vulkan_destroy_pipeline_layout(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkPipelineLayout* pipeline_layout_ud = lua_check_VkPipelineLayout(L, 2);
     if (pipeline_layout_ud->pipeline_layout != VK_NULL_HANDLE) {
-        vkDestroyPipelineLayout(device_ud->device, pipeline_layout_ud->pipeline_layout, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_PIPELINE_LAYOUT, .handle.pipeline_layout = pipeline_layout_ud->pipeline_layout});
         pipeline_layout_ud->pipeline_layout = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2738,7 +5570,7 @@ static int l_vulkan_destroy_shader_module(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkShaderModule* shader_module_ud = lua_check_VkShaderModule(L, 2);
     if (shader_module_ud->shader_module != VK_NULL_HANDLE) {
-        vkDestroyShaderModule(device_ud->device, shader_module_ud->shader_module, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_SHADER_MODULE, .handle.shader_module = shader_module_ud->shader_module});
         shader_module_ud->shader_module = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2749,7 +5581,7 @@ static int l_vulkan_destroy_render_pass(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     lua_VkRenderPass* render_pass_ud = lua_check_VkRenderPass(L, 2);
     if (render_pass_ud->render_pass != VK_NULL_HANDLE) {
-        vkDestroyRenderPass(device_ud->device, render_pass_ud->render_pass, NULL);
+        vulkan_release(device_ud->device, &(vulkan_deletion){VULKAN_DELETE_RENDER_PASS, .handle.render_pass = render_pass_ud->render_pass});
         render_pass_ud->render_pass = VK_NULL_HANDLE; // Prevent double destruction
     }
     return 0;
@@ -2759,6 +5591,8 @@ static int l_vulkan_destroy_render_pass(lua_State* L) {
 static int l_vulkan_destroy_device(lua_State* L) {
     lua_VkDevice* device_ud = lua_check_VkDevice(L, 1);
     if (device_ud->device != VK_NULL_HANDLE) {
+        lua_VkDeletionQueue* q = deletion_queue_for(device_ud->device);
+        if (q) deletion_queue_release(q);
         vkDestroyDevice(device_ud->device, NULL);
         device_ud->device = VK_NULL_HANDLE; // Prevent double destruction
     }
@@ -2864,6 +5698,113 @@ static int l_vulkan_create_shader_module_str(lua_State* L) {
 }
 
 
+//===============================================
+// method surface
+//===============================================
+// cmd:draw(3, 1, 0, 0) calls the same function as vulkan.cmd_draw(cmd, 3, 1, 0, 0). The method
+// comes from the handle's own metatable, so frame loops skip the global and module table
+// lookups of vulkan.cmd_*; self is still validated by its type tag. "end" is a keyword, so
+// end_commandbuffer is cmd:finish().
+
+static const struct luaL_Reg command_buffer_methods[] = {
+    {"reset", l_vulkan_reset_command_buffer},
+    {"begin", l_vulkan_begin_command_buffer},
+    {"finish", l_vulkan_end_commandbuffer},
+    {"begin_renderpass", l_vulkan_cmd_begin_renderpass},
+    {"end_renderpass", l_vulkan_cmd_end_renderpass},
+    {"begin_rendering", l_vulkan_cmd_begin_rendering},
+    {"end_rendering", l_vulkan_cmd_end_rendering},
+    {"bind_pipeline", l_vulkan_cmd_bind_pipeline},
+    {"draw", l_vulkan_cmd_draw},
+    {"set_viewport", l_vulkan_cmd_set_viewport},
+    {"set_scissor", l_vulkan_cmd_set_scissor},
+    {"pipeline_barrier", l_vulkan_cmd_pipeline_barrier},
+    {"pipeline_barrier2", l_vulkan_cmd_pipeline_barrier2},
+    {"transition_image", l_vulkan_cmd_transition_image},
+    {"copy_buffer_to_image", l_vulkan_cmd_copy_buffer_to_image},
+    {"generate_mipmaps", l_vulkan_cmd_generate_mipmaps},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg queue_methods[] = {
+    {"submit", l_vulkan_queue_submit},
+    {"present", l_vulkan_queue_present_KHR},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg device_methods[] = {
+    {"wait_idle", l_vulkan_device_wait_idle},
+    {"get_queue", l_vulkan_get_device_queue},
+    {"create_swapchain", l_vulkan_create_swap_chain_KHR},
+    {"get_swapchain_images", l_vulkan_get_swapchain_images_KHR},
+    {"acquire_next_image", l_vulkan_acquire_next_image_KHR},
+    {"create_image_view", l_vulkan_create_image_view},
+    {"create_render_pass", l_vulkan_create_render_pass},
+    {"create_framebuffer", l_vulkan_create_framebuffer},
+    {"create_shader_module", l_vulkan_create_shader_module},
+    {"create_pipeline_layout", l_vulkan_create_pipeline_layout},
+    {"create_graphics_pipelines", l_vulkan_create_graphics_pipelines},
+    {"create_semaphore", l_vulkan_create_semaphore},
+    {"create_timeline_semaphore", l_vulkan_create_timeline_semaphore},
+    {"create_fence", l_vulkan_create_fence},
+    {"create_command_pool", l_vulkan_create_command_pool},
+    {"allocate_command_buffers", l_vulkan_create_allocate_command_buffers},
+    {"create_sampler", l_vulkan_create_sampler},
+    {"create_sampler_cache", l_vulkan_create_sampler_cache},
+    {"create_deletion_queue", l_vulkan_create_deletion_queue},
+    {"wait_for_fences", l_vulkan_wait_for_fences},
+    {"reset_fences", l_vulkan_reset_fences},
+    {"get_fence_status", l_vulkan_get_fence_status},
+    {"wait_semaphores", l_vulkan_wait_semaphores},
+    {"signal_semaphore", l_vulkan_signal_semaphore},
+    {"get_semaphore_counter_value", l_vulkan_get_semaphore_counter_value},
+    {"destroy_swapchain", l_vulkan_destroy_swapchain_khr},
+    {"destroy_image_view", l_vulkan_destroy_image_view},
+    {"destroy_framebuffer", l_vulkan_destroy_framebuffer},
+    {"destroy_render_pass", l_vulkan_destroy_render_pass},
+    {"destroy_shader_module", l_vulkan_destroy_shader_module},
+    {"destroy_pipeline_layout", l_vulkan_destroy_pipeline_layout},
+    {"destroy_pipeline", l_vulkan_destroy_pipeline},
+    {"destroy_semaphore", l_vulkan_destroy_semaphore},
+    {"destroy_fence", l_vulkan_destroy_fence},
+    {"destroy_command_pool", l_vulkan_destroy_command_pool},
+    {"destroy", l_vulkan_destroy_device},
+    {NULL, NULL}
+};
+
+static void set_methods(lua_State* L, const char* mt, const luaL_Reg* methods) {
+    luaL_getmetatable(L, mt);
+    lua_newtable(L);
+    luaL_setfuncs(L, methods, 0);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+static void method_tables(lua_State* L) {
+    set_methods(L, COMMAND_BUFFER_MT, command_buffer_methods);
+    set_methods(L, QUEUE_MT, queue_methods);
+    set_methods(L, DEVICE_MT, device_methods);
+}
+
+// Remember the metatable of every tagged type for test_tag.
+static void tag_metatables(lua_State* L) {
+    static const struct { vulkan_type_tag tag; const char** name; } types[] = {
+        {VULKAN_TAG_DEVICE, &DEVICE_MT}, {VULKAN_TAG_QUEUE, &QUEUE_MT}, {VULKAN_TAG_SWAPCHAIN, &SWAPCHAIN_MT},
+        {VULKAN_TAG_IMAGE_VIEW, &IMAGE_VIEW_MT}, {VULKAN_TAG_RENDER_PASS, &RENDER_PASS_MT},
+        {VULKAN_TAG_FRAMEBUFFER, &FRAMEBUFFER_MT}, {VULKAN_TAG_PIPELINE_LAYOUT, &PIPELINE_LAYOUT_MT},
+        {VULKAN_TAG_PIPELINE, &PIPELINE_MT}, {VULKAN_TAG_SEMAPHORE, &SEMAPHORE_MT}, {VULKAN_TAG_FENCE, &FENCE_MT},
+        {VULKAN_TAG_COMMAND_POOL, &COMMAND_POOL_MT}, {VULKAN_TAG_COMMAND_BUFFER, &COMMAND_BUFFER_MT},
+        {VULKAN_TAG_BUFFER, &BUFFER_MT}, {VULKAN_TAG_IMAGE, &IMAGE_MT}, {VULKAN_TAG_SAMPLER, &SAMPLER_MT},
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        int index = types[i].tag - VULKAN_TAG_DEVICE;
+        luaL_getmetatable(L, *types[i].name);
+        tag_types[index].name = *types[i].name;
+        tag_types[index].metatable = lua_topointer(L, -1);
+        lua_pop(L, 1);
+    }
+}
+
 //===============================================
 // Module loader
 //===============================================
@@ -2886,6 +5827,19 @@ static const struct luaL_Reg vulkan_lib[] = {
     {"create_swap_chain_KHR", l_vulkan_create_swap_chain_KHR},
 
     {"get_swapchain_images_KHR", l_vulkan_get_swapchain_images_KHR},
+    {"create_swapchain_manager", l_vulkan_create_swapchain_manager},
+    {"swapchain_acquire", l_vulkan_swapchain_acquire},
+    {"swapchain_present", l_vulkan_swapchain_present},
+    {"swapchain_resize", l_vulkan_swapchain_resize},
+    {"swapchain_images", l_vulkan_swapchain_images},
+    {"swapchain_info", l_vulkan_swapchain_info},
+    {"destroy_swapchain_manager", l_vulkan_destroy_swapchain_manager},
+    {"create_deletion_queue", l_vulkan_create_deletion_queue},
+    {"deletion_queue_end_frame", l_vulkan_deletion_queue_end_frame},
+    {"deletion_queue_collect", l_vulkan_deletion_queue_collect},
+    {"deletion_queue_flush", l_vulkan_deletion_queue_flush},
+    {"deletion_queue_stats", l_vulkan_deletion_queue_stats},
+    {"destroy_deletion_queue", l_vulkan_destroy_deletion_queue},
     {"create_image_view", l_vulkan_create_image_view},
 
     {"create_render_pass", l_vulkan_create_render_pass},
@@ -2900,11 +5854,16 @@ static const struct luaL_Reg vulkan_lib[] = {
 
     {"create_semaphore", l_vulkan_create_semaphore},
     {"create_fence", l_vulkan_create_fence},
+    {"create_timeline_semaphore", l_vulkan_create_timeline_semaphore},
+    {"get_semaphore_counter_value", l_vulkan_get_semaphore_counter_value},
+    {"wait_semaphores", l_vulkan_wait_semaphores},
+    {"signal_semaphore", l_vulkan_signal_semaphore},
     {"create_command_pool", l_vulkan_create_command_pool},
     {"create_allocate_command_buffers", l_vulkan_create_allocate_command_buffers},
 
     {"wait_for_fences", l_vulkan_wait_for_fences},
     {"reset_fences", l_vulkan_reset_fences},
+    {"get_fence_status", l_vulkan_get_fence_status},
     {"acquire_next_image_KHR", l_vulkan_acquire_next_image_KHR},
     {"reset_command_buffer", l_vulkan_reset_command_buffer},
     {"begin_command_buffer", l_vulkan_begin_command_buffer},
@@ -2912,6 +5871,8 @@ static const struct luaL_Reg vulkan_lib[] = {
     {"cmd_bind_pipeline", l_vulkan_cmd_bind_pipeline},
     {"cmd_draw", l_vulkan_cmd_draw},
     {"cmd_end_renderpass", l_vulkan_cmd_end_renderpass},
+    {"cmd_begin_rendering", l_vulkan_cmd_begin_rendering},
+    {"cmd_end_rendering", l_vulkan_cmd_end_rendering},
     {"end_commandbuffer", l_vulkan_end_commandbuffer},
     {"queue_submit", l_vulkan_queue_submit},
     {"queue_present_KHR", l_vulkan_queue_present_KHR},
@@ -2937,6 +5898,32 @@ static const struct luaL_Reg vulkan_lib[] = {
     {"destroy_surface_KHR", l_vulkan_destroy_surface_KHR},
     {"destroy_instance", l_vulkan_destroy_instance},
 
+    {"create_allocator", l_vulkan_create_allocator},
+    {"allocator_stats", l_vulkan_allocator_stats},
+    {"destroy_allocator", l_vulkan_destroy_allocator},
+    {"create_buffer", l_vulkan_create_buffer},
+    {"buffer_write", l_vulkan_buffer_write},
+    {"destroy_buffer", l_vulkan_destroy_buffer},
+    {"create_image", l_vulkan_create_image},
+    {"image_info", l_vulkan_image_info},
+    {"upload_image", l_vulkan_upload_image},
+    {"destroy_image", l_vulkan_destroy_image},
+    {"cmd_transition_image", l_vulkan_cmd_transition_image},
+    {"cmd_copy_buffer_to_image", l_vulkan_cmd_copy_buffer_to_image},
+    {"cmd_generate_mipmaps", l_vulkan_cmd_generate_mipmaps},
+    {"create_sampler", l_vulkan_create_sampler},
+    {"create_sampler_cache", l_vulkan_create_sampler_cache},
+    {"get_sampler", l_vulkan_get_sampler},
+    {"sampler_cache_count", l_vulkan_sampler_cache_count},
+    {"destroy_sampler", l_vulkan_destroy_sampler},
+    {"cmd_pipeline_barrier", l_vulkan_cmd_pipeline_barrier},
+    {"cmd_pipeline_barrier2", l_vulkan_cmd_pipeline_barrier2},
+    {"create_barrier_tracker", l_vulkan_create_barrier_tracker},
+    {"tracker_use_image", l_vulkan_tracker_use_image},
+    {"tracker_use_buffer", l_vulkan_tracker_use_buffer},
+    {"tracker_flush", l_vulkan_tracker_flush},
+    {"tracker_stats", l_vulkan_tracker_stats},
+
     {NULL, NULL}
 };
 
@@ -2955,6 +5942,13 @@ int luaopen_vulkan(lua_State* L) {
     swapchain_metatable(L);
 
     image_view_metatable(L);
+    allocator_metatable(L);
+    buffer_metatable(L);
+    image_metatable(L);
+    sampler_metatable(L);
+    barrier_tracker_metatable(L);
+    swapchain_manager_metatable(L);
+    deletion_queue_metatable(L);
 
     render_pass_metatable(L);
 
@@ -2968,6 +5962,8 @@ int luaopen_vulkan(lua_State* L) {
     fence_metatable(L);
     command_pool_metatable(L);
     command_buffer_metatable(L);
+    method_tables(L);
+    tag_metatables(L);
 
     luaL_newlib(L, vulkan_lib);
 
@@ -2980,6 +5976,8 @@ int luaopen_vulkan(lua_State* L) {
     lua_setfield(L, -2, "VK_API_VERSION_1_2");
     lua_pushinteger(L, VK_API_VERSION_1_3);
     lua_setfield(L, -2, "VK_API_VERSION_1_3");
+    lua_pushboolean(L, !HOT_CHECKED); // Built with LUAVK_FAST_PATH
+    lua_setfield(L, -2, "FAST_PATH");
 
     // Device type constants
     lua_pushinteger(L, VK_PHYSICAL_DEVICE_TYPE_OTHER);
@@ -3018,6 +6016,8 @@ int luaopen_vulkan(lua_State* L) {
     lua_setfield(L, -2, "IMAGE_ASPECT_COLOR_BIT");
 
     // Render pass constants
+    lua_pushinteger(L, VK_ATTACHMENT_LOAD_OP_LOAD);
+    lua_setfield(L, -2, "ATTACHMENT_LOAD_OP_LOAD");
     lua_pushinteger(L, VK_ATTACHMENT_LOAD_OP_CLEAR);
     lua_setfield(L, -2, "ATTACHMENT_LOAD_OP_CLEAR");
     lua_pushinteger(L, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
@@ -3053,6 +6053,190 @@ int luaopen_vulkan(lua_State* L) {
     lua_pushnumber(L, UINT64_MAX);
     lua_setfield(L, -2, "UINT64_MAX");
 
+    // Images and memory
+    lua_pushinteger(L, VK_FORMAT_R8G8B8A8_UNORM);
+    lua_setfield(L, -2, "FORMAT_R8G8B8A8_UNORM");
+    lua_pushinteger(L, VK_FORMAT_R8G8B8A8_SRGB);
+    lua_setfield(L, -2, "FORMAT_R8G8B8A8_SRGB");
+    lua_pushinteger(L, VK_FORMAT_B8G8R8A8_UNORM);
+    lua_setfield(L, -2, "FORMAT_B8G8R8A8_UNORM");
+    lua_pushinteger(L, VK_FORMAT_R16G16B16A16_SFLOAT);
+    lua_setfield(L, -2, "FORMAT_R16G16B16A16_SFLOAT");
+    lua_pushinteger(L, VK_FORMAT_R32_SFLOAT);
+    lua_setfield(L, -2, "FORMAT_R32_SFLOAT");
+    lua_pushinteger(L, VK_FORMAT_D32_SFLOAT);
+    lua_setfield(L, -2, "FORMAT_D32_SFLOAT");
+    lua_pushinteger(L, VK_FORMAT_D24_UNORM_S8_UINT);
+    lua_setfield(L, -2, "FORMAT_D24_UNORM_S8_UINT");
+    lua_pushinteger(L, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    lua_setfield(L, -2, "IMAGE_USAGE_TRANSFER_SRC_BIT");
+    lua_pushinteger(L, VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    lua_setfield(L, -2, "IMAGE_USAGE_TRANSFER_DST_BIT");
+    lua_pushinteger(L, VK_IMAGE_USAGE_SAMPLED_BIT);
+    lua_setfield(L, -2, "IMAGE_USAGE_SAMPLED_BIT");
+    lua_pushinteger(L, VK_IMAGE_USAGE_STORAGE_BIT);
+    lua_setfield(L, -2, "IMAGE_USAGE_STORAGE_BIT");
+    lua_pushinteger(L, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    lua_setfield(L, -2, "IMAGE_USAGE_COLOR_ATTACHMENT_BIT");
+    lua_pushinteger(L, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    lua_setfield(L, -2, "IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT");
+    lua_pushinteger(L, VK_IMAGE_ASPECT_DEPTH_BIT);
+    lua_setfield(L, -2, "IMAGE_ASPECT_DEPTH_BIT");
+    lua_pushinteger(L, VK_IMAGE_ASPECT_STENCIL_BIT);
+    lua_setfield(L, -2, "IMAGE_ASPECT_STENCIL_BIT");
+    lua_pushinteger(L, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+    lua_setfield(L, -2, "IMAGE_VIEW_TYPE_2D_ARRAY");
+    lua_pushinteger(L, VK_IMAGE_TILING_OPTIMAL);
+    lua_setfield(L, -2, "IMAGE_TILING_OPTIMAL");
+    lua_pushinteger(L, VK_IMAGE_TILING_LINEAR);
+    lua_setfield(L, -2, "IMAGE_TILING_LINEAR");
+    lua_pushinteger(L, VK_IMAGE_LAYOUT_GENERAL);
+    lua_setfield(L, -2, "IMAGE_LAYOUT_GENERAL");
+    lua_pushinteger(L, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    lua_setfield(L, -2, "IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL");
+    lua_pushinteger(L, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    lua_setfield(L, -2, "IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL");
+    lua_pushinteger(L, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    lua_setfield(L, -2, "IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL");
+    lua_pushinteger(L, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    lua_setfield(L, -2, "IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL");
+    lua_pushinteger(L, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    lua_setfield(L, -2, "IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL");
+    lua_pushinteger(L, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    lua_setfield(L, -2, "BUFFER_USAGE_TRANSFER_SRC_BIT");
+    lua_pushinteger(L, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    lua_setfield(L, -2, "BUFFER_USAGE_TRANSFER_DST_BIT");
+    lua_pushinteger(L, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    lua_setfield(L, -2, "BUFFER_USAGE_UNIFORM_BUFFER_BIT");
+    lua_pushinteger(L, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    lua_setfield(L, -2, "BUFFER_USAGE_STORAGE_BUFFER_BIT");
+    lua_pushinteger(L, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    lua_setfield(L, -2, "BUFFER_USAGE_INDEX_BUFFER_BIT");
+    lua_pushinteger(L, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    lua_setfield(L, -2, "BUFFER_USAGE_VERTEX_BUFFER_BIT");
+    lua_pushinteger(L, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    lua_setfield(L, -2, "MEMORY_PROPERTY_DEVICE_LOCAL_BIT");
+    lua_pushinteger(L, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    lua_setfield(L, -2, "MEMORY_PROPERTY_HOST_VISIBLE_BIT");
+    lua_pushinteger(L, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    lua_setfield(L, -2, "MEMORY_PROPERTY_HOST_COHERENT_BIT");
+    lua_pushinteger(L, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    lua_setfield(L, -2, "MEMORY_PROPERTY_HOST_CACHED_BIT");
+
+    // Samplers
+    lua_pushinteger(L, VK_FILTER_NEAREST);
+    lua_setfield(L, -2, "FILTER_NEAREST");
+    lua_pushinteger(L, VK_FILTER_LINEAR);
+    lua_setfield(L, -2, "FILTER_LINEAR");
+    lua_pushinteger(L, VK_SAMPLER_MIPMAP_MODE_NEAREST);
+    lua_setfield(L, -2, "SAMPLER_MIPMAP_MODE_NEAREST");
+    lua_pushinteger(L, VK_SAMPLER_MIPMAP_MODE_LINEAR);
+    lua_setfield(L, -2, "SAMPLER_MIPMAP_MODE_LINEAR");
+    lua_pushinteger(L, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    lua_setfield(L, -2, "SAMPLER_ADDRESS_MODE_REPEAT");
+    lua_pushinteger(L, VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT);
+    lua_setfield(L, -2, "SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT");
+    lua_pushinteger(L, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    lua_setfield(L, -2, "SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE");
+    lua_pushinteger(L, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
+    lua_setfield(L, -2, "SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER");
+    lua_pushinteger(L, VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK);
+    lua_setfield(L, -2, "BORDER_COLOR_FLOAT_TRANSPARENT_BLACK");
+    lua_pushinteger(L, VK_BORDER_COLOR_INT_OPAQUE_BLACK);
+    lua_setfield(L, -2, "BORDER_COLOR_INT_OPAQUE_BLACK");
+    lua_pushinteger(L, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE);
+    lua_setfield(L, -2, "BORDER_COLOR_FLOAT_OPAQUE_WHITE");
+    lua_pushinteger(L, VK_COMPARE_OP_LESS);
+    lua_setfield(L, -2, "COMPARE_OP_LESS");
+    lua_pushinteger(L, VK_COMPARE_OP_LESS_OR_EQUAL);
+    lua_setfield(L, -2, "COMPARE_OP_LESS_OR_EQUAL");
+    lua_pushinteger(L, VK_COMPARE_OP_ALWAYS);
+    lua_setfield(L, -2, "COMPARE_OP_ALWAYS");
+
+    // Barriers
+    lua_pushinteger(L, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_TOP_OF_PIPE_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_DRAW_INDIRECT_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_VERTEX_INPUT_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_VERTEX_SHADER_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_FRAGMENT_SHADER_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_COMPUTE_SHADER_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_TRANSFER_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_HOST_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_HOST_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_ALL_GRAPHICS_BIT");
+    lua_pushinteger(L, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    lua_setfield(L, -2, "PIPELINE_STAGE_ALL_COMMANDS_BIT");
+    lua_pushinteger(L, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_INDIRECT_COMMAND_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_INDEX_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_INDEX_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_VERTEX_ATTRIBUTE_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_UNIFORM_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_UNIFORM_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_INPUT_ATTACHMENT_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_SHADER_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_SHADER_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_SHADER_WRITE_BIT);
+    lua_setfield(L, -2, "ACCESS_SHADER_WRITE_BIT");
+    lua_pushinteger(L, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_COLOR_ATTACHMENT_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    lua_setfield(L, -2, "ACCESS_COLOR_ATTACHMENT_WRITE_BIT");
+    lua_pushinteger(L, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    lua_setfield(L, -2, "ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT");
+    lua_pushinteger(L, VK_ACCESS_TRANSFER_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_TRANSFER_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_TRANSFER_WRITE_BIT);
+    lua_setfield(L, -2, "ACCESS_TRANSFER_WRITE_BIT");
+    lua_pushinteger(L, VK_ACCESS_HOST_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_HOST_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_HOST_WRITE_BIT);
+    lua_setfield(L, -2, "ACCESS_HOST_WRITE_BIT");
+    lua_pushinteger(L, VK_ACCESS_MEMORY_READ_BIT);
+    lua_setfield(L, -2, "ACCESS_MEMORY_READ_BIT");
+    lua_pushinteger(L, VK_ACCESS_MEMORY_WRITE_BIT);
+    lua_setfield(L, -2, "ACCESS_MEMORY_WRITE_BIT");
+    lua_pushinteger(L, VK_DEPENDENCY_BY_REGION_BIT);
+    lua_setfield(L, -2, "DEPENDENCY_BY_REGION_BIT");
+
+    // Dynamic rendering constants
+    lua_pushinteger(L, VK_RESOLVE_MODE_NONE);
+    lua_setfield(L, -2, "RESOLVE_MODE_NONE");
+    lua_pushinteger(L, VK_RESOLVE_MODE_SAMPLE_ZERO_BIT);
+    lua_setfield(L, -2, "RESOLVE_MODE_SAMPLE_ZERO_BIT");
+    lua_pushinteger(L, VK_RESOLVE_MODE_AVERAGE_BIT);
+    lua_setfield(L, -2, "RESOLVE_MODE_AVERAGE_BIT");
+    lua_pushinteger(L, VK_RESOLVE_MODE_MIN_BIT);
+    lua_setfield(L, -2, "RESOLVE_MODE_MIN_BIT");
+    lua_pushinteger(L, VK_RESOLVE_MODE_MAX_BIT);
+    lua_setfield(L, -2, "RESOLVE_MODE_MAX_BIT");
+    lua_pushinteger(L, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+    lua_setfield(L, -2, "RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT");
+    lua_pushinteger(L, VK_RENDERING_SUSPENDING_BIT);
+    lua_setfield(L, -2, "RENDERING_SUSPENDING_BIT");
+    lua_pushinteger(L, VK_RENDERING_RESUMING_BIT);
+    lua_setfield(L, -2, "RENDERING_RESUMING_BIT");
+
     // shaders
     lua_pushinteger(L, shaderc_glsl_vertex_shader);
     lua_setfield(L, -2, "shaderc_vertex_shader");
@@ -0,0 +1,742 @@
+// module_worker.c
+// Lua states on their own threads. Values cross between states as serialized messages in
+// lock-free mailboxes; sdl.float_array data and runtime.buffer memory are handed over, not copied.
+
+#include "module_worker.h"
+#include "module_runtime.h"
+#include "module_sdl.h"
+#include <lualib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* WORKER_MT = "worker.worker";
+static const char* HUB_MT = "worker.hub";
+static const char* WRITER_MT = "worker.writer";
+static const char* MESSAGE_MT = "worker.message";
+static const char* FLOAT_ARRAY_MT = "sdl.float_array";
+static const char* SELF_KEY = "worker.self"; // Registry: worker_thread* of a worker state
+
+// Message encoding: one tag byte per value, followed by its payload.
+enum {
+    TAG_NIL,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_INTEGER, // lua_Integer
+    TAG_NUMBER,  // lua_Number
+    TAG_STRING,  // size_t length, bytes
+    TAG_TABLE,   // key/value pairs until TAG_END
+    TAG_END,
+    TAG_ARRAY,   // int index into worker_message.arrays
+    TAG_BUFFER   // int index into worker_message.buffers
+};
+
+//===============================================
+// Mailbox (lock-free MPSC)
+//===============================================
+
+static int mailbox_init(worker_mailbox* box) {
+    atomic_init(&box->stub.next, NULL);
+    atomic_init(&box->head, &box->stub);
+    box->tail = &box->stub;
+    atomic_init(&box->closed, 0);
+    box->ready = SDL_CreateSemaphore(0);
+    return box->ready != NULL;
+}
+
+static void mailbox_link(worker_mailbox* box, worker_message* msg) {
+    atomic_store_explicit(&msg->next, NULL, memory_order_relaxed);
+    worker_message* prev = atomic_exchange_explicit(&box->head, msg, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, msg, memory_order_release);
+}
+
+// Any thread.
+static void mailbox_push(worker_mailbox* box, worker_message* msg) {
+    mailbox_link(box, msg);
+    SDL_SignalSemaphore(box->ready);
+}
+
+// Consumer thread only. NULL when empty, or while a producer is between its exchange and
+// link; its semaphore signal follows, so a waiting consumer retries.
+static worker_message* mailbox_pop(worker_mailbox* box) {
+    worker_message* tail = box->tail;
+    worker_message* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &box->stub) {
+        if (!next) return NULL;
+        box->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next) {
+        box->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&box->head, memory_order_acquire)) return NULL;
+    mailbox_link(box, &box->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        box->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+// Wait up to timeout_ms (-1 = forever) for a message. NULL on timeout, or once the mailbox
+// is closed and drained.
+static worker_message* mailbox_wait(worker_mailbox* box, Sint32 timeout_ms) {
+    Uint64 deadline = SDL_GetTicks() + (Uint64)(timeout_ms > 0 ? timeout_ms : 0);
+    for (;;) {
+        worker_message* msg = mailbox_pop(box);
+        if (msg) return msg;
+        if (atomic_load(&box->closed)) {
+            return mailbox_pop(box); // Pushes made before closing are visible now
+        }
+        Sint32 wait = -1;
+        if (timeout_ms >= 0) {
+            Uint64 now = SDL_GetTicks();
+            if (now >= deadline) return NULL;
+            wait = (Sint32)(deadline - now);
+        }
+        SDL_WaitSemaphoreTimeout(box->ready, wait);
+    }
+}
+
+static void mailbox_close(worker_mailbox* box) {
+    atomic_store(&box->closed, 1);
+    SDL_SignalSemaphore(box->ready); // Wake a blocked receive
+}
+
+static void message_free(worker_message* msg) {
+    for (int i = 0; i < msg->array_count; i++) {
+        free(msg->arrays[i].data);
+    }
+    for (int i = 0; i < msg->buffer_count; i++) {
+        runtime_buffer_release(msg->buffers[i]);
+    }
+    free(msg);
+}
+
+// Free undelivered messages. No producer may still be running.
+static void mailbox_destroy(worker_mailbox* box) {
+    worker_message* msg;
+    while ((msg = mailbox_pop(box)) != NULL) {
+        message_free(msg);
+    }
+    if (box->ready) {
+        SDL_DestroySemaphore(box->ready);
+        box->ready = NULL;
+    }
+}
+
+//===============================================
+// Messages
+//===============================================
+
+// Encode buffer, held in a userdata so a Lua error while encoding does not leak it.
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    int array_count;
+    int buffer_count;
+} message_writer;
+
+static int writer_gc(lua_State* L) {
+    message_writer* w = (message_writer*)lua_touserdata(L, 1);
+    free(w->data);
+    w->data = NULL;
+    return 0;
+}
+
+static void writer_put(lua_State* L, message_writer* w, const void* p, size_t n) {
+    if (w->size + n > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity * 2 : 256;
+        while (capacity < w->size + n) capacity *= 2;
+        unsigned char* data = (unsigned char*)realloc(w->data, capacity);
+        if (!data) luaL_error(L, "Out of memory encoding worker message");
+        w->data = data;
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->size, p, n);
+    w->size += n;
+}
+
+static void writer_tag(lua_State* L, message_writer* w, unsigned char tag) {
+    writer_put(L, w, &tag, 1);
+}
+
+// Encode the value at idx. arrays and buffers are tables of the float arrays and runtime
+// buffers seen so far, both value -> index and index -> value; they are moved or shared
+// only after encoding succeeds.
+static void encode_value(lua_State* L, int idx, message_writer* w, int arrays, int buffers, int depth) {
+    switch (lua_type(L, idx)) {
+    case LUA_TNIL:
+        writer_tag(L, w, TAG_NIL);
+        break;
+    case LUA_TBOOLEAN:
+        writer_tag(L, w, lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE);
+        break;
+    case LUA_TNUMBER:
+        if (lua_isinteger(L, idx)) {
+            lua_Integer v = lua_tointeger(L, idx);
+            writer_tag(L, w, TAG_INTEGER);
+            writer_put(L, w, &v, sizeof(v));
+        } else {
+            lua_Number v = lua_tonumber(L, idx);
+            writer_tag(L, w, TAG_NUMBER);
+            writer_put(L, w, &v, sizeof(v));
+        }
+        break;
+    case LUA_TSTRING: {
+        size_t len;
+        const char* s = lua_tolstring(L, idx, &len);
+        writer_tag(L, w, TAG_STRING);
+        writer_put(L, w, &len, sizeof(len));
+        writer_put(L, w, s, len);
+        break;
+    }
+    case LUA_TTABLE:
+        if (depth >= WORKER_MAX_DEPTH) {
+            luaL_error(L, "Worker message nested deeper than %d tables (cyclic?)", WORKER_MAX_DEPTH);
+        }
+        luaL_checkstack(L, 3, "worker message nested too deeply");
+        writer_tag(L, w, TAG_TABLE);
+        lua_pushnil(L);
+        while (lua_next(L, idx)) {
+            int top = lua_gettop(L);
+            encode_value(L, top - 1, w, arrays, buffers, depth + 1);
+            encode_value(L, top, w, arrays, buffers, depth + 1);
+            lua_pop(L, 1);
+        }
+        writer_tag(L, w, TAG_END);
+        break;
+    case LUA_TUSERDATA: {
+        lua_SDL_FloatArray* arr = (lua_SDL_FloatArray*)luaL_testudata(L, idx, FLOAT_ARRAY_MT);
+        if (arr) {
+            if (!arr->data) luaL_error(L, "Cannot send an empty or already sent float array");
+            lua_pushvalue(L, idx);
+            if (lua_rawget(L, arrays) != LUA_TNIL) {
+                luaL_error(L, "Float array appears more than once in a worker message");
+            }
+            lua_pop(L, 1);
+            int index = w->array_count++;
+            lua_pushvalue(L, idx);
+            lua_pushinteger(L, index);
+            lua_rawset(L, arrays);
+            lua_pushvalue(L, idx);
+            lua_rawseti(L, arrays, index + 1);
+            writer_tag(L, w, TAG_ARRAY);
+            writer_put(L, w, &index, sizeof(index));
+            break;
+        }
+        lua_RuntimeBuffer* buf = lua_test_RuntimeBuffer(L, idx);
+        if (buf) {
+            if (!buf->buffer) luaL_error(L, "Cannot send a moved or released buffer");
+            lua_pushvalue(L, idx);
+            int type = lua_rawget(L, buffers);
+            if (type != LUA_TNIL && !buf->buffer->readonly) {
+                luaL_error(L, "Writable buffer appears more than once in a worker message");
+            }
+            int index;
+            if (type != LUA_TNIL) {
+                index = (int)lua_tointeger(L, -1); // Read-only: one reference serves every use
+                lua_pop(L, 1);
+            } else {
+                lua_pop(L, 1);
+                index = w->buffer_count++;
+                lua_pushvalue(L, idx);
+                lua_pushinteger(L, index);
+                lua_rawset(L, buffers);
+                lua_pushvalue(L, idx);
+                lua_rawseti(L, buffers, index + 1);
+            }
+            writer_tag(L, w, TAG_BUFFER);
+            writer_put(L, w, &index, sizeof(index));
+            break;
+        }
+    }
+    // fallthrough
+    default:
+        luaL_error(L, "Cannot send a %s in a worker message", luaL_typename(L, idx));
+    }
+}
+
+// Serialize the value at idx into a message for box. Float arrays and writable buffers in
+// it are moved: the sending userdata is left empty and the receiver takes over the data.
+// Read-only buffers are shared; both states keep a reference.
+static void send_value(lua_State* L, int idx, worker_mailbox* box, int sender) {
+    idx = lua_absindex(L, idx);
+    message_writer* w = (message_writer*)lua_newuserdatauv(L, sizeof(message_writer), 0);
+    memset(w, 0, sizeof(message_writer));
+    luaL_setmetatable(L, WRITER_MT);
+    lua_newtable(L);
+    int arrays = lua_gettop(L);
+    lua_newtable(L);
+    int buffers = lua_gettop(L);
+    encode_value(L, idx, w, arrays, buffers, 0);
+
+    // Header, array table, buffer table and bytes share one allocation.
+    size_t header = sizeof(worker_message) + (size_t)w->array_count * sizeof(worker_array) +
+                    (size_t)w->buffer_count * sizeof(runtime_buffer*);
+    worker_message* msg = (worker_message*)malloc(header + w->size);
+    if (!msg) luaL_error(L, "Out of memory sending worker message");
+    msg->sender = sender;
+    msg->array_count = w->array_count;
+    msg->buffer_count = w->buffer_count;
+    msg->arrays = (worker_array*)(msg + 1);
+    msg->buffers = (runtime_buffer**)(msg->arrays + w->array_count);
+    msg->bytes = (unsigned char*)msg + header;
+    msg->size = w->size;
+    memcpy(msg->bytes, w->data, w->size);
+    for (int i = 0; i < w->array_count; i++) {
+        lua_rawgeti(L, arrays, i + 1);
+        lua_SDL_FloatArray* arr = (lua_SDL_FloatArray*)lua_touserdata(L, -1);
+        msg->arrays[i].data = arr->data;
+        msg->arrays[i].count = arr->count;
+        arr->data = NULL;
+        arr->count = 0;
+        lua_pop(L, 1);
+    }
+    for (int i = 0; i < w->buffer_count; i++) {
+        lua_rawgeti(L, buffers, i + 1);
+        lua_RuntimeBuffer* buf = (lua_RuntimeBuffer*)lua_touserdata(L, -1);
+        msg->buffers[i] = buf->buffer;
+        if (buf->buffer->readonly) {
+            runtime_buffer_retain(buf->buffer);
+        } else {
+            buf->buffer = NULL;
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 3); // buffers, arrays, writer
+    mailbox_push(box, msg);
+}
+
+static void decode_value(lua_State* L, worker_message* msg, size_t* pos) {
+    luaL_checkstack(L, 3, "worker message nested too deeply");
+    unsigned char tag = msg->bytes[(*pos)++];
+    switch (tag) {
+    case TAG_NIL:
+        lua_pushnil(L);
+        break;
+    case TAG_FALSE:
+    case TAG_TRUE:
+        lua_pushboolean(L, tag == TAG_TRUE);
+        break;
+    case TAG_INTEGER: {
+        lua_Integer v;
+        memcpy(&v, msg->bytes + *pos, sizeof(v));
+        *pos += sizeof(v);
+        lua_pushinteger(L, v);
+        break;
+    }
+    case TAG_NUMBER: {
+        lua_Number v;
+        memcpy(&v, msg->bytes + *pos, sizeof(v));
+        *pos += sizeof(v);
+        lua_pushnumber(L, v);
+        break;
+    }
+    case TAG_STRING: {
+        size_t len;
+        memcpy(&len, msg->bytes + *pos, sizeof(len));
+        *pos += sizeof(len);
+        lua_pushlstring(L, (const char*)msg->bytes + *pos, len);
+        *pos += len;
+        break;
+    }
+    case TAG_TABLE:
+        lua_newtable(L);
+        while (msg->bytes[*pos] != TAG_END) {
+            decode_value(L, msg, pos);
+            decode_value(L, msg, pos);
+            lua_rawset(L, -3);
+        }
+        (*pos)++;
+        break;
+    case TAG_ARRAY: {
+        int index;
+        memcpy(&index, msg->bytes + *pos, sizeof(index));
+        *pos += sizeof(index);
+        worker_array* arr = &msg->arrays[index];
+        lua_push_SDL_FloatArray(L, arr->data, arr->count);
+        arr->data = NULL; // Owned by the new userdata
+        break;
+    }
+    case TAG_BUFFER: {
+        int index;
+        memcpy(&index, msg->bytes + *pos, sizeof(index));
+        *pos += sizeof(index);
+        lua_RuntimeBuffer* ud = lua_push_RuntimeBuffer(L, NULL);
+        ud->buffer = msg->buffers[index];
+        runtime_buffer_retain(ud->buffer); // The message drops its own reference when freed
+        break;
+    }
+    }
+}
+
+static int message_gc(lua_State* L) {
+    worker_message** holder = (worker_message**)lua_touserdata(L, 1);
+    if (*holder) {
+        message_free(*holder);
+        *holder = NULL;
+    }
+    return 0;
+}
+
+// Push the decoded value of msg and free it. The message is held by a userdata while
+// decoding so a Lua error does not leak it.
+static void push_message(lua_State* L, worker_message* msg) {
+    worker_message** holder = (worker_message**)lua_newuserdatauv(L, sizeof(worker_message*), 0);
+    *holder = msg;
+    luaL_setmetatable(L, MESSAGE_MT);
+    size_t pos = 0;
+    decode_value(L, msg, &pos);
+    message_free(msg);
+    *holder = NULL;
+    lua_remove(L, -2);
+}
+
+static void message_metatables(lua_State* L) {
+    luaL_newmetatable(L, WRITER_MT);
+    lua_pushcfunction(L, writer_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+    luaL_newmetatable(L, MESSAGE_MT);
+    lua_pushcfunction(L, message_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// Worker threads
+//===============================================
+
+static int worker_main(void* data) {
+    worker_thread* w = (worker_thread*)data;
+    lua_State* L = runtime_newstate();
+    if (!L) {
+        snprintf(w->error, sizeof(w->error), "Failed to create worker Lua state");
+        atomic_store(&w->finished, 1);
+        return 1;
+    }
+    luaL_openlibs(L);
+    luaL_requiref(L, "runtime", luaopen_runtime, 1);
+    lua_pop(L, 1); // Remove module from stack.
+    lua_pushlightuserdata(L, w);
+    lua_setfield(L, LUA_REGISTRYINDEX, SELF_KEY);
+    luaL_requiref(L, "worker", luaopen_worker, 1);
+    lua_pop(L, 1); // Remove module from stack.
+
+    int status = luaL_loadfile(L, w->path);
+    if (status == LUA_OK) status = lua_pcall(L, 0, 0, 0);
+    if (status != LUA_OK) {
+        const char* msg = lua_tostring(L, -1);
+        snprintf(w->error, sizeof(w->error), "%s", msg ? msg : "unknown error");
+    } else {
+        int dropped = runtime_drop_tasks(L);
+        if (dropped > 0) {
+            fprintf(stderr, "Warning: worker '%s' returned with %d task(s) still waiting; dropped them\n", w->path, dropped);
+        }
+    }
+    runtime_close(L);
+    atomic_store(&w->finished, 1);
+    return status == LUA_OK ? 0 : 1;
+}
+
+// Close the inbox, wait for the thread and free the worker.
+static void worker_release(worker_thread* w) {
+    if (w->thread) {
+        mailbox_close(&w->inbox);
+        SDL_WaitThread(w->thread, NULL);
+        w->thread = NULL;
+    }
+    mailbox_destroy(&w->inbox);
+    free(w->path);
+    free(w);
+}
+
+//===============================================
+// Worker handles (main state)
+//===============================================
+
+lua_Worker* lua_check_Worker(lua_State* L, int idx) {
+    lua_Worker* ud = (lua_Worker*)luaL_checkudata(L, idx, WORKER_MT);
+    if (!ud->worker) {
+        luaL_error(L, "Invalid worker (already joined)");
+    }
+    return ud;
+}
+
+// Forget the handle in the hub table so receive no longer returns it.
+static void forget_handle(lua_State* L, int idx, int id) {
+    if (lua_getiuservalue(L, idx, 1) == LUA_TUSERDATA && lua_getiuservalue(L, -1, 1) == LUA_TTABLE) {
+        lua_pushnil(L);
+        lua_rawseti(L, -2, id);
+    }
+    lua_pop(L, 2);
+}
+
+static int worker_gc(lua_State* L) {
+    lua_Worker* ud = (lua_Worker*)luaL_checkudata(L, 1, WORKER_MT);
+    if (ud->worker) {
+        worker_release(ud->worker);
+        ud->worker = NULL;
+    }
+    return 0;
+}
+
+// Send a value to the worker: w:send(value)
+// Tables, strings, numbers, booleans, sdl.float_array (moved, left empty here) and runtime.buffer
+// (moved when writable, shared when read-only).
+static int worker_send(lua_State* L) {
+    lua_Worker* ud = lua_check_Worker(L, 1);
+    luaL_checkany(L, 2);
+    if (atomic_load(&ud->worker->inbox.closed)) {
+        luaL_error(L, "Worker %d is closed", ud->worker->id);
+    }
+    send_value(L, 2, &ud->worker->inbox, 0);
+    return 0;
+}
+
+// Tell the worker no more messages follow: w:close()
+// Its worker.receive() returns nil, "closed" once the inbox is drained.
+static int worker_close(lua_State* L) {
+    lua_Worker* ud = lua_check_Worker(L, 1);
+    mailbox_close(&ud->worker->inbox);
+    return 0;
+}
+
+// Close the worker and wait for its script to end: w:join() -> true | false, error
+static int worker_join(lua_State* L) {
+    lua_Worker* ud = lua_check_Worker(L, 1);
+    worker_thread* w = ud->worker;
+    mailbox_close(&w->inbox);
+    SDL_WaitThread(w->thread, NULL);
+    w->thread = NULL;
+    int id = w->id;
+    int ok = w->error[0] == '\0';
+    if (ok) {
+        lua_pushboolean(L, 1);
+    } else {
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, w->error);
+    }
+    worker_release(w);
+    ud->worker = NULL;
+    forget_handle(L, 1, id);
+    return ok ? 1 : 2;
+}
+
+// Worker id, also passed to the worker script as worker.id(): w:id() -> integer
+static int worker_id(lua_State* L) {
+    lua_Worker* ud = lua_check_Worker(L, 1);
+    lua_pushinteger(L, ud->worker->id);
+    return 1;
+}
+
+// Whether the script is still running: w:running() -> boolean
+static int worker_running(lua_State* L) {
+    lua_Worker* ud = lua_check_Worker(L, 1);
+    lua_pushboolean(L, !atomic_load(&ud->worker->finished));
+    return 1;
+}
+
+static const struct luaL_Reg worker_methods[] = {
+    {"send", worker_send},
+    {"close", worker_close},
+    {"join", worker_join},
+    {"id", worker_id},
+    {"running", worker_running},
+    {NULL, NULL}
+};
+
+static void worker_metatable(lua_State* L) {
+    luaL_newmetatable(L, WORKER_MT);
+    lua_pushcfunction(L, worker_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, worker_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+//===============================================
+// Lua API (main state)
+//===============================================
+
+static worker_hub* check_hub(lua_State* L) {
+    return (worker_hub*)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+static int hub_gc(lua_State* L) {
+    worker_hub* hub = (worker_hub*)lua_touserdata(L, 1);
+    mailbox_destroy(&hub->inbox); // Handles keep the hub alive, so every worker is joined
+    return 0;
+}
+
+// Optional timeout in milliseconds at idx; negative waits forever.
+static Sint32 opt_timeout_ms(lua_State* L, int idx, Sint32 def) {
+    lua_Integer ms = luaL_optinteger(L, idx, def);
+    if (ms < 0) return -1;
+    return ms > SDL_MAX_SINT32 ? SDL_MAX_SINT32 : (Sint32)ms;
+}
+
+// Start a worker running a script: worker.spawn(path) -> worker
+static int l_worker_spawn(lua_State* L) {
+    worker_hub* hub = check_hub(L);
+    size_t len;
+    const char* path = luaL_checklstring(L, 1, &len);
+
+    lua_Worker* ud = (lua_Worker*)lua_newuserdatauv(L, sizeof(lua_Worker), 1);
+    ud->worker = NULL;
+    luaL_setmetatable(L, WORKER_MT);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_setiuservalue(L, -2, 1); // The hub outlives its workers
+
+    worker_thread* w = (worker_thread*)calloc(1, sizeof(worker_thread));
+    if (!w || !(w->path = (char*)malloc(len + 1))) {
+        free(w);
+        luaL_error(L, "Failed to allocate worker");
+    }
+    memcpy(w->path, path, len + 1);
+    if (!mailbox_init(&w->inbox)) {
+        free(w->path);
+        free(w);
+        luaL_error(L, "Failed to create worker mailbox: %s", SDL_GetError());
+    }
+    w->id = ++hub->next_id;
+    w->outbox = &hub->inbox;
+    atomic_init(&w->finished, 0);
+    ud->worker = w;
+
+    w->thread = SDL_CreateThread(worker_main, "lua_worker", w);
+    if (!w->thread) {
+        luaL_error(L, "Failed to start worker thread: %s", SDL_GetError());
+    }
+    lua_getiuservalue(L, lua_upvalueindex(1), 1);
+    lua_pushvalue(L, -2);
+    lua_rawseti(L, -2, w->id);
+    lua_pop(L, 1);
+    return 1;
+}
+
+// Take the next message from any worker: worker.receive([timeout_ms]) -> value, worker | nil
+// Returns immediately by default; a negative timeout waits until a message arrives.
+static int l_worker_receive(lua_State* L) {
+    worker_hub* hub = check_hub(L);
+    worker_message* msg = mailbox_wait(&hub->inbox, opt_timeout_ms(L, 1, 0));
+    if (!msg) {
+        lua_pushnil(L);
+        return 1;
+    }
+    int sender = msg->sender;
+    push_message(L, msg);
+    lua_getiuservalue(L, lua_upvalueindex(1), 1);
+    lua_rawgeti(L, -1, sender);
+    lua_remove(L, -2);
+    return 2;
+}
+
+static const struct luaL_Reg worker_lib[] = {
+    {"spawn", l_worker_spawn},
+    {"receive", l_worker_receive},
+    {NULL, NULL}
+};
+
+//===============================================
+// Lua API (worker state)
+//===============================================
+
+static worker_thread* check_self(lua_State* L) {
+    return (worker_thread*)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+// Send a value to the main state: worker.send(value)
+static int l_child_send(lua_State* L) {
+    worker_thread* w = check_self(L);
+    luaL_checkany(L, 1);
+    send_value(L, 1, w->outbox, w->id);
+    return 0;
+}
+
+// Wait for a message from the main state: worker.receive([timeout_ms]) -> value | nil, "closed" | "timeout"
+// Waits forever by default.
+static int l_child_receive(lua_State* L) {
+    worker_thread* w = check_self(L);
+    worker_message* msg = mailbox_wait(&w->inbox, opt_timeout_ms(L, 1, -1));
+    if (!msg) {
+        lua_pushnil(L);
+        lua_pushstring(L, atomic_load(&w->inbox.closed) ? "closed" : "timeout");
+        return 2;
+    }
+    push_message(L, msg);
+    return 1;
+}
+
+// This worker's id: worker.id() -> integer
+static int l_child_id(lua_State* L) {
+    lua_pushinteger(L, check_self(L)->id);
+    return 1;
+}
+
+// Create a float array to fill and send: worker.create_float_array(count) or worker.create_float_array({v1, v2, ...})
+static int l_child_create_float_array(lua_State* L) {
+    int is_table = lua_istable(L, 1);
+    lua_Integer count = is_table ? (lua_Integer)lua_rawlen(L, 1) : luaL_checkinteger(L, 1);
+    if (count < 0 || count > 0x7fffffff / (lua_Integer)sizeof(float)) {
+        luaL_error(L, "Invalid float array size: %d", (int)count);
+    }
+    float* data = (float*)calloc(count > 0 ? (size_t)count : 1, sizeof(float));
+    if (!data) luaL_error(L, "Failed to allocate float array");
+    lua_SDL_FloatArray* arr = lua_push_SDL_FloatArray(L, data, (int)count);
+    for (int i = 1; is_table && i <= count; i++) {
+        lua_rawgeti(L, 1, i);
+        arr->data[i - 1] = (float)luaL_checknumber(L, -1);
+        lua_pop(L, 1);
+    }
+    return 1;
+}
+
+static const struct luaL_Reg child_lib[] = {
+    {"send", l_child_send},
+    {"receive", l_child_receive},
+    {"id", l_child_id},
+    {"create_float_array", l_child_create_float_array},
+    {NULL, NULL}
+};
+
+//===============================================
+// module
+//===============================================
+
+// The main state gets spawn/receive; a worker state (marked in the registry before it
+// requires this module) gets send/receive towards the main state.
+int luaopen_worker(lua_State* L) {
+    message_metatables(L);
+    lua_getfield(L, LUA_REGISTRYINDEX, SELF_KEY);
+    worker_thread* self = (worker_thread*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (self) {
+        luaL_newlibtable(L, child_lib);
+        lua_pushlightuserdata(L, self);
+        luaL_setfuncs(L, child_lib, 1);
+        return 1;
+    }
+
+    worker_metatable(L);
+    luaL_newlibtable(L, worker_lib);
+    // Shared upvalue: the main mailbox; its uservalue maps worker ids to handles.
+    worker_hub* hub = (worker_hub*)lua_newuserdatauv(L, sizeof(worker_hub), 1);
+    memset(hub, 0, sizeof(worker_hub));
+    luaL_newmetatable(L, HUB_MT);
+    lua_pushcfunction(L, hub_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 1);
+    if (!mailbox_init(&hub->inbox)) {
+        luaL_error(L, "Failed to create worker mailbox: %s", SDL_GetError());
+    }
+    luaL_setfuncs(L, worker_lib, 1);
+    return 1;
+}
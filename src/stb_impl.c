@@ -0,0 +1,16 @@
+// stb_impl.c
+// Single translation unit holding the stb implementations used by the modules.
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_BMP
+#define STBI_ONLY_TGA
+#include <stb_image.h>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+// After stb_rect_pack so the font packer uses it instead of its fallback.
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb_truetype.h>